@@ -0,0 +1,91 @@
+#ifndef BIT_STREAM_H
+#define BIT_STREAM_H
+
+#include <cstdint>
+
+// 按位写入定长缓冲区，低位在前
+// 写入的位先攒在64位的暂存里，每满32位写出4个字节；超出容量后Overflowed为true，之后的写入被忽略。
+class BitWriter {
+public:
+    BitWriter(uint8_t* data, int capacity);
+
+    // bits为0 - 32，value高于bits的位必须为0
+    void WriteBits(uint32_t value, int bits);
+    void WriteBool(bool value) { WriteBits(value ? 1u : 0u, 1); }
+    // 写出暂存里剩下的位（最后一个字节补0），返回总字节数
+    int Flush();
+
+    int GetBitCount() const { return m_bytes * 8 + m_scratchBits; }
+    bool Overflowed() const { return m_overflow; }
+
+private:
+    uint8_t* m_data;
+    int m_capacity;
+    int m_bytes;
+    uint64_t m_scratch;
+    int m_scratchBits;
+    bool m_overflow;
+};
+
+// 按位读取，读过头后返回0，Failed为true
+class BitReader {
+public:
+    BitReader(const uint8_t* data, int size);
+
+    uint32_t ReadBits(int bits);
+    bool ReadBool() { return ReadBits(1) != 0; }
+
+    bool Failed() const { return m_failed; }
+
+private:
+    const uint8_t* m_data;
+    int m_size;
+    int m_bytes;
+    uint64_t m_scratch;
+    int m_scratchBits;
+    bool m_failed;
+};
+
+// 每个字段都要调用，放在头文件里内联
+inline void BitWriter::WriteBits(uint32_t value, int bits) {
+    if (m_overflow || bits == 0) {
+        return;
+    }
+    m_scratch |= static_cast<uint64_t>(value) << m_scratchBits;
+    m_scratchBits += bits;
+    if (m_scratchBits >= 32) {
+        if (m_bytes + 4 > m_capacity) {
+            m_overflow = true;
+            return;
+        }
+        uint32_t word = static_cast<uint32_t>(m_scratch);
+        m_data[m_bytes] = static_cast<uint8_t>(word);
+        m_data[m_bytes + 1] = static_cast<uint8_t>(word >> 8);
+        m_data[m_bytes + 2] = static_cast<uint8_t>(word >> 16);
+        m_data[m_bytes + 3] = static_cast<uint8_t>(word >> 24);
+        m_bytes += 4;
+        m_scratch >>= 32;
+        m_scratchBits -= 32;
+    }
+}
+
+inline uint32_t BitReader::ReadBits(int bits) {
+    if (bits == 0) {
+        return 0;
+    }
+    // 暂存不够时按字节补充
+    while (m_scratchBits < bits) {
+        if (m_bytes == m_size) {
+            m_failed = true;
+            return 0;
+        }
+        m_scratch |= static_cast<uint64_t>(m_data[m_bytes++]) << m_scratchBits;
+        m_scratchBits += 8;
+    }
+    uint32_t value = static_cast<uint32_t>(m_scratch & ((1ull << bits) - 1));
+    m_scratch >>= bits;
+    m_scratchBits -= bits;
+    return value;
+}
+
+#endif // BIT_STREAM_H
@@ -0,0 +1,120 @@
+#ifndef BOT_CONTROLLER_H
+#define BOT_CONTROLLER_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "PlayerMovement.h"
+
+class LevelGeometry;
+class NavPathfinder;
+
+struct BotSettings {
+    int tickRate = 128;
+    float separationRadius = 2.0f;  // 离其他机器人比这更近时互相推开（米），也是邻居网格的格子边长
+    float separationWeight = 1.5f;
+    float wallMargin = 3.0f;        // 离墙比这更近时往房间中间推
+    float goalSeconds = 4.0f;       // 平均每隔这么久换一个要去的点
+    float targetSeconds = 3.0f;     // 平均每隔这么久换一个要打的玩家
+    float turnSpeed = 540.0f;       // 每秒最多转的角度
+    float fireRange = 40.0f;
+    float fireCone = 4.0f;          // 水平瞄准误差小于这个角度时开火
+    float eyeHeight = 1.63f;
+    float aimHeight = 1.3f;         // 瞄准目标脚底以上这个高度（胸口）
+    int hotspots = 16;              // 有导航网格时目标点从这么多个固定的地点里挑（路径缓存能命中）
+    float waypointRadius = 1.0f;    // 离路径上的下一个拐点这么近时走向再下一个
+    bool simd = true;               // false时避让用标量代码（比较用）
+};
+
+// 机器人能看到的一个玩家（别的机器人或者真人）
+struct BotTarget {
+    int slot;
+    glm::vec3 position;
+    bool alive;
+};
+
+struct BotStats {
+    long long thinks = 0;
+    long long commands = 0;
+    long long attacks = 0;          // 按着开火的命令
+    double thinkSeconds = 0.0;
+    double steerSeconds = 0.0;      // 其中建邻居网格和算分离力的时间
+};
+
+// 一群机器人的大脑，不管命令怎么送到服务器：同一进程里直接放进模拟的命令队列，或者每个机器人一个回环客户端。
+// 每帧调用者先用Observe告诉每个机器人自己的位置和死活，SetTargets给出所有可以打的玩家，
+// 然后Think为每个机器人生成一个命令（和真人一样的视角、移动和按键）。
+// 移动：朝随机选的目标点走，离其他机器人太近时互相推开，离墙太近时往回推。
+// 有导航网格（SetNavigation）时目标点从几个固定的地点里挑，寻路后沿着拐点走，寻路失败时直接朝目标点走。
+// 分离力是唯一和机器人数的平方有关的部分，所以机器人按位置计数排序进边长为separationRadius的均匀网格，
+// 每个机器人只看周围3x3格，同一行的3格在排好的数组里是连续的，用SSE2一次算4个邻居。
+// 瞄准：每隔几秒在几个随机的活着的玩家里挑最近的一个，按turnSpeed转过去，对准了并且在射程内时开火。
+// 状态按字段分开存（SoA），1000个以上的机器人每帧也只要几十微秒。
+class BotController {
+public:
+    BotController(const LevelGeometry& level, const BotSettings& settings = BotSettings());
+
+    // 返回机器人的编号；slot是它在服务器上的槽位（不打自己），还没连上时为-1，之后用SetSlot设置
+    int AddBot(int slot, uint32_t seed);
+    void SetSlot(int bot, int slot) { m_slots[bot] = slot; }
+    int GetSlot(int bot) const { return m_slots[bot]; }
+    int GetCount() const { return static_cast<int>(m_slots.size()); }
+    // 所有机器人共用的寻路（要在AddBot之前设置），nullptr为不用
+    void SetNavigation(NavPathfinder* pathfinder);
+
+    // 这一帧机器人自己的位置（脚底）和死活
+    void Observe(int bot, const glm::vec3& position, bool alive);
+    // 这一帧所有可以打的玩家
+    void SetTargets(const std::vector<BotTarget>& targets);
+    // 生成这一帧的命令，commands[bot]
+    void Think(int tick, std::vector<PlayerCommand>& commands);
+
+    const BotSettings& GetSettings() const { return m_settings; }
+    const BotStats& GetStats() const { return m_stats; }
+
+private:
+    BotSettings m_settings;
+    float m_extent;                         // 房间中心到墙的距离
+
+    // 每个机器人，按编号
+    std::vector<int> m_slots;
+    std::vector<float> m_posX, m_posY, m_posZ;
+    std::vector<uint8_t> m_alive;
+    std::vector<float> m_goalX, m_goalZ;
+    std::vector<int> m_goalTick;            // 到这一帧换目标点
+    std::vector<std::vector<glm::vec3>> m_paths;  // 到目标点的拐点，空为直接走
+    std::vector<int> m_pathNext;            // 正在走向的拐点
+    std::vector<float> m_sepX, m_sepZ;      // 分离力
+    std::vector<float> m_yaw, m_pitch;      // 现在的视角（度）
+    std::vector<int> m_target;              // 要打的玩家的槽位，-1为没有
+    std::vector<int> m_targetTick;          // 到这一帧换目标
+    std::vector<uint32_t> m_random;
+
+    NavPathfinder* m_pathfinder;
+    std::vector<glm::vec3> m_hotspots;
+
+    // 邻居网格：活着的机器人按格子排好，格子c里的在m_sorted*[m_cellStarts[c]...m_cellStarts[c + 1]]，
+    // 数组末尾多留一组，SIMD可以整组读
+    int m_gridSize;
+    std::vector<int> m_cellStarts;
+    std::vector<int> m_cells;               // 每个机器人的格子，死了为-1
+    std::vector<float> m_sortedX, m_sortedZ;
+
+    std::vector<BotTarget> m_targets;
+    std::vector<int> m_targetIndex;         // 槽位对应m_targets里的下标，-1为不在
+
+    BotStats m_stats;
+
+    float NextRandom(int bot);              // [0, 1)
+    void PickGoal(int bot, int tick);
+    void PickTarget(int bot, int tick);
+    void BuildGrid();
+    int CellCoordinate(float value) const;
+    // 机器人[begin, end)的分离力
+    void SeparateScalar(int begin, int end);
+#if defined(__SSE2__)
+    void SeparateSSE2(int begin, int end);
+#endif
+};
+
+#endif // BOT_CONTROLLER_H
@@ -0,0 +1,104 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// 包围盒相交的一对物体（句柄），a < b
+struct BroadphasePair {
+    int a;
+    int b;
+};
+
+struct BroadphaseStats {
+    int entities = 0;
+    int large = 0;          // 跨的格子太多、单独处理的物体
+    int entries = 0;        // 网格中的 (格子, 物体) 项
+    int buckets = 0;
+    int moved = 0;          // 上次刷新以来换了格子的物体
+    int pairTests = 0;      // 上次FindPairs做的包围盒测试
+    int pairs = 0;
+};
+
+// 宽相位：均匀网格的空间哈希
+// 每个物体的包围盒和它覆盖的格子范围按句柄放在一起，SetBounds只写入新的包围盒并比较格子范围；
+// 没有物体换格子时网格不动，否则用计数排序把所有 (格子, 物体) 项按桶重新排好（线性时间，数组在帧之间复用，
+// 不分配内存）。桶号是格子坐标各取低几位拼起来的（网格在每个轴上循环），相邻的格子不会落进同一个桶；
+// 桶数取不小于项数的2的幂。排序时顺便记下有两项以上的桶，FindPairs只看这些桶。
+// 一对物体只在它们共同覆盖的第一个格子里报告，不需要去重。
+// 跨的格子超过MAX_CELLS_PER_ENTITY的大物体不进网格，与所有物体逐个测试。
+// 格子大小取常见物体的大小（玩家、投射物），太小时一个物体占很多格子，太大时每个桶里的物体太多。
+class Broadphase {
+public:
+    static const int MAX_CELLS_PER_ENTITY = 8;
+
+    explicit Broadphase(float cellSize = 2.0f);
+
+    void Clear();
+    // 返回句柄，删除的句柄会被重新使用
+    int Add(const glm::vec3& minBounds, const glm::vec3& maxBounds);
+    void Remove(int handle);
+    // 物体移动后调用；只记下包围盒，网格在下一次Refresh或FindPairs时更新
+    void SetBounds(int handle, const glm::vec3& minBounds, const glm::vec3& maxBounds);
+
+    // 让网格与当前的包围盒一致，Query之前需要调用（FindPairs会调用）
+    void Refresh();
+    // 每帧调用一次，pairs被清空后填入所有包围盒相交的对
+    void FindPairs(std::vector<BroadphasePair>& pairs);
+    // 与包围盒相交的物体，handles被清空后填入；网格需要是最新的，多个线程可以同时查询
+    void Query(const glm::vec3& minBounds, const glm::vec3& maxBounds, std::vector<int>& handles) const;
+
+    int GetCount() const { return m_count; }
+    const BroadphaseStats& GetStats() const { return m_stats; }
+
+private:
+    // 物体覆盖的格子范围，闭区间
+    struct CellRange {
+        int minX, minY, minZ;
+        int maxX, maxY, maxZ;
+    };
+
+    struct Proxy {
+        glm::vec3 minBounds;
+        glm::vec3 maxBounds;
+        CellRange cells;
+    };
+
+    struct Entry {
+        int x, y, z;
+        int entity;
+    };
+
+    float m_cellSize;
+    float m_inverseCellSize;
+    int m_count;
+    int m_entryCount;       // 网格中的项数，随SetBounds更新
+    int m_moved;
+    bool m_gridDirty;
+
+    // 按句柄存放
+    std::vector<Proxy> m_proxies;
+    std::vector<uint8_t> m_alive;
+    std::vector<int> m_freeHandles;
+
+    // 网格：m_entries按桶排好，桶b的项为 [m_bucketStart[b], m_bucketStart[b + 1])
+    std::vector<Entry> m_entries;
+    std::vector<Entry> m_unsorted;
+    std::vector<uint32_t> m_unsortedBuckets;
+    std::vector<int> m_bucketStart;
+    std::vector<int> m_pairBuckets;     // 有两项以上的桶
+    std::vector<int> m_large;
+    uint32_t m_bucketMaskX, m_bucketMaskY, m_bucketMaskZ;
+    int m_bucketShiftY, m_bucketShiftZ;
+
+    BroadphaseStats m_stats;
+
+    CellRange ComputeCells(const glm::vec3& minBounds, const glm::vec3& maxBounds) const;
+    uint32_t Bucket(int x, int y, int z) const;
+    static bool Overlaps(const Proxy& a, const glm::vec3& minBounds, const glm::vec3& maxBounds);
+    static bool IsLarge(const CellRange& cells);
+    static int GridEntries(const CellRange& cells);
+};
+
+#endif // BROADPHASE_H
@@ -0,0 +1,71 @@
+#ifndef CLIENT_PREDICTION_H
+#define CLIENT_PREDICTION_H
+
+#include <glm/glm.hpp>
+#include "PlayerMovement.h"
+
+struct PredictionStats {
+    long long commands = 0;
+    long long corrections = 0;        // 服务器的状态和预测不一致、重新模拟的次数
+    long long replayedTicks = 0;
+    long long snaps = 0;              // 误差太大（复活、传送）直接跳过去的次数
+    int maxReplayTicks = 0;
+    double replaySeconds = 0.0;
+};
+
+// 客户端预测
+// 本地的命令立即用和服务器相同的PlayerMovement模拟，命令和模拟后的状态按帧号存进环形缓冲区，直到服务器确认。
+// 快照带着服务器执行到的最后一个命令和之后的准确状态：和当时预测的一样就什么都不做；不一样时从服务器的状态
+// 重新模拟之后所有没确认的命令，新旧预测的位置差记为显示误差，按时间常数SMOOTH_SECONDS指数衰减，画面不会跳。
+// 移动是确定的，只有丢了命令、死亡和复活时才需要重新模拟。
+class ClientPrediction {
+public:
+    static const int COMMAND_RING = 256;          // 128帧时2秒
+    static constexpr float SMOOTH_SECONDS = 0.1f; // 显示误差衰减的时间常数
+    static constexpr float SNAP_DISTANCE = 2.0f;  // 误差超过这个距离时不平滑
+
+    explicit ClientPrediction(const PlayerMovement& movement);
+
+    // 清空命令，从state开始
+    void Reset(const PlayerState& state);
+
+    // 执行一个本地命令（帧号必须递增），返回模拟后的状态
+    const PlayerState& Predict(const PlayerCommand& command);
+    // 服务器执行完ackCommandTick这个命令之后，玩家的状态是server；alive为false时命令不移动玩家（和服务器一样）
+    void Reconcile(int ackCommandTick, const PlayerState& server, bool alive);
+    // 显示误差按经过的时间衰减
+    void UpdateSmoothing(float deltaSeconds);
+
+    const PlayerState& GetState() const { return m_state; }
+    // 最近两个预测帧之间按alpha插值的位置，加上还没衰减完的误差
+    glm::vec3 GetRenderPosition(float alpha) const;
+    int GetLatestTick() const { return m_latestTick; }
+    // 还没被服务器确认的命令数
+    int GetPendingCount() const;
+    const PredictionStats& GetStats() const { return m_stats; }
+
+private:
+    struct Entry {
+        PlayerCommand command;
+        PlayerState state;        // 执行这个命令之后
+    };
+
+    const PlayerMovement& m_movement;
+    Entry m_ring[COMMAND_RING];
+    PlayerState m_state;
+    PlayerState m_previousState;
+    PlayerState m_baseState;      // 第一个命令之前的状态
+    int m_latestTick;             // 最后一个预测的命令，-1为还没有
+    int m_firstTick;              // Reset之后的第一个命令
+    int m_ackTick;                // 服务器确认的最后一个命令
+    bool m_alive;
+    glm::vec3 m_error;
+    PredictionStats m_stats;
+
+    bool HasEntry(int tick) const;
+    // 执行完tick这个命令之后预测的状态，已经不在环形缓冲区里时返回空
+    const PlayerState* PredictedAt(int tick) const;
+    void Step(PlayerState& state, const PlayerCommand& command) const;
+};
+
+#endif // CLIENT_PREDICTION_H
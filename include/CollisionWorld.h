@@ -0,0 +1,122 @@
+#ifndef COLLISION_WORLD_H
+#define COLLISION_WORLD_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class LevelGeometry;
+struct LevelHit;
+
+// 扫掠查询的最早接触
+struct SweepHit {
+    float time;          // 沿位移的比例 [0, 1]，开始时已经相交为0
+    glm::vec3 position;  // 接触时形状的起点（球心或胶囊的下端点）
+    glm::vec3 normal;    // 接触法线，从三角形指向形状
+    float depth;         // 开始时已经相交的深度，否则为0
+    int surface;         // 三角形所属的关卡表面（LevelSurfaceId），AddBox添加的物体为其surface参数
+};
+
+// 移动并沿接触面滑动的结果
+struct CollisionMoveResult {
+    static const int MAX_CONTACTS = 4;
+
+    glm::vec3 position;
+    int contactCount;
+    glm::vec3 normals[MAX_CONTACTS];  // 接触过的面的法线，相近的只记一次
+};
+
+// 射线穿过的一个三角形
+struct RayHit {
+    float distance;
+    glm::vec3 normal;    // 三角形的法线（表面朝外的一侧，不按射线方向翻转）
+    int surface;
+    int material;        // 表面的材质（LevelMaterial），没有设置时为0
+    float thickness;     // 表面背后实体的厚度，没有设置时为0
+};
+
+// 一条射线的所有交点，按距离排好
+struct RayHitList {
+    static const int MAX_HITS = 16;
+
+    int count;
+    RayHit hits[MAX_HITS];   // 超过MAX_HITS个时只保留最近的
+};
+
+// 三角形碰撞世界
+// 关卡的所有三角形（和放进房间的物体）放进一棵BVH，节点按包围盒最长轴的中点划分，
+// 叶子最多4个三角形，节点展开成数组，左孩子紧跟在父节点后面。
+// 查询是连续的：球或胶囊（线段 + 半径）沿位移扫掠，对每个候选三角形做保守前进——
+// 形状与三角形的最近距离是时间的凸函数，按当前距离和接近速度前进永远不会越过第一次接触，
+// 所以快速移动也不会穿过薄的表面（玻璃只有几厘米）。
+// 射线查询可以把最多4条射线打成一个包一起遍历：包围盒和三角形都用SSE一次测试4条射线，
+// 节点只要被包里的一条射线碰到就展开，方向和起点相近的射线（同一个人的连射、霰弹）共用一次遍历。
+// 查询不分配内存也不修改状态，多个线程可以同时查询。
+class CollisionWorld {
+public:
+    static const int MAX_SLIDES = 4;   // MoveCapsule每次最多处理的接触次数
+    static constexpr int RAY_PACKET_SIZE = 4;
+
+    CollisionWorld();
+
+    void Clear();
+    // 关卡所有表面的三角形，包括窗框和玻璃
+    void AddLevel(const LevelGeometry& level);
+    void AddTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, int surface);
+    // 轴对齐盒子的12个三角形，用于放进房间的物体
+    void AddBox(const glm::vec3& minBounds, const glm::vec3& maxBounds, int surface);
+    // 表面的材质和背后实体的厚度，射线交点会带上；AddLevel会设置关卡的表面
+    void SetSurface(int surface, int material, float thickness);
+    // 添加完三角形后构建BVH，之后才能查询
+    void Build();
+
+    int GetTriangleCount() const { return static_cast<int>(m_triangles.size()); }
+    int GetNodeCount() const { return static_cast<int>(m_nodes.size()); }
+
+    // 半径为radius的球从start移动delta，返回是否有接触，hit为最早的一个
+    bool SweepSphere(const glm::vec3& start, const glm::vec3& delta, float radius, SweepHit& hit) const;
+    // 胶囊为线段 [start, start + axis] 加半径radius
+    bool SweepCapsule(const glm::vec3& start, const glm::vec3& axis, const glm::vec3& delta, float radius,
+                      SweepHit& hit) const;
+
+    // 最近的交点，direction需要归一化；结果与LevelGeometry::Raycast相同
+    bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, LevelHit& hit) const;
+    // count条射线（最多RAY_PACKET_SIZE）一起遍历，results[i]为第i条射线在maxDistances[i]以内的所有交点；
+    // 同一个表面在同一距离上的交点（射在两个三角形的公共边上）只记一次
+    void RaycastPacket(const glm::vec3* origins, const glm::vec3* directions, const float* maxDistances, int count,
+                       RayHitList* results) const;
+
+    // 移动胶囊，碰到表面后停在表面前，剩余的位移去掉指向表面的分量后继续（两个面之间沿交线滑动）；
+    // 开始时已经相交的先沿法线推出。axis为0时就是球
+    CollisionMoveResult MoveCapsule(const glm::vec3& start, const glm::vec3& axis, const glm::vec3& delta,
+                                    float radius) const;
+
+private:
+    struct Triangle {
+        glm::vec3 a, b, c;
+        glm::vec3 normal;
+        int surface;
+    };
+
+    // 叶子：first为第一个三角形，count > 0；内部节点：count为0，左孩子为下一个节点，first为右孩子
+    struct Node {
+        glm::vec3 minBounds;
+        int first;
+        glm::vec3 maxBounds;
+        int count;
+    };
+
+    struct SurfaceInfo {
+        int material;
+        float thickness;
+    };
+
+    std::vector<Triangle> m_triangles;
+    std::vector<Node> m_nodes;
+    std::vector<SurfaceInfo> m_surfaces;   // 按表面编号
+
+    int BuildNode(int first, int count, int depth, std::vector<glm::vec3>& centroids);
+    bool SweepTriangle(const Triangle& triangle, const glm::vec3& start, const glm::vec3& axis,
+                       const glm::vec3& delta, float radius, float maxTime, SweepHit& hit) const;
+};
+
+#endif // COLLISION_WORLD_H
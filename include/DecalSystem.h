@@ -0,0 +1,84 @@
+#ifndef DECAL_SYSTEM_H
+#define DECAL_SYSTEM_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "Image.h"
+
+// 贴花图集
+// 所有贴花图像按行（shelf）打包进一张图，每张图周围复制边缘像素作为间隔，
+// 双线性过滤不会采到相邻的图。区域的uv为 (左, 上, 右, 下)，v从图像顶行开始。
+class DecalAtlas {
+public:
+    DecalAtlas(int width = 1024, int height = 1024, int padding = 2);
+
+    // 返回区域编号，放不下返回-1
+    int Add(const Image& image);
+
+    const Image& GetImage() const { return m_image; }
+    const glm::vec4& GetRegion(int region) const { return m_regions[region]; }
+    int GetRegionCount() const { return static_cast<int>(m_regions.size()); }
+
+private:
+    Image m_image;
+    int m_padding;
+    int m_shelfX, m_shelfY, m_shelfHeight;
+    std::vector<glm::vec4> m_regions;
+};
+
+// 生成弹孔图像：黑色孔洞、浅色边缘、向外淡出的焦痕和几条裂纹
+void GenerateBulletHoleImage(int size, uint32_t seed, Image& image);
+
+// 贴花系统
+// 固定容量的环形缓冲区，满了以后新的贴花覆盖最旧的，运行中不分配内存。
+// 数据按属性分数组存放（SoA），每个数组直接作为一个实例属性上传：
+//   中心、U轴（右方向 * 半宽）、V轴（上方向 * 半高）、图集uv、颜色
+// 第k个（从0开始计数的）贴花放在槽位 k % capacity，渲染器根据GetAddedCount
+// 只上传新增的槽位；Clear之后GetGeneration改变，需要全部重新上传。
+class DecalSystem {
+public:
+    // 贴花离墙面的距离，避免与墙面深度冲突
+    static constexpr float SURFACE_OFFSET = 0.02f;
+
+    explicit DecalSystem(int capacity = 4096);
+
+    void Clear();
+
+    // normal为表面朝外的法线，up不能与normal平行；返回使用的槽位
+    int Add(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& up,
+            float halfWidth, float halfHeight, const glm::vec4& uvRect,
+            const glm::vec4& color = glm::vec4(1.0f));
+
+    int GetCapacity() const { return m_capacity; }
+    int GetCount() const { return static_cast<int>(std::min<uint64_t>(m_added, m_capacity)); }
+    uint64_t GetAddedCount() const { return m_added; }
+    uint32_t GetGeneration() const { return m_generation; }
+
+    // 从最旧到最新第i个贴花所在的槽位
+    int GetSlot(int i) const;
+
+    // 按槽位访问的SoA数组，长度为容量
+    const glm::vec3* GetCenters() const { return m_centers.data(); }
+    const glm::vec3* GetAxesU() const { return m_axesU.data(); }
+    const glm::vec3* GetAxesV() const { return m_axesV.data(); }
+    const glm::vec4* GetUvRects() const { return m_uvRects.data(); }
+    const glm::vec4* GetColors() const { return m_colors.data(); }
+
+    // 槽位上贴花的四个角（左下、右下、右上、左上）和对应的uv
+    void GetCorners(int slot, glm::vec3 corners[4], glm::vec2 uvs[4]) const;
+
+private:
+    int m_capacity;
+    uint64_t m_added;
+    uint32_t m_generation;
+
+    std::vector<glm::vec3> m_centers;
+    std::vector<glm::vec3> m_axesU;
+    std::vector<glm::vec3> m_axesV;
+    std::vector<glm::vec4> m_uvRects;
+    std::vector<glm::vec4> m_colors;
+};
+
+#endif // DECAL_SYSTEM_H
@@ -0,0 +1,135 @@
+#ifndef DEMO_RECORDING_H
+#define DEMO_RECORDING_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "GameSimulation.h"
+#include "NetProtocol.h"
+#include "SnapshotEncoder.h"
+
+// 录像文件（小端序），只在末尾追加：
+//   文件头    标识"CSDM"、版本u32、帧率u16、槽位数u16、SnapshotFormat（4个f32、2个u8）
+//   块        标识"DCHK"、第一帧u32、帧数u32、数据字节数u32，然后是连续的每一帧：
+//             命令个数u16、命令（槽位u8、命令、看到的时间f32）、快照字节数u16、快照位流
+//             每块的第一帧是完整快照（关键帧），之后的帧相对上一帧差量编码
+//   索引      标识"DIDX"、块数u32、每块第一帧u32、帧数u32、文件偏移u64
+//   结尾      索引的文件偏移u64、标识"DEND"
+// 录像中途退出时没有索引和结尾，读的时候顺着块头扫一遍重建索引，只丢掉最后没写完的块。
+const uint32_t DEMO_FILE_ID = 0x4D445343;      // "CSDM"
+const uint32_t DEMO_VERSION = 1;
+
+struct DemoStats {
+    long long ticks = 0;
+    long long chunks = 0;
+    long long commands = 0;
+    long long snapshotBytes = 0;
+    long long commandBytes = 0;
+    long long fileBytes = 0;
+};
+
+// 录像（服务器端）
+// 每帧记下执行的命令和所有玩家的状态，玩家状态用和网络相同的SnapshotEncoder相对上一帧差量编码。
+// 一块的数据先放在内存里，每KEYFRAME_INTERVAL帧（或者帧号不连续时）以一个关键帧开始新的一块，
+// 旧的块一次写进文件，所以任何时候文件里都是完整的块。
+class DemoRecorder {
+public:
+    static const int KEYFRAME_INTERVAL = 256;      // 128帧时2秒
+
+    DemoRecorder();
+    ~DemoRecorder();
+
+    bool Open(const std::string& path, int tickRate, int maxPlayers, const SnapshotFormat& format = SnapshotFormat());
+    // 写完最后一块、索引和结尾
+    bool Close();
+    bool IsOpen() const { return m_file != nullptr; }
+
+    void RecordTick(int tick, const std::vector<NetPlayerState>& players, const std::vector<ExecutedCommand>& commands);
+    const DemoStats& GetStats() const { return m_stats; }
+
+private:
+    struct IndexEntry {
+        int firstTick;
+        int tickCount;
+        uint64_t offset;
+    };
+
+    FILE* m_file;
+    bool m_failed;
+    std::unique_ptr<SnapshotEncoder> m_encoder;
+    std::vector<uint8_t> m_chunk;           // 当前块的每一帧（不含块头）
+    int m_chunkSize;
+    int m_chunkFirstTick;
+    int m_chunkTicks;
+    int m_lastTick;
+    uint64_t m_offset;                      // 下一次写的文件偏移
+    std::vector<IndexEntry> m_index;
+    std::vector<uint8_t> m_snapshot;
+    DemoStats m_stats;
+
+    void FlushChunk();
+    void WriteFile(const uint8_t* data, int size);
+};
+
+// 录像里的一帧
+struct DemoFrame {
+    int tick = -1;
+    std::vector<NetPlayerState> players;
+    std::vector<ExecutedCommand> commands;
+};
+
+// 录像回放
+// 文件整个映射进内存，读索引（没有时扫描块头）。Seek跳到包含目标帧的块，从它的关键帧开始解码到目标帧，
+// 最多解码KEYFRAME_INTERVAL帧；ReadTick顺序读下一帧，不需要窗口和定时，可以远快于实时。
+class DemoPlayer {
+public:
+    DemoPlayer();
+    ~DemoPlayer();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    int GetTickRate() const { return m_tickRate; }
+    int GetMaxPlayers() const { return m_maxPlayers; }
+    int GetFirstTick() const { return m_chunks.empty() ? -1 : m_chunks.front().firstTick; }
+    int GetLastTick() const { return m_chunks.empty() ? -1 : m_chunks.back().firstTick + m_chunks.back().tickCount - 1; }
+    int GetChunkCount() const { return static_cast<int>(m_chunks.size()); }
+    // 索引是从文件里读的（false为扫描块头重建的）
+    bool HasIndex() const { return m_hasIndex; }
+    size_t GetFileSize() const { return m_size; }
+
+    // 之后的ReadTick从tick开始；tick不在录像里（或者在两块之间的空隙里）时返回false
+    bool Seek(int tick);
+    // 读下一帧，到结尾或数据损坏时返回false
+    bool ReadTick(DemoFrame& frame);
+
+private:
+    struct Chunk {
+        int firstTick;
+        int tickCount;
+        uint64_t offset;                    // 块头的位置
+        uint32_t size;                      // 块头之后的数据字节数
+    };
+
+    int m_fd;
+    const uint8_t* m_data;
+    size_t m_size;
+    int m_tickRate;
+    int m_maxPlayers;
+    bool m_hasIndex;
+    std::unique_ptr<SnapshotDecoder> m_decoder;
+    std::vector<Chunk> m_chunks;
+    int m_chunk;                            // 当前的块，-1为还没开始
+    int m_chunkTick;                        // 下一帧是当前块的第几帧
+    size_t m_cursor;                        // 下一帧在文件里的位置
+    DemoFrame m_scratch;                    // Seek时跳过的帧
+
+    bool ReadIndex(size_t headerSize);
+    bool ScanChunks(size_t headerSize);
+    bool ReadChunkHeader(uint64_t offset, Chunk& chunk) const;
+    void EnterChunk(int chunk);
+};
+
+#endif // DEMO_RECORDING_H
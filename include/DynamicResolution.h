@@ -0,0 +1,42 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+// 动态分辨率控制参数
+struct DynamicResolutionSettings {
+    float targetMilliseconds = 14.0f; // 场景渲染预算，60Hz的16.7ms里给放大和交换留出余量
+    float minScale = 0.5f;            // 每个方向上的最小缩放
+    float maxScale = 1.0f;
+    float kp = 0.10f;                 // 位置式PID系数，误差为相对预算的比例，输出是相对maxScale的缩放
+    float ki = 0.05f;                 // 每帧把ki * 误差累积进积分项
+    float kd = 0.05f;
+};
+
+// 动态分辨率控制器
+// 输入每帧测得的GPU场景渲染时间，输出下一帧的分辨率缩放（每个方向）。
+// 平时用位置式PID慢慢逼近预算（缩放 = maxScale + 输出，稳态的偏移由积分项保持，误差为0时不再变化）；严重超出预算时按像素数与时间成正比直接降一级，
+// 保证一两帧内回到预算内。不依赖OpenGL，计时来源由调用者决定。
+class DynamicResolution {
+public:
+    explicit DynamicResolution(const DynamicResolutionSettings& settings = DynamicResolutionSettings());
+
+    void SetSettings(const DynamicResolutionSettings& settings);
+    const DynamicResolutionSettings& GetSettings() const { return m_settings; }
+
+    void Reset(float scale = 1.0f);
+
+    // 用上一帧的测量值更新，返回新的缩放
+    float Update(float frameMilliseconds);
+    float GetScale() const { return m_scale; }
+
+    // 输出尺寸按当前缩放得到的渲染尺寸，对齐到8像素，避免每帧细微变化
+    void GetRenderSize(int outputWidth, int outputHeight, int& width, int& height) const;
+
+private:
+    DynamicResolutionSettings m_settings;
+    float m_scale;
+    float m_integral;                 // 积分项（已乘ki，缩放单位），在[minScale - maxScale, 0]内
+    float m_previousError;
+    bool m_hasPrevious;
+};
+
+#endif // DYNAMIC_RESOLUTION_H
@@ -0,0 +1,42 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <vector>
+
+// 低延迟帧节奏
+// 开启垂直同步时，帧尽早开始只会让画面在交换前多等待，输入更旧。
+// FramePacer记录最近若干帧从开始到渲染完成的耗时，用其高百分位加安全余量预测本帧耗时，
+// 然后睡到 "下一次垂直同步 - 预测耗时" 才开始这一帧。
+// 时间单位为秒，来自同一个单调时钟。
+class FramePacer {
+public:
+    FramePacer(double refreshRate = 60.0, double safetyMargin = 0.001);
+
+    void SetRefreshRate(double refreshRate);
+    double GetRefreshInterval() const { return m_refreshInterval; }
+
+    // 睡到本帧最晚的开始时间，返回实际开始时间
+    double WaitForFrameStart(double now);
+
+    // 本帧渲染完成（交换之前，GPU已经完成）
+    void OnRenderComplete(double now);
+
+    // 交换完成，即垂直同步时刻
+    void OnPresent(double now);
+
+    double GetPredictedWork() const;
+
+private:
+    static const int HISTORY = 64;
+
+    double m_refreshInterval;
+    double m_safetyMargin;
+    double m_frameStart;
+    double m_lastPresent;
+    std::vector<double> m_workHistory;
+    int m_nextWork;
+    int m_workCount;
+    mutable std::vector<double> m_sorted;
+};
+
+#endif // FRAME_PACER_H
@@ -0,0 +1,98 @@
+#ifndef GAME_CLIENT_H
+#define GAME_CLIENT_H
+
+#include <cstdint>
+#include <vector>
+#include "NetProtocol.h"
+#include "NetSocket.h"
+#include "SnapshotEncoder.h"
+#include "SnapshotInterpolator.h"
+
+// 客户端收到的一个快照
+struct ClientSnapshot {
+    int tick = -1;
+    int ackCommandTick = -1;          // 服务器执行到的我们的最后一个命令
+    int serverTickMicros = 0;         // 服务器上一帧用的时间（收包、模拟和发快照）
+    PlayerState localState = {};      // 执行完这个命令之后我们的玩家的准确状态
+    std::vector<NetPlayerState> players;
+};
+
+struct ClientStats {
+    long long snapshots = 0;
+    long long droppedSnapshots = 0;   // 差量基准已经不在了，解不出来
+    long long bytesIn = 0;
+    long long bytesOut = 0;
+    long long simulatedLoss = 0;      // 模拟网络条件丢掉的包（两个方向）
+};
+
+// 模拟的网络条件，只用来在本机回环上测试：单程延迟、在它上面随机增加的抖动（会乱序）和丢包率
+struct NetworkConditions {
+    double latencySeconds = 0.0;
+    double jitterSeconds = 0.0;
+    float lossPercent = 0.0f;
+};
+
+// 连接服务器的客户端（网络部分）
+// Connect之后每次Update都收完所有的包，连上之前每0.5秒重发一次连接请求；
+// SendCommand发送这个命令和之前的几个命令，丢一个包不会丢命令。只保留最新的快照；
+// 命令包里确认的是最新解码成功的快照，服务器拿它做下一个快照的差量基准。解码的快照同时放进插值缓冲区，
+// 其他玩家按GetInterpolator给出的时间显示。
+// SetConditions之后收发的包都先排队，到时间了才处理或发出（精度是Update的间隔）。
+class GameClient {
+public:
+    GameClient();
+
+    bool Connect(const NetAddress& server);
+    void Disconnect();
+    void Update(double now);
+
+    bool IsConnected() const { return m_slot >= 0; }
+    bool WasRejected() const { return m_rejected; }
+    int GetSlot() const { return m_slot; }
+    int GetTickRate() const { return m_tickRate; }
+    // viewTick为客户端现在看到的服务器时间（帧号带小数）
+    void SendCommand(const PlayerCommand& command, float viewTick);
+
+    bool HasSnapshot() const { return m_snapshot.tick >= 0; }
+    const ClientSnapshot& GetSnapshot() const { return m_snapshot; }
+    const ClientStats& GetStats() const { return m_stats; }
+    SnapshotInterpolator& GetInterpolator() { return m_interpolator; }
+
+    void SetConditions(const NetworkConditions& conditions) { m_conditions = conditions; }
+
+private:
+    struct DelayedPacket {
+        double time;
+        std::vector<uint8_t> data;
+    };
+
+    UdpSocket m_socket;
+    NetAddress m_server;
+    uint32_t m_nonce;
+    int m_slot;
+    int m_tickRate;
+    bool m_rejected;
+    double m_lastConnectTime;
+    PlayerCommand m_recentCommands[NET_COMMAND_REDUNDANCY];
+    int m_recentCount;
+    ClientSnapshot m_snapshot;
+    SnapshotDecoder m_decoder;
+    SnapshotInterpolator m_interpolator;
+    ClientStats m_stats;
+    uint8_t m_buffer[NET_MAX_PACKET];
+    NetworkConditions m_conditions;
+    std::vector<DelayedPacket> m_delayedIn;
+    std::vector<DelayedPacket> m_delayedOut;
+    uint32_t m_random;
+    double m_now;
+
+    bool HasConditions() const;
+    // 按模拟的网络条件丢掉（返回false）或者返回这个包应该处理的时间
+    bool Condition(double& time);
+    void Send(const uint8_t* data, int size);
+    void SendConnect();
+    void HandlePacket(const uint8_t* data, int size, double now);
+    void HandleSnapshot(ByteReader& reader, double now);
+};
+
+#endif // GAME_CLIENT_H
@@ -0,0 +1,112 @@
+#ifndef GAME_SERVER_H
+#define GAME_SERVER_H
+
+#include <cstdint>
+#include <vector>
+#include "GameSimulation.h"
+#include "NetIoThread.h"
+#include "NetProtocol.h"
+#include "NetSocket.h"
+#include "DemoRecording.h"
+#include "SnapshotEncoder.h"
+#include "VisibilitySet.h"
+
+struct ServerStats {
+    long long ticks = 0;
+    long long packetsIn = 0;
+    long long packetsOut = 0;
+    long long bytesIn = 0;
+    long long bytesOut = 0;
+    long long snapshots = 0;
+    long long snapshotEncodes = 0;   // 实际编码的次数，确认帧相同的客户端共用一次
+    long long fullSnapshots = 0;     // 没有可用基准、发完整快照的次数
+    long long culledPlayers = 0;     // 不在客户端的可见集里、没有发给它的玩家（每个快照分别计）
+    long long connects = 0;
+    long long timeouts = 0;
+    long long sendDrops = 0;         // 发包池用完没有发的包
+};
+
+// 专用服务器
+// 每帧先取完I/O线程收到的所有包（连接请求、命令、断开），命令按槽位放进模拟的队列，模拟一帧，
+// 再给每个客户端发一个快照（直接写进发包池的包，帧末一次交给I/O线程批量发出，模拟线程不做收发的系统调用）：所有玩家量化后记进SnapshotEncoder，对客户端确认收到的那一帧差量编码，
+// 确认帧相同的客户端共用同一份编码，只有包头不同。
+// 设置了可见集时，每个客户端只收到它眼睛所在的叶子能看到的玩家（脚或眼睛所在的叶子可见），
+// 每帧发给它的玩家记下来，下次差量编码时基准用同样的过滤；基准帧和可见的玩家都相同的客户端仍然共用编码。
+// 一个槽位对应一个客户端，地址和连接时的随机数都对上的包才处理；5秒收不到包的客户端断开。
+// 同一进程里的机器人直接在模拟里占槽位，命令直接放进模拟的队列（和收到的命令同一条路），不收快照也不会超时。
+// 每个快照带着服务器上一帧用的时间，客户端（测试用的机器人）可以看到服务器的负载。
+// 网络收发在Start时创建的I/O线程里（NetIoThread），模拟不创建线程，RunTick由调用者按固定帧率调用。
+class GameServer {
+public:
+    static const int TIMEOUT_SECONDS = 5;
+
+    explicit GameServer(const GameSettings& settings = GameSettings());
+
+    bool Start(uint16_t port, bool loopbackOnly = false);
+    void Stop();
+    uint16_t GetPort() const { return m_socket.GetPort(); }
+
+    void RunTick();
+
+    // 可见集，要在关卡不变的情况下编译；为空时发所有玩家
+    void SetVisibility(const VisibilitySet* visibility) { m_visibility = visibility; }
+    // 录像，设置后每帧模拟完把执行的命令和所有玩家的状态交给它；为空时不录
+    void SetRecorder(DemoRecorder* recorder) { m_recorder = recorder; }
+
+    GameSimulation& GetSimulation() { return m_simulation; }
+    const GameSimulation& GetSimulation() const { return m_simulation; }
+    int GetClientCount() const { return m_clientCount; }
+    const ServerStats& GetStats() const { return m_stats; }
+    // Stop之后才能读
+    const NetIoStats& GetIoStats() const { return m_io.GetStats(); }
+
+    // 快照里的玩家状态
+    static NetPlayerState BuildPlayerState(int slot, const SimPlayer& player);
+
+private:
+    struct Client {
+        bool connected;
+        NetAddress address;
+        uint32_t nonce;
+        int lastHeardTick;
+        int ackSnapshotTick;      // 客户端收到的最新快照
+        std::vector<uint8_t> visibleHistory;  // 每帧发给它的玩家，按帧号 % HISTORY，每帧按槽位
+    };
+
+    GameSimulation m_simulation;
+    UdpSocket m_socket;
+    NetIoThread m_io;
+    std::vector<Client> m_clients;     // 按槽位
+    int m_clientCount;
+    struct EncodedSnapshot {
+        int baseTick;
+        const uint8_t* visible;
+        const uint8_t* baseVisible;
+        int size;
+        const uint8_t* data;
+    };
+
+    SnapshotEncoder m_encoder;
+    std::vector<uint8_t> m_encodedData;             // 这一帧编码好的快照，每个NET_MAX_PACKET字节
+    std::vector<EncodedSnapshot> m_encodedSnapshots;
+    const VisibilitySet* m_visibility;
+    std::vector<int> m_eyeLeaves;                   // 按槽位，这一帧眼睛和脚所在的叶子
+    std::vector<int> m_footLeaves;
+    std::vector<int> m_activeSlots;                 // 这一帧有玩家的槽位
+    DemoRecorder* m_recorder;
+    int m_lastTickMicros;                           // 上一次RunTick用的时间，写进快照
+    std::vector<NetPlayerState> m_demoPlayers;
+    ServerStats m_stats;
+
+    void ReceivePackets();
+    void HandleConnect(ByteReader& reader, const NetAddress& address);
+    void HandleCommands(ByteReader& reader, const NetAddress& address);
+    void HandleDisconnect(ByteReader& reader, const NetAddress& address);
+    Client* FindClient(int slot, uint32_t nonce, const NetAddress& address);
+    void DropClient(int slot);
+    void SendSnapshots();
+    void RecordDemo();
+    void Send(const uint8_t* data, int size, const NetAddress& address);
+};
+
+#endif // GAME_SERVER_H
@@ -0,0 +1,117 @@
+#ifndef GAME_SIMULATION_H
+#define GAME_SIMULATION_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "CollisionWorld.h"
+#include "LagCompensation.h"
+#include "LevelGeometry.h"
+#include "PlayerMovement.h"
+
+// 游戏规则的参数
+struct GameSettings {
+    int maxPlayers = 64;
+    int tickRate = 128;
+    int maxHealth = 100;
+    int weaponDamage = 36;            // 打在胸口的伤害，其他部位按倍数
+    float fireInterval = 0.1f;        // 每分钟600发
+    float weaponRange = 100.0f;
+    float respawnSeconds = 2.0f;
+    float maxRewindSeconds = 0.2f;    // 延迟补偿最多倒回的时间
+    int maxCommandsPerTick = 4;       // 每个玩家每帧最多执行的命令，积压的命令在之后的帧里追上
+};
+
+// 服务器上的一个玩家
+struct SimPlayer {
+    bool active;
+    PlayerState state;
+    uint16_t yaw;
+    int16_t pitch;
+    int health;
+    int kills;
+    int deaths;
+    int respawnTick;          // 死亡后复活的帧
+    int nextFireTick;
+    int lastCommandTick;      // 已经执行的最后一个命令的帧号，-1为还没有
+};
+
+// 一帧里执行的一个命令（录像用）
+struct ExecutedCommand {
+    int slot;
+    PlayerCommand command;
+    float viewTick;
+};
+
+struct GameStats {
+    long long commands = 0;
+    long long droppedCommands = 0;    // 重复或过时的命令
+    long long shots = 0;
+    long long hits = 0;
+    long long kills = 0;
+};
+
+// 游戏的模拟：关卡碰撞、玩家移动、射击和规则，不依赖窗口、OpenGL和网络
+// 玩家的命令先排队，Tick时每个玩家按顺序执行（每帧最多maxCommandsPerTick个），命令里的按键决定是否开火；
+// 开火时按命令附带的客户端看到的时间把其他玩家倒回去求命中，墙挡住的距离用碰撞世界的射线求出。
+// 每帧结束时所有活着的玩家的命中盒记入延迟补偿的历史。
+// 一帧里只有命令的执行顺序（按槽位）影响结果，同样的命令序列得到同样的模拟。
+class GameSimulation {
+public:
+    explicit GameSimulation(const GameSettings& settings = GameSettings());
+
+    const GameSettings& GetSettings() const { return m_settings; }
+    const LevelGeometry& GetLevel() const { return m_level; }
+    const CollisionWorld& GetCollisionWorld() const { return m_world; }
+    const PlayerMovement& GetMovement() const { return m_movement; }
+
+    // 占用一个空槽位，满了时返回-1
+    int AddPlayer();
+    void RemovePlayer(int slot);
+    // viewTick为客户端执行这个命令时看到的服务器时间（帧号带小数），开火时倒回到这个时间
+    void QueueCommand(int slot, const PlayerCommand& command, float viewTick);
+
+    void Tick();
+
+    int GetTick() const { return m_tick; }
+    int GetMaxPlayers() const { return m_settings.maxPlayers; }
+    int GetPlayerCount() const { return m_playerCount; }
+    const SimPlayer& GetPlayer(int slot) const { return m_players[slot]; }
+    const GameStats& GetStats() const { return m_stats; }
+    // 上一次Tick执行的命令，按执行顺序
+    const std::vector<ExecutedCommand>& GetExecutedCommands() const { return m_executed; }
+
+    // 玩家的命中盒（头、胸、腹和两条腿），蹲下时整体变矮
+    static void BuildHitboxes(const glm::vec3& position, float yaw, float duckAmount, EntityPose& pose);
+
+private:
+    struct QueuedCommand {
+        PlayerCommand command;
+        float viewTick;
+    };
+    static const int COMMAND_QUEUE_SIZE = 64;
+
+    GameSettings m_settings;
+    LevelGeometry m_level;
+    CollisionWorld m_world;
+    PlayerMovement m_movement;
+    LagCompensation m_history;
+
+    int m_tick;
+    int m_playerCount;
+    uint32_t m_random;
+    std::vector<SimPlayer> m_players;
+    std::vector<QueuedCommand> m_queues;     // 每个玩家COMMAND_QUEUE_SIZE个，环形
+    std::vector<int> m_queueHead;
+    std::vector<int> m_queueCount;
+    std::vector<ExecutedCommand> m_executed;
+    GameStats m_stats;
+
+    uint32_t NextRandom();
+    void Spawn(int slot);
+    void ExecuteCommand(int slot, const QueuedCommand& queued);
+    void Fire(int slot, float viewTick);
+    void RecordHistory();
+};
+
+#endif // GAME_SIMULATION_H
@@ -0,0 +1,111 @@
+#ifndef GPU_PARTICLE_WORLD_H
+#define GPU_PARTICLE_WORLD_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "ParticleWorld.h"
+
+class Renderer;
+
+struct GpuParticleWorldStats {
+    int emitters = 0;
+    int pools = 0;
+    int capacity = 0;       // 所有粒子池的槽位数，每帧都在GPU上更新
+    int spawned = 0;        // 本帧请求发射的粒子
+    int spawnRequests = 0;  // 本帧上传的发射请求
+};
+
+// GPU粒子世界：ParticleWorld的另一个后端，效果定义相同
+// 每个效果一个固定容量的粒子池，状态放在两个GL缓冲区里交替读写，
+// 每帧在顶点shader中用transform feedback更新（关闭光栅化），绘制时直接把状态缓冲区作为实例属性。
+// CPU只维护发射器的发射进度：每帧给每个粒子池上传一个小的uniform块，列出本帧的发射请求
+// （位置、方向、个数、起始槽位），shader按槽位号判断自己是否被新粒子占用，
+// 用 (种子, 帧号, 槽位) 的哈希生成新粒子，CPU不写入也不上传单个粒子。
+// 槽位按环形分配，粒子池满时最旧的槽位被新粒子覆盖。
+// 需要GL 3.3（transform feedback、uniform块、gl_VertexID），可以在Mesa llvmpipe上运行。
+class GpuParticleWorld {
+public:
+    static const int MAX_SPAWN_REQUESTS = 16; // 每个粒子池每帧最多的发射请求，多出的顺延到下一帧
+    static const int CURVE_SIZE = 32;         // 颜色和大小曲线的采样数
+
+    explicit GpuParticleWorld(Renderer& renderer);
+    ~GpuParticleWorld();
+
+    // 为effects中的每个效果创建粒子池，容量为效果的maxParticles * capacityScale
+    // GL版本不够或shader编译失败时返回false
+    bool Initialize(const ParticleWorld& effects, int capacityScale);
+    // 删除所有缓冲区和shader，需要在GL上下文销毁之前调用
+    void Shutdown();
+    bool IsInitialized() const { return m_initialized; }
+
+    void Seed(uint32_t seed) { m_seed = seed; }
+
+    // 与ParticleWorld::Spawn相同：启动效果和它的子效果，返回发射器个数
+    int Spawn(int effect, const glm::vec3& position, const glm::vec3& direction = glm::vec3(0.0f));
+    // 删除发射器并清空所有粒子池
+    void Clear();
+
+    // 只提交GPU命令，不等待结果
+    void Update(float deltaTime);
+
+    // 实例化绘制所有粒子池，每个粒子与drawParticle相同（XY平面上的正方形），使用当前的固定管线矩阵。
+    // 混合和深度状态由调用者设置；粒子不排序
+    void Draw();
+
+    const GpuParticleWorldStats& GetStats() const { return m_stats; }
+
+private:
+    // 与shader中的SpawnBlock相同（std140）
+    struct SpawnBlock {
+        glm::vec4 position[MAX_SPAWN_REQUESTS];  // xyz：位置，w：起始槽位
+        glm::vec4 direction[MAX_SPAWN_REQUESTS]; // xyz：方向，w：个数
+        int32_t header[4];                       // 请求个数，随机数种子
+    };
+
+    struct Pool {
+        int effect;
+        int capacity;
+        int next;               // 下一个分配的槽位
+        int requested;          // 本帧已请求的槽位
+        float remaining;        // 最后发射的粒子还能存活的时间，<= 0时粒子池为空，跳过更新和绘制
+        uint32_t frame;
+        unsigned int buffers[2];
+        int current;            // 存放当前状态的缓冲区
+        unsigned int spawnBuffer;
+        SpawnBlock spawns;
+        glm::vec4 colorCurve[CURVE_SIZE];
+        float sizeCurve[CURVE_SIZE];
+    };
+
+    struct Emitter {
+        int effect;
+        glm::vec3 position;
+        glm::vec3 direction;
+        ParticleEmitterClock clock;
+        int pending;            // 还没有发出的粒子（请求超过上限时顺延）
+    };
+
+    Renderer& m_renderer;
+    const ParticleWorld* m_effects;
+    bool m_initialized;
+    uint32_t m_seed;
+
+    unsigned int m_updateShader;
+    unsigned int m_drawShader;
+    unsigned int m_cornerBuffer;
+    int m_drawAttributes[3];    // 角点，位置和生命值，大小
+
+    std::vector<Pool> m_pools;  // 与效果一一对应
+    std::vector<Emitter> m_emitters;
+    GpuParticleWorldStats m_stats;
+
+    GpuParticleWorld(const GpuParticleWorld&) = delete;
+    GpuParticleWorld& operator=(const GpuParticleWorld&) = delete;
+
+    void SpawnEmitter(int effect, const glm::vec3& position, const glm::vec3& direction, int depth, int& spawned);
+    void UpdatePool(Pool& pool, float deltaTime);
+    void ResetPool(Pool& pool);
+};
+
+#endif // GPU_PARTICLE_WORLD_H
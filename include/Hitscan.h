@@ -0,0 +1,88 @@
+#ifndef HITSCAN_H
+#define HITSCAN_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+class CollisionWorld;
+class LevelGeometry;
+struct RayHitList;
+
+// 一次射击（一发子弹或霰弹的一颗弹丸）
+struct HitscanShot {
+    glm::vec3 origin;
+    glm::vec3 direction;   // 需要归一化
+    float range;
+    float penetration;     // 能穿过多少米阻力为1的实体（墙），0为不能穿透
+};
+
+// 子弹碰到的一个实体
+struct HitscanImpact {
+    float distance;
+    glm::vec3 position;    // 入口
+    glm::vec3 normal;      // 朝向射线来的一侧
+    int surface;
+    int material;
+    float thickness;       // 沿射线穿过的长度，出口在 position + direction * thickness
+    bool penetrated;       // 穿了过去；最后一个实体没有穿过时为false
+    float damageScale;     // 穿过之后剩下的伤害比例
+};
+
+struct HitscanStats {
+    int shots = 0;
+    int packets = 0;
+    int rayHits = 0;       // BVH返回的三角形交点
+    int impacts = 0;
+    int penetrations = 0;
+};
+
+// 即时命中的射击
+// 一帧里所有玩家的射击先收集起来，Process时按方向所在的卦限、起点所在的格子和方向排序，
+// 每4条打成一个射线包在CollisionWorld的BVH上一起遍历，取回每条射线按距离排好的所有交点，再逐条计算穿透：
+// 从一个表面进入的实体到它后面第一个朝着射线方向的面为止（前墙的外墙面、窗洞的侧面），
+// 没有这样的面时按表面的厚度（LevelSurface::thickness，墙为wallThickness）和入射角算出穿过的长度；
+// 贴在同一平面上的表面（窗框和墙）当作一个，取最厚的；从背面碰到的表面（窗洞里的外墙面）实体在它前面，
+// 不消耗穿透能力。每米消耗的穿透能力由表面的阻力决定。
+class Hitscan {
+public:
+    static const int MAX_IMPACTS = 8;   // 每次射击最多记录的实体
+
+    Hitscan();
+
+    void SetWorld(const CollisionWorld* world) { m_world = world; }
+    // 表面每米消耗的穿透能力，默认为1
+    void SetResistance(int surface, float resistance);
+    // 关卡表面的阻力：半透明的玻璃0.1，不遮挡的窗框0.5，墙、地面和天花板1
+    void SetLevelResistances(const LevelGeometry& level);
+
+    // 开始新的一帧，清掉之前的射击和结果
+    void Clear();
+    // 返回射击的编号
+    int AddShot(const HitscanShot& shot);
+    // 处理这一帧所有的射击
+    void Process();
+
+    int GetShotCount() const { return static_cast<int>(m_shots.size()); }
+    int GetImpactCount(int shot) const { return m_impactCount[shot]; }
+    const HitscanImpact& GetImpact(int shot, int i) const { return m_impacts[m_firstImpact[shot] + i]; }
+    const HitscanStats& GetStats() const { return m_stats; }
+
+private:
+    const CollisionWorld* m_world;
+    std::vector<float> m_resistances;   // 按表面编号
+
+    std::vector<HitscanShot> m_shots;
+    std::vector<uint32_t> m_keys;
+    std::vector<int> m_order;
+    std::vector<int> m_firstImpact;
+    std::vector<int> m_impactCount;
+    std::vector<HitscanImpact> m_impacts;
+
+    HitscanStats m_stats;
+
+    float GetResistance(int surface) const;
+    void ResolveShot(int shot, const RayHitList& hits);
+};
+
+#endif // HITSCAN_H
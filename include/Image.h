@@ -0,0 +1,23 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <cstdint>
+#include <vector>
+
+// RGBA8图像，第一行是图像的最上面一行（与PNG文件一致）
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// 读取PNG，统一转换成RGBA8
+bool LoadPNG(const char* filename, Image& image);
+
+// 保存为RGBA8 PNG
+bool SavePNG(const char* filename, const Image& image);
+
+// 两张图像的峰值信噪比（dB），尺寸不同返回-1，完全相同返回100
+double ComputePSNR(const Image& a, const Image& b);
+
+#endif // IMAGE_H
@@ -0,0 +1,52 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 简单的工作线程池
+// ParallelFor把[0, count)切成块分给工作线程，调用线程也参与执行，返回时全部完成。
+// 同一时间只执行一个ParallelFor，不支持在任务内部嵌套调用。
+class JobSystem {
+public:
+    // workerCount为0时使用 (CPU核数 - 1) 个工作线程
+    explicit JobSystem(int workerCount = 0);
+    ~JobSystem();
+
+    // 工作线程数 + 调用线程，用于分配每线程的缓冲区
+    int GetThreadCount() const { return static_cast<int>(m_workers.size()) + 1; }
+
+    // func(begin, end, threadIndex)，threadIndex: 调用线程为0，工作线程为1..N
+    typedef std::function<void(int begin, int end, int threadIndex)> RangeFunc;
+    void ParallelFor(int count, const RangeFunc& func, int grainSize = 1);
+
+private:
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_submitMutex; // 串行化ParallelFor调用
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_doneCondition;
+
+    // 当前任务
+    const RangeFunc* m_func;
+    int m_count;
+    int m_grainSize;
+    std::atomic<int> m_nextIndex;
+    std::atomic<int> m_pendingChunks;
+    int m_activeWorkers;
+    unsigned int m_generation;
+    bool m_quit;
+
+    void WorkerLoop(int threadIndex);
+    void RunChunks(int threadIndex);
+};
+
+#endif // JOB_SYSTEM_H
@@ -0,0 +1,105 @@
+#ifndef LAG_COMPENSATION_H
+#define LAG_COMPENSATION_H
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// 命中盒：线段 [a, b] 加半径，a == b 时为球
+struct Hitbox {
+    glm::vec3 a;
+    glm::vec3 b;
+    float radius;
+    int group;            // 命中部位（头、胸、腹、腿），伤害倍数由游戏规则决定
+};
+
+// 实体在一帧里的姿态，命中盒为世界坐标
+struct EntityPose {
+    static constexpr int MAX_HITBOXES = 6;
+
+    glm::vec3 position;
+    float yaw;
+    int hitboxCount;
+    Hitbox hitboxes[MAX_HITBOXES];
+};
+
+// 射线命中的实体
+struct LagHit {
+    int entity;
+    int group;
+    float distance;
+    glm::vec3 position;
+};
+
+// 射线与命中盒的第一个交点，起点在命中盒里时为0；direction需要归一化
+bool RaycastHitbox(const glm::vec3& origin, const glm::vec3& direction, const Hitbox& hitbox, float& distance);
+
+// 延迟补偿的历史
+// 每个实体一个固定长度的环形缓冲区，按帧号取模存放每帧的姿态和所有命中盒的包围盒，
+// 所有实体的缓冲区在构造时一次分配（64个实体、128帧约2MB），之后记录和查询都不分配内存。
+// 查询的时间是帧号加小数（客户端看到的时间），在前后两帧之间插值。
+class LagCompensation {
+public:
+    // historyTicks向上取为2的幂
+    explicit LagCompensation(int maxEntities = 64, int historyTicks = 128);
+
+    int GetMaxEntities() const { return m_maxEntities; }
+    int GetHistoryTicks() const { return m_historyTicks; }
+    size_t GetMemoryBytes() const { return m_records.size() * sizeof(HistoryEntry); }
+
+    // 记录实体在tick的姿态，每个实体每帧一次，帧号递增；跳过的帧在查询时从前后两帧插值
+    void Record(int entity, int tick, const EntityPose& pose);
+    // 实体死亡或离开，之前的历史作废
+    void Remove(int entity);
+
+    // 实体在tick（可以带小数）的姿态和包围盒，历史里没有这个时间时返回false
+    bool GetPose(int entity, float tick, EntityPose& pose) const;
+    bool GetBounds(int entity, float tick, glm::vec3& minBounds, glm::vec3& maxBounds) const;
+    // 实体最新记录的帧，没有记录时为-1
+    int GetLatestTick(int entity) const { return m_latestTick[entity]; }
+
+private:
+    struct HistoryEntry {
+        int tick;
+        glm::vec3 minBounds;
+        glm::vec3 maxBounds;
+        EntityPose pose;
+    };
+
+    int m_maxEntities;
+    int m_historyTicks;
+    int m_tickMask;
+    std::vector<HistoryEntry> m_records;     // 实体e的第t帧在 e * m_historyTicks + (t & m_tickMask)
+    std::vector<int> m_latestTick;
+
+    // tick前后的两条记录和插值系数
+    bool FindRecords(int entity, float tick, const HistoryEntry*& before, const HistoryEntry*& after,
+                     float& t) const;
+};
+
+// 把世界倒回到客户端看到的时间做一次射线查询
+// 只有两帧包围盒的并集被射线穿过的实体才插值出姿态，放进这个对象自己的固定数组；
+// 历史和实体的当前状态都不修改，多个查询可以在不同线程同时进行。
+class LagRewind {
+public:
+    static const int MAX_ENTITIES = 32;   // 射线穿过的实体多于这个数时保留最近的
+
+    // ignoreEntity为射击者自己
+    LagRewind(const LagCompensation& history, float tick, const glm::vec3& origin, const glm::vec3& direction,
+              float maxDistance, int ignoreEntity = -1);
+
+    int GetEntityCount() const { return m_count; }
+    // 最近的命中盒
+    bool Raycast(LagHit& hit) const;
+
+private:
+    glm::vec3 m_origin;
+    glm::vec3 m_direction;
+    float m_maxDistance;
+    int m_count;
+    int m_entities[MAX_ENTITIES];
+    float m_entryDistances[MAX_ENTITIES];
+    EntityPose m_poses[MAX_ENTITIES];
+};
+
+#endif // LAG_COMPENSATION_H
@@ -0,0 +1,39 @@
+#ifndef LATENCY_TRACKER_H
+#define LATENCY_TRACKER_H
+
+#include <cstddef>
+#include <vector>
+
+// 输入到显示的延迟统计
+// 每个输入事件在程序收到时打时间戳；帧在构建视图矩阵时"锁存"此前收到的全部输入，
+// 这一帧交换完成时，每个被锁存的输入记一个样本：交换时间 - 输入时间。
+// 样本放在固定容量的环形缓冲区里，运行中不分配内存。
+class LatencyTracker {
+public:
+    explicit LatencyTracker(int capacity = 4096);
+
+    void Reset();
+
+    // 时间单位为秒，来自同一个单调时钟
+    void OnInput(double time);
+    void OnLatch();
+    void OnPresent(double time);
+
+    int GetSampleCount() const;
+
+    // 百分位延迟（毫秒），p在[0, 100]
+    double GetPercentile(double p) const;
+
+    // 输出 样本数、p50/p90/p99/最大值
+    void PrintReport(const char* label) const;
+
+private:
+    std::vector<double> m_pending; // 收到但还没有被帧使用的输入
+    std::vector<double> m_latched; // 当前帧使用的输入
+    std::vector<float> m_samples;  // 延迟（毫秒）
+    int m_nextSample;
+    bool m_full;
+    mutable std::vector<float> m_sorted;
+};
+
+#endif // LATENCY_TRACKER_H
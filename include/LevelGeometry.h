@@ -0,0 +1,147 @@
+#ifndef LEVEL_GEOMETRY_H
+#define LEVEL_GEOMETRY_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// 关卡参数 - 房间尺寸、窗户位置和墙壁厚度
+struct LevelDesc {
+    float roomSize = 60.0f;      // 房间的宽度和长度
+    float roomHeight = 25.0f;    // 房间的高度
+    float windowWidth = 8.0f;    // 窗户宽度
+    float windowHeight = 6.0f;   // 窗户高度
+    float windowX = -8.0f;       // 窗户中心X位置
+    float windowY = 8.0f;        // 窗户中心Y位置（离地面高度）
+    float wallThickness = 2.0f;  // 前墙厚度
+    float frameThickness = 0.3f; // 窗框宽度
+    float outsideDepth = 30.0f;  // 窗外区域的深度（只用于可见性）
+};
+
+// 表面材质，对应一张纹理；MATERIAL_NONE为纯色表面
+// MATERIAL_FIRST_DECAL及之后的是贴花图像，放进贴花图集而不是单独的纹理
+enum LevelMaterial {
+    MATERIAL_NONE = 0,
+    MATERIAL_FLOOR,
+    MATERIAL_SKY,
+    MATERIAL_WALL,
+    MATERIAL_FIRST_DECAL,
+    MATERIAL_LOGO = MATERIAL_FIRST_DECAL,
+    MATERIAL_DAQING,
+    MATERIAL_HOME,
+    MATERIAL_COUNT
+};
+
+// 关卡中的表面，每个表面是一次绘制
+enum LevelSurfaceId {
+    SURFACE_FLOOR = 0,
+    SURFACE_CEILING,
+    SURFACE_FRONT_WALL,
+    SURFACE_BACK_WALL,
+    SURFACE_LEFT_WALL,
+    SURFACE_RIGHT_WALL,
+    SURFACE_WINDOW_FRAME,
+    SURFACE_WINDOW_GLASS_INNER,
+    SURFACE_WINDOW_GLASS_OUTER,
+    SURFACE_COUNT
+};
+
+struct LevelVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+struct LevelSurface {
+    LevelMaterial material;
+    glm::vec4 color;      // 顶点颜色，纹理表面为白色
+    bool translucent;     // 需要混合
+    bool occluder;        // 可以作为遮挡体
+    float thickness;      // 表面背后实体的厚度（穿透计算用）
+    int firstQuad;
+    int quadCount;
+    glm::vec3 minBounds;
+    glm::vec3 maxBounds;
+};
+
+// 贴在墙上的装饰画，由贴花系统绘制
+struct LevelDecal {
+    LevelMaterial material;
+    glm::vec3 position;   // 墙面上的中心
+    glm::vec3 normal;     // 墙面朝向房间内的法线
+    glm::vec3 up;
+    float halfWidth;
+    float halfHeight;
+};
+
+// 可见性的单元格：凸的空区域（轴对齐盒子），里面没有遮挡，任意两点互相可见
+struct LevelCell {
+    glm::vec3 minBounds;
+    glm::vec3 maxBounds;
+};
+
+// 连接两个单元格的开口：垂直于axis轴的矩形（axis方向上最小值和最大值相同），玻璃不挡视线
+struct LevelOpening {
+    int cells[2];
+    int axis;
+    glm::vec3 minBounds;
+    glm::vec3 maxBounds;
+};
+
+// 射线与关卡的交点
+struct LevelHit {
+    float distance;
+    glm::vec3 position;
+    glm::vec3 normal;     // 朝向射线来的一侧
+    int surface;
+};
+
+// 关卡几何
+// 渲染（GL和软件光栅化）、遮挡剔除和碰撞都从这里取同一份四边形数据，
+// 每个四边形4个顶点，按 (0,1,2) (0,2,3) 拆成两个三角形。
+class LevelGeometry {
+public:
+    explicit LevelGeometry(const LevelDesc& desc = LevelDesc());
+
+    void Build();
+
+    const LevelDesc& GetDesc() const { return m_desc; }
+    const std::vector<LevelSurface>& GetSurfaces() const { return m_surfaces; }
+    const LevelSurface& GetSurface(int id) const { return m_surfaces[id]; }
+    const std::vector<LevelVertex>& GetVertices() const { return m_vertices; }
+    const std::vector<LevelDecal>& GetDecals() const { return m_decals; }
+    const std::vector<LevelCell>& GetCells() const { return m_cells; }
+    const std::vector<LevelOpening>& GetOpenings() const { return m_openings; }
+
+    // 四边形q的第i个顶点
+    const LevelVertex& GetQuadVertex(int quad, int i) const { return m_vertices[quad * 4 + i]; }
+
+    // 逐个四边形求最近交点，direction需要归一化；游戏中用CollisionWorld::Raycast，这里用来检查它的结果
+    bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, LevelHit& hit) const;
+
+private:
+    LevelDesc m_desc;
+    std::vector<LevelSurface> m_surfaces;
+    std::vector<LevelVertex> m_vertices;
+    std::vector<LevelDecal> m_decals;
+    std::vector<LevelCell> m_cells;
+    std::vector<LevelOpening> m_openings;
+
+    void BeginSurface(LevelSurfaceId id, LevelMaterial material, const glm::vec4& color,
+                      bool translucent, bool occluder, float thickness);
+    void AddQuad(const glm::vec3& normal,
+                 const glm::vec3& p0, const glm::vec2& t0, const glm::vec3& p1, const glm::vec2& t1,
+                 const glm::vec3& p2, const glm::vec2& t2, const glm::vec3& p3, const glm::vec2& t3);
+    void AddQuad(const glm::vec3& normal,
+                 const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3);
+    void EndSurface();
+
+    void BuildRoom();
+    void BuildFrontWall();
+    void BuildWindow();
+    void BuildPosters();
+    void BuildCells();
+
+    int m_currentSurface;
+};
+
+#endif // LEVEL_GEOMETRY_H
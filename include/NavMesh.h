@@ -0,0 +1,211 @@
+#ifndef NAV_MESH_H
+#define NAV_MESH_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+class LevelGeometry;
+
+struct NavMeshSettings {
+    float cellSize = 0.25f;       // 体素的水平边长（米）
+    float cellHeight = 0.1f;      // 体素的高度
+    float agentHeight = 1.83f;    // 站着的玩家高度，头顶空间不够的地方不能走
+    float agentRadius = 0.4f;     // 可走区域离墙至少这么远
+    float agentClimb = 0.46f;     // 能直接走上去的台阶（和PlayerMovement的stepHeight相同）
+    float maxSlope = 45.0f;       // 能走的最陡的坡（度）
+    int tileCells = 16;           // 多边形不跨过这么多格子的块，一块4米
+    int clusterTiles = 4;         // 层次寻路的簇是这么多块见方（16米）
+};
+
+struct NavMeshStats {
+    int columns = 0;              // 体素的列数
+    int spans = 0;                // 实心的体素段
+    int walkableCells = 0;        // 能站人的格子（离墙收缩之前）
+    int cells = 0;                // 收缩之后
+    int regions = 0;              // 互相连通的可走区域
+    int polygons = 0;
+    int links = 0;                // 多边形之间的边（每个方向算一个）
+    int clusters = 0;             // 有多边形的簇
+    int entrances = 0;            // 层次图的节点：和别的簇相连的多边形
+    int abstractEdges = 0;
+    double buildSeconds = 0.0;    // 体素化到多边形
+    double graphSeconds = 0.0;    // 多边形的连接和层次图
+};
+
+// 导航网格的一个多边形：同一高度上的一块矩形（格子坐标，[x0, x1) x [z0, z1)），凸的，里面随便走直线
+struct NavPolygon {
+    int x0, z0, x1, z1;
+    float y;                      // 地面高度
+    int region;
+    int cluster;
+    glm::vec3 center;
+    int firstLink;
+    int linkCount;
+};
+
+// 两个多边形之间的通道：共用的那段边
+struct NavLink {
+    int polygon;                  // 通到的多边形
+    glm::vec3 a, b;               // 共用边的两端
+    float cost;                   // 两个多边形中心之间的距离
+};
+
+// A*的临时数据，多次搜索共用，按代号清空
+struct NavSearchState {
+    std::vector<float> cost;
+    std::vector<int> parent;
+    std::vector<uint32_t> visited;  // 等于generation时这一次搜到过
+    std::vector<uint8_t> closed;
+    std::vector<std::pair<float, int>> open;
+    uint32_t generation = 0;
+    int expanded = 0;
+
+    bool Reached(int node) const { return visited[node] == generation; }
+};
+
+// 导航网格
+// 离线生成（Build）：关卡的三角形体素化成一列列实心的段，顶面够平、头顶空间够高的段是能站人的格子，
+// 相邻格子高度差不超过agentClimb时连通；离墙（不能走的格子）近于agentRadius的格子去掉，
+// 剩下的按连通性分成区域，每一块（tileCells见方）里同一区域、同一高度的格子贪心合并成尽量大的矩形多边形。
+// 关卡都是轴对齐的，矩形正好贴合，不需要勾轮廓、三角化；斜坡会变成按高度分开的一条条矩形。
+// 存文件的只是多边形；加载后（和生成后）由多边形建出连接、位置查找网格和层次图：
+// 地图按clusterTiles块见方分成簇，和别的簇相连的多边形是层次图的节点，同簇的节点两两在簇里求A*，
+// 路径和长度存起来，长距离寻路先在层次图上走，再把存好的路径接起来。
+class NavMesh {
+public:
+    bool Build(const LevelGeometry& level, const NavMeshSettings& settings = NavMeshSettings());
+    bool Save(const std::string& path) const;
+    bool Load(const std::string& path);
+
+    bool IsValid() const { return !m_polygons.empty(); }
+    const NavMeshSettings& GetSettings() const { return m_settings; }
+    const NavMeshStats& GetStats() const { return m_stats; }
+    int GetPolygonCount() const { return static_cast<int>(m_polygons.size()); }
+    const NavPolygon& GetPolygon(int polygon) const { return m_polygons[polygon]; }
+    const NavLink& GetLink(int link) const { return m_links[link]; }
+    glm::vec3 GetPolygonMin(int polygon) const;
+    glm::vec3 GetPolygonMax(int polygon) const;
+
+    // 位置（脚底）所在的多边形：同一列里不高于脚底+agentClimb的最高的一个，没有时返回-1
+    int FindPolygon(const glm::vec3& position) const;
+    // 找不到时在周围searchRadius米（水平）内找最近的；point为多边形里离position最近的点
+    int FindNearestPolygon(const glm::vec3& position, float searchRadius, glm::vec3& point) const;
+
+    // 多边形图上的A*，代价是经过的多边形中心之间的距离；goal为-1时不停，算出到所有能到的多边形的代价（Dijkstra）。
+    // cluster不为-1时只走这个簇里的多边形。路径从state.parent里倒着取
+    bool Search(int start, int goal, int cluster, NavSearchState& state) const;
+
+    // 层次图
+    int GetClusterCount() const { return m_clusterCount; }
+    int GetClustersX() const { return m_clustersX; }        // 簇c在(c % GetClustersX(), c / GetClustersX())
+    int GetCluster(const glm::vec3& position) const;
+    // 多边形对应的层次图节点，不是入口时为-1
+    int GetEntrance(int polygon) const { return m_entranceOf[polygon]; }
+    int GetEntranceCount() const { return static_cast<int>(m_entrances.size()); }
+    int GetEntrancePolygon(int entrance) const { return m_entrances[entrance]; }
+    // 簇里的入口在m_clusterEntrances[m_clusterEntranceStarts[c]...m_clusterEntranceStarts[c + 1]]
+    const int* GetClusterEntrances(int cluster, int& count) const;
+
+    struct AbstractEdge {
+        int to;                   // 入口
+        float cost;
+        int pathOffset;           // 路径上的多边形（不含起点，含终点）在m_abstractPaths里
+        int pathLength;
+    };
+    const AbstractEdge* GetAbstractEdges(int entrance, int& count) const;
+    const int* GetAbstractPath(const AbstractEdge& edge) const { return &m_abstractPaths[edge.pathOffset]; }
+
+private:
+    NavMeshSettings m_settings;
+    NavMeshStats m_stats;
+    glm::vec3 m_origin = glm::vec3(0.0f);   // 格子(0, 0)的最小角
+    int m_width = 0;                        // x方向的格子数
+    int m_depth = 0;                        // z方向的格子数
+    std::vector<NavPolygon> m_polygons;
+    std::vector<NavLink> m_links;
+
+    // 每列的多边形在m_columnPolygons[m_columnStarts[i]...m_columnStarts[i + 1]]，i = z * m_width + x
+    std::vector<uint32_t> m_columnStarts;
+    std::vector<uint32_t> m_columnPolygons;
+
+    int m_clustersX = 0;
+    int m_clusterCount = 0;
+    std::vector<int> m_entrances;
+    std::vector<int> m_entranceOf;
+    std::vector<int> m_clusterEntranceStarts;
+    std::vector<int> m_clusterEntrances;
+    std::vector<int> m_abstractEdgeStarts;  // 每个入口一段，最后多一个结尾
+    std::vector<AbstractEdge> m_abstractEdges;
+    std::vector<int> m_abstractPaths;
+
+    void Clear();
+    // 由多边形建出连接、查找网格和层次图
+    void BuildGraph();
+    void BuildLinks();
+    void BuildHierarchy();
+};
+
+struct NavPathStats {
+    long long queries = 0;
+    long long failures = 0;         // 起点或终点不在网格上，或者不连通
+    long long cacheHits = 0;
+    long long hierarchical = 0;     // 走层次图的查询
+    long long expanded = 0;         // 展开的节点（两层加起来）
+    double seconds = 0.0;
+};
+
+// 寻路，多个机器人共用一个（不是线程安全的，每个线程一个）
+// 起点和终点先找到多边形，多边形对查共享的路径缓存（直接映射，按多边形对哈希，新的覆盖旧的），
+// 很多机器人去同一个地方时大部分查询只是一次复制。不命中时默认直接在多边形上A*；
+// 开了层次图时，簇的距离超过阈值的查询在起点和终点的簇里各做一次Dijkstra连到簇的入口，在层次图上A*，
+// 再把每段存好的路径接起来。展开的节点只有在大地图上才会变少，现在的关卡上它更慢、路径也更长，所以默认不开。
+// 多边形的通道最后拉直（漏斗算法）成拐点。
+class NavPathfinder {
+public:
+    explicit NavPathfinder(const NavMesh& mesh, int cacheSize = 4096);
+
+    // 成功时path是从start（投影到网格上）到goal的拐点，含两端
+    bool FindPath(const glm::vec3& start, const glm::vec3& goal, std::vector<glm::vec3>& path);
+    // 多边形的通道，不拉直
+    bool FindCorridor(int startPolygon, int goalPolygon, std::vector<int>& corridor);
+
+    void SetCacheEnabled(bool enabled) { m_cacheEnabled = enabled; }
+    // 簇的距离超过clusters的查询走层次图；小于0为不走（默认），0为不在同一个簇时总是走
+    void SetHierarchyThreshold(int clusters) { m_hierarchyThreshold = clusters; }
+    void ClearCache();
+    const NavMesh& GetMesh() const { return m_mesh; }
+    const NavPathStats& GetStats() const { return m_stats; }
+
+private:
+    struct CacheEntry {
+        int start;
+        int goal;
+        std::vector<int> corridor;
+    };
+
+    const NavMesh& m_mesh;
+    bool m_cacheEnabled;
+    int m_hierarchyThreshold;
+    std::vector<CacheEntry> m_cache;
+    NavSearchState m_search;
+    NavSearchState m_goalSearch;
+    // 层次图上的A*，入口的编号，最后一个是终点
+    std::vector<float> m_abstractCost;
+    std::vector<int> m_abstractParent;      // 上一个入口，-1为从起点直接到
+    std::vector<const NavMesh::AbstractEdge*> m_abstractParentEdge;  // 从上一个入口过来用的边
+    std::vector<uint32_t> m_abstractVisited;
+    std::vector<uint8_t> m_abstractClosed;
+    std::vector<std::pair<float, int>> m_abstractOpen;
+    uint32_t m_abstractGeneration;
+    std::vector<int> m_corridor;
+    NavPathStats m_stats;
+
+    bool FindHierarchical(int startPolygon, int goalPolygon, std::vector<int>& corridor);
+    void StringPull(const glm::vec3& start, const glm::vec3& goal, const std::vector<int>& corridor,
+                    std::vector<glm::vec3>& path) const;
+};
+
+#endif // NAV_MESH_H
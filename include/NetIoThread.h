@@ -0,0 +1,116 @@
+#ifndef NET_IO_THREAD_H
+#define NET_IO_THREAD_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "NetProtocol.h"
+#include "NetSocket.h"
+
+// 包池里的一个包
+struct NetPacket {
+    NetAddress address;
+    int size;
+    uint8_t data[NET_MAX_PACKET];
+};
+
+// 单生产者单消费者的无锁环形队列，存包在池里的编号。
+// 头尾各占一条缓存行，生产者只写m_tail，消费者只写m_head，不需要锁和比较交换
+class PacketQueue {
+public:
+    // 容量向上取2的幂，不小于capacity
+    explicit PacketQueue(int capacity);
+
+    // 生产者；满了返回false
+    bool Push(int packet);
+    // 消费者；空了返回false
+    bool Pop(int& packet);
+    bool Empty() const;
+
+private:
+    std::vector<int> m_items;
+    uint32_t m_mask;
+    alignas(64) std::atomic<uint32_t> m_head;
+    alignas(64) std::atomic<uint32_t> m_tail;
+};
+
+struct NetIoSettings {
+    int receivePackets = 1024;        // 收包池的大小
+    int sendPackets = 1024;           // 发包池的大小，128帧时255个客户端可以积压4帧
+    double receiveInterval = 0.0005;  // 两次从套接字收包之间至少隔这么久（秒），限制每帧的系统调用
+};
+
+// Stop之后才能读（不加锁，I/O线程写）
+struct NetIoStats {
+    long long wakeups = 0;            // poll返回的次数
+    long long receiveCalls = 0;       // recvmmsg
+    long long sendCalls = 0;          // sendmmsg
+    long long flushes = 0;            // 模拟线程唤醒I/O线程的次数（每次一个write）
+    long long packetsIn = 0;
+    long long packetsOut = 0;
+    long long receivePoolFull = 0;    // 收包池用完，包留在套接字里等下次
+    long long sendPoolFull = 0;       // 发包池用完，模拟线程丢掉的包
+    long long sendFailures = 0;       // 套接字缓冲区满或出错丢掉的包
+};
+
+// 专用服务器的网络I/O线程
+// 模拟线程不做系统调用：收到的包从队列里取（处理完还回收包池），要发的包从发包池借出、写好后放进发送队列，
+// 每帧最后Flush一次，往唤醒管道里写一个字节。I/O线程在套接字和唤醒管道上poll，
+// 被唤醒时用sendmmsg一次发出最多64个包，套接字可读时用recvmmsg一次收最多64个包；
+// 两次收包之间至少隔receiveInterval，不管有多少客户端，每帧的系统调用数都是常数
+// （180个客户端时每帧约一次write、三次sendmmsg加上十次左右的poll和recvmmsg，逐包收发时是340次左右）。
+// 包在两个预先分配的池里，四个单生产者单消费者队列在两个线程之间传递包的编号：
+// 收到的包和收包池的空闲编号、要发的包和发包池的空闲编号，运行时不分配内存。
+class NetIoThread {
+public:
+    explicit NetIoThread(const NetIoSettings& settings = NetIoSettings());
+    ~NetIoThread();
+    NetIoThread(const NetIoThread&) = delete;
+    NetIoThread& operator=(const NetIoThread&) = delete;
+
+    // 套接字要已经打开，运行时只有I/O线程用它
+    bool Start(UdpSocket* socket);
+    // 发完已经Flush的包后退出线程
+    void Stop();
+    bool IsRunning() const { return m_thread.joinable(); }
+
+    // 以下只在模拟线程调用
+    // 下一个收到的包，没有时为nullptr；处理完要Release
+    NetPacket* Receive();
+    void Release(NetPacket* packet);
+    // 借一个发包池的包，池用完时为nullptr；写好data、size和address后Send，不发了时CancelSend
+    NetPacket* AllocateSend();
+    void Send(NetPacket* packet);
+    void CancelSend(NetPacket* packet);
+    // 唤醒I/O线程发出Send过的包；没有新包时不做系统调用
+    void Flush();
+
+    const NetIoStats& GetStats() const { return m_stats; }
+
+private:
+    NetIoSettings m_settings;
+    UdpSocket* m_socket;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    int m_wakeRead;                   // 唤醒管道
+    int m_wakeWrite;
+
+    std::vector<NetPacket> m_receivePool;
+    std::vector<NetPacket> m_sendPool;
+    PacketQueue m_receiveFree;        // 模拟线程 -> I/O线程
+    PacketQueue m_received;           // I/O线程 -> 模拟线程
+    PacketQueue m_sendFree;           // I/O线程 -> 模拟线程
+    PacketQueue m_sending;            // 模拟线程 -> I/O线程
+    std::vector<int> m_sendSpare;     // 模拟线程借了没发的包
+    std::vector<int> m_receiveSpare;  // I/O线程取了没用上的收包编号
+    bool m_pendingFlush;              // 上次Flush之后Send过
+
+    NetIoStats m_stats;
+
+    void Run();
+    void ReceiveAll();
+    void SendAll();
+};
+
+#endif // NET_IO_THREAD_H
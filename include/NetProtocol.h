@@ -0,0 +1,101 @@
+#ifndef NET_PROTOCOL_H
+#define NET_PROTOCOL_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include "PlayerMovement.h"
+
+// 服务器和客户端之间的数据包
+// 每个包的第一个字节是NetMessageType，多字节的值都是小端序：
+//   CONNECT     协议号u32、客户端随机数u32
+//   ACCEPT      客户端随机数u32、槽位u8、帧率u16、服务器当前帧u32
+//   REJECT      客户端随机数u32（服务器满了）
+//   COMMANDS    槽位u8、客户端随机数u32、收到的最新快照帧u32、看到的时间f32、个数u8、命令（最近的几个，丢包时不用重发）
+//   SNAPSHOT    帧u32、执行到的这个客户端的最后一个命令u32、服务器上一帧用的时间u16（微秒，最大65535）、
+//               这个客户端的玩家的移动状态（不量化，客户端预测用）、
+//               玩家状态的位流（SnapshotEncoder，相对客户端确认收到的快照差量编码）
+//   DISCONNECT  槽位u8、客户端随机数u32
+const uint32_t NET_PROTOCOL_ID = 0x43534734;   // "CSG4"
+const int NET_MAX_PACKET = 4096;
+const int NET_COMMAND_REDUNDANCY = 4;          // 每个命令包带最近的4个命令
+const int NET_MAX_SLOTS = 256;                 // 槽位是u8
+
+enum NetMessageType : uint8_t {
+    NET_CONNECT = 1,
+    NET_ACCEPT,
+    NET_REJECT,
+    NET_COMMANDS,
+    NET_SNAPSHOT,
+    NET_DISCONNECT,
+};
+
+// 快照里的一个玩家
+struct NetPlayerState {
+    enum Flags {
+        FLAG_ALIVE = 1,
+        FLAG_ON_GROUND = 2,
+    };
+
+    uint8_t slot;
+    uint8_t flags;
+    uint8_t health;
+    uint8_t duck;            // duckAmount * 255
+    uint16_t yaw;
+    int16_t pitch;
+    glm::vec3 position;
+    glm::vec3 velocity;
+};
+
+// 按顺序写入定长缓冲区，超出容量后不再写入，GetSize不变，Overflowed为true
+class ByteWriter {
+public:
+    ByteWriter(uint8_t* data, int capacity) : m_data(data), m_capacity(capacity), m_size(0), m_overflow(false) {}
+
+    void WriteU8(uint8_t value) { Write(&value, 1); }
+    void WriteU16(uint16_t value);
+    void WriteU32(uint32_t value);
+    void WriteFloat(float value);
+    void Write(const void* data, int size);
+
+    int GetSize() const { return m_size; }
+    bool Overflowed() const { return m_overflow; }
+
+private:
+    uint8_t* m_data;
+    int m_capacity;
+    int m_size;
+    bool m_overflow;
+};
+
+// 按顺序读取，读过头后返回0，Failed为true
+class ByteReader {
+public:
+    ByteReader(const uint8_t* data, int size) : m_data(data), m_size(size), m_offset(0), m_failed(false) {}
+
+    uint8_t ReadU8();
+    uint16_t ReadU16();
+    uint32_t ReadU32();
+    float ReadFloat();
+    void Read(void* data, int size);
+
+    int GetRemaining() const { return m_size - m_offset; }
+    const uint8_t* GetCursor() const { return m_data + m_offset; }
+    bool Failed() const { return m_failed; }
+
+private:
+    const uint8_t* m_data;
+    int m_size;
+    int m_offset;
+    bool m_failed;
+};
+
+void WriteCommand(ByteWriter& writer, const PlayerCommand& command);
+PlayerCommand ReadCommand(ByteReader& reader);
+// 移动状态（30字节），和服务器上的完全相同，客户端预测从它重新模拟
+void WriteMoveState(ByteWriter& writer, const PlayerState& state);
+PlayerState ReadMoveState(ByteReader& reader);
+// 不压缩的玩家状态（32字节），快照改用SnapshotEncoder后只用来比较
+void WritePlayerState(ByteWriter& writer, const NetPlayerState& state);
+NetPlayerState ReadPlayerState(ByteReader& reader);
+
+#endif // NET_PROTOCOL_H
@@ -0,0 +1,64 @@
+#ifndef NET_SOCKET_H
+#define NET_SOCKET_H
+
+#include <cstdint>
+
+// IPv4地址和端口（主机字节序）
+struct NetAddress {
+    uint32_t ip;
+    uint16_t port;
+
+    static NetAddress Loopback(uint16_t port) { return {0x7F000001u, port}; }
+    bool operator==(const NetAddress& other) const { return ip == other.ip && port == other.port; }
+    bool operator!=(const NetAddress& other) const { return !(*this == other); }
+};
+
+// 批量收发的一个数据包，data指向调用者的缓冲区
+struct NetDatagram {
+    NetAddress address;
+    uint8_t* data;
+    int size;
+    int capacity;             // 接收时data的大小，更长的包被截断
+};
+
+// 非阻塞的UDP套接字
+// 收发都不等待：没有数据时ReceiveFrom返回0，发送缓冲区满时SendTo返回0（UDP本来就可能丢包）。
+// ReceiveBatch/SendBatch一次系统调用收发最多MAX_BATCH个包（Linux上是recvmmsg/sendmmsg，其他系统逐个收发）。
+class UdpSocket {
+public:
+    static constexpr int MAX_BATCH = 64;
+
+    UdpSocket();
+    ~UdpSocket();
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    // 绑定本机的端口，0为系统分配；loopbackOnly时只接受本机的数据包
+    bool Open(uint16_t port, bool loopbackOnly = false);
+    void Close();
+    bool IsOpen() const { return m_socket >= 0; }
+    // 实际绑定的端口
+    uint16_t GetPort() const { return m_port; }
+    // 收发缓冲区的大小（字节），一次收不完的快照会在缓冲区里排队
+    void SetBufferSize(int bytes);
+
+    // 返回发送的字节数，失败时为-1
+    int SendTo(const void* data, int size, const NetAddress& address);
+    // 返回收到的字节数，没有数据时为0，失败时为-1
+    int ReceiveFrom(void* buffer, int capacity, NetAddress& address);
+    // 发送datagrams[0...count)（count不超过MAX_BATCH），返回发出去的个数（前面的），失败时为-1
+    int SendBatch(const NetDatagram* datagrams, int count);
+    // 收到datagrams里，填好address和size，返回收到的个数，没有数据时为0，失败时为-1
+    int ReceiveBatch(NetDatagram* datagrams, int count);
+    // 给poll用
+    int GetHandle() const { return m_socket; }
+
+private:
+    int m_socket;
+    uint16_t m_port;
+};
+
+// 解析 "host:port" 或 "port"，host只支持点分的IPv4地址和localhost
+bool ParseNetAddress(const char* text, NetAddress& address);
+
+#endif // NET_SOCKET_H
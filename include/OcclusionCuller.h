@@ -0,0 +1,61 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class JobSystem;
+
+// CPU软件遮挡剔除
+// 每帧把指定的遮挡体（房间墙壁、有厚度的前墙）光栅化到一张低分辨率深度图，
+// 然后用候选物体的包围盒去测试，被完全挡住的绘制在提交给驱动之前就被丢弃。
+// 光栅化按水平条带分给工作线程，每次用SIMD计算4个像素的边函数和覆盖掩码；
+// 完成后再生成每个8x8块的最远深度，测试时先按块拒绝再逐像素检查。
+// 不依赖GPU，没有显卡的机器上结果完全一致。
+class OcclusionCuller {
+public:
+    OcclusionCuller(int width = 256, int height = 128);
+    ~OcclusionCuller();
+
+    void SetJobSystem(JobSystem* jobs) { m_jobs = jobs; }
+
+    // 遮挡体（世界坐标），通常在加载关卡时设置一次
+    void ClearOccluders();
+    void AddOccluderTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+    void AddOccluderQuad(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d);
+
+    // 用本帧的 投影 * 视图 矩阵光栅化所有遮挡体
+    void RenderOccluders(const glm::mat4& viewProjection);
+
+    // 包围盒是否可能可见（保守：跨过近平面的包围盒总是可见，完全在视锥外的不可见）
+    bool IsBoxVisible(const glm::vec3& minBounds, const glm::vec3& maxBounds) const;
+
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+    const float* GetDepthBuffer() const { return m_depth.data(); }
+
+private:
+    struct ScreenTriangle {
+        float x[3], y[3], z[3];
+        int minY, maxY;
+    };
+
+    int m_width, m_height;
+    int m_tilesX, m_tilesY;
+    JobSystem* m_jobs;
+    glm::mat4 m_viewProjection;
+
+    std::vector<glm::vec3> m_occluders; // 每3个顶点一个三角形
+    std::vector<ScreenTriangle> m_triangles;
+    std::vector<float> m_depth;   // 归一化深度 [0, 1]，1为最远
+    std::vector<float> m_tileMax; // 每个8x8块中最远的遮挡深度
+
+    void SetupTriangles();
+    void ClipAndAddTriangle(const glm::vec4 clip[3]);
+    void AddScreenTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void RasterizeBand(int band);
+    void RasterizeTriangle(const ScreenTriangle& tri, int rowBegin, int rowEnd);
+    void UpdateTileMax(int rowBegin, int rowEnd);
+};
+
+#endif // OCCLUSION_CULLER_H
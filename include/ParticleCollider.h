@@ -0,0 +1,117 @@
+#ifndef PARTICLE_COLLIDER_H
+#define PARTICLE_COLLIDER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "ParticleSystem.h"
+
+class LevelGeometry;
+
+// 一段连续粒子的属性数组（ParticleSystem的SoA存储）
+struct ParticleStreams {
+    float* posX;
+    float* posY;
+    float* posZ;
+    float* velX;
+    float* velY;
+    float* velZ;
+    float* life;
+    int count;
+};
+
+// 粒子碰撞体
+// 三种形状，都描述实体所在的一侧：
+//   - 平面：normal指向空的一侧，dot(normal, p) < distance 为实体（房间的地面、天花板、墙）
+//   - 轴对齐盒子：内部为实体（带窗洞的前墙拆成几块）
+//   - 粗糙的有向距离场：任意四边形，每个四边形向背面挤出表面的厚度；距离在网格顶点上预先算好，
+//     查询时三线性插值，法线取插值的梯度
+// 粒子看作半径为radius的球，进入实体后推回表面，再按效果的设置反弹、停住或消失。
+// 每次调用先求这段粒子的包围盒，只留下可能碰到它的形状（远离墙的一块粒子只花求包围盒的时间）；
+// 留下的平面和盒子每次用SSE2测试4个粒子，整组都没有接触时不写回；距离场先按组判断是否在范围内，
+// 范围内的粒子逐个采样。开销与粒子数 × 留下的形状数成正比，不分配内存，
+// 多个线程可以同时对不同的粒子调用Collide。
+class ParticleCollider {
+public:
+    static const int MAX_PLANES = 32;
+    static const int MAX_BOXES = 32;
+
+    // 盒子的面：粒子只从这些面推出去，与其他盒子相接的面不要加，否则会被推进相邻的盒子
+    enum BoxFace {
+        BOX_FACE_NEG_X = 1,
+        BOX_FACE_POS_X = 2,
+        BOX_FACE_NEG_Y = 4,
+        BOX_FACE_POS_Y = 8,
+        BOX_FACE_NEG_Z = 16,
+        BOX_FACE_POS_Z = 32,
+        BOX_FACE_ALL = 63
+    };
+
+    ParticleCollider();
+
+    void Clear();
+    // 超过MAX_PLANES / MAX_BOXES时返回false
+    bool AddPlane(const glm::vec3& normal, float distance);
+    // 相接的盒子按添加顺序处理：被前一个盒子推进后一个盒子的粒子会再从后一个盒子推出去
+    bool AddBox(const glm::vec3& minBounds, const glm::vec3& maxBounds, int faces = BOX_FACE_ALL);
+    // 在 [minBounds, maxBounds] 内按cellSize采样surfaces的有向距离；
+    // 比两个格子薄的表面按两个格子的厚度计算，否则表面背后没有负的采样点，粒子会穿过去
+    void BuildDistanceField(const LevelGeometry& level, const std::vector<int>& surfaces,
+                            const glm::vec3& minBounds, const glm::vec3& maxBounds, float cellSize);
+
+    // 房间的地面、天花板和三面墙为平面，前墙窗洞四周为盒子，窗户框架和玻璃为距离场
+    void BuildLevel(const LevelGeometry& level);
+
+    bool IsEmpty() const { return m_planes.empty() && m_boxes.empty() && m_field.empty(); }
+
+    // 返回接触的粒子个数；KILL的粒子生命值设为0，由调用者删除
+    int Collide(const ParticleStreams& particles, const ParticleCollisionParams& params) const;
+
+    // 有向距离和梯度（未归一化），在距离场范围外返回false
+    bool SampleDistanceField(const glm::vec3& position, float& distance, glm::vec3& gradient) const;
+
+private:
+    struct Plane {
+        glm::vec3 normal;
+        float distance;
+    };
+
+    struct Box {
+        glm::vec3 minBounds;
+        glm::vec3 maxBounds;
+        int faces;
+    };
+
+    // 一次调用中可能碰到粒子的形状
+    struct ActiveShapes {
+        Plane planes[MAX_PLANES];
+        Box boxes[MAX_BOXES];   // 已按半径扩大
+        int planeCount;
+        int boxCount;
+        bool field;
+    };
+
+    std::vector<Plane> m_planes;
+    std::vector<Box> m_boxes;
+
+    std::vector<float> m_field;  // x最快，然后y、z
+    int m_fieldSize[3];
+    glm::vec3 m_fieldMin;
+    glm::vec3 m_fieldMax;
+    float m_cellSize;
+
+    float FieldValue(int x, int y, int z) const {
+        return m_field[(static_cast<size_t>(z) * m_fieldSize[1] + y) * m_fieldSize[0] + x];
+    }
+
+    void FindActiveShapes(const ParticleStreams& particles, float radius, ActiveShapes& active) const;
+
+    // 逐个粒子测试 [begin, end)，用于没有SSE2时、每段末尾不满4个的粒子和距离场
+    int CollideScalar(const ParticleStreams& particles, const ParticleCollisionParams& params,
+                      const ActiveShapes& active, int begin, int end, bool shapes) const;
+#if defined(__SSE2__)
+    int CollideSSE2(const ParticleStreams& particles, const ParticleCollisionParams& params,
+                    const ActiveShapes& active, int end) const;
+#endif
+};
+
+#endif // PARTICLE_COLLIDER_H
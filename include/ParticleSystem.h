@@ -0,0 +1,139 @@
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class ParticleCollider;
+
+// 粒子碰到关卡后的处理
+enum ParticleCollisionResponse {
+    PARTICLE_COLLISION_NONE = 0, // 不做碰撞
+    PARTICLE_COLLISION_BOUNCE,   // 反弹，restitution为0时沿表面滑动
+    PARTICLE_COLLISION_STICK,    // 停在表面上
+    PARTICLE_COLLISION_KILL      // 立即消失
+};
+
+struct ParticleCollisionParams {
+    ParticleCollisionResponse response = PARTICLE_COLLISION_NONE;
+    float radius = 0.0f;       // 碰撞半径
+    float restitution = 0.5f;  // 反弹后法向速度保留的比例
+    float friction = 0.0f;     // 反弹时切向速度损失的比例
+};
+
+// 粒子模拟参数（单位：米、秒）
+struct ParticleSimParams {
+    glm::vec3 gravity = glm::vec3(0.0f);
+    float turbulence = 0.0f;   // 水平速度随机扰动的加速度上限
+    float drag = 0.0f;         // 每秒速度衰减的比例
+    float growth = 0.0f;       // 每秒尺寸增长
+    ParticleCollisionParams collision;
+};
+
+// 发射用的xorshift32随机数
+struct ParticleRandom {
+    uint32_t state;
+
+    explicit ParticleRandom(uint32_t seed);
+    // [0, 1)
+    float Next();
+    float Range(float minValue, float maxValue) { return minValue + (maxValue - minValue) * Next(); }
+};
+
+// 把几个数混合成一个随机数种子（同样的输入总是得到同样的种子）
+uint32_t HashParticleSeed(uint32_t a, uint32_t b, uint32_t c = 0);
+
+// 粒子系统
+// 数据按属性分数组存放（SoA），每8个粒子一组更新：
+//   积分、衰老、颜色查表和删除死亡粒子在同一遍里完成。
+//   颜色、透明度和尺寸倍数只取决于生命值，预先计算成256项的查找表。
+//   随机扰动来自8路xorshift32，每组粒子的每一路用自己的状态。
+//   死亡粒子用掩码压缩掉，不需要分支，存活粒子保持原来的顺序。
+// 编译时开启AVX2用256位指令，否则用SSE2，两者都没有时退回标量循环；
+// 三条路径消耗随机数的顺序相同。
+//
+// 粒子按CHUNK_SIZE分块，每块的随机数状态由 (种子, 更新次数, 块编号) 决定，
+// 不同的块可以在不同线程上同时更新（BeginUpdate / UpdateChunk / EndUpdate），
+// 结果与线程数无关。
+class ParticleSystem {
+public:
+    typedef std::function<glm::vec4(float life)> ColorFunc;
+    typedef std::function<float(float life)> SizeFunc;
+
+    static const int CHUNK_SIZE = 2048;
+
+    explicit ParticleSystem(int capacity = 1024);
+
+    void Seed(uint32_t seed);
+    void SetParams(const ParticleSimParams& params) { m_params = params; }
+    const ParticleSimParams& GetParams() const { return m_params; }
+
+    // 按生命值 (0, 1] 采样生成查找表，生命值从1减到0
+    void SetColorGradient(const ColorFunc& color);
+    void SetSizeCurve(const SizeFunc& size);
+
+    void Clear() { m_count = 0; }
+    // 满了返回-1
+    int Spawn(const glm::vec3& position, const glm::vec3& velocity, float size, float lifetime);
+    void Update(float deltaTime);
+
+    // 分块更新：BeginUpdate返回块数，各块的UpdateChunk可以并行调用，最后EndUpdate合并
+    int BeginUpdate();
+    void UpdateChunk(int chunk, float deltaTime);
+    // 块更新之后、EndUpdate之前对块内的粒子做碰撞（与UpdateChunk一样可以并行），返回接触的粒子数；
+    // KILL的粒子立即删除
+    int CollideChunk(int chunk, const ParticleCollider& collider);
+    void EndUpdate();
+
+    // 发射时使用的随机数 [0, 1)
+    float Random() { return m_spawnRandom.Next(); }
+
+    int GetCount() const { return m_count; }
+    int GetCapacity() const { return m_capacity; }
+
+    glm::vec3 GetPosition(int i) const { return glm::vec3(m_posX[i], m_posY[i], m_posZ[i]); }
+    // 乘上尺寸曲线之后的大小
+    float GetSize(int i) const { return m_size[i] * m_sizeLut[LutIndex(m_life[i])]; }
+    float GetLife(int i) const { return m_life[i]; }
+    // RGBA8，r在最低字节
+    uint32_t GetColor(int i) const { return m_color[i]; }
+
+    static glm::vec4 UnpackColor(uint32_t color);
+
+private:
+    static const int LANES = 8;
+    static const int LUT_SIZE = 256;
+
+    int m_capacity;
+    int m_count;
+    ParticleSimParams m_params;
+    uint32_t m_seed;
+    uint32_t m_step;
+
+    // 长度为容量加一组，最后一组可以整组读写
+    std::vector<float> m_posX, m_posY, m_posZ;
+    std::vector<float> m_velX, m_velY, m_velZ;
+    std::vector<float> m_life;
+    std::vector<float> m_fade;   // 每秒减少的生命值
+    std::vector<float> m_size;   // 乘尺寸曲线之前的大小
+    std::vector<uint32_t> m_color;
+    std::vector<int> m_chunkCounts; // 每块更新后存活的个数
+
+    uint32_t m_colorLut[LUT_SIZE];
+    float m_sizeLut[LUT_SIZE];
+    ParticleRandom m_spawnRandom;
+
+    static int LutIndex(float life);
+
+    // 更新 [begin, end)，存活的压缩到begin开始，返回存活个数
+    int UpdateScalar(int begin, int end, float deltaTime, uint32_t laneState[LANES]);
+#if defined(__AVX2__)
+    int UpdateAVX2(int begin, int end, float deltaTime, uint32_t laneState[LANES]);
+#elif defined(__SSE2__)
+    int UpdateSSE2(int begin, int end, float deltaTime, uint32_t laneState[LANES]);
+#endif
+};
+
+#endif // PARTICLE_SYSTEM_H
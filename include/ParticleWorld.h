@@ -0,0 +1,158 @@
+#ifndef PARTICLE_WORLD_H
+#define PARTICLE_WORLD_H
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ParticleSystem.h"
+
+class JobSystem;
+class ParticleCollider;
+
+// 曲线关键点，age为归一化年龄：0为刚发射，1为消失
+struct ParticleColorKey {
+    float age;
+    glm::vec4 color;
+};
+
+struct ParticleSizeKey {
+    float age;
+    float scale;
+};
+
+// 数据定义的粒子效果
+struct ParticleEffectDesc {
+    std::string name;
+    int maxParticles = 256;
+    float spawnRate = 0.0f;      // 每秒发射个数
+    int burst = 0;               // 启动时一次发射的个数
+    float duration = 0.0f;       // 持续发射的时间，0表示一直发射（spawnRate为0时只发射burst）
+    float lifetimeMin = 1.0f, lifetimeMax = 1.0f;
+    float sizeMin = 0.1f, sizeMax = 0.1f;
+    float speedMin = 0.0f, speedMax = 0.0f;
+    glm::vec3 direction = glm::vec3(0.0f, 1.0f, 0.0f);
+    float coneAngle = 0.0f;      // 速度方向与direction的最大夹角（度）
+    float spawnRadius = 0.0f;    // 在这个半径的球内发射
+    ParticleSimParams sim;
+    std::vector<ParticleColorKey> colorKeys; // 按age升序，同一age写两次表示突变
+    std::vector<ParticleSizeKey> sizeKeys;
+    std::vector<std::string> children;       // 同时启动的其他效果
+};
+
+// 按年龄采样颜色和大小曲线（没有关键点时颜色为白色线性淡出，大小倍数为1）
+glm::vec4 SampleParticleColor(const std::vector<ParticleColorKey>& keys, float age);
+float SampleParticleSize(const std::vector<ParticleSizeKey>& keys, float age);
+
+// 发射器的发射进度，CPU和GPU后端共用
+struct ParticleEmitterClock {
+    float age = 0.0f;
+    float spawnAccumulator = 0.0f;
+    bool burstDone = false;
+
+    // 推进deltaTime，返回本帧应发射的个数：第一次包含burst，之后按速率累积
+    int Advance(const ParticleEffectDesc& effect, float deltaTime);
+    bool IsEmitting(const ParticleEffectDesc& effect) const;
+};
+
+struct ParticleWorldStats {
+    int emitters = 0;
+    int particles = 0;
+    int spawned = 0;        // 本帧新发射的粒子
+    int updateChunks = 0;   // 本帧并行更新的块数
+    int collisions = 0;     // 本帧粒子与关卡的接触次数
+    int spawnBatches = 0;   // 本帧并行发射的批数
+};
+
+// 粒子世界
+// 管理所有效果实例（发射器），每个发射器有自己的粒子池，火焰、烟雾、火花、手雷可以同时存在。
+// 每帧的更新和发射拆成一批独立的任务交给工作线程：
+//   - 每个发射器的粒子按块更新（ParticleSystem::UpdateChunk），紧接着在同一个任务里与关卡碰撞
+//   - 发射按批生成，每批的随机数种子由 (发射器种子, 帧号, 批号) 决定，
+//     结果写进当前线程的发射缓冲区
+// 全部完成后按发射器和批的顺序把缓冲区里的粒子加入粒子池，
+// 因此结果与线程数和任务被哪个线程执行无关。
+class ParticleWorld {
+public:
+    ParticleWorld();
+    ~ParticleWorld();
+
+    void SetJobSystem(JobSystem* jobs) { m_jobs = jobs; }
+    // 更新每个块之后与关卡碰撞（效果的collision为none时跳过），nullptr关闭碰撞
+    void SetCollider(const ParticleCollider* collider) { m_collider = collider; }
+    void Seed(uint32_t seed) { m_seed = seed; }
+
+    // 从文本文件读取效果定义，同名的效果被替换
+    bool LoadEffects(const char* path);
+    int AddEffect(const ParticleEffectDesc& effect);
+    int FindEffect(const char* name) const;
+    int GetEffectCount() const { return static_cast<int>(m_effects.size()); }
+    const ParticleEffectDesc& GetEffect(int effect) const { return m_effects[effect]; }
+
+    // 启动效果和它的子效果，返回发射器个数（效果不存在返回0）
+    // direction不为零时代替效果定义的发射方向（例如击中表面的法线）
+    int Spawn(int effect, const glm::vec3& position, const glm::vec3& direction = glm::vec3(0.0f));
+    void Clear();
+
+    void Update(float deltaTime);
+
+    int GetEmitterCount() const { return static_cast<int>(m_emitters.size()); }
+    const ParticleSystem& GetParticles(int emitter) const { return m_emitters[emitter]->particles; }
+    const ParticleWorldStats& GetStats() const { return m_stats; }
+
+private:
+    struct Emitter {
+        int effect;
+        glm::vec3 position;
+        glm::vec3 direction;
+        uint32_t seed;
+        uint32_t frame;
+        ParticleEmitterClock clock;
+        ParticleSystem particles;
+
+        explicit Emitter(int capacity) : particles(capacity) {}
+    };
+
+    struct SpawnRecord {
+        glm::vec3 position;
+        glm::vec3 velocity;
+        float size;
+        float lifetime;
+    };
+
+    // 一批发射任务，执行后记录结果在哪个线程的缓冲区里
+    struct SpawnBatch {
+        int emitter;
+        int count;
+        uint32_t seed;
+        int thread;
+        size_t offset;
+    };
+
+    // 更新任务：发射器的一个块
+    struct UpdateTask {
+        int emitter;
+        int chunk;
+        int contacts;
+    };
+
+    JobSystem* m_jobs;
+    const ParticleCollider* m_collider;
+    uint32_t m_seed;
+    uint32_t m_spawnSerial;
+    std::vector<ParticleEffectDesc> m_effects;
+    std::vector<std::unique_ptr<Emitter>> m_emitters;
+
+    std::vector<UpdateTask> m_updateTasks;
+    std::vector<SpawnBatch> m_spawnBatches;
+    std::vector<std::vector<SpawnRecord>> m_spawnBuffers; // 每个线程一个
+    ParticleWorldStats m_stats;
+
+    ParticleWorld(const ParticleWorld&) = delete;
+    ParticleWorld& operator=(const ParticleWorld&) = delete;
+
+    void SpawnEmitter(int effect, const glm::vec3& position, const glm::vec3& direction, int depth, int& spawned);
+    void RunSpawnBatch(SpawnBatch& batch, int thread);
+};
+
+#endif // PARTICLE_WORLD_H
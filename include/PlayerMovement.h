@@ -0,0 +1,106 @@
+#ifndef PLAYER_MOVEMENT_H
+#define PLAYER_MOVEMENT_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+class CollisionWorld;
+struct SweepHit;
+
+// 命令中的按键
+enum PlayerButton {
+    BUTTON_JUMP = 1,
+    BUTTON_DUCK = 2,
+    BUTTON_WALK = 4,
+    BUTTON_ATTACK = 8,
+};
+
+// 一帧的输入命令：客户端每帧生成一个，服务器和客户端预测用同样的命令模拟
+// 角度和移动量都是整数，网络上传输的就是模拟用的值
+struct PlayerCommand {
+    int tick;
+    uint16_t yaw;        // 视角，一圈为65536，0为+x方向，16384为+z方向（与相机的yaw相同）
+    int16_t pitch;       // 向上为正，[-16384, 16384]
+    int8_t forward;      // 前后移动 [-127, 127]
+    int8_t side;         // 左右移动，向右为正
+    uint8_t buttons;     // PlayerButton
+};
+
+// 玩家的移动状态，只有这些值决定下一帧
+struct PlayerState {
+    glm::vec3 position;       // 碰撞胶囊的底部（脚底）
+    glm::vec3 velocity;
+    float duckAmount;         // 0为站立，1为完全蹲下
+    uint8_t onGround;
+    uint8_t previousButtons;  // 上一帧的按键，跳跃需要重新按下
+};
+
+// 移动参数，单位为米和秒（1米约39.4个Source单位）
+struct MovementSettings {
+    int tickRate = 128;
+    float maxSpeed = 6.35f;           // 250单位/秒
+    float walkScale = 0.52f;          // 按住走路键时的速度比例
+    float duckScale = 0.34f;          // 蹲下时的速度比例
+    float acceleration = 5.5f;
+    float airAcceleration = 12.0f;
+    float maxAirWishSpeed = 0.76f;    // 空中加速的速度上限（30单位/秒）
+    float friction = 5.2f;
+    float stopSpeed = 2.03f;          // 摩擦按不低于这个速度计算，慢的时候很快停下
+    float gravity = 20.32f;           // 800单位/秒²
+    float jumpSpeed = 7.67f;          // 起跳速度，跳起约1.45米
+    float standHeight = 1.83f;
+    float duckHeight = 1.37f;
+    float standEyeHeight = 1.63f;
+    float duckEyeHeight = 1.17f;
+    float radius = 0.4f;
+    float stepHeight = 0.46f;         // 能直接走上去的台阶高度
+    float duckSpeed = 8.0f;           // 每秒蹲下或站起的进度
+    float maxWalkSlope = 0.7f;        // 能站住的地面法线y分量下限（约45度）
+};
+
+// 固定帧率的玩家移动
+// 地面上先摩擦再加速，空中只有受限的加速和重力（Quake/Source的方式），胶囊用CollisionWorld::MoveCapsule
+// 移动并沿表面滑动，在地面上被挡住时再试一次先抬高stepHeight、移动、再落下，走得更远就上台阶。
+// 结果只取决于状态、命令和碰撞世界，不读时钟也不用随机数；三角函数用多项式从整数角度算出，
+// 不依赖标准库的实现，同样的命令序列在不同机器上得到相同的结果（PlayerMovement.cpp不允许合并乘加）。
+// Simulate是const的，客户端预测可以每帧从服务器确认的状态重新模拟几十帧。
+class PlayerMovement {
+public:
+    explicit PlayerMovement(const MovementSettings& settings = MovementSettings());
+
+    void SetWorld(const CollisionWorld* world) { m_world = world; }
+    const MovementSettings& GetSettings() const { return m_settings; }
+    float GetTickSeconds() const { return 1.0f / static_cast<float>(m_settings.tickRate); }
+
+    // 前进一帧
+    void Simulate(PlayerState& state, const PlayerCommand& command) const;
+
+    float GetHeight(const PlayerState& state) const;
+    float GetEyeHeight(const PlayerState& state) const;
+
+    // 角度（度）与命令中的整数角度
+    static uint16_t QuantizeYaw(float degrees);
+    static int16_t QuantizePitch(float degrees);
+    // 整数角度的水平前方和右方
+    static void YawVectors(uint16_t yaw, glm::vec3& forward, glm::vec3& right);
+
+private:
+    MovementSettings m_settings;
+    const CollisionWorld* m_world;
+
+    void UpdateDuck(PlayerState& state, bool duck) const;
+    void GroundMove(PlayerState& state, const glm::vec3& delta) const;
+    // 在地面上被挡住时试着走上台阶，比moved走得更远时替换moved和velocity
+    void StepMove(const PlayerState& state, float height, const glm::vec3& delta, glm::vec3& moved,
+                  glm::vec3& velocity) const;
+    void AirMove(PlayerState& state, const glm::vec3& delta) const;
+    void CategorizePosition(PlayerState& state, float probe) const;
+    // 向下扫掠碰到的地方能不能站住：平缓的面，或者台阶的边
+    bool IsStandable(const SweepHit& hit) const;
+    // 胶囊从脚底position移动delta，返回新的脚底位置，velocity去掉指向碰到的面的分量；
+    // blocked表示碰到了站不住的面（墙、台阶的侧面）
+    glm::vec3 SlideMove(const glm::vec3& position, float height, const glm::vec3& delta, bool ground,
+                        glm::vec3* velocity, bool& blocked) const;
+};
+
+#endif // PLAYER_MOVEMENT_H
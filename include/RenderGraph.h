@@ -0,0 +1,140 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glm/glm.hpp>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+class Renderer;
+
+// 全屏pass的类型
+enum FullscreenPassType {
+    FULLSCREEN_SAMPLE,    // vec4 $fn(vec2 uv)：可以在任意位置采样输入
+    FULLSCREEN_POINTWISE  // vec4 $fn(vec4 color, vec2 uv)：color为第一个输入在同一像素的值
+};
+
+// 编译结果统计
+struct RenderGraphStats {
+    int declaredPasses = 0;
+    int culledPasses = 0;
+    int fusedPasses = 0;       // 合并进其他pass的个数
+    int executedPasses = 0;    // 实际执行的pass（合并后的算一个）
+    int virtualTextures = 0;   // 声明的临时纹理
+    int physicalTextures = 0;  // 实际分配的纹理
+    size_t physicalBytes = 0;
+};
+
+// 后处理渲染图
+// 每帧重新声明资源和pass，pass只声明读写哪些资源，Compile负责：
+//   1. 剔除：只保留写入导入资源（默认帧缓冲等）所需的pass
+//   2. 合并：逐像素pass如果只读上一个全屏pass的输出，且该输出没有别的读者，
+//      两者生成一个shader一次画完，中间纹理不再分配
+//   3. 排序：按依赖拓扑排序，没有依赖关系时保持声明顺序
+//   4. 别名：临时纹理按生命周期分配，生命周期不重叠且尺寸相同的共用一张纹理
+// 纹理在帧之间保留，本帧没有用到的才释放。
+// 资源有分配尺寸和使用尺寸：动态分辨率只使用纹理左下角的一部分，uv在使用区域内为[0, 1]。
+//
+// 全屏pass的GLSL代码里可以使用：
+//   $fn      本pass的函数名
+//   $0..$3   采样第i个输入的函数 vec4 $0(vec2 uv)，坐标限制在使用区域内
+//   $texel0..$texel3  第i个输入一个像素对应的uv大小
+//   $p       vec4参数
+// 逐像素pass的第一个输入通过color传入，不能用$0采样。
+class RenderGraph {
+public:
+    typedef std::function<void()> ExecuteFunc;
+
+    explicit RenderGraph(Renderer& renderer);
+
+    // 开始声明新的一帧，已分配的纹理保留
+    void Reset();
+
+    // 外部纹理（只读或外部管理），framebuffer为0表示不能作为输出
+    int ImportTexture(const char* name, unsigned int texture, unsigned int framebuffer,
+                      int width, int height, int usedWidth, int usedHeight);
+    // 默认帧缓冲
+    int ImportBackbuffer(int width, int height);
+    // 临时RGBA8纹理，由图分配
+    int CreateTexture(const char* name, int width, int height, int usedWidth, int usedHeight);
+
+    // 全屏pass，同名pass的代码必须相同（按名字缓存生成的shader）
+    int AddFullscreenPass(const char* name, FullscreenPassType type, const char* code,
+                          const std::vector<int>& inputs, int output,
+                          const glm::vec4& params = glm::vec4(0.0f));
+    // 自定义绘制，执行前绑定输出的帧缓冲并设置视口
+    int AddPass(const char* name, const std::vector<int>& reads, int output, const ExecuteFunc& execute);
+
+    bool Compile();
+    void Execute();
+
+    const RenderGraphStats& GetStats() const { return m_stats; }
+
+    // 删除所有纹理、帧缓冲和shader，需要在GL上下文销毁之前调用
+    void Release();
+
+private:
+    struct ResourceNode {
+        std::string name;
+        int width, height;
+        int usedWidth, usedHeight;
+        bool imported;
+        unsigned int texture;
+        unsigned int framebuffer;
+        int writer;      // 写入的pass，-1表示没有
+        int readers;     // 存活的读者个数
+        int physical;    // 临时纹理分配到的实际纹理
+    };
+
+    struct PassNode {
+        std::string name;
+        bool fullscreen;
+        FullscreenPassType type;
+        std::string code;
+        std::vector<int> inputs;
+        int output;
+        glm::vec4 params;
+        ExecuteFunc execute;
+        bool alive;
+        int group;
+    };
+
+    // 合并后的执行单元，passes按执行顺序排列，最后一个的输出是组的输出
+    struct PassGroup {
+        std::vector<int> passes;
+        std::vector<int> inputs; // 组外部的输入资源
+        int output;
+    };
+
+    struct PhysicalTexture {
+        int width, height;
+        unsigned int texture;
+        unsigned int framebuffer;
+        bool used;
+    };
+
+    Renderer& m_renderer;
+    std::vector<ResourceNode> m_resources;
+    std::vector<PassNode> m_passes;
+    std::vector<PassGroup> m_groups;      // 按执行顺序
+    std::vector<PhysicalTexture> m_pool;
+    std::map<std::string, unsigned int> m_programs;
+    RenderGraphStats m_stats;
+    bool m_compiled;
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    void CullPasses();
+    void FusePasses();
+    bool SortGroups();
+    void AllocateTextures();
+    int AcquirePhysical(int width, int height, std::vector<bool>& busy);
+
+    unsigned int GetProgram(const PassGroup& group);
+    std::string GenerateShader(const PassGroup& group) const;
+    void ExecuteGroup(const PassGroup& group);
+};
+
+#endif // RENDER_GRAPH_H
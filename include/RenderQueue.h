@@ -0,0 +1,58 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 排序键渲染队列
+// 每个绘制编码成一个64位键，每帧做一次基数排序后按键顺序提交，
+// 这样同一状态的绘制被归并到一起，不透明物体由近到远、半透明物体由远到近。
+//
+// 键的位布局（44位）：
+//   不透明/贴花: [43:42] pass | [41:36] program | [35:24] material | [23:0] depth
+//   半透明:      [43:42] pass | [41:18] ~depth  | [17:12] program  | [11:0] material
+// 半透明必须先按深度排序才能正确混合，所以深度放在状态之前。
+// 排序时键左移20位，低20位存提交序号，只需对8字节的整数做基数排序。
+class RenderQueue {
+public:
+    enum Pass {
+        PASS_OPAQUE = 0,
+        PASS_DECAL = 1,       // 贴在不透明表面上，混合但不需要按深度排序
+        PASS_TRANSLUCENT = 2
+    };
+
+    static const uint32_t MAX_PROGRAMS = 1u << 6;
+    static const uint32_t MAX_MATERIALS = 1u << 12;
+    static const uint32_t MAX_DRAWS = 1u << 20;
+
+    RenderQueue();
+
+    void Reserve(size_t count);
+    void Clear();
+
+    // depth为归一化的视距 (0.0 - 1.0)，超出范围会被截断
+    void Submit(Pass pass, uint32_t program, uint32_t material, float depth, uint32_t payload);
+    void Sort();
+
+    size_t GetCount() const { return m_items.size(); }
+    uint64_t GetKey(size_t index) const { return m_items[index] >> INDEX_BITS; }
+    uint32_t GetPayload(size_t index) const { return m_payloads[m_items[index] & (MAX_DRAWS - 1)]; }
+
+    static uint64_t MakeKey(Pass pass, uint32_t program, uint32_t material, float depth);
+    static Pass GetPass(uint64_t key);
+    static uint32_t GetProgram(uint64_t key);
+    static uint32_t GetMaterial(uint64_t key);
+
+private:
+    static const int INDEX_BITS = 20;
+
+    // (键 << 20) | 提交序号
+    std::vector<uint64_t> m_items;
+    std::vector<uint32_t> m_payloads;
+
+    // 基数排序的双缓冲，保留容量避免每帧分配
+    std::vector<uint64_t> m_tempItems;
+};
+
+#endif // RENDER_QUEUE_H
@@ -4,6 +4,19 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <string>
+#include <vector>
+#include "RenderGraph.h"
+
+class DecalSystem;
+
+// 后处理参数
+struct PostProcessSettings {
+    float sharpness = 0.0f;       // 放大时的锐化强度 [0, 1]，0为只做双线性放大
+    bool bloom = false;           // 火焰等亮部的泛光
+    float bloomThreshold = 0.85f; // 亮度（最大分量）超过阈值的部分参与泛光
+    float bloomKnee = 0.15f;      // 阈值附近的过渡宽度
+    float bloomIntensity = 0.8f;
+};
 
 class Renderer {
 public:
@@ -14,13 +27,18 @@ public:
     void Shutdown();
     
     void BeginFrame();
-    void EndFrame();
+    
+    // 后处理：用渲染图把场景目标经过各个效果输出到默认帧缓冲
+    void EndFrame(int windowWidth, int windowHeight, const PostProcessSettings& settings);
+    const RenderGraphStats& GetPostProcessStats() const { return m_postGraph.GetStats(); }
     
     void SetViewport(int x, int y, int width, int height);
     void Clear(float r = 0.0f, float g = 0.0f, float b = 0.0f, float a = 1.0f);
     
     // Shader管理
     unsigned int CreateShader(const std::string& vertexSource, const std::string& fragmentSource);
+    // 只有顶点shader的transform feedback程序，varyings按顺序交错写入一个缓冲区；链接失败返回0
+    unsigned int CreateTransformFeedbackShader(const std::string& vertexSource, const std::vector<const char*>& varyings);
     void UseShader(unsigned int shader);
     void DeleteShader(unsigned int shader);
     
@@ -34,10 +52,79 @@ public:
     void EnableBlending(bool enable = true);
     void SetBlendFunc(int src, int dst);
     
+    // 离屏场景目标：按最大尺寸分配，动态分辨率只使用左下角的一部分，改变分辨率不需要重新分配
+    bool CreateSceneTarget(int width, int height);
+    void DestroySceneTarget();
+    int GetSceneTargetWidth() const { return m_sceneTargetWidth; }
+    int GetSceneTargetHeight() const { return m_sceneTargetHeight; }
+    
+    // 绑定场景目标并把视口设为width x height（不超过目标大小）
+    void BeginScene(int width, int height);
+    void EndScene();
+    
+    // 低分辨率粒子层，在BeginScene和EndScene之间使用：
+    // Begin把场景深度缩小到1/divisor（取最近的深度）作为层的深度缓冲，清空并绑定层，
+    // 之后绘制的粒子做深度测试、不写深度，rgb累积预乘颜色，alpha累积透过率；
+    // End把层按深度双边放大合成回场景，再绑定回场景目标。projection用来把深度还原成距离
+    void BeginParticleLayer(int divisor, const glm::mat4& projection);
+    void EndParticleLayer();
+    
+    // 一次实例化绘制所有贴花，光照与固定管线相同（前lightCount个光源，颜色材质，无高光）
+    // 调用前设置好混合和深度写入；只上传上次绘制之后新增的贴花
+    void DrawDecals(const DecalSystem& decals, unsigned int atlasTexture, int lightCount);
+    
+    // GPU计时（GL_TIME_ELAPSED），结果几帧后才可读，读取不会阻塞
+    void BeginGpuTimer();
+    void EndGpuTimer();
+    bool ReadGpuTime(float& milliseconds);
+    
 private:
+    static const int GPU_TIMER_QUERIES = 4;
+    
     bool m_initialized;
     unsigned int m_currentShader;
     
+    unsigned int m_sceneFramebuffer;
+    unsigned int m_sceneColorFramebuffer; // 只有颜色，合成粒子层时可以同时采样场景深度
+    unsigned int m_sceneColor;
+    unsigned int m_sceneDepth;            // 深度纹理
+    int m_sceneTargetWidth, m_sceneTargetHeight;
+    int m_sceneWidth, m_sceneHeight;
+    RenderGraph m_postGraph;
+    
+    // 粒子层：与场景目标一样按最大尺寸分配，只使用左下角
+    unsigned int m_particleFramebuffer;
+    unsigned int m_particleColor;
+    unsigned int m_particleDepth;
+    int m_particleTargetWidth, m_particleTargetHeight;
+    int m_particleWidth, m_particleHeight;
+    int m_particleDivisor;
+    glm::vec2 m_particleDepthParams;      // 投影矩阵的[3][2]和[2][2]
+    unsigned int m_particleDepthShader;
+    unsigned int m_particleCompositeShader;
+    
+    // 贴花：一个角点缓冲 + 每个SoA数组一个实例缓冲
+    static const int DECAL_STREAMS = 5;
+    unsigned int m_decalShader;
+    unsigned int m_decalCornerBuffer;
+    unsigned int m_decalBuffers[DECAL_STREAMS];
+    int m_decalAttributes[DECAL_STREAMS + 1]; // 角点 + 各实例属性
+    int m_decalCapacity;
+    unsigned long long m_decalUploaded;      // 已上传的贴花总数（DecalSystem::GetAddedCount）
+    unsigned int m_decalGeneration;
+    
+    unsigned int m_timerQueries[GPU_TIMER_QUERIES];
+    int m_timerWrite, m_timerRead; // 已发出和已读取的查询个数
+    bool m_timerActive;
+    
+    bool CreateParticleTarget(int width, int height);
+    void DestroyParticleTarget();
+    void DrawFullscreenQuad();
+    
+    void CreateDecalBuffers(int capacity);
+    void DestroyDecalBuffers();
+    void UploadDecals(const DecalSystem& decals, int firstSlot, int count);
+    
     std::string ReadFile(const std::string& filepath);
     unsigned int CompileShader(unsigned int type, const std::string& source);
     unsigned int CreateShaderProgram(const std::string& vertexSource, const std::string& fragmentSource);
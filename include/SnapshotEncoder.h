@@ -0,0 +1,113 @@
+#ifndef SNAPSHOT_ENCODER_H
+#define SNAPSHOT_ENCODER_H
+
+#include <cstdint>
+#include <vector>
+#include "NetProtocol.h"
+
+// 快照的量化精度，服务器和客户端必须一致
+struct SnapshotFormat {
+    float positionStep = 1.0f / 64.0f;     // 位置精度（米）
+    float positionExtent = 128.0f;         // 位置范围 ±米，超出的被夹住
+    float velocityStep = 1.0f / 32.0f;     // 速度精度（米/秒）
+    float velocityExtent = 64.0f;          // 速度范围 ±米/秒
+    int yawBits = 16;                      // 水平角位数（PlayerCommand里是16位）
+    int pitchBits = 14;                    // 俯仰角位数
+};
+
+// 玩家状态的量化字段，每个字段是无符号整数，位数由SnapshotFormat决定
+enum SnapshotField {
+    SNAPSHOT_FLAGS,
+    SNAPSHOT_HEALTH,
+    SNAPSHOT_DUCK,
+    SNAPSHOT_YAW,
+    SNAPSHOT_PITCH,
+    SNAPSHOT_POSITION_X,
+    SNAPSHOT_POSITION_Y,
+    SNAPSHOT_POSITION_Z,
+    SNAPSHOT_VELOCITY_X,
+    SNAPSHOT_VELOCITY_Y,
+    SNAPSHOT_VELOCITY_Z,
+    SNAPSHOT_FIELD_COUNT
+};
+
+// 量化后的一帧快照，按槽位存放，是差量编码的基准
+struct QuantizedSnapshot {
+    int tick = -1;
+    std::vector<uint8_t> present;          // 按槽位，这个槽位有没有玩家
+    std::vector<uint32_t> fields;          // 按槽位，每个槽位SNAPSHOT_FIELD_COUNT个字段
+};
+
+// 量化、反量化和字段位数，编码器和解码器共用
+class SnapshotQuantizer {
+public:
+    explicit SnapshotQuantizer(const SnapshotFormat& format = SnapshotFormat());
+
+    const SnapshotFormat& GetFormat() const { return m_format; }
+    int GetFieldBits(int field) const { return m_bits[field]; }
+
+    void Quantize(const NetPlayerState& state, uint32_t* fields) const;
+    NetPlayerState Dequantize(int slot, const uint32_t* fields) const;
+
+private:
+    SnapshotFormat m_format;
+    int m_bits[SNAPSHOT_FIELD_COUNT];
+    uint32_t m_positionMax;
+    uint32_t m_velocityMax;
+};
+
+// 快照编码器（服务器端）
+// 每帧用BeginSnapshot/AddPlayer记下量化后的所有玩家，保留最近HISTORY帧。Encode对某个客户端确认收到的那一帧
+// 做差量：只写变了的玩家，变了的玩家只写变了的字段，字段写量化值的差（小的差用短码）；基准太旧或没有时
+// 相对空快照编码，即完整快照。
+// 位流格式：有没有基准1位（有时再写8位帧号差），然后是变化的玩家：每个前面1位1，槽位间隔（变长），
+// 是否被删除1位，每个字段变没变1位和变化量；最后1位0结束。
+class SnapshotEncoder {
+public:
+    static const int HISTORY = 64;
+
+    SnapshotEncoder(int maxPlayers, const SnapshotFormat& format = SnapshotFormat());
+
+    void BeginSnapshot(int tick);
+    void AddPlayer(const NetPlayerState& player);
+    int GetTick() const { return m_current ? m_current->tick : -1; }
+
+    // baseTick还在历史里、可以作为最新快照的差量基准
+    bool HasBaseline(int baseTick) const;
+    // 相对baseTick编码最新的快照，返回字节数；放不下时返回-1。
+    // visible（按槽位）给出时只发这个客户端看得到的玩家，baseVisible是发基准那一帧时它看得到的玩家，
+    // 这样客户端手里的基准和这里用的一致；看不到了的玩家按删除处理，重新看到时完整地发
+    int Encode(int baseTick, uint8_t* buffer, int capacity, const uint8_t* visible = nullptr,
+               const uint8_t* baseVisible = nullptr) const;
+    // 客户端解码后应该得到的玩家（量化过的），用来检查
+    void GetPlayers(std::vector<NetPlayerState>& players) const;
+    const SnapshotQuantizer& GetQuantizer() const { return m_quantizer; }
+
+private:
+    SnapshotQuantizer m_quantizer;
+    int m_maxPlayers;
+    std::vector<QuantizedSnapshot> m_history;     // 按帧号 % HISTORY
+    QuantizedSnapshot* m_current;
+    QuantizedSnapshot m_empty;
+};
+
+// 快照解码器（客户端）
+// 解出来的快照保留最近HISTORY帧作为之后的基准。客户端只应该确认解码成功的帧，
+// 这样服务器用的基准一定还在这里。
+class SnapshotDecoder {
+public:
+    SnapshotDecoder(int maxPlayers, const SnapshotFormat& format = SnapshotFormat());
+
+    // 基准不在历史里或数据损坏时返回false，players不变
+    bool Decode(int tick, const uint8_t* data, int size, std::vector<NetPlayerState>& players);
+    void Reset();
+
+private:
+    SnapshotQuantizer m_quantizer;
+    int m_maxPlayers;
+    std::vector<QuantizedSnapshot> m_history;
+    QuantizedSnapshot m_empty;
+    QuantizedSnapshot m_scratch;
+};
+
+#endif // SNAPSHOT_ENCODER_H
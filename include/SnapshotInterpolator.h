@@ -0,0 +1,56 @@
+#ifndef SNAPSHOT_INTERPOLATOR_H
+#define SNAPSHOT_INTERPOLATOR_H
+
+#include <vector>
+#include "NetProtocol.h"
+
+struct InterpolationStats {
+    long long snapshots = 0;
+    long long late = 0;           // 到的时候已经显示过了的快照
+    long long samples = 0;
+    long long underruns = 0;      // 要显示的时间超过了最新的快照，只能停在最新的快照上
+};
+
+// 其他玩家的插值（抖动缓冲区）
+// 快照按帧号放进环形缓冲区，每个快照的帧号减去收到的时间（换算成帧）估计服务器时钟的偏移，
+// 偏移和它的平均偏差（抖动）都做指数平滑。显示的时间比估计的服务器最新帧晚一段缓冲延迟，
+// 延迟随抖动自动调整，网络越不稳定缓冲越多；显示时在两边的快照之间插值，中间丢了的快照直接跨过去。
+class SnapshotInterpolator {
+public:
+    static const int BUFFER_SIZE = 64;
+    static constexpr float MIN_DELAY_TICKS = 1.5f;   // 两个快照之间的间隔，加上半帧余量
+    static constexpr float MAX_DELAY_TICKS = 32.0f;
+    static constexpr float TELEPORT_DISTANCE = 3.0f; // 两个快照之间移动超过这个距离时不插值
+
+    explicit SnapshotInterpolator(int tickRate = 128);
+
+    void Reset(int tickRate);
+    void Push(int tick, const std::vector<NetPlayerState>& players, double receiveTime);
+
+    // now时应该显示的服务器时间（帧号带小数），还没有快照时返回-1
+    float GetRenderTick(double now) const;
+    // 在renderTick两边的快照之间插值，没有快照时返回false
+    bool Sample(float renderTick, std::vector<NetPlayerState>& players);
+
+    float GetDelayTicks() const;
+    float GetJitterTicks() const { return static_cast<float>(m_jitter); }
+    const InterpolationStats& GetStats() const { return m_stats; }
+
+private:
+    struct Entry {
+        int tick;
+        std::vector<NetPlayerState> players;
+    };
+
+    int m_tickRate;
+    std::vector<Entry> m_entries;     // 按帧号 % BUFFER_SIZE
+    int m_newestTick;
+    double m_offset;                  // 服务器帧号 - 本地时间 * 帧率
+    double m_jitter;                  // 偏移的平均偏差（帧）
+    float m_lastRenderTick;
+    InterpolationStats m_stats;
+
+    const Entry* Find(int tick) const;
+};
+
+#endif // SNAPSHOT_INTERPOLATOR_H
@@ -0,0 +1,166 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+struct Image;
+class JobSystem;
+
+// 点光源，参数含义与固定管线的glLight相同
+// 与main.cpp中的setupLighting一致，光源位置是在单位模型视图下设置的，即相机空间坐标
+struct RasterLight {
+    glm::vec4 position;
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    float constantAttenuation;
+    float linearAttenuation;
+    float quadraticAttenuation;
+};
+
+struct RasterVertex {
+    glm::vec3 position; // 世界坐标
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+// 分块多线程软件光栅化
+// 用来替代没有显卡时的llvmpipe：同样的三角形、纹理和固定管线光照，直接光栅化到分块的帧缓冲。
+// End()分两个阶段在工作线程上执行：
+//   1. 三角形按提交顺序切成批，每批独立做顶点变换、逐顶点光照、近/远平面裁剪和三角形建立，
+//      并把结果分到它覆盖的64x64块里（每批有自己的块列表，不需要加锁）；
+//   2. 每个块由一个线程独立光栅化，按批次顺序遍历，保证与提交顺序一致（半透明混合需要）。
+// 像素用SIMD一次计算4个边函数和深度，透视校正插值纹理坐标和颜色，纹理双线性过滤并重复平铺。
+//
+// 同一个类也用作低分辨率的半透明层（粒子）：BeginLayer之后按场景的1/divisor分辨率光栅化，
+// 深度测试用场景深度缩小后的结果，End之后由场景的Composite做深度感知的双边放大合成回去。
+class SoftwareRasterizer {
+public:
+    static constexpr int TILE_SIZE = 64;
+    static const int MAX_LAYER_DIVISOR = 4;
+
+    SoftwareRasterizer(int width = 1024, int height = 768);
+
+    void SetJobSystem(JobSystem* jobs) { m_jobs = jobs; }
+
+    void Resize(int width, int height);
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+
+    // 场景参数，每帧Begin之前设置
+    void SetLights(const RasterLight* lights, int count);
+    void SetMatrices(const glm::mat4& view, const glm::mat4& projection);
+
+    // 开始一帧，清除颜色和深度（深度清为1）
+    void Begin(const glm::vec4& clearColor);
+
+    // 之后提交的三角形使用的状态。texture为空时不贴图；
+    // blend为SRC_ALPHA/ONE_MINUS_SRC_ALPHA混合并且不写深度
+    void SetState(const Image* texture, bool lighting, bool blend);
+
+    // color相当于glColor，开启光照时作为环境光和漫反射材质（GL_COLOR_MATERIAL）
+    void AddTriangle(const RasterVertex& a, const RasterVertex& b, const RasterVertex& c, const glm::vec4& color);
+    void AddQuad(const RasterVertex v[4], const glm::vec4& color);
+
+    // 执行所有阶段，返回后帧缓冲可读
+    void End();
+
+    // 开始一个低分辨率层（代替Begin）：尺寸为scene的1/divisor（向上取整），矩阵和光源与scene相同。
+    // 每个像素的深度取scene对应的 divisor x divisor 个像素中最近的，被场景挡住的部分不会画进层里。
+    // 颜色清为(0, 0, 0, 1)，混合的三角形在rgb中累积预乘颜色，在alpha中累积透过率，
+    // 与直接按顺序混合到场景上的结果相同：场景 * 透过率 + rgb。
+    // scene需要已经End，并且在层End之前不能改变。
+    void BeginLayer(const SoftwareRasterizer& scene, int divisor);
+
+    // 把已经End的层放大合成到帧缓冲上。每个像素取层中相邻的4个像素，
+    // 按双线性权重和深度的接近程度加权，深度都不接近时（物体边缘）取深度最接近的一个。
+    void Composite(const SoftwareRasterizer& layer);
+
+    // 读出RGBA8像素，bottomUp为true时与glReadPixels的行顺序相同
+    void ReadPixels(uint8_t* rgba, bool bottomUp) const;
+
+    int GetTriangleCount() const { return static_cast<int>(m_input.size()); }
+
+private:
+    static const int BATCH_SIZE = 256;
+    static const int MAX_LIGHTS = 8;
+
+    struct DrawState {
+        const Image* texture;
+        bool lighting;
+        bool blend;
+    };
+
+    struct InputTriangle {
+        RasterVertex v[3];
+        glm::vec4 color;
+        int state;
+    };
+
+    struct ClipVertex {
+        glm::vec4 clip;
+        glm::vec2 uv;
+        glm::vec4 color;
+    };
+
+    // 屏幕空间三角形：3条边函数，以及 z、1/w、u/w、v/w、rgba/w 的平面方程 a*x + b*y + c
+    enum { PLANE_Z = 0, PLANE_INV_W, PLANE_U, PLANE_V, PLANE_R, PLANE_G, PLANE_B, PLANE_A, PLANE_COUNT };
+    struct SetupTriangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        bool topLeft[3];
+        float planes[PLANE_COUNT][3];
+        int minX, minY, maxX, maxY;
+        int state;
+    };
+
+    // 一批三角形的建立结果和它在每个块中的三角形列表
+    struct Batch {
+        std::vector<SetupTriangle> triangles;
+        std::vector<std::vector<uint32_t>> tiles;
+    };
+
+    int m_width, m_height;
+    int m_tilesX, m_tilesY;
+    JobSystem* m_jobs;
+
+    glm::mat4 m_view;
+    glm::mat4 m_projection;
+    RasterLight m_lights[MAX_LIGHTS];
+    int m_lightCount;
+    uint32_t m_clearColor;
+
+    std::vector<DrawState> m_states;
+    std::vector<InputTriangle> m_input;
+    std::vector<Batch> m_batches;
+    int m_batchCount;
+
+    // 按块存放：每块 TILE_SIZE * TILE_SIZE 个像素连续存储
+    std::vector<uint32_t> m_color;
+    std::vector<float> m_depth;
+
+    // 作为低分辨率层时的场景，否则为空
+    const SoftwareRasterizer* m_layerScene;
+    int m_layerDivisor;
+
+    void SetupBatch(int batch);
+    glm::vec4 Light(const glm::vec3& eyePosition, const glm::vec3& eyeNormal, const glm::vec4& color) const;
+    int ClipPolygon(const ClipVertex* vertices, int count, float sign, ClipVertex* out) const;
+    void SetupScreenTriangle(Batch& batch, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, int state);
+
+    size_t PixelIndex(int x, int y) const {
+        return (static_cast<size_t>(y / TILE_SIZE) * m_tilesX + x / TILE_SIZE) * TILE_SIZE * TILE_SIZE +
+               (y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE;
+    }
+    // 深度缓冲中的值还原成到相机的距离
+    float LinearDepth(float depth) const;
+
+    void RasterizeTile(int tile);
+    void DownsampleDepth(int tile);
+    void CompositeTile(const SoftwareRasterizer& layer, int tile);
+    void RasterizeTriangle(const SetupTriangle& tri, int tile);
+    uint32_t Shade(const SetupTriangle& tri, const DrawState& state, float x, float y, uint32_t dst) const;
+};
+
+#endif // SOFTWARE_RASTERIZER_H
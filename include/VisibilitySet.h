@@ -0,0 +1,84 @@
+#ifndef VISIBILITY_SET_H
+#define VISIBILITY_SET_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+class LevelGeometry;
+
+struct VisibilitySettings {
+    float leafSize = 4.0f;        // 单元格按这个边长的均匀网格切成叶子（米）
+};
+
+struct VisibilityStats {
+    int cells = 0;
+    int leaves = 0;
+    int uniqueRows = 0;           // 去掉重复之后的可见性行数
+    int rawBytes = 0;             // 每个叶子一行、不压缩时的字节数
+    int compressedBytes = 0;      // 去重并压缩后存进文件的字节数
+    float visibleFraction = 0.0f; // 互相可见的叶子对的比例
+    double compileSeconds = 0.0;
+};
+
+// 预计算的可见集（PVS）
+// 离线编译：关卡的每个单元格（凸的空区域）按均匀网格切成叶子，同一个单元格里的叶子互相可见；
+// 别的单元格经过一串开口（窗户）才能看到，对每个开口判断是否存在一条从源叶子穿过它到目标的线段，
+// 一串开口里每一段都要过得去，只会多算不会漏算。每个叶子的可见性是一行位集，相同的行只存一次，
+// 存文件时连续的0x00和0xFF字节按游程压缩。
+// 加载时解压成完整的位集；位置到叶子查均匀网格（每格只有一两个叶子），两个叶子能否互相看到查一位，都是O(1)。
+class VisibilitySet {
+public:
+    bool Compile(const LevelGeometry& level, const VisibilitySettings& settings = VisibilitySettings());
+    bool Save(const std::string& path) const;
+    bool Load(const std::string& path);
+
+    bool IsValid() const { return !m_leaves.empty(); }
+    int GetLeafCount() const { return static_cast<int>(m_leaves.size()); }
+    const VisibilityStats& GetStats() const { return m_stats; }
+
+    // 位置所在的叶子，不在任何单元格里（墙里、关卡外）时返回-1
+    int FindLeaf(const glm::vec3& position) const;
+    // 叶子from的可见性位集，from为-1时返回空；一个叶子要查很多目标时先取出这一行
+    const uint64_t* GetRow(int from) const {
+        return from < 0 ? nullptr : &m_rows[static_cast<size_t>(m_leafRows[from]) * m_rowWords];
+    }
+    static bool RowCanSee(const uint64_t* row, int to) {
+        return !row || to < 0 || ((row[to >> 6] >> (to & 63)) & 1);
+    }
+    // 叶子from能不能看到叶子to；任何一个为-1时保守地返回true
+    bool CanSee(int from, int to) const { return RowCanSee(GetRow(from), to); }
+
+private:
+    struct Leaf {
+        glm::vec3 minBounds;
+        glm::vec3 maxBounds;
+        int cell;
+    };
+
+    std::vector<Leaf> m_leaves;             // 按单元格排好
+    std::vector<uint32_t> m_leafRows;       // 每个叶子的可见性是第几行
+    std::vector<uint8_t> m_compressed;      // 压缩后的行，文件里存的就是这些
+    std::vector<uint32_t> m_rowOffsets;     // 每行在m_compressed里的起点，最后多一个结尾
+    std::vector<uint64_t> m_rows;           // 解压后的行，每行m_rowWords个字
+    int m_rowWords = 0;
+
+    // 叶子查找网格，和切叶子的网格相同；每格的叶子在m_gridLeaves[m_gridStarts[i]...m_gridStarts[i + 1]]
+    glm::vec3 m_gridOrigin = glm::vec3(0.0f);
+    int m_gridSize[3] = {0, 0, 0};
+    float m_leafSize = 0.0f;
+    std::vector<uint32_t> m_gridStarts;
+    std::vector<uint32_t> m_gridLeaves;
+
+    VisibilityStats m_stats;
+
+    void Clear();
+    // 坐标在网格axis轴上的格子，夹到网格里
+    int GridCoordinate(float value, int axis) const;
+    int GridIndex(const glm::vec3& position) const;
+    void BuildGrid();
+    bool DecompressRows();
+};
+
+#endif // VISIBILITY_SET_H
@@ -0,0 +1,25 @@
+#include "BitStream.h"
+
+BitWriter::BitWriter(uint8_t* data, int capacity)
+    : m_data(data), m_capacity(capacity), m_bytes(0), m_scratch(0), m_scratchBits(0), m_overflow(false) {
+}
+
+int BitWriter::Flush() {
+    while (m_scratchBits > 0 && !m_overflow) {
+        if (m_bytes == m_capacity) {
+            m_overflow = true;
+            break;
+        }
+        m_data[m_bytes++] = static_cast<uint8_t>(m_scratch);
+        m_scratch >>= 8;
+        m_scratchBits = m_scratchBits > 8 ? m_scratchBits - 8 : 0;
+    }
+    m_scratch = 0;
+    m_scratchBits = 0;
+    return m_bytes;
+}
+
+BitReader::BitReader(const uint8_t* data, int size)
+    : m_data(data), m_size(size), m_bytes(0), m_scratch(0), m_scratchBits(0), m_failed(false) {
+}
+
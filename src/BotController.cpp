@@ -0,0 +1,376 @@
+#include "BotController.h"
+#include "LevelGeometry.h"
+#include "NavMesh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const float DEGREES = 57.2957795f;
+
+// 角度差放到[-180, 180)
+float wrapDegrees(float degrees) {
+    degrees = std::fmod(degrees + 180.0f, 360.0f);
+    if (degrees < 0.0f) {
+        degrees += 360.0f;
+    }
+    return degrees - 180.0f;
+}
+
+float approach(float value, float target, float maxStep) {
+    return value + std::min(std::max(target - value, -maxStep), maxStep);
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+BotController::BotController(const LevelGeometry& level, const BotSettings& settings)
+    : m_settings(settings), m_extent(level.GetDesc().roomSize * 0.5f), m_pathfinder(nullptr) {
+    m_gridSize = std::max(1, static_cast<int>(std::ceil(2.0f * m_extent / m_settings.separationRadius)));
+}
+
+int BotController::AddBot(int slot, uint32_t seed) {
+    int bot = GetCount();
+    m_slots.push_back(slot);
+    m_posX.push_back(0.0f);
+    m_posY.push_back(0.0f);
+    m_posZ.push_back(0.0f);
+    m_alive.push_back(0);
+    m_goalX.push_back(0.0f);
+    m_goalZ.push_back(0.0f);
+    m_goalTick.push_back(0);
+    m_paths.emplace_back();
+    m_pathNext.push_back(0);
+    m_sepX.push_back(0.0f);
+    m_sepZ.push_back(0.0f);
+    m_pitch.push_back(0.0f);
+    m_target.push_back(-1);
+    m_targetTick.push_back(0);
+    m_cells.push_back(-1);
+    m_random.push_back(seed ? seed : 0x9E3779B9u);
+    m_yaw.push_back(NextRandom(bot) * 360.0f);
+    return bot;
+}
+
+void BotController::SetNavigation(NavPathfinder* pathfinder) {
+    m_pathfinder = pathfinder;
+    m_hotspots.clear();
+    if (!pathfinder) {
+        return;
+    }
+    // 固定种子挑几个多边形的中心，每次启动都一样
+    const NavMesh& mesh = pathfinder->GetMesh();
+    uint32_t state = 0x2545F491u;
+    for (int i = 0; i < m_settings.hotspots && mesh.GetPolygonCount() > 0; i++) {
+        state = state * 1664525u + 1013904223u;
+        m_hotspots.push_back(mesh.GetPolygon(static_cast<int>((state >> 8) % mesh.GetPolygonCount())).center);
+    }
+}
+
+void BotController::Observe(int bot, const glm::vec3& position, bool alive) {
+    m_posX[bot] = position.x;
+    m_posY[bot] = position.y;
+    m_posZ[bot] = position.z;
+    m_alive[bot] = alive ? 1 : 0;
+}
+
+void BotController::SetTargets(const std::vector<BotTarget>& targets) {
+    m_targets = targets;
+    int maxSlot = -1;
+    for (const BotTarget& target : targets) {
+        maxSlot = std::max(maxSlot, target.slot);
+    }
+    m_targetIndex.assign(maxSlot + 1, -1);
+    for (int i = 0; i < static_cast<int>(targets.size()); i++) {
+        if (targets[i].slot >= 0) {
+            m_targetIndex[targets[i].slot] = i;
+        }
+    }
+}
+
+float BotController::NextRandom(int bot) {
+    uint32_t& state = m_random[bot];
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+void BotController::PickGoal(int bot, int tick) {
+    m_paths[bot].clear();
+    m_pathNext[bot] = 0;
+    if (!m_hotspots.empty()) {
+        const glm::vec3& goal = m_hotspots[std::min(static_cast<int>(NextRandom(bot) * m_hotspots.size()),
+                                                    static_cast<int>(m_hotspots.size()) - 1)];
+        m_goalX[bot] = goal.x;
+        m_goalZ[bot] = goal.z;
+        if (m_pathfinder->FindPath(glm::vec3(m_posX[bot], m_posY[bot], m_posZ[bot]), goal, m_paths[bot])) {
+            m_pathNext[bot] = 1;
+        }
+    } else {
+        float extent = m_extent - m_settings.wallMargin;
+        m_goalX[bot] = (NextRandom(bot) * 2.0f - 1.0f) * extent;
+        m_goalZ[bot] = (NextRandom(bot) * 2.0f - 1.0f) * extent;
+    }
+    m_goalTick[bot] = tick + static_cast<int>((0.5f + NextRandom(bot)) * m_settings.goalSeconds * m_settings.tickRate);
+}
+
+void BotController::PickTarget(int bot, int tick) {
+    // 随机看几个玩家，打最近的那个；不用每帧找最近的，也不会所有机器人都打同一个
+    const int SAMPLES = 4;
+    int best = -1;
+    float bestDistance = 0.0f;
+    int count = static_cast<int>(m_targets.size());
+    for (int i = 0; i < SAMPLES && count > 0; i++) {
+        const BotTarget& target = m_targets[std::min(static_cast<int>(NextRandom(bot) * count), count - 1)];
+        if (!target.alive || target.slot == m_slots[bot]) {
+            continue;
+        }
+        float dx = target.position.x - m_posX[bot];
+        float dz = target.position.z - m_posZ[bot];
+        float distance = dx * dx + dz * dz;
+        if (best < 0 || distance < bestDistance) {
+            best = target.slot;
+            bestDistance = distance;
+        }
+    }
+    m_target[bot] = best;
+    m_targetTick[bot] = tick + static_cast<int>((0.5f + NextRandom(bot)) * m_settings.targetSeconds * m_settings.tickRate);
+}
+
+int BotController::CellCoordinate(float value) const {
+    int cell = static_cast<int>((value + m_extent) / m_settings.separationRadius);
+    return std::min(std::max(cell, 0), m_gridSize - 1);
+}
+
+void BotController::BuildGrid() {
+    // 计数排序：数每格的机器人，前缀和得到每格的起点，再按起点放进去
+    int cellCount = m_gridSize * m_gridSize;
+    m_cellStarts.assign(cellCount + 1, 0);
+    int count = GetCount();
+    for (int bot = 0; bot < count; bot++) {
+        if (m_alive[bot]) {
+            m_cells[bot] = CellCoordinate(m_posZ[bot]) * m_gridSize + CellCoordinate(m_posX[bot]);
+            m_cellStarts[m_cells[bot] + 1]++;
+        } else {
+            m_cells[bot] = -1;
+        }
+    }
+    for (int cell = 0; cell < cellCount; cell++) {
+        m_cellStarts[cell + 1] += m_cellStarts[cell];
+    }
+    m_sortedX.resize(count + 4);
+    m_sortedZ.resize(count + 4);
+    for (int bot = 0; bot < count; bot++) {
+        if (m_cells[bot] >= 0) {
+            int index = m_cellStarts[m_cells[bot]]++;
+            m_sortedX[index] = m_posX[bot];
+            m_sortedZ[index] = m_posZ[bot];
+        }
+    }
+    // 放完之后每格的起点变成了下一格的起点，挪回来
+    for (int cell = cellCount - 1; cell > 0; cell--) {
+        m_cellStarts[cell] = m_cellStarts[cell - 1];
+    }
+    m_cellStarts[0] = 0;
+}
+
+// 每个邻居推开的力沿着两者的连线，大小从挨着时的1线性减到separationRadius处的0；自己（距离为0）不算
+void BotController::SeparateScalar(int begin, int end) {
+    const float radius = m_settings.separationRadius;
+    const float radiusSquared = radius * radius;
+    const float inverseRadius = 1.0f / radius;
+    for (int bot = begin; bot < end; bot++) {
+        float forceX = 0.0f;
+        float forceZ = 0.0f;
+        if (m_cells[bot] >= 0) {
+            int cellX = m_cells[bot] % m_gridSize;
+            int cellZ = m_cells[bot] / m_gridSize;
+            int x0 = std::max(cellX - 1, 0);
+            int x1 = std::min(cellX + 1, m_gridSize - 1);
+            for (int z = std::max(cellZ - 1, 0); z <= std::min(cellZ + 1, m_gridSize - 1); z++) {
+                int first = m_cellStarts[z * m_gridSize + x0];
+                int last = m_cellStarts[z * m_gridSize + x1 + 1];
+                for (int i = first; i < last; i++) {
+                    float dx = m_posX[bot] - m_sortedX[i];
+                    float dz = m_posZ[bot] - m_sortedZ[i];
+                    float distanceSquared = dx * dx + dz * dz;
+                    if (distanceSquared < radiusSquared && distanceSquared > 1e-8f) {
+                        float strength = 1.0f / std::sqrt(distanceSquared) - inverseRadius;
+                        forceX += dx * strength;
+                        forceZ += dz * strength;
+                    }
+                }
+            }
+        }
+        m_sepX[bot] = forceX;
+        m_sepZ[bot] = forceZ;
+    }
+}
+
+#if defined(__SSE2__)
+void BotController::SeparateSSE2(int begin, int end) {
+    const __m128 radiusSquared = _mm_set1_ps(m_settings.separationRadius * m_settings.separationRadius);
+    const __m128 inverseRadius = _mm_set1_ps(1.0f / m_settings.separationRadius);
+    const __m128 epsilon = _mm_set1_ps(1e-8f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+    for (int bot = begin; bot < end; bot++) {
+        __m128 forceX = _mm_setzero_ps();
+        __m128 forceZ = _mm_setzero_ps();
+        if (m_cells[bot] >= 0) {
+            const __m128 positionX = _mm_set1_ps(m_posX[bot]);
+            const __m128 positionZ = _mm_set1_ps(m_posZ[bot]);
+            int cellX = m_cells[bot] % m_gridSize;
+            int cellZ = m_cells[bot] / m_gridSize;
+            int x0 = std::max(cellX - 1, 0);
+            int x1 = std::min(cellX + 1, m_gridSize - 1);
+            for (int z = std::max(cellZ - 1, 0); z <= std::min(cellZ + 1, m_gridSize - 1); z++) {
+                int first = m_cellStarts[z * m_gridSize + x0];
+                int last = m_cellStarts[z * m_gridSize + x1 + 1];
+                const __m128i lastLane = _mm_set1_epi32(last);
+                for (int i = first; i < last; i += 4) {
+                    // 最后一组超出范围的通道读到的是别的格子（或末尾多留的）的数据，用掩码去掉
+                    __m128 valid = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_add_epi32(_mm_set1_epi32(i), lanes), lastLane));
+                    __m128 dx = _mm_sub_ps(positionX, _mm_loadu_ps(&m_sortedX[i]));
+                    __m128 dz = _mm_sub_ps(positionZ, _mm_loadu_ps(&m_sortedZ[i]));
+                    __m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz));
+                    __m128 inside = _mm_and_ps(valid, _mm_and_ps(_mm_cmplt_ps(distanceSquared, radiusSquared),
+                                                                 _mm_cmpgt_ps(distanceSquared, epsilon)));
+                    __m128 distance = _mm_sqrt_ps(_mm_max_ps(distanceSquared, epsilon));
+                    __m128 strength = _mm_and_ps(inside, _mm_sub_ps(_mm_div_ps(one, distance), inverseRadius));
+                    forceX = _mm_add_ps(forceX, _mm_mul_ps(dx, strength));
+                    forceZ = _mm_add_ps(forceZ, _mm_mul_ps(dz, strength));
+                }
+            }
+        }
+        // 4个通道加起来
+        float sumX[4], sumZ[4];
+        _mm_storeu_ps(sumX, forceX);
+        _mm_storeu_ps(sumZ, forceZ);
+        m_sepX[bot] = (sumX[0] + sumX[1]) + (sumX[2] + sumX[3]);
+        m_sepZ[bot] = (sumZ[0] + sumZ[1]) + (sumZ[2] + sumZ[3]);
+    }
+}
+#endif
+
+void BotController::Think(int tick, std::vector<PlayerCommand>& commands) {
+    auto start = std::chrono::steady_clock::now();
+    int count = GetCount();
+    commands.resize(count);
+
+    BuildGrid();
+#if defined(__SSE2__)
+    if (m_settings.simd) {
+        SeparateSSE2(0, count);
+    } else {
+        SeparateScalar(0, count);
+    }
+#else
+    SeparateScalar(0, count);
+#endif
+    m_stats.steerSeconds += secondsSince(start);
+
+    const float maxTurn = m_settings.turnSpeed / m_settings.tickRate;
+    const float inner = m_extent - m_settings.wallMargin;
+    const float inverseMargin = 1.0f / m_settings.wallMargin;
+    const float fireRangeSquared = m_settings.fireRange * m_settings.fireRange;
+    const float waypointRadiusSquared = m_settings.waypointRadius * m_settings.waypointRadius;
+    for (int bot = 0; bot < count; bot++) {
+        PlayerCommand& command = commands[bot];
+        command = {};
+        command.tick = tick;
+        if (!m_alive[bot]) {
+            command.yaw = PlayerMovement::QuantizeYaw(m_yaw[bot]);
+            continue;
+        }
+        float x = m_posX[bot];
+        float z = m_posZ[bot];
+        float goalX = m_goalX[bot] - x;
+        float goalZ = m_goalZ[bot] - z;
+        if (tick >= m_goalTick[bot] || goalX * goalX + goalZ * goalZ < 4.0f) {
+            PickGoal(bot, tick);
+            goalX = m_goalX[bot] - x;
+            goalZ = m_goalZ[bot] - z;
+        }
+        // 沿着路径走：朝下一个拐点，走到附近就换再下一个
+        std::vector<glm::vec3>& path = m_paths[bot];
+        if (!path.empty()) {
+            int& next = m_pathNext[bot];
+            while (next + 1 < static_cast<int>(path.size())) {
+                float dx = path[next].x - x;
+                float dz = path[next].z - z;
+                if (dx * dx + dz * dz > waypointRadiusSquared) {
+                    break;
+                }
+                next++;
+            }
+            goalX = path[next].x - x;
+            goalZ = path[next].z - z;
+        }
+        int targetIndex = m_target[bot] >= 0 && m_target[bot] < static_cast<int>(m_targetIndex.size())
+                              ? m_targetIndex[m_target[bot]] : -1;
+        if (tick >= m_targetTick[bot] || targetIndex < 0 || !m_targets[targetIndex].alive) {
+            PickTarget(bot, tick);
+            targetIndex = m_target[bot] >= 0 ? m_targetIndex[m_target[bot]] : -1;
+        }
+
+        // 移动方向：目标点、分离力和墙的推力加起来
+        float goalLength = std::sqrt(goalX * goalX + goalZ * goalZ);
+        float moveX = goalLength > 1e-3f ? goalX / goalLength : 0.0f;
+        float moveZ = goalLength > 1e-3f ? goalZ / goalLength : 0.0f;
+        moveX += m_settings.separationWeight * m_sepX[bot];
+        moveZ += m_settings.separationWeight * m_sepZ[bot];
+        moveX += 2.0f * inverseMargin * (std::max(-inner - x, 0.0f) - std::max(x - inner, 0.0f));
+        moveZ += 2.0f * inverseMargin * (std::max(-inner - z, 0.0f) - std::max(z - inner, 0.0f));
+        float moveLength = std::sqrt(moveX * moveX + moveZ * moveZ);
+        if (moveLength > 1e-3f) {
+            moveX /= moveLength;
+            moveZ /= moveLength;
+        }
+
+        // 瞄准：有目标时看目标的胸口，没有时看走的方向
+        float wantYaw = std::atan2(moveZ, moveX) * DEGREES;
+        float wantPitch = 0.0f;
+        float targetDistanceSquared = 0.0f;
+        if (targetIndex >= 0) {
+            const glm::vec3& target = m_targets[targetIndex].position;
+            float dx = target.x - x;
+            float dz = target.z - z;
+            targetDistanceSquared = dx * dx + dz * dz;
+            wantYaw = std::atan2(dz, dx) * DEGREES;
+            float dy = target.y + m_settings.aimHeight - (m_posY[bot] + m_settings.eyeHeight);
+            wantPitch = std::atan2(dy, std::sqrt(targetDistanceSquared)) * DEGREES;
+        }
+        float yawError = wrapDegrees(wantYaw - m_yaw[bot]);
+        float turn = std::min(std::max(yawError, -maxTurn), maxTurn);
+        m_yaw[bot] = wrapDegrees(m_yaw[bot] + turn);
+        m_pitch[bot] = approach(m_pitch[bot], wantPitch, maxTurn);
+
+        command.yaw = PlayerMovement::QuantizeYaw(m_yaw[bot]);
+        command.pitch = PlayerMovement::QuantizePitch(m_pitch[bot]);
+        glm::vec3 forward, right;
+        PlayerMovement::YawVectors(command.yaw, forward, right);
+        command.forward = static_cast<int8_t>(std::lround((moveX * forward.x + moveZ * forward.z) * 127.0f));
+        command.side = static_cast<int8_t>(std::lround((moveX * right.x + moveZ * right.z) * 127.0f));
+        if (targetIndex >= 0 && std::fabs(yawError - turn) < m_settings.fireCone &&
+            targetDistanceSquared < fireRangeSquared) {
+            command.buttons |= BUTTON_ATTACK;
+            m_stats.attacks++;
+        }
+        if (NextRandom(bot) < 1.0f / 512.0f) {
+            command.buttons |= BUTTON_JUMP;
+        }
+        m_stats.commands++;
+    }
+    m_stats.thinks++;
+    m_stats.thinkSeconds += secondsSince(start);
+}
@@ -0,0 +1,319 @@
+#include "Broadphase.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// 查询范围超过这么多格子时直接逐个测试所有物体
+const int MAX_QUERY_CELLS = 512;
+
+#if !defined(__SSE2__)
+// 向下取整，不调用floor
+int floorToInt(float value) {
+    int truncated = static_cast<int>(value);
+    return truncated - (value < static_cast<float>(truncated) ? 1 : 0);
+}
+#endif
+
+int cellCount(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+    return (maxX - minX + 1) * (maxY - minY + 1) * (maxZ - minZ + 1);
+}
+
+} // namespace
+
+Broadphase::Broadphase(float cellSize)
+    : m_cellSize(cellSize), m_inverseCellSize(1.0f / cellSize), m_count(0), m_entryCount(0), m_moved(0),
+      m_gridDirty(false),
+      m_bucketMaskX(0), m_bucketMaskY(0), m_bucketMaskZ(0), m_bucketShiftY(0), m_bucketShiftZ(0) {
+}
+
+void Broadphase::Clear() {
+    m_proxies.clear();
+    m_alive.clear();
+    m_freeHandles.clear();
+    m_entries.clear();
+    m_bucketStart.clear();
+    m_pairBuckets.clear();
+    m_large.clear();
+    m_bucketMaskX = m_bucketMaskY = m_bucketMaskZ = 0;
+    m_count = 0;
+    m_entryCount = 0;
+    m_moved = 0;
+    m_gridDirty = false;
+    m_stats = BroadphaseStats();
+}
+
+int Broadphase::Add(const glm::vec3& minBounds, const glm::vec3& maxBounds) {
+    int handle;
+    if (!m_freeHandles.empty()) {
+        handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+    } else {
+        handle = static_cast<int>(m_alive.size());
+        m_proxies.push_back(Proxy());
+        m_alive.push_back(0);
+    }
+    m_alive[handle] = 1;
+    m_count++;
+    m_proxies[handle].cells = ComputeCells(minBounds, maxBounds);
+    m_entryCount += GridEntries(m_proxies[handle].cells);
+    SetBounds(handle, minBounds, maxBounds);
+    m_gridDirty = true;
+    return handle;
+}
+
+void Broadphase::Remove(int handle) {
+    if (handle < 0 || handle >= static_cast<int>(m_alive.size()) || !m_alive[handle]) {
+        return;
+    }
+    m_alive[handle] = 0;
+    m_freeHandles.push_back(handle);
+    m_count--;
+    m_entryCount -= GridEntries(m_proxies[handle].cells);
+    m_gridDirty = true;
+}
+
+void Broadphase::SetBounds(int handle, const glm::vec3& minBounds, const glm::vec3& maxBounds) {
+    Proxy& proxy = m_proxies[handle];
+    proxy.minBounds = minBounds;
+    proxy.maxBounds = maxBounds;
+
+    // 还在原来的格子里时网格不用动
+    CellRange cells = ComputeCells(minBounds, maxBounds);
+    CellRange& current = proxy.cells;
+    int changed = (cells.minX ^ current.minX) | (cells.minY ^ current.minY) | (cells.minZ ^ current.minZ) |
+                  (cells.maxX ^ current.maxX) | (cells.maxY ^ current.maxY) | (cells.maxZ ^ current.maxZ);
+    if (changed != 0) {
+        m_entryCount += GridEntries(cells) - GridEntries(current);
+        current = cells;
+        m_moved++;
+        m_gridDirty = true;
+    }
+}
+
+inline Broadphase::CellRange Broadphase::ComputeCells(const glm::vec3& minBounds,
+                                                     const glm::vec3& maxBounds) const {
+    CellRange cells;
+#if defined(__SSE2__)
+    // 截断后在负数处减1就是向下取整
+    __m128 scale = _mm_set1_ps(m_inverseCellSize);
+    __m128 low = _mm_mul_ps(_mm_setr_ps(minBounds.x, minBounds.y, minBounds.z, 0.0f), scale);
+    __m128 high = _mm_mul_ps(_mm_setr_ps(maxBounds.x, maxBounds.y, maxBounds.z, 0.0f), scale);
+    __m128i lowCells = _mm_cvttps_epi32(low);
+    __m128i highCells = _mm_cvttps_epi32(high);
+    lowCells = _mm_add_epi32(lowCells, _mm_castps_si128(_mm_cmplt_ps(low, _mm_cvtepi32_ps(lowCells))));
+    highCells = _mm_add_epi32(highCells, _mm_castps_si128(_mm_cmplt_ps(high, _mm_cvtepi32_ps(highCells))));
+    alignas(16) int values[8];
+    _mm_store_si128(reinterpret_cast<__m128i*>(values), lowCells);
+    _mm_store_si128(reinterpret_cast<__m128i*>(values + 4), highCells);
+    cells.minX = values[0];
+    cells.minY = values[1];
+    cells.minZ = values[2];
+    cells.maxX = values[4];
+    cells.maxY = values[5];
+    cells.maxZ = values[6];
+#else
+    cells.minX = floorToInt(minBounds.x * m_inverseCellSize);
+    cells.minY = floorToInt(minBounds.y * m_inverseCellSize);
+    cells.minZ = floorToInt(minBounds.z * m_inverseCellSize);
+    cells.maxX = floorToInt(maxBounds.x * m_inverseCellSize);
+    cells.maxY = floorToInt(maxBounds.y * m_inverseCellSize);
+    cells.maxZ = floorToInt(maxBounds.z * m_inverseCellSize);
+#endif
+    return cells;
+}
+
+uint32_t Broadphase::Bucket(int x, int y, int z) const {
+    return (static_cast<uint32_t>(x) & m_bucketMaskX) | (static_cast<uint32_t>(z) & m_bucketMaskZ) << m_bucketShiftZ |
+           (static_cast<uint32_t>(y) & m_bucketMaskY) << m_bucketShiftY;
+}
+
+bool Broadphase::Overlaps(const Proxy& a, const glm::vec3& minBounds, const glm::vec3& maxBounds) {
+    return a.minBounds.x <= maxBounds.x && a.maxBounds.x >= minBounds.x && a.minBounds.y <= maxBounds.y &&
+           a.maxBounds.y >= minBounds.y && a.minBounds.z <= maxBounds.z && a.maxBounds.z >= minBounds.z;
+}
+
+bool Broadphase::IsLarge(const CellRange& cells) {
+    return cellCount(cells.minX, cells.minY, cells.minZ, cells.maxX, cells.maxY, cells.maxZ) > MAX_CELLS_PER_ENTITY;
+}
+
+int Broadphase::GridEntries(const CellRange& cells) {
+    return IsLarge(cells) ? 0 : cellCount(cells.minX, cells.minY, cells.minZ, cells.maxX, cells.maxY, cells.maxZ);
+}
+
+void Broadphase::Refresh() {
+    m_stats.entities = m_count;
+    m_stats.moved = m_moved;
+    m_moved = 0;
+    if (!m_gridDirty) {
+        return;
+    }
+    m_gridDirty = false;
+
+    // 桶的个数为项数以上的2的幂
+    uint32_t bucketCount = 16;
+    while (bucketCount < static_cast<uint32_t>(m_entryCount)) {
+        bucketCount *= 2;
+    }
+    // 每个轴取格子坐标的低几位拼成桶号：相距不到一个周期的格子不会落进同一个桶
+    int bits = 0;
+    while ((1u << bits) < bucketCount) {
+        bits++;
+    }
+    int bitsX = (bits + 2) / 3;
+    int bitsZ = (bits + 1) / 3;
+    int bitsY = bits - bitsX - bitsZ;
+    m_bucketMaskX = (1u << bitsX) - 1;
+    m_bucketMaskZ = (1u << bitsZ) - 1;
+    m_bucketMaskY = (1u << bitsY) - 1;
+    m_bucketShiftZ = bitsX;
+    m_bucketShiftY = bitsX + bitsZ;
+
+    // 每个物体覆盖的每个格子一项，同时数出每个桶的项数
+    m_bucketStart.assign(bucketCount + 1, 0);
+    m_unsorted.resize(m_entryCount);
+    m_unsortedBuckets.resize(m_entryCount);
+    m_large.clear();
+    int entry = 0;
+    for (int handle = 0; handle < static_cast<int>(m_alive.size()); handle++) {
+        if (!m_alive[handle]) {
+            continue;
+        }
+        const CellRange& cells = m_proxies[handle].cells;
+        if (IsLarge(cells)) {
+            m_large.push_back(handle);
+            continue;
+        }
+        for (int z = cells.minZ; z <= cells.maxZ; z++) {
+            for (int y = cells.minY; y <= cells.maxY; y++) {
+                for (int x = cells.minX; x <= cells.maxX; x++) {
+                    uint32_t bucket = Bucket(x, y, z);
+                    m_unsorted[entry] = {x, y, z, handle};
+                    m_unsortedBuckets[entry] = bucket;
+                    m_bucketStart[bucket]++;
+                    entry++;
+                }
+            }
+        }
+    }
+
+    // 计数排序：每个桶的项数累加成桶的末尾，再倒着放，放完后就是每个桶的开头
+    // 同时记下有两项以上的桶（不用分支：总是写入，只在满足条件时前进）
+    m_pairBuckets.resize(bucketCount + 1);
+    int pairBucketCount = 0;
+    int sum = 0;
+    for (uint32_t bucket = 0; bucket <= bucketCount; bucket++) {
+        int count = m_bucketStart[bucket];
+        m_pairBuckets[pairBucketCount] = static_cast<int>(bucket);
+        pairBucketCount += count >= 2 ? 1 : 0;
+        sum += count;
+        m_bucketStart[bucket] = sum;
+    }
+    m_pairBuckets.resize(pairBucketCount);
+    m_entries.resize(m_unsorted.size());
+    for (size_t i = m_unsorted.size(); i-- > 0;) {
+        m_entries[--m_bucketStart[m_unsortedBuckets[i]]] = m_unsorted[i];
+    }
+
+    m_stats.large = static_cast<int>(m_large.size());
+    m_stats.entries = static_cast<int>(m_entries.size());
+    m_stats.buckets = static_cast<int>(bucketCount);
+}
+
+void Broadphase::FindPairs(std::vector<BroadphasePair>& pairs) {
+    Refresh();
+    pairs.clear();
+    int tests = 0;
+
+    // 只看有两项以上的桶，大部分桶只有0或1项
+    for (int bucket : m_pairBuckets) {
+        int begin = m_bucketStart[bucket];
+        int end = m_bucketStart[bucket + 1];
+        for (int i = begin; i < end; i++) {
+            const Entry& first = m_entries[i];
+            const Proxy& a = m_proxies[first.entity];
+            for (int j = i + 1; j < end; j++) {
+                const Entry& second = m_entries[j];
+                // 同一个格子（排除哈希冲突），且是两个物体共同覆盖的第一个格子；
+                // 条件都算出来再判断一次，少一些预测不了的分支
+                const Proxy& b = m_proxies[second.entity];
+                bool sameCell = (first.x == second.x) & (first.y == second.y) & (first.z == second.z);
+                bool home = (first.x == std::max(a.cells.minX, b.cells.minX)) &
+                            (first.y == std::max(a.cells.minY, b.cells.minY)) &
+                            (first.z == std::max(a.cells.minZ, b.cells.minZ));
+                bool overlap = (a.minBounds.x <= b.maxBounds.x) & (a.maxBounds.x >= b.minBounds.x) &
+                               (a.minBounds.y <= b.maxBounds.y) & (a.maxBounds.y >= b.minBounds.y) &
+                               (a.minBounds.z <= b.maxBounds.z) & (a.maxBounds.z >= b.minBounds.z);
+                tests += sameCell & home;
+                if (sameCell & home & overlap) {
+                    pairs.push_back({std::min(first.entity, second.entity), std::max(first.entity, second.entity)});
+                }
+            }
+        }
+    }
+
+    // 大物体与所有物体测试，两个大物体之间只测一次
+    for (size_t i = 0; i < m_large.size(); i++) {
+        int large = m_large[i];
+        for (int handle = 0; handle < static_cast<int>(m_alive.size()); handle++) {
+            const Proxy& proxy = m_proxies[handle];
+            if (!m_alive[handle] || handle == large || (handle < large && IsLarge(proxy.cells))) {
+                continue;
+            }
+            tests++;
+            if (Overlaps(proxy, m_proxies[large].minBounds, m_proxies[large].maxBounds)) {
+                pairs.push_back({std::min(large, handle), std::max(large, handle)});
+            }
+        }
+    }
+
+    m_stats.pairTests = tests;
+    m_stats.pairs = static_cast<int>(pairs.size());
+}
+
+void Broadphase::Query(const glm::vec3& minBounds, const glm::vec3& maxBounds, std::vector<int>& handles) const {
+    handles.clear();
+
+    CellRange query = ComputeCells(minBounds, maxBounds);
+    if (m_bucketStart.empty() ||
+        cellCount(query.minX, query.minY, query.minZ, query.maxX, query.maxY, query.maxZ) > MAX_QUERY_CELLS) {
+        for (int handle = 0; handle < static_cast<int>(m_alive.size()); handle++) {
+            if (m_alive[handle] && Overlaps(m_proxies[handle], minBounds, maxBounds)) {
+                handles.push_back(handle);
+            }
+        }
+        return;
+    }
+
+    for (int z = query.minZ; z <= query.maxZ; z++) {
+        for (int y = query.minY; y <= query.maxY; y++) {
+            for (int x = query.minX; x <= query.maxX; x++) {
+                uint32_t bucket = Bucket(x, y, z);
+                for (int i = m_bucketStart[bucket]; i < m_bucketStart[bucket + 1]; i++) {
+                    const Entry& entry = m_entries[i];
+                    if (entry.x != x || entry.y != y || entry.z != z) {
+                        continue;
+                    }
+                    // 与FindPairs相同，物体只在与查询范围共同覆盖的第一个格子里报告
+                    const CellRange& cells = m_proxies[entry.entity].cells;
+                    if (x != std::max(cells.minX, query.minX) || y != std::max(cells.minY, query.minY) ||
+                        z != std::max(cells.minZ, query.minZ)) {
+                        continue;
+                    }
+                    if (Overlaps(m_proxies[entry.entity], minBounds, maxBounds)) {
+                        handles.push_back(entry.entity);
+                    }
+                }
+            }
+        }
+    }
+    for (int large : m_large) {
+        if (Overlaps(m_proxies[large], minBounds, maxBounds)) {
+            handles.push_back(large);
+        }
+    }
+}
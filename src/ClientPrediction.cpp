@@ -0,0 +1,143 @@
+#include "ClientPrediction.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+// 移动是确定的，同样的状态和命令在客户端和服务器上得到完全相同的浮点数，不需要容差
+bool sameState(const PlayerState& a, const PlayerState& b) {
+    return a.position == b.position && a.velocity == b.velocity && a.duckAmount == b.duckAmount &&
+           a.onGround == b.onGround && a.previousButtons == b.previousButtons;
+}
+
+} // namespace
+
+ClientPrediction::ClientPrediction(const PlayerMovement& movement) : m_movement(movement) {
+    Reset(PlayerState());
+}
+
+void ClientPrediction::Reset(const PlayerState& state) {
+    for (Entry& entry : m_ring) {
+        entry.command.tick = -1;
+    }
+    m_state = state;
+    m_previousState = state;
+    m_baseState = state;
+    m_latestTick = -1;
+    m_firstTick = -1;
+    m_ackTick = -1;
+    m_alive = true;
+    m_error = glm::vec3(0.0f);
+}
+
+bool ClientPrediction::HasEntry(int tick) const {
+    return tick >= 0 && m_ring[tick % COMMAND_RING].command.tick == tick;
+}
+
+const PlayerState* ClientPrediction::PredictedAt(int tick) const {
+    if (HasEntry(tick)) {
+        return &m_ring[tick % COMMAND_RING].state;
+    }
+    // 服务器还没执行到我们的第一个命令
+    if (m_firstTick < 0 || tick < m_firstTick) {
+        return &m_baseState;
+    }
+    return nullptr;
+}
+
+void ClientPrediction::Step(PlayerState& state, const PlayerCommand& command) const {
+    if (m_alive) {
+        m_movement.Simulate(state, command);
+    }
+}
+
+const PlayerState& ClientPrediction::Predict(const PlayerCommand& command) {
+    if (command.tick <= m_latestTick) {
+        return m_state;
+    }
+    m_previousState = m_state;
+    Step(m_state, command);
+    Entry& entry = m_ring[command.tick % COMMAND_RING];
+    entry.command = command;
+    entry.state = m_state;
+    m_latestTick = command.tick;
+    if (m_firstTick < 0) {
+        m_firstTick = command.tick;
+    }
+    m_stats.commands++;
+    return m_state;
+}
+
+int ClientPrediction::GetPendingCount() const {
+    if (m_latestTick < 0) {
+        return 0;
+    }
+    return m_latestTick - std::max(m_ackTick, m_firstTick - 1);
+}
+
+void ClientPrediction::Reconcile(int ackCommandTick, const PlayerState& server, bool alive) {
+    // 乱序到达的旧快照
+    if (ackCommandTick < m_ackTick) {
+        return;
+    }
+    bool aliveChanged = alive != m_alive;
+    m_ackTick = ackCommandTick;
+    m_alive = alive;
+    const PlayerState* predicted = PredictedAt(ackCommandTick);
+    if (!aliveChanged && predicted && sameState(*predicted, server)) {
+        return;
+    }
+
+    // 没确认的命令已经不在环形缓冲区里（卡住太久）或者还没有命令：直接用服务器的状态
+    glm::vec3 oldPosition = m_state.position;
+    if (m_latestTick < 0 || m_latestTick - ackCommandTick >= COMMAND_RING || ackCommandTick > m_latestTick) {
+        m_state = server;
+        m_previousState = server;
+        m_baseState = server;
+        m_error = glm::vec3(0.0f);
+        m_stats.snaps++;
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (HasEntry(ackCommandTick)) {
+        m_ring[ackCommandTick % COMMAND_RING].state = server;
+    } else if (ackCommandTick < m_firstTick) {
+        m_baseState = server;
+    }
+    PlayerState state = server;
+    PlayerState previous = server;
+    int replayed = 0;
+    for (int tick = std::max(ackCommandTick + 1, m_firstTick); tick <= m_latestTick; tick++) {
+        if (!HasEntry(tick)) {
+            continue;
+        }
+        Entry& entry = m_ring[tick % COMMAND_RING];
+        previous = state;
+        Step(state, entry.command);
+        entry.state = state;
+        replayed++;
+    }
+    m_state = state;
+    m_previousState = previous;
+    m_stats.replaySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_stats.corrections++;
+    m_stats.replayedTicks += replayed;
+    m_stats.maxReplayTicks = std::max(m_stats.maxReplayTicks, replayed);
+
+    // 新旧预测的差留在显示上慢慢消掉；复活、传送这样的大跳变直接跳过去
+    m_error += oldPosition - m_state.position;
+    if (glm::length(m_error) > SNAP_DISTANCE) {
+        m_error = glm::vec3(0.0f);
+        m_stats.snaps++;
+    }
+}
+
+void ClientPrediction::UpdateSmoothing(float deltaSeconds) {
+    m_error *= std::exp(-deltaSeconds / SMOOTH_SECONDS);
+}
+
+glm::vec3 ClientPrediction::GetRenderPosition(float alpha) const {
+    return m_previousState.position + (m_state.position - m_previousState.position) * alpha + m_error;
+}
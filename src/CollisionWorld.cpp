@@ -0,0 +1,749 @@
+#include "CollisionWorld.h"
+#include "LevelGeometry.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// BVH叶子的三角形个数和树的最大深度（遍历栈的大小）
+const int LEAF_SIZE = 4;
+const int MAX_DEPTH = 48;
+const int TRAVERSAL_STACK_SIZE = MAX_DEPTH + 2;
+
+// 距离表面小于这个值就算接触（米）
+const float CONTACT_TOLERANCE = 1e-4f;
+// MoveCapsule停在离表面这么远的地方，下一次扫掠不会一开始就接触
+const float CONTACT_SKIN = 1e-3f;
+// 保守前进的最多迭代次数，用完时按当前时间报告接触（不会越过真正的接触）
+const int MAX_ADVANCE_ITERATIONS = 16;
+// 剩余位移小于这个值就不再滑动
+const float MIN_MOVE = 1e-5f;
+// 射线与三角形平面几乎平行时不算相交（与LevelGeometry::Raycast相同）
+const float RAY_PARALLEL_EPSILON = 1e-7f;
+// 同一表面上距离差小于这个值的交点是同一个
+const float RAY_DUPLICATE_DISTANCE = 1e-4f;
+
+// 三角形上离p最近的点（Ericson, Real-Time Collision Detection 5.1.5）
+glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap);
+    float d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        return a;
+    }
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp);
+    float d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        return b;
+    }
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp);
+    float d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        return c;
+    }
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// 两条线段上最近的两个点，返回距离的平方（Ericson 5.1.9）
+float closestPointsSegmentSegment(const glm::vec3& p1, const glm::vec3& q1, const glm::vec3& p2, const glm::vec3& q2,
+                                  glm::vec3& c1, glm::vec3& c2) {
+    const float epsilon = 1e-12f;
+    glm::vec3 d1 = q1 - p1;
+    glm::vec3 d2 = q2 - p2;
+    glm::vec3 r = p1 - p2;
+    float a = glm::dot(d1, d1);
+    float e = glm::dot(d2, d2);
+    float f = glm::dot(d2, r);
+    float s = 0.0f;
+    float t = 0.0f;
+    if (a <= epsilon && e <= epsilon) {
+        // 两个都是点
+    } else if (a <= epsilon) {
+        t = glm::clamp(f / e, 0.0f, 1.0f);
+    } else {
+        float c = glm::dot(d1, r);
+        if (e <= epsilon) {
+            s = glm::clamp(-c / a, 0.0f, 1.0f);
+        } else {
+            float b = glm::dot(d1, d2);
+            float denom = a * e - b * b;
+            s = denom != 0.0f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f) {
+                t = 0.0f;
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            } else if (t > 1.0f) {
+                t = 1.0f;
+                s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+            }
+        }
+    }
+    c1 = p1 + d1 * s;
+    c2 = p2 + d2 * t;
+    glm::vec3 d = c1 - c2;
+    return glm::dot(d, d);
+}
+
+// 线段 [p, q] 与三角形的最近距离和两边的最近点；p == q时为点
+// 不相交时最近点一定在线段的端点与三角形之间，或线段与三角形的某条边之间
+float segmentTriangleDistance(const glm::vec3& p, const glm::vec3& q, const glm::vec3& a, const glm::vec3& b,
+                              const glm::vec3& c, const glm::vec3& normal, glm::vec3& onSegment,
+                              glm::vec3& onTriangle) {
+    onSegment = p;
+    onTriangle = closestPointOnTriangle(p, a, b, c);
+    glm::vec3 d = onSegment - onTriangle;
+    float best = glm::dot(d, d);
+    if (p == q) {
+        return std::sqrt(best);
+    }
+
+    // 线段穿过三角形所在平面时检查交点是否在三角形内
+    float dp = glm::dot(normal, p - a);
+    float dq = glm::dot(normal, q - a);
+    if ((dp <= 0.0f) != (dq <= 0.0f)) {
+        glm::vec3 crossing = p + (q - p) * (dp / (dp - dq));
+        glm::vec3 inside = closestPointOnTriangle(crossing, a, b, c);
+        glm::vec3 offset = crossing - inside;
+        if (glm::dot(offset, offset) < 1e-12f) {
+            onSegment = crossing;
+            onTriangle = inside;
+            return 0.0f;
+        }
+    }
+
+    glm::vec3 candidate = closestPointOnTriangle(q, a, b, c);
+    d = q - candidate;
+    if (glm::dot(d, d) < best) {
+        best = glm::dot(d, d);
+        onSegment = q;
+        onTriangle = candidate;
+    }
+    const glm::vec3* corners[3] = {&a, &b, &c};
+    for (int edge = 0; edge < 3; edge++) {
+        glm::vec3 segmentPoint, edgePoint;
+        float distance = closestPointsSegmentSegment(p, q, *corners[edge], *corners[(edge + 1) % 3], segmentPoint,
+                                                     edgePoint);
+        if (distance < best) {
+            best = distance;
+            onSegment = segmentPoint;
+            onTriangle = edgePoint;
+        }
+    }
+    return std::sqrt(best);
+}
+
+bool boxesOverlap(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB) {
+    return minA.x <= maxB.x && maxA.x >= minB.x && minA.y <= maxB.y && maxA.y >= minB.y && minA.z <= maxB.z &&
+           maxA.z >= minB.z;
+}
+
+// 射线方向分量的倒数，为0时取很大的数（同号），包围盒测试不会出现0 * 无穷
+float safeInverse(float value) {
+    if (std::fabs(value) < 1e-20f) {
+        return value < 0.0f ? -1e30f : 1e30f;
+    }
+    return 1.0f / value;
+}
+
+// 射线与三角形（Moller-Trumbore），distance为射线上的距离
+bool rayTriangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& a, const glm::vec3& b,
+                 const glm::vec3& c, float& distance) {
+    glm::vec3 e1 = b - a;
+    glm::vec3 e2 = c - a;
+    glm::vec3 pv = glm::cross(direction, e2);
+    float det = glm::dot(e1, pv);
+    if (std::fabs(det) < RAY_PARALLEL_EPSILON) {
+        return false;
+    }
+    float invDet = 1.0f / det;
+    glm::vec3 tv = origin - a;
+    float u = glm::dot(tv, pv) * invDet;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    glm::vec3 qv = glm::cross(tv, e1);
+    float v = glm::dot(direction, qv) * invDet;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+    distance = glm::dot(e2, qv) * invDet;
+    return distance > 0.0f;
+}
+
+// 射线在 [0, maxDistance] 内是否穿过包围盒（slab测试）
+bool rayHitsBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance,
+                const glm::vec3& minBounds, const glm::vec3& maxBounds) {
+    float entry = 0.0f;
+    float leave = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t1 = (minBounds[axis] - origin[axis]) * inverseDirection[axis];
+        float t2 = (maxBounds[axis] - origin[axis]) * inverseDirection[axis];
+        entry = std::max(entry, std::min(t1, t2));
+        leave = std::min(leave, std::max(t1, t2));
+    }
+    return entry <= leave;
+}
+
+// 射线包：每个分量一个数组，一次处理4条射线；maxDistance随交点列表变满而缩短
+struct RayPacket {
+    alignas(16) float originX[CollisionWorld::RAY_PACKET_SIZE];
+    alignas(16) float originY[CollisionWorld::RAY_PACKET_SIZE];
+    alignas(16) float originZ[CollisionWorld::RAY_PACKET_SIZE];
+    alignas(16) float directionX[CollisionWorld::RAY_PACKET_SIZE];
+    alignas(16) float directionY[CollisionWorld::RAY_PACKET_SIZE];
+    alignas(16) float directionZ[CollisionWorld::RAY_PACKET_SIZE];
+    alignas(16) float inverseX[CollisionWorld::RAY_PACKET_SIZE];
+    alignas(16) float inverseY[CollisionWorld::RAY_PACKET_SIZE];
+    alignas(16) float inverseZ[CollisionWorld::RAY_PACKET_SIZE];
+    alignas(16) float maxDistance[CollisionWorld::RAY_PACKET_SIZE];
+};
+
+// 包里碰到包围盒的射线，第i位对应第i条
+int packetHitsBox(const RayPacket& packet, const glm::vec3& minBounds, const glm::vec3& maxBounds) {
+#if defined(__SSE2__)
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(minBounds.x), _mm_load_ps(packet.originX)),
+                           _mm_load_ps(packet.inverseX));
+    __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(maxBounds.x), _mm_load_ps(packet.originX)),
+                           _mm_load_ps(packet.inverseX));
+    __m128 entry = _mm_max_ps(_mm_setzero_ps(), _mm_min_ps(t1, t2));
+    __m128 leave = _mm_min_ps(_mm_load_ps(packet.maxDistance), _mm_max_ps(t1, t2));
+    t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(minBounds.y), _mm_load_ps(packet.originY)), _mm_load_ps(packet.inverseY));
+    t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(maxBounds.y), _mm_load_ps(packet.originY)), _mm_load_ps(packet.inverseY));
+    entry = _mm_max_ps(entry, _mm_min_ps(t1, t2));
+    leave = _mm_min_ps(leave, _mm_max_ps(t1, t2));
+    t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(minBounds.z), _mm_load_ps(packet.originZ)), _mm_load_ps(packet.inverseZ));
+    t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(maxBounds.z), _mm_load_ps(packet.originZ)), _mm_load_ps(packet.inverseZ));
+    entry = _mm_max_ps(entry, _mm_min_ps(t1, t2));
+    leave = _mm_min_ps(leave, _mm_max_ps(t1, t2));
+    return _mm_movemask_ps(_mm_cmple_ps(entry, leave));
+#else
+    int mask = 0;
+    for (int lane = 0; lane < CollisionWorld::RAY_PACKET_SIZE; lane++) {
+        glm::vec3 origin(packet.originX[lane], packet.originY[lane], packet.originZ[lane]);
+        glm::vec3 inverse(packet.inverseX[lane], packet.inverseY[lane], packet.inverseZ[lane]);
+        if (rayHitsBox(origin, inverse, packet.maxDistance[lane], minBounds, maxBounds)) {
+            mask |= 1 << lane;
+        }
+    }
+    return mask;
+#endif
+}
+
+// 包里碰到三角形的射线（Moller-Trumbore，4条射线对同一个三角形），distances为每条射线的距离
+int packetHitsTriangle(const RayPacket& packet, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c,
+                       float* distances) {
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    glm::vec3 e1 = b - a;
+    glm::vec3 e2 = c - a;
+    __m128 e1x = _mm_set1_ps(e1.x), e1y = _mm_set1_ps(e1.y), e1z = _mm_set1_ps(e1.z);
+    __m128 e2x = _mm_set1_ps(e2.x), e2y = _mm_set1_ps(e2.y), e2z = _mm_set1_ps(e2.z);
+    __m128 dx = _mm_load_ps(packet.directionX);
+    __m128 dy = _mm_load_ps(packet.directionY);
+    __m128 dz = _mm_load_ps(packet.directionZ);
+
+    // pv = direction x e2
+    __m128 pvx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 pvy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 pvz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, pvx), _mm_mul_ps(e1y, pvy)), _mm_mul_ps(e1z, pvz));
+    // |det|：清掉符号位
+    __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+    __m128 valid = _mm_cmpge_ps(absDet, _mm_set1_ps(RAY_PARALLEL_EPSILON));
+    // 平行时det为0，除出来的无穷和NaN都被valid去掉
+    __m128 invDet = _mm_div_ps(one, det);
+
+    // tv = origin - a
+    __m128 tvx = _mm_sub_ps(_mm_load_ps(packet.originX), _mm_set1_ps(a.x));
+    __m128 tvy = _mm_sub_ps(_mm_load_ps(packet.originY), _mm_set1_ps(a.y));
+    __m128 tvz = _mm_sub_ps(_mm_load_ps(packet.originZ), _mm_set1_ps(a.z));
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tvx, pvx), _mm_mul_ps(tvy, pvy)), _mm_mul_ps(tvz, pvz)),
+                          invDet);
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+
+    // qv = tv x e1
+    __m128 qvx = _mm_sub_ps(_mm_mul_ps(tvy, e1z), _mm_mul_ps(tvz, e1y));
+    __m128 qvy = _mm_sub_ps(_mm_mul_ps(tvz, e1x), _mm_mul_ps(tvx, e1z));
+    __m128 qvz = _mm_sub_ps(_mm_mul_ps(tvx, e1y), _mm_mul_ps(tvy, e1x));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qvx), _mm_mul_ps(dy, qvy)), _mm_mul_ps(dz, qvz)),
+                          invDet);
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qvx), _mm_mul_ps(e2y, qvy)), _mm_mul_ps(e2z, qvz)),
+                          invDet);
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, _mm_load_ps(packet.maxDistance))));
+    _mm_storeu_ps(distances, t);
+    return _mm_movemask_ps(valid);
+#else
+    int mask = 0;
+    for (int lane = 0; lane < CollisionWorld::RAY_PACKET_SIZE; lane++) {
+        glm::vec3 origin(packet.originX[lane], packet.originY[lane], packet.originZ[lane]);
+        glm::vec3 direction(packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane]);
+        if (rayTriangle(origin, direction, a, b, c, distances[lane]) && distances[lane] < packet.maxDistance[lane]) {
+            mask |= 1 << lane;
+        }
+    }
+    return mask;
+#endif
+}
+
+// 加入一个交点；列表满了时替换最远的一个，maxDistance缩短到剩下最远的交点，之后更远的不用再测
+void addRayHit(RayHitList& list, const RayHit& hit, float& maxDistance) {
+    if (list.count < RayHitList::MAX_HITS) {
+        list.hits[list.count++] = hit;
+        if (list.count < RayHitList::MAX_HITS) {
+            return;
+        }
+    } else {
+        int farthest = 0;
+        for (int i = 1; i < list.count; i++) {
+            if (list.hits[i].distance > list.hits[farthest].distance) {
+                farthest = i;
+            }
+        }
+        list.hits[farthest] = hit;
+    }
+    maxDistance = 0.0f;
+    for (int i = 0; i < list.count; i++) {
+        maxDistance = std::max(maxDistance, list.hits[i].distance);
+    }
+}
+
+// 按距离排序（插入排序，交点很少），去掉公共边上重复的交点
+void finishRayHits(RayHitList& list) {
+    for (int i = 1; i < list.count; i++) {
+        RayHit hit = list.hits[i];
+        int j = i;
+        while (j > 0 && list.hits[j - 1].distance > hit.distance) {
+            list.hits[j] = list.hits[j - 1];
+            j--;
+        }
+        list.hits[j] = hit;
+    }
+    int kept = 0;
+    for (int i = 0; i < list.count; i++) {
+        const RayHit& hit = list.hits[i];
+        bool duplicate = false;
+        for (int k = kept - 1; k >= 0 && hit.distance - list.hits[k].distance < RAY_DUPLICATE_DISTANCE; k--) {
+            if (list.hits[k].surface == hit.surface && glm::dot(list.hits[k].normal, hit.normal) > 0.999f) {
+                duplicate = true;
+                break;
+            }
+        }
+        if (!duplicate) {
+            list.hits[kept++] = hit;
+        }
+    }
+    list.count = kept;
+}
+
+void addContact(CollisionMoveResult& result, const glm::vec3& normal) {
+    for (int k = 0; k < result.contactCount; k++) {
+        if (glm::dot(result.normals[k], normal) > 0.999f) {
+            return;
+        }
+    }
+    if (result.contactCount < CollisionMoveResult::MAX_CONTACTS) {
+        result.normals[result.contactCount++] = normal;
+    }
+}
+
+} // namespace
+
+CollisionWorld::CollisionWorld() {
+}
+
+void CollisionWorld::Clear() {
+    m_triangles.clear();
+    m_nodes.clear();
+    m_surfaces.clear();
+}
+
+void CollisionWorld::AddLevel(const LevelGeometry& level) {
+    const std::vector<LevelSurface>& surfaces = level.GetSurfaces();
+    for (size_t s = 0; s < surfaces.size(); s++) {
+        SetSurface(static_cast<int>(s), surfaces[s].material, surfaces[s].thickness);
+        for (int q = 0; q < surfaces[s].quadCount; q++) {
+            int quad = surfaces[s].firstQuad + q;
+            const glm::vec3& p0 = level.GetQuadVertex(quad, 0).position;
+            const glm::vec3& p1 = level.GetQuadVertex(quad, 1).position;
+            const glm::vec3& p2 = level.GetQuadVertex(quad, 2).position;
+            const glm::vec3& p3 = level.GetQuadVertex(quad, 3).position;
+            // 三角形的法线按顶点顺序算出，朝向与四边形的法线（表面朝外的一侧）一致
+            if (glm::dot(glm::cross(p1 - p0, p2 - p0), level.GetQuadVertex(quad, 0).normal) >= 0.0f) {
+                AddTriangle(p0, p1, p2, static_cast<int>(s));
+                AddTriangle(p0, p2, p3, static_cast<int>(s));
+            } else {
+                AddTriangle(p0, p2, p1, static_cast<int>(s));
+                AddTriangle(p0, p3, p2, static_cast<int>(s));
+            }
+        }
+    }
+}
+
+void CollisionWorld::AddTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, int surface) {
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float area = glm::length(normal);
+    // 退化的三角形没有平面，也碰不到
+    if (area < 1e-8f) {
+        return;
+    }
+    m_triangles.push_back({a, b, c, normal / area, surface});
+}
+
+void CollisionWorld::AddBox(const glm::vec3& minBounds, const glm::vec3& maxBounds, int surface) {
+    glm::vec3 lo = glm::min(minBounds, maxBounds);
+    glm::vec3 hi = glm::max(minBounds, maxBounds);
+    // 8个角，第i位为1时该轴取hi
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        corners[i] = glm::vec3(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z);
+    }
+    // 每个面4个角，逆时针朝外
+    const int faces[6][4] = {
+        {0, 4, 6, 2}, {1, 3, 7, 5},   // -x +x
+        {0, 1, 5, 4}, {2, 6, 7, 3},   // -y +y
+        {0, 2, 3, 1}, {4, 5, 7, 6},   // -z +z
+    };
+    for (int face = 0; face < 6; face++) {
+        const int* f = faces[face];
+        AddTriangle(corners[f[0]], corners[f[1]], corners[f[2]], surface);
+        AddTriangle(corners[f[0]], corners[f[2]], corners[f[3]], surface);
+    }
+}
+
+void CollisionWorld::SetSurface(int surface, int material, float thickness) {
+    if (surface < 0) {
+        return;
+    }
+    if (surface >= static_cast<int>(m_surfaces.size())) {
+        m_surfaces.resize(surface + 1, SurfaceInfo{0, 0.0f});
+    }
+    m_surfaces[surface] = {material, thickness};
+}
+
+void CollisionWorld::Build() {
+    m_nodes.clear();
+    if (m_triangles.empty()) {
+        return;
+    }
+    std::vector<glm::vec3> centroids(m_triangles.size());
+    for (size_t i = 0; i < m_triangles.size(); i++) {
+        centroids[i] = (m_triangles[i].a + m_triangles[i].b + m_triangles[i].c) / 3.0f;
+    }
+    m_nodes.reserve(m_triangles.size() * 2);
+    BuildNode(0, static_cast<int>(m_triangles.size()), 0, centroids);
+}
+
+int CollisionWorld::BuildNode(int first, int count, int depth, std::vector<glm::vec3>& centroids) {
+    int index = static_cast<int>(m_nodes.size());
+    m_nodes.push_back(Node());
+
+    glm::vec3 minBounds(1e30f), maxBounds(-1e30f);
+    glm::vec3 minCentroid(1e30f), maxCentroid(-1e30f);
+    for (int i = first; i < first + count; i++) {
+        const Triangle& triangle = m_triangles[i];
+        minBounds = glm::min(minBounds, glm::min(triangle.a, glm::min(triangle.b, triangle.c)));
+        maxBounds = glm::max(maxBounds, glm::max(triangle.a, glm::max(triangle.b, triangle.c)));
+        minCentroid = glm::min(minCentroid, centroids[i]);
+        maxCentroid = glm::max(maxCentroid, centroids[i]);
+    }
+
+    glm::vec3 extent = maxCentroid - minCentroid;
+    int axis = 0;
+    if (extent.y > extent[axis]) {
+        axis = 1;
+    }
+    if (extent.z > extent[axis]) {
+        axis = 2;
+    }
+    // 中心都重合时分不开，只能做成叶子
+    if (count <= LEAF_SIZE || depth >= MAX_DEPTH || extent[axis] <= 0.0f) {
+        m_nodes[index] = {minBounds, first, maxBounds, count};
+        return index;
+    }
+
+    // 按中心在最长轴中点的哪一侧划分，两侧都不会为空
+    float split = (minCentroid[axis] + maxCentroid[axis]) * 0.5f;
+    int middle = first;
+    for (int i = first; i < first + count; i++) {
+        if (centroids[i][axis] < split) {
+            std::swap(m_triangles[i], m_triangles[middle]);
+            std::swap(centroids[i], centroids[middle]);
+            middle++;
+        }
+    }
+
+    BuildNode(first, middle - first, depth + 1, centroids);
+    int right = BuildNode(middle, first + count - middle, depth + 1, centroids);
+    m_nodes[index] = {minBounds, right, maxBounds, 0};
+    return index;
+}
+
+bool CollisionWorld::SweepSphere(const glm::vec3& start, const glm::vec3& delta, float radius, SweepHit& hit) const {
+    return SweepCapsule(start, glm::vec3(0.0f), delta, radius, hit);
+}
+
+bool CollisionWorld::SweepCapsule(const glm::vec3& start, const glm::vec3& axis, const glm::vec3& delta, float radius,
+                                  SweepHit& hit) const {
+    if (m_nodes.empty()) {
+        return false;
+    }
+    // 扫掠经过的包围盒
+    glm::vec3 end = start + axis;
+    glm::vec3 margin(radius + CONTACT_TOLERANCE);
+    glm::vec3 queryMin = glm::min(glm::min(start, end), glm::min(start + delta, end + delta)) - margin;
+    glm::vec3 queryMax = glm::max(glm::max(start, end), glm::max(start + delta, end + delta)) + margin;
+
+    bool found = false;
+    int stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int index = stack[--top];
+        const Node& node = m_nodes[index];
+        if (!boxesOverlap(node.minBounds, node.maxBounds, queryMin, queryMax)) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[top++] = node.first;
+            stack[top++] = index + 1;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; i++) {
+            const Triangle& triangle = m_triangles[i];
+            glm::vec3 triangleMin = glm::min(triangle.a, glm::min(triangle.b, triangle.c));
+            glm::vec3 triangleMax = glm::max(triangle.a, glm::max(triangle.b, triangle.c));
+            if (!boxesOverlap(triangleMin, triangleMax, queryMin, queryMax)) {
+                continue;
+            }
+            SweepHit candidate;
+            if (!SweepTriangle(triangle, start, axis, delta, radius, found ? hit.time : 1.0f, candidate)) {
+                continue;
+            }
+            // 同时接触时取相交最深的，推出方向最可靠
+            if (!found || candidate.time < hit.time || candidate.depth > hit.depth) {
+                hit = candidate;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+bool CollisionWorld::SweepTriangle(const Triangle& triangle, const glm::vec3& start, const glm::vec3& axis,
+                                   const glm::vec3& delta, float radius, float maxTime, SweepHit& hit) const {
+    float time = 0.0f;
+    for (int iteration = 0; iteration < MAX_ADVANCE_ITERATIONS; iteration++) {
+        glm::vec3 position = start + delta * time;
+        glm::vec3 onShape, onTriangle;
+        float distance = segmentTriangleDistance(position, position + axis, triangle.a, triangle.b, triangle.c,
+                                                 triangle.normal, onShape, onTriangle);
+        glm::vec3 normal;
+        if (distance > 1e-6f) {
+            normal = (onShape - onTriangle) / distance;
+        } else {
+            // 形状的轴穿过三角形：取迎着移动方向的一面
+            normal = glm::dot(triangle.normal, delta) > 0.0f ? -triangle.normal : triangle.normal;
+        }
+
+        float gap = distance - radius;
+        if (gap <= CONTACT_TOLERANCE || iteration == MAX_ADVANCE_ITERATIONS - 1) {
+            hit.time = time;
+            hit.position = position;
+            hit.normal = normal;
+            hit.depth = time == 0.0f ? std::max(-gap, 0.0f) : 0.0f;
+            hit.surface = triangle.surface;
+            return true;
+        }
+
+        // 距离是时间的凸函数，沿切线前进到距离为radius处不会越过真正的接触；
+        // 不再接近时以后也不会接近
+        float approach = -glm::dot(delta, normal);
+        if (approach <= 0.0f) {
+            return false;
+        }
+        time += gap / approach;
+        if (time > maxTime) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool CollisionWorld::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                             LevelHit& hit) const {
+    hit.distance = maxDistance;
+    hit.surface = -1;
+    bool found = false;
+    if (m_nodes.empty()) {
+        return false;
+    }
+    glm::vec3 inverseDirection(safeInverse(direction.x), safeInverse(direction.y), safeInverse(direction.z));
+
+    int stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int index = stack[--top];
+        const Node& node = m_nodes[index];
+        if (!rayHitsBox(origin, inverseDirection, hit.distance, node.minBounds, node.maxBounds)) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[top++] = node.first;
+            stack[top++] = index + 1;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; i++) {
+            const Triangle& triangle = m_triangles[i];
+            float distance;
+            if (rayTriangle(origin, direction, triangle.a, triangle.b, triangle.c, distance) &&
+                distance < hit.distance) {
+                found = true;
+                hit.distance = distance;
+                hit.surface = triangle.surface;
+                hit.normal = triangle.normal;
+            }
+        }
+    }
+
+    // AddBox添加的物体可以没有表面编号（-1），不能用surface判断是否命中
+    if (!found) {
+        return false;
+    }
+    if (glm::dot(hit.normal, direction) > 0.0f) {
+        hit.normal = -hit.normal;
+    }
+    hit.position = origin + direction * hit.distance;
+    return true;
+}
+
+void CollisionWorld::RaycastPacket(const glm::vec3* origins, const glm::vec3* directions, const float* maxDistances,
+                                   int count, RayHitList* results) const {
+    count = std::min(count, RAY_PACKET_SIZE);
+    for (int lane = 0; lane < count; lane++) {
+        results[lane].count = 0;
+    }
+    if (m_nodes.empty() || count <= 0) {
+        return;
+    }
+
+    // 不用的通道复制第一条射线，最远距离为-1，什么都碰不到
+    RayPacket packet;
+    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        int source = lane < count ? lane : 0;
+        const glm::vec3& origin = origins[source];
+        const glm::vec3& direction = directions[source];
+        packet.originX[lane] = origin.x;
+        packet.originY[lane] = origin.y;
+        packet.originZ[lane] = origin.z;
+        packet.directionX[lane] = direction.x;
+        packet.directionY[lane] = direction.y;
+        packet.directionZ[lane] = direction.z;
+        packet.inverseX[lane] = safeInverse(direction.x);
+        packet.inverseY[lane] = safeInverse(direction.y);
+        packet.inverseZ[lane] = safeInverse(direction.z);
+        packet.maxDistance[lane] = lane < count ? maxDistances[lane] : -1.0f;
+    }
+
+    int stack[TRAVERSAL_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int index = stack[--top];
+        const Node& node = m_nodes[index];
+        if (packetHitsBox(packet, node.minBounds, node.maxBounds) == 0) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[top++] = node.first;
+            stack[top++] = index + 1;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; i++) {
+            const Triangle& triangle = m_triangles[i];
+            float distances[RAY_PACKET_SIZE];
+            int mask = packetHitsTriangle(packet, triangle.a, triangle.b, triangle.c, distances);
+            if (mask == 0) {
+                continue;
+            }
+            SurfaceInfo info = triangle.surface >= 0 && triangle.surface < static_cast<int>(m_surfaces.size())
+                                   ? m_surfaces[triangle.surface]
+                                   : SurfaceInfo{0, 0.0f};
+            for (int lane = 0; lane < count; lane++) {
+                if (mask & (1 << lane)) {
+                    RayHit hit = {distances[lane], triangle.normal, triangle.surface, info.material, info.thickness};
+                    addRayHit(results[lane], hit, packet.maxDistance[lane]);
+                }
+            }
+        }
+    }
+
+    for (int lane = 0; lane < count; lane++) {
+        finishRayHits(results[lane]);
+    }
+}
+
+CollisionMoveResult CollisionWorld::MoveCapsule(const glm::vec3& start, const glm::vec3& axis, const glm::vec3& delta,
+                                                float radius) const {
+    CollisionMoveResult result;
+    result.position = start;
+    result.contactCount = 0;
+
+    glm::vec3 remaining = delta;
+    for (int slide = 0; slide < MAX_SLIDES; slide++) {
+        SweepHit hit;
+        if (!SweepCapsule(result.position, axis, remaining, radius, hit)) {
+            result.position += remaining;
+            break;
+        }
+        // 停在表面前（开始时相交的先推出来）
+        result.position = hit.position + hit.normal * (hit.depth + CONTACT_SKIN);
+        addContact(result, hit.normal);
+
+        // 剩余的位移去掉指向表面的分量
+        remaining = remaining * (1.0f - hit.time);
+        float into = glm::dot(remaining, hit.normal);
+        if (into < 0.0f) {
+            remaining -= hit.normal * into;
+        }
+        // 又指向之前碰到的面时，沿两个面的交线滑动
+        for (int k = 0; k < result.contactCount; k++) {
+            const glm::vec3& other = result.normals[k];
+            if (glm::dot(other, hit.normal) > 0.999f || glm::dot(remaining, other) >= 0.0f) {
+                continue;
+            }
+            glm::vec3 crease = glm::cross(other, hit.normal);
+            float length2 = glm::dot(crease, crease);
+            remaining = length2 > 1e-6f ? crease * (glm::dot(remaining, crease) / length2) : glm::vec3(0.0f);
+            break;
+        }
+        if (glm::dot(remaining, remaining) < MIN_MOVE * MIN_MOVE) {
+            break;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,157 @@
+#include "DecalSystem.h"
+#include <cmath>
+#include <cstring>
+
+DecalAtlas::DecalAtlas(int width, int height, int padding)
+    : m_padding(padding), m_shelfX(0), m_shelfY(0), m_shelfHeight(0) {
+    m_image.width = width;
+    m_image.height = height;
+    m_image.pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+}
+
+int DecalAtlas::Add(const Image& image) {
+    int paddedWidth = image.width + m_padding * 2;
+    int paddedHeight = image.height + m_padding * 2;
+    if (image.pixels.empty() || paddedWidth > m_image.width) {
+        return -1;
+    }
+
+    // 当前行放不下就换一行
+    if (m_shelfX + paddedWidth > m_image.width) {
+        m_shelfY += m_shelfHeight;
+        m_shelfX = 0;
+        m_shelfHeight = 0;
+    }
+    if (m_shelfY + paddedHeight > m_image.height) {
+        return -1;
+    }
+
+    // 连同间隔一起复制，间隔取最近的边缘像素
+    int originX = m_shelfX + m_padding;
+    int originY = m_shelfY + m_padding;
+    for (int y = -m_padding; y < image.height + m_padding; y++) {
+        int sourceY = std::min(std::max(y, 0), image.height - 1);
+        for (int x = -m_padding; x < image.width + m_padding; x++) {
+            int sourceX = std::min(std::max(x, 0), image.width - 1);
+            const uint8_t* source = &image.pixels[(static_cast<size_t>(sourceY) * image.width + sourceX) * 4];
+            uint8_t* target = &m_image.pixels[(static_cast<size_t>(originY + y) * m_image.width + originX + x) * 4];
+            memcpy(target, source, 4);
+        }
+    }
+
+    m_regions.push_back(glm::vec4(float(originX) / m_image.width, float(originY) / m_image.height,
+                                  float(originX + image.width) / m_image.width,
+                                  float(originY + image.height) / m_image.height));
+    m_shelfX += paddedWidth;
+    m_shelfHeight = std::max(m_shelfHeight, paddedHeight);
+    return static_cast<int>(m_regions.size()) - 1;
+}
+
+void GenerateBulletHoleImage(int size, uint32_t seed, Image& image) {
+    image.width = size;
+    image.height = size;
+    image.pixels.assign(static_cast<size_t>(size) * size * 4, 0);
+
+    // 裂纹方向，xorshift32
+    const int CRACK_COUNT = 5;
+    float crackAngles[CRACK_COUNT];
+    uint32_t state = seed ? seed : 0x9e3779b9u;
+    for (int i = 0; i < CRACK_COUNT; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        crackAngles[i] = (state & 0xffff) / 65536.0f * 6.2831853f;
+    }
+
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            float dx = (x + 0.5f) / size * 2.0f - 1.0f;
+            float dy = (y + 0.5f) / size * 2.0f - 1.0f;
+            float d = std::sqrt(dx * dx + dy * dy);
+            float angle = std::atan2(dy, dx);
+
+            float shade;
+            float alpha;
+            if (d < 0.22f) {
+                // 孔洞
+                shade = 0.03f;
+                alpha = 1.0f;
+            } else if (d < 0.34f) {
+                // 被打碎的边缘，比墙面浅
+                shade = 0.55f;
+                alpha = 0.9f;
+            } else {
+                // 焦痕向外淡出
+                float fade = std::max(1.0f - (d - 0.34f) / 0.66f, 0.0f);
+                shade = 0.12f;
+                alpha = 0.7f * fade * fade;
+            }
+
+            // 裂纹：角度接近裂纹方向的细线，越往外越细
+            for (int i = 0; i < CRACK_COUNT && d >= 0.22f && d < 0.9f; i++) {
+                float delta = std::fabs(std::remainder(angle - crackAngles[i], 6.2831853f));
+                float width = 0.09f * (1.0f - d);
+                if (delta * d < width * 0.5f) {
+                    shade = 0.05f;
+                    alpha = std::max(alpha, 0.85f * (1.0f - d));
+                }
+            }
+
+            uint8_t* pixel = &image.pixels[(static_cast<size_t>(y) * size + x) * 4];
+            uint8_t value = static_cast<uint8_t>(shade * 255.0f + 0.5f);
+            pixel[0] = value;
+            pixel[1] = value;
+            pixel[2] = value;
+            pixel[3] = static_cast<uint8_t>(std::min(std::max(alpha, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+DecalSystem::DecalSystem(int capacity)
+    : m_capacity(std::max(capacity, 1)), m_added(0), m_generation(0),
+      m_centers(m_capacity), m_axesU(m_capacity), m_axesV(m_capacity),
+      m_uvRects(m_capacity), m_colors(m_capacity) {
+}
+
+void DecalSystem::Clear() {
+    m_added = 0;
+    m_generation++;
+}
+
+int DecalSystem::Add(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& up,
+                     float halfWidth, float halfHeight, const glm::vec4& uvRect, const glm::vec4& color) {
+    // 面向贴花时的右方向和上方向，cross(U, V)与法线同向
+    glm::vec3 n = glm::normalize(normal);
+    glm::vec3 right = glm::normalize(glm::cross(up, n));
+    glm::vec3 realUp = glm::cross(n, right);
+
+    int slot = static_cast<int>(m_added % static_cast<uint64_t>(m_capacity));
+    m_centers[slot] = position + n * SURFACE_OFFSET;
+    m_axesU[slot] = right * halfWidth;
+    m_axesV[slot] = realUp * halfHeight;
+    m_uvRects[slot] = uvRect;
+    m_colors[slot] = color;
+    m_added++;
+    return slot;
+}
+
+int DecalSystem::GetSlot(int i) const {
+    // 没满时最旧的在槽位0，满了以后在下一个要写的槽位
+    uint64_t oldest = m_added > static_cast<uint64_t>(m_capacity) ? m_added - m_capacity : 0;
+    return static_cast<int>((oldest + i) % static_cast<uint64_t>(m_capacity));
+}
+
+void DecalSystem::GetCorners(int slot, glm::vec3 corners[4], glm::vec2 uvs[4]) const {
+    const glm::vec3& c = m_centers[slot];
+    const glm::vec3& u = m_axesU[slot];
+    const glm::vec3& v = m_axesV[slot];
+    const glm::vec4& rect = m_uvRects[slot];
+    corners[0] = c - u - v;
+    corners[1] = c + u - v;
+    corners[2] = c + u + v;
+    corners[3] = c - u + v;
+    uvs[0] = glm::vec2(rect.x, rect.w);
+    uvs[1] = glm::vec2(rect.z, rect.w);
+    uvs[2] = glm::vec2(rect.z, rect.y);
+    uvs[3] = glm::vec2(rect.x, rect.y);
+}
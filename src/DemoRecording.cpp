@@ -0,0 +1,377 @@
+#include "DemoRecording.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t DEMO_CHUNK_ID = 0x4B484344;     // "DCHK"
+const uint32_t DEMO_INDEX_ID = 0x58444944;     // "DIDX"
+const uint32_t DEMO_END_ID = 0x444E4544;       // "DEND"
+const int HEADER_BYTES = 30;
+const int CHUNK_HEADER_BYTES = 16;
+const int INDEX_ENTRY_BYTES = 16;
+const int TRAILER_BYTES = 12;
+const int COMMAND_BYTES = 16;                  // 槽位、命令11字节、看到的时间
+const int MAX_SNAPSHOT_BYTES = 65535;          // 快照字节数是u16
+
+void writeU64(ByteWriter& writer, uint64_t value) {
+    writer.WriteU32(static_cast<uint32_t>(value));
+    writer.WriteU32(static_cast<uint32_t>(value >> 32));
+}
+
+uint64_t readU64(ByteReader& reader) {
+    uint64_t low = reader.ReadU32();
+    uint64_t high = reader.ReadU32();
+    return low | (high << 32);
+}
+
+} // namespace
+
+DemoRecorder::DemoRecorder()
+    : m_file(nullptr), m_failed(false), m_chunkSize(0), m_chunkFirstTick(-1), m_chunkTicks(0),
+      m_lastTick(-1), m_offset(0) {
+}
+
+DemoRecorder::~DemoRecorder() {
+    Close();
+}
+
+bool DemoRecorder::Open(const std::string& path, int tickRate, int maxPlayers, const SnapshotFormat& format) {
+    Close();
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file) {
+        return false;
+    }
+    m_failed = false;
+    m_encoder.reset(new SnapshotEncoder(maxPlayers, format));
+    m_chunk.resize(64 * 1024);
+    m_chunkSize = 0;
+    m_chunkTicks = 0;
+    m_lastTick = -1;
+    m_offset = 0;
+    m_index.clear();
+    m_snapshot.resize(MAX_SNAPSHOT_BYTES);
+    m_stats = DemoStats();
+
+    uint8_t header[HEADER_BYTES];
+    ByteWriter writer(header, sizeof(header));
+    writer.WriteU32(DEMO_FILE_ID);
+    writer.WriteU32(DEMO_VERSION);
+    writer.WriteU16(static_cast<uint16_t>(tickRate));
+    writer.WriteU16(static_cast<uint16_t>(maxPlayers));
+    writer.WriteFloat(format.positionStep);
+    writer.WriteFloat(format.positionExtent);
+    writer.WriteFloat(format.velocityStep);
+    writer.WriteFloat(format.velocityExtent);
+    writer.WriteU8(static_cast<uint8_t>(format.yawBits));
+    writer.WriteU8(static_cast<uint8_t>(format.pitchBits));
+    WriteFile(header, writer.GetSize());
+    return !m_failed;
+}
+
+void DemoRecorder::WriteFile(const uint8_t* data, int size) {
+    if (m_failed || size <= 0) {
+        return;
+    }
+    if (fwrite(data, 1, size, m_file) != static_cast<size_t>(size)) {
+        m_failed = true;
+        return;
+    }
+    m_offset += size;
+    m_stats.fileBytes += size;
+}
+
+void DemoRecorder::RecordTick(int tick, const std::vector<NetPlayerState>& players,
+                              const std::vector<ExecutedCommand>& commands) {
+    if (!m_file || m_failed) {
+        return;
+    }
+    // 帧号不连续（服务器卡住又重新开始）时也开始新的一块，块里的帧号总是连续的
+    bool keyframe = m_chunkTicks == 0 || tick != m_lastTick + 1 || m_chunkTicks >= KEYFRAME_INTERVAL;
+    if (keyframe && m_chunkTicks > 0) {
+        FlushChunk();
+    }
+
+    m_encoder->BeginSnapshot(tick);
+    for (const NetPlayerState& player : players) {
+        m_encoder->AddPlayer(player);
+    }
+    int snapshotSize = m_encoder->Encode(keyframe ? -1 : m_lastTick, m_snapshot.data(), MAX_SNAPSHOT_BYTES);
+    int commandCount = std::min(static_cast<int>(commands.size()), 65535);
+    if (snapshotSize < 0) {
+        m_failed = true;
+        return;
+    }
+
+    int recordSize = 4 + commandCount * COMMAND_BYTES + snapshotSize;
+    if (m_chunkSize + recordSize > static_cast<int>(m_chunk.size())) {
+        m_chunk.resize(std::max(m_chunk.size() * 2, static_cast<size_t>(m_chunkSize + recordSize)));
+    }
+    ByteWriter writer(m_chunk.data() + m_chunkSize, recordSize);
+    writer.WriteU16(static_cast<uint16_t>(commandCount));
+    for (int i = 0; i < commandCount; i++) {
+        writer.WriteU8(static_cast<uint8_t>(commands[i].slot));
+        WriteCommand(writer, commands[i].command);
+        writer.WriteFloat(commands[i].viewTick);
+    }
+    writer.WriteU16(static_cast<uint16_t>(snapshotSize));
+    writer.Write(m_snapshot.data(), snapshotSize);
+    m_chunkSize += writer.GetSize();
+
+    if (keyframe) {
+        m_chunkFirstTick = tick;
+    }
+    m_chunkTicks++;
+    m_lastTick = tick;
+    m_stats.ticks++;
+    m_stats.commands += commandCount;
+    m_stats.commandBytes += 2 + commandCount * COMMAND_BYTES;
+    m_stats.snapshotBytes += 2 + snapshotSize;
+}
+
+void DemoRecorder::FlushChunk() {
+    uint8_t header[CHUNK_HEADER_BYTES];
+    ByteWriter writer(header, sizeof(header));
+    writer.WriteU32(DEMO_CHUNK_ID);
+    writer.WriteU32(static_cast<uint32_t>(m_chunkFirstTick));
+    writer.WriteU32(static_cast<uint32_t>(m_chunkTicks));
+    writer.WriteU32(static_cast<uint32_t>(m_chunkSize));
+    uint64_t offset = m_offset;
+    WriteFile(header, writer.GetSize());
+    WriteFile(m_chunk.data(), m_chunkSize);
+    // 每块写完就交给系统，服务器崩溃时最多丢掉内存里的这一块
+    if (!m_failed && fflush(m_file) != 0) {
+        m_failed = true;
+    }
+    m_index.push_back({m_chunkFirstTick, m_chunkTicks, offset});
+    m_stats.chunks++;
+    m_chunkSize = 0;
+    m_chunkTicks = 0;
+}
+
+bool DemoRecorder::Close() {
+    if (!m_file) {
+        return false;
+    }
+    if (m_chunkTicks > 0) {
+        FlushChunk();
+    }
+    uint64_t indexOffset = m_offset;
+    std::vector<uint8_t> index(8 + m_index.size() * INDEX_ENTRY_BYTES + TRAILER_BYTES);
+    ByteWriter writer(index.data(), static_cast<int>(index.size()));
+    writer.WriteU32(DEMO_INDEX_ID);
+    writer.WriteU32(static_cast<uint32_t>(m_index.size()));
+    for (const IndexEntry& entry : m_index) {
+        writer.WriteU32(static_cast<uint32_t>(entry.firstTick));
+        writer.WriteU32(static_cast<uint32_t>(entry.tickCount));
+        writeU64(writer, entry.offset);
+    }
+    writeU64(writer, indexOffset);
+    writer.WriteU32(DEMO_END_ID);
+    WriteFile(index.data(), writer.GetSize());
+
+    bool closed = fclose(m_file) == 0;
+    m_file = nullptr;
+    return closed && !m_failed;
+}
+
+DemoPlayer::DemoPlayer()
+    : m_fd(-1), m_data(nullptr), m_size(0), m_tickRate(0), m_maxPlayers(0), m_hasIndex(false), m_chunk(-1),
+      m_chunkTick(0), m_cursor(0) {
+}
+
+DemoPlayer::~DemoPlayer() {
+    Close();
+}
+
+void DemoPlayer::Close() {
+    if (m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+        m_data = nullptr;
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_size = 0;
+    m_chunks.clear();
+    m_chunk = -1;
+    m_decoder.reset();
+}
+
+bool DemoPlayer::Open(const std::string& path) {
+    Close();
+    m_fd = open(path.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(m_fd, &info) != 0 || info.st_size < HEADER_BYTES) {
+        Close();
+        return false;
+    }
+    m_size = static_cast<size_t>(info.st_size);
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (data == MAP_FAILED) {
+        m_size = 0;
+        Close();
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(data);
+
+    ByteReader reader(m_data, HEADER_BYTES);
+    uint32_t id = reader.ReadU32();
+    uint32_t version = reader.ReadU32();
+    m_tickRate = reader.ReadU16();
+    m_maxPlayers = reader.ReadU16();
+    SnapshotFormat format;
+    format.positionStep = reader.ReadFloat();
+    format.positionExtent = reader.ReadFloat();
+    format.velocityStep = reader.ReadFloat();
+    format.velocityExtent = reader.ReadFloat();
+    format.yawBits = reader.ReadU8();
+    format.pitchBits = reader.ReadU8();
+    if (reader.Failed() || id != DEMO_FILE_ID || version != DEMO_VERSION || m_tickRate <= 0 || m_maxPlayers <= 0 ||
+        m_maxPlayers > NET_MAX_SLOTS) {
+        Close();
+        return false;
+    }
+    m_decoder.reset(new SnapshotDecoder(m_maxPlayers, format));
+
+    m_hasIndex = ReadIndex(HEADER_BYTES);
+    if (!m_hasIndex && !ScanChunks(HEADER_BYTES)) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool DemoPlayer::ReadChunkHeader(uint64_t offset, Chunk& chunk) const {
+    // 偏移来自文件，先减再比较，坏的偏移不会回绕
+    if (offset > m_size || m_size - offset < CHUNK_HEADER_BYTES) {
+        return false;
+    }
+    ByteReader reader(m_data + offset, CHUNK_HEADER_BYTES);
+    uint32_t id = reader.ReadU32();
+    chunk.firstTick = static_cast<int>(reader.ReadU32());
+    chunk.tickCount = static_cast<int>(reader.ReadU32());
+    chunk.size = reader.ReadU32();
+    chunk.offset = offset;
+    return id == DEMO_CHUNK_ID && chunk.firstTick >= 0 && chunk.tickCount > 0 &&
+           m_size - offset - CHUNK_HEADER_BYTES >= chunk.size;
+}
+
+bool DemoPlayer::ReadIndex(size_t headerSize) {
+    m_chunks.clear();
+    if (m_size < headerSize + 8 + TRAILER_BYTES) {
+        return false;
+    }
+    ByteReader trailer(m_data + m_size - TRAILER_BYTES, TRAILER_BYTES);
+    uint64_t indexOffset = readU64(trailer);
+    if (trailer.ReadU32() != DEMO_END_ID || indexOffset < headerSize ||
+        indexOffset > m_size - TRAILER_BYTES || m_size - TRAILER_BYTES - indexOffset < 8) {
+        return false;
+    }
+    ByteReader reader(m_data + indexOffset, static_cast<int>(m_size - TRAILER_BYTES - indexOffset));
+    uint32_t id = reader.ReadU32();
+    uint32_t count = reader.ReadU32();
+    if (reader.Failed() || id != DEMO_INDEX_ID || count > static_cast<uint32_t>(reader.GetRemaining()) / INDEX_ENTRY_BYTES) {
+        return false;
+    }
+    m_chunks.resize(count);
+    for (Chunk& chunk : m_chunks) {
+        int firstTick = static_cast<int>(reader.ReadU32());
+        int tickCount = static_cast<int>(reader.ReadU32());
+        uint64_t offset = readU64(reader);
+        // 索引和块头对不上时当作没有索引
+        if (!ReadChunkHeader(offset, chunk) || chunk.firstTick != firstTick || chunk.tickCount != tickCount ||
+            (&chunk != &m_chunks.front() && firstTick < (&chunk - 1)->firstTick + (&chunk - 1)->tickCount)) {
+            m_chunks.clear();
+            return false;
+        }
+    }
+    return !m_chunks.empty();
+}
+
+bool DemoPlayer::ScanChunks(size_t headerSize) {
+    m_chunks.clear();
+    uint64_t offset = headerSize;
+    Chunk chunk;
+    while (ReadChunkHeader(offset, chunk)) {
+        if (!m_chunks.empty() && chunk.firstTick < m_chunks.back().firstTick + m_chunks.back().tickCount) {
+            break;
+        }
+        m_chunks.push_back(chunk);
+        offset += CHUNK_HEADER_BYTES + chunk.size;
+    }
+    return !m_chunks.empty();
+}
+
+void DemoPlayer::EnterChunk(int chunk) {
+    m_chunk = chunk;
+    m_chunkTick = 0;
+    m_cursor = m_chunks[chunk].offset + CHUNK_HEADER_BYTES;
+    // 块从关键帧开始，不需要之前的基准
+    m_decoder->Reset();
+}
+
+bool DemoPlayer::Seek(int tick) {
+    auto next = std::upper_bound(m_chunks.begin(), m_chunks.end(), tick,
+                                 [](int value, const Chunk& chunk) { return value < chunk.firstTick; });
+    if (next == m_chunks.begin()) {
+        return false;
+    }
+    const Chunk& chunk = *(next - 1);
+    if (tick >= chunk.firstTick + chunk.tickCount) {
+        return false;
+    }
+    EnterChunk(static_cast<int>(next - 1 - m_chunks.begin()));
+    // 从关键帧解码到目标帧的前一帧
+    while (m_chunkTick < tick - chunk.firstTick) {
+        if (!ReadTick(m_scratch)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DemoPlayer::ReadTick(DemoFrame& frame) {
+    if (m_chunks.empty()) {
+        return false;
+    }
+    if (m_chunk < 0) {
+        EnterChunk(0);
+    }
+    while (m_chunkTick >= m_chunks[m_chunk].tickCount) {
+        if (m_chunk + 1 >= static_cast<int>(m_chunks.size())) {
+            return false;
+        }
+        EnterChunk(m_chunk + 1);
+    }
+    const Chunk& chunk = m_chunks[m_chunk];
+    size_t end = chunk.offset + CHUNK_HEADER_BYTES + chunk.size;
+    ByteReader reader(m_data + m_cursor, static_cast<int>(end - m_cursor));
+    int tick = chunk.firstTick + m_chunkTick;
+    int commandCount = reader.ReadU16();
+    if (commandCount > reader.GetRemaining() / COMMAND_BYTES) {
+        return false;
+    }
+    frame.commands.resize(commandCount);
+    for (ExecutedCommand& command : frame.commands) {
+        command.slot = reader.ReadU8();
+        command.command = ReadCommand(reader);
+        command.viewTick = reader.ReadFloat();
+    }
+    int snapshotSize = reader.ReadU16();
+    if (reader.Failed() || snapshotSize > reader.GetRemaining() ||
+        !m_decoder->Decode(tick, reader.GetCursor(), snapshotSize, frame.players)) {
+        return false;
+    }
+    m_cursor = static_cast<size_t>(reader.GetCursor() - m_data) + snapshotSize;
+    m_chunkTick++;
+    frame.tick = tick;
+    return true;
+}
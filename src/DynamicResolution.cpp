@@ -0,0 +1,75 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 超过预算这个倍数时直接按比例降分辨率
+const float PANIC_RATIO = 1.5f;
+
+const int SIZE_ALIGNMENT = 8;
+
+} // namespace
+
+DynamicResolution::DynamicResolution(const DynamicResolutionSettings& settings)
+    : m_settings(settings) {
+    Reset(settings.maxScale);
+}
+
+void DynamicResolution::SetSettings(const DynamicResolutionSettings& settings) {
+    m_settings = settings;
+    m_scale = std::min(std::max(m_scale, m_settings.minScale), m_settings.maxScale);
+    // 无扰切换：积分项接着当前的缩放
+    m_integral = m_scale - m_settings.maxScale;
+}
+
+void DynamicResolution::Reset(float scale) {
+    m_scale = std::min(std::max(scale, m_settings.minScale), m_settings.maxScale);
+    m_integral = m_scale - m_settings.maxScale;
+    m_previousError = 0.0f;
+    m_hasPrevious = false;
+}
+
+float DynamicResolution::Update(float frameMilliseconds) {
+    if (frameMilliseconds <= 0.0f || m_settings.targetMilliseconds <= 0.0f) {
+        return m_scale;
+    }
+
+    // 正误差表示还有余量，可以提高分辨率
+    float error = (m_settings.targetMilliseconds - frameMilliseconds) / m_settings.targetMilliseconds;
+
+    if (frameMilliseconds > m_settings.targetMilliseconds * PANIC_RATIO) {
+        // 帧时间大致与像素数（缩放的平方）成正比
+        float scale = m_scale * std::sqrt(m_settings.targetMilliseconds / frameMilliseconds);
+        m_scale = std::max(scale, m_settings.minScale);
+        m_integral = m_scale - m_settings.maxScale;
+        m_previousError = error;
+        m_hasPrevious = true;
+        return m_scale;
+    }
+
+    float derivative = m_hasPrevious ? error - m_previousError : 0.0f;
+    // 积分项不超出缩放的范围，防止长时间饱和后积累过多
+    float integral = std::min(std::max(m_integral + m_settings.ki * error, m_settings.minScale - m_settings.maxScale), 0.0f);
+    float output = m_settings.kp * error + integral + m_settings.kd * derivative;
+    float scale = m_settings.maxScale + output;
+
+    // 饱和时不积分（条件积分抗饱和）
+    if (scale >= m_settings.minScale && scale <= m_settings.maxScale) {
+        m_integral = integral;
+    }
+
+    m_scale = std::min(std::max(scale, m_settings.minScale), m_settings.maxScale);
+    m_previousError = error;
+    m_hasPrevious = true;
+    return m_scale;
+}
+
+void DynamicResolution::GetRenderSize(int outputWidth, int outputHeight, int& width, int& height) const {
+    width = static_cast<int>(outputWidth * m_scale + 0.5f);
+    height = static_cast<int>(outputHeight * m_scale + 0.5f);
+    width = std::min(std::max((width + SIZE_ALIGNMENT / 2) / SIZE_ALIGNMENT * SIZE_ALIGNMENT, SIZE_ALIGNMENT), outputWidth);
+    height = std::min(std::max((height + SIZE_ALIGNMENT / 2) / SIZE_ALIGNMENT * SIZE_ALIGNMENT, SIZE_ALIGNMENT), outputHeight);
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+}
@@ -0,0 +1,62 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// 用第90百分位的耗时作为预测，偶尔的慢帧不至于让每帧都提前太多
+const double PREDICTION_PERCENTILE = 0.9;
+
+} // namespace
+
+FramePacer::FramePacer(double refreshRate, double safetyMargin)
+    : m_safetyMargin(safetyMargin), m_frameStart(0.0), m_lastPresent(0.0),
+      m_workHistory(HISTORY, 0.0), m_nextWork(0), m_workCount(0) {
+    SetRefreshRate(refreshRate);
+    m_sorted.reserve(HISTORY);
+}
+
+void FramePacer::SetRefreshRate(double refreshRate) {
+    m_refreshInterval = 1.0 / std::max(refreshRate, 1.0);
+}
+
+double FramePacer::GetPredictedWork() const {
+    if (m_workCount == 0) {
+        return m_refreshInterval;
+    }
+    m_sorted.assign(m_workHistory.begin(), m_workHistory.begin() + m_workCount);
+    size_t index = static_cast<size_t>(PREDICTION_PERCENTILE * (m_workCount - 1));
+    std::nth_element(m_sorted.begin(), m_sorted.begin() + index, m_sorted.end());
+    return m_sorted[index];
+}
+
+double FramePacer::WaitForFrameStart(double now) {
+    m_frameStart = now;
+    if (m_lastPresent <= 0.0) {
+        return now;
+    }
+
+    // 下一次垂直同步（上次交换之后可能已经错过了几次）
+    double nextVsync = m_lastPresent + m_refreshInterval;
+    while (nextVsync < now) {
+        nextVsync += m_refreshInterval;
+    }
+
+    double start = nextVsync - GetPredictedWork() - m_safetyMargin;
+    if (start > now) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(start - now));
+        m_frameStart = start;
+    }
+    return m_frameStart;
+}
+
+void FramePacer::OnRenderComplete(double now) {
+    m_workHistory[m_nextWork] = now - m_frameStart;
+    m_nextWork = (m_nextWork + 1) % HISTORY;
+    m_workCount = std::min(m_workCount + 1, static_cast<int>(HISTORY));
+}
+
+void FramePacer::OnPresent(double now) {
+    m_lastPresent = now;
+}
@@ -0,0 +1,207 @@
+#include "GameClient.h"
+#include <chrono>
+#include <utility>
+
+namespace {
+
+const double CONNECT_RETRY_SECONDS = 0.5;
+
+} // namespace
+
+GameClient::GameClient()
+    : m_server({0, 0}), m_nonce(0), m_slot(-1), m_tickRate(0), m_rejected(false), m_lastConnectTime(-1.0),
+      m_recentCount(0), m_decoder(NET_MAX_SLOTS), m_random(0x6C078965u), m_now(0.0) {
+}
+
+bool GameClient::Connect(const NetAddress& server) {
+    Disconnect();
+    if (!m_socket.Open(0)) {
+        return false;
+    }
+    m_server = server;
+    // 随机数让服务器区分同一个地址上先后的两次连接
+    uint64_t now = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    m_nonce = static_cast<uint32_t>(now ^ (now >> 32)) ^ (static_cast<uint32_t>(m_socket.GetPort()) << 16);
+    m_rejected = false;
+    m_lastConnectTime = -1.0;
+    return true;
+}
+
+void GameClient::Disconnect() {
+    if (m_slot >= 0) {
+        uint8_t packet[8];
+        ByteWriter writer(packet, sizeof(packet));
+        writer.WriteU8(NET_DISCONNECT);
+        writer.WriteU8(static_cast<uint8_t>(m_slot));
+        writer.WriteU32(m_nonce);
+        m_socket.SendTo(packet, writer.GetSize(), m_server);
+    }
+    m_socket.Close();
+    m_delayedIn.clear();
+    m_delayedOut.clear();
+    m_slot = -1;
+    m_recentCount = 0;
+    m_snapshot = ClientSnapshot();
+    m_decoder.Reset();
+}
+
+void GameClient::SendConnect() {
+    uint8_t packet[16];
+    ByteWriter writer(packet, sizeof(packet));
+    writer.WriteU8(NET_CONNECT);
+    writer.WriteU32(NET_PROTOCOL_ID);
+    writer.WriteU32(m_nonce);
+    Send(packet, writer.GetSize());
+}
+
+bool GameClient::HasConditions() const {
+    return m_conditions.latencySeconds > 0.0 || m_conditions.jitterSeconds > 0.0 || m_conditions.lossPercent > 0.0f;
+}
+
+bool GameClient::Condition(double& time) {
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    if ((m_random % 10000) < m_conditions.lossPercent * 100.0f) {
+        m_stats.simulatedLoss++;
+        return false;
+    }
+    time += m_conditions.latencySeconds + m_conditions.jitterSeconds * ((m_random >> 8) % 1001) / 1000.0;
+    return true;
+}
+
+void GameClient::Send(const uint8_t* data, int size) {
+    m_stats.bytesOut += size;
+    if (!HasConditions()) {
+        m_socket.SendTo(data, size, m_server);
+        return;
+    }
+    double time = m_now;
+    if (Condition(time)) {
+        m_delayedOut.push_back({time, std::vector<uint8_t>(data, data + size)});
+    }
+}
+
+void GameClient::Update(double now) {
+    if (!m_socket.IsOpen()) {
+        return;
+    }
+    m_now = now;
+    // 到时间的延迟包，保持排队的顺序
+    for (size_t i = 0; i < m_delayedOut.size();) {
+        if (m_delayedOut[i].time <= now) {
+            m_socket.SendTo(m_delayedOut[i].data.data(), static_cast<int>(m_delayedOut[i].data.size()), m_server);
+            m_delayedOut.erase(m_delayedOut.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    if (m_slot < 0 && !m_rejected && (m_lastConnectTime < 0.0 || now - m_lastConnectTime >= CONNECT_RETRY_SECONDS)) {
+        SendConnect();
+        m_lastConnectTime = now;
+    }
+
+    NetAddress address;
+    int size;
+    while ((size = m_socket.ReceiveFrom(m_buffer, sizeof(m_buffer), address)) > 0) {
+        if (address != m_server) {
+            continue;
+        }
+        m_stats.bytesIn += size;
+        if (!HasConditions()) {
+            HandlePacket(m_buffer, size, now);
+            continue;
+        }
+        double time = now;
+        if (Condition(time)) {
+            m_delayedIn.push_back({time, std::vector<uint8_t>(m_buffer, m_buffer + size)});
+        }
+    }
+    for (size_t i = 0; i < m_delayedIn.size();) {
+        if (m_delayedIn[i].time <= now) {
+            DelayedPacket packet = std::move(m_delayedIn[i]);
+            m_delayedIn.erase(m_delayedIn.begin() + i);
+            HandlePacket(packet.data.data(), static_cast<int>(packet.data.size()), now);
+        } else {
+            i++;
+        }
+    }
+}
+
+void GameClient::HandlePacket(const uint8_t* data, int size, double now) {
+    ByteReader reader(data, size);
+    uint8_t type = reader.ReadU8();
+    if (type == NET_SNAPSHOT) {
+        if (m_slot >= 0) {
+            HandleSnapshot(reader, now);
+        }
+    } else if (type == NET_ACCEPT) {
+        uint32_t nonce = reader.ReadU32();
+        int slot = reader.ReadU8();
+        int tickRate = reader.ReadU16();
+        reader.ReadU32();
+        if (!reader.Failed() && nonce == m_nonce && m_slot < 0) {
+            m_slot = slot;
+            m_tickRate = tickRate;
+            m_interpolator.Reset(tickRate);
+        }
+    } else if (type == NET_REJECT) {
+        if (reader.ReadU32() == m_nonce) {
+            m_rejected = true;
+        }
+    } else if (type == NET_DISCONNECT) {
+        int slot = reader.ReadU8();
+        if (slot == m_slot && reader.ReadU32() == m_nonce) {
+            m_slot = -1;
+            m_rejected = true;
+        }
+    }
+}
+
+void GameClient::HandleSnapshot(ByteReader& reader, double now) {
+    int tick = static_cast<int>(reader.ReadU32());
+    int ackCommandTick = static_cast<int>(reader.ReadU32());
+    int serverTickMicros = reader.ReadU16();
+    PlayerState localState = ReadMoveState(reader);
+    // 乱序到达的旧快照不要
+    if (reader.Failed() || tick <= m_snapshot.tick) {
+        return;
+    }
+    if (!m_decoder.Decode(tick, reader.GetCursor(), reader.GetRemaining(), m_snapshot.players)) {
+        m_stats.droppedSnapshots++;
+        return;
+    }
+    m_snapshot.tick = tick;
+    m_snapshot.ackCommandTick = ackCommandTick;
+    m_snapshot.serverTickMicros = serverTickMicros;
+    m_snapshot.localState = localState;
+    m_interpolator.Push(tick, m_snapshot.players, now);
+    m_stats.snapshots++;
+}
+
+void GameClient::SendCommand(const PlayerCommand& command, float viewTick) {
+    if (m_slot < 0) {
+        return;
+    }
+    // 保留最近的几个命令，从旧到新发送
+    if (m_recentCount == NET_COMMAND_REDUNDANCY) {
+        for (int i = 1; i < NET_COMMAND_REDUNDANCY; i++) {
+            m_recentCommands[i - 1] = m_recentCommands[i];
+        }
+        m_recentCount--;
+    }
+    m_recentCommands[m_recentCount++] = command;
+
+    uint8_t packet[64];
+    ByteWriter writer(packet, sizeof(packet));
+    writer.WriteU8(NET_COMMANDS);
+    writer.WriteU8(static_cast<uint8_t>(m_slot));
+    writer.WriteU32(m_nonce);
+    writer.WriteU32(static_cast<uint32_t>(m_snapshot.tick));
+    writer.WriteFloat(viewTick);
+    writer.WriteU8(static_cast<uint8_t>(m_recentCount));
+    for (int i = 0; i < m_recentCount; i++) {
+        WriteCommand(writer, m_recentCommands[i]);
+    }
+    Send(packet, writer.GetSize());
+}
@@ -0,0 +1,333 @@
+#include "GameServer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+// 套接字缓冲区：一帧里所有客户端的命令和快照都能放下
+const int SOCKET_BUFFER_BYTES = 4 * 1024 * 1024;
+
+// 两个客户端看得到的玩家是否相同，没有可见集时都为空
+bool sameMask(const uint8_t* a, const uint8_t* b, int count) {
+    if (!a || !b) {
+        return a == b;
+    }
+    return memcmp(a, b, count) == 0;
+}
+
+} // namespace
+
+GameServer::GameServer(const GameSettings& settings)
+    : m_simulation(settings), m_clientCount(0), m_encoder(settings.maxPlayers), m_visibility(nullptr),
+      m_recorder(nullptr), m_lastTickMicros(0) {
+    Client empty = {};
+    m_clients.assign(settings.maxPlayers, empty);
+    // 每个不同的基准帧一份，最多是历史的帧数加上完整快照；有可见集时最多每个客户端一份
+    size_t encodings = std::max(SnapshotEncoder::HISTORY + 1, settings.maxPlayers);
+    m_encodedData.resize(encodings * NET_MAX_PACKET);
+    m_encodedSnapshots.reserve(encodings);
+    m_eyeLeaves.assign(settings.maxPlayers, -1);
+    m_footLeaves.assign(settings.maxPlayers, -1);
+    m_activeSlots.reserve(settings.maxPlayers);
+}
+
+bool GameServer::Start(uint16_t port, bool loopbackOnly) {
+    if (!m_socket.Open(port, loopbackOnly)) {
+        return false;
+    }
+    m_socket.SetBufferSize(SOCKET_BUFFER_BYTES);
+    if (!m_io.Start(&m_socket)) {
+        m_socket.Close();
+        return false;
+    }
+    return true;
+}
+
+void GameServer::Stop() {
+    for (int slot = 0; slot < static_cast<int>(m_clients.size()); slot++) {
+        if (m_clients[slot].connected) {
+            uint8_t packet[8];
+            ByteWriter writer(packet, sizeof(packet));
+            writer.WriteU8(NET_DISCONNECT);
+            writer.WriteU8(static_cast<uint8_t>(slot));
+            writer.WriteU32(m_clients[slot].nonce);
+            Send(packet, writer.GetSize(), m_clients[slot].address);
+            DropClient(slot);
+        }
+    }
+    // 断开的包发出去之后才关套接字
+    m_io.Flush();
+    m_io.Stop();
+    m_socket.Close();
+}
+
+void GameServer::RunTick() {
+    auto start = std::chrono::steady_clock::now();
+    ReceivePackets();
+
+    // 超时的客户端
+    int timeoutTicks = TIMEOUT_SECONDS * m_simulation.GetSettings().tickRate;
+    for (int slot = 0; slot < static_cast<int>(m_clients.size()); slot++) {
+        if (m_clients[slot].connected && m_simulation.GetTick() - m_clients[slot].lastHeardTick > timeoutTicks) {
+            DropClient(slot);
+            m_stats.timeouts++;
+        }
+    }
+
+    m_simulation.Tick();
+    if (m_recorder) {
+        RecordDemo();
+    }
+    SendSnapshots();
+    m_io.Flush();
+    m_stats.ticks++;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_lastTickMicros = static_cast<int>(std::min(seconds * 1e6, 65535.0));
+}
+
+void GameServer::ReceivePackets() {
+    NetPacket* packet;
+    while ((packet = m_io.Receive()) != nullptr) {
+        m_stats.packetsIn++;
+        m_stats.bytesIn += packet->size;
+        ByteReader reader(packet->data, packet->size);
+        switch (reader.ReadU8()) {
+        case NET_CONNECT:
+            HandleConnect(reader, packet->address);
+            break;
+        case NET_COMMANDS:
+            HandleCommands(reader, packet->address);
+            break;
+        case NET_DISCONNECT:
+            HandleDisconnect(reader, packet->address);
+            break;
+        default:
+            break;
+        }
+        m_io.Release(packet);
+    }
+}
+
+void GameServer::HandleConnect(ByteReader& reader, const NetAddress& address) {
+    uint32_t protocol = reader.ReadU32();
+    uint32_t nonce = reader.ReadU32();
+    if (reader.Failed() || protocol != NET_PROTOCOL_ID) {
+        return;
+    }
+    // 接受的包丢了时客户端会重发请求，回同一个槽位
+    int slot = -1;
+    for (int i = 0; i < static_cast<int>(m_clients.size()); i++) {
+        if (m_clients[i].connected && m_clients[i].address == address && m_clients[i].nonce == nonce) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        slot = m_simulation.AddPlayer();
+        if (slot >= 0) {
+            Client& client = m_clients[slot];
+            client.connected = true;
+            client.address = address;
+            client.nonce = nonce;
+            client.ackSnapshotTick = -1;
+            m_clientCount++;
+            m_stats.connects++;
+        }
+    }
+
+    uint8_t packet[16];
+    ByteWriter writer(packet, sizeof(packet));
+    if (slot < 0) {
+        writer.WriteU8(NET_REJECT);
+        writer.WriteU32(nonce);
+    } else {
+        m_clients[slot].lastHeardTick = m_simulation.GetTick();
+        writer.WriteU8(NET_ACCEPT);
+        writer.WriteU32(nonce);
+        writer.WriteU8(static_cast<uint8_t>(slot));
+        writer.WriteU16(static_cast<uint16_t>(m_simulation.GetSettings().tickRate));
+        writer.WriteU32(static_cast<uint32_t>(m_simulation.GetTick()));
+    }
+    Send(packet, writer.GetSize(), address);
+}
+
+GameServer::Client* GameServer::FindClient(int slot, uint32_t nonce, const NetAddress& address) {
+    if (slot < 0 || slot >= static_cast<int>(m_clients.size())) {
+        return nullptr;
+    }
+    Client& client = m_clients[slot];
+    if (!client.connected || client.nonce != nonce || client.address != address) {
+        return nullptr;
+    }
+    return &client;
+}
+
+void GameServer::HandleCommands(ByteReader& reader, const NetAddress& address) {
+    int slot = reader.ReadU8();
+    uint32_t nonce = reader.ReadU32();
+    int ackTick = static_cast<int>(reader.ReadU32());
+    float viewTick = reader.ReadFloat();
+    int count = std::min<int>(reader.ReadU8(), NET_COMMAND_REDUNDANCY);
+    Client* client = FindClient(slot, nonce, address);
+    if (reader.Failed() || !client) {
+        return;
+    }
+    client->lastHeardTick = m_simulation.GetTick();
+    client->ackSnapshotTick = std::max(client->ackSnapshotTick, ackTick);
+    // 从旧到新，已经执行过的在模拟里丢掉
+    for (int i = 0; i < count; i++) {
+        PlayerCommand command = ReadCommand(reader);
+        if (reader.Failed()) {
+            break;
+        }
+        m_simulation.QueueCommand(slot, command, viewTick);
+    }
+}
+
+void GameServer::HandleDisconnect(ByteReader& reader, const NetAddress& address) {
+    int slot = reader.ReadU8();
+    uint32_t nonce = reader.ReadU32();
+    if (!reader.Failed() && FindClient(slot, nonce, address)) {
+        DropClient(slot);
+    }
+}
+
+void GameServer::DropClient(int slot) {
+    m_clients[slot].connected = false;
+    m_simulation.RemovePlayer(slot);
+    m_clientCount--;
+}
+
+void GameServer::SendSnapshots() {
+    if (m_clientCount == 0) {
+        return;
+    }
+    // 快照的帧号是刚模拟完的那一帧
+    int tick = m_simulation.GetTick() - 1;
+    const int maxPlayers = m_simulation.GetMaxPlayers();
+    m_encoder.BeginSnapshot(tick);
+    m_activeSlots.clear();
+    for (int slot = 0; slot < maxPlayers; slot++) {
+        const SimPlayer& player = m_simulation.GetPlayer(slot);
+        if (player.active) {
+            m_encoder.AddPlayer(BuildPlayerState(slot, player));
+            m_activeSlots.push_back(slot);
+            if (m_visibility) {
+                const glm::vec3& position = player.state.position;
+                float eyeHeight = m_simulation.GetMovement().GetEyeHeight(player.state);
+                m_eyeLeaves[slot] = m_visibility->FindLeaf(position + glm::vec3(0.0f, eyeHeight, 0.0f));
+                m_footLeaves[slot] = m_visibility->FindLeaf(position + glm::vec3(0.0f, 0.1f, 0.0f));
+            }
+        }
+    }
+
+    m_encodedSnapshots.clear();
+    for (int slot = 0; slot < static_cast<int>(m_clients.size()); slot++) {
+        Client& client = m_clients[slot];
+        if (!client.connected) {
+            continue;
+        }
+        // 大部分客户端的延迟差不多，确认的是同一帧，编码一次
+        int baseTick = m_encoder.HasBaseline(client.ackSnapshotTick) ? client.ackSnapshotTick : -1;
+        const uint8_t* visible = nullptr;
+        const uint8_t* baseVisible = nullptr;
+        if (m_visibility) {
+            if (client.visibleHistory.empty()) {
+                client.visibleHistory.assign(static_cast<size_t>(SnapshotEncoder::HISTORY) * maxPlayers, 0);
+            }
+            uint8_t* mask = &client.visibleHistory[static_cast<size_t>(tick % SnapshotEncoder::HISTORY) * maxPlayers];
+            memset(mask, 0, maxPlayers);
+            const uint64_t* row = m_visibility->GetRow(m_eyeLeaves[slot]);
+            for (int other : m_activeSlots) {
+                mask[other] = other == slot || VisibilitySet::RowCanSee(row, m_eyeLeaves[other]) ||
+                              VisibilitySet::RowCanSee(row, m_footLeaves[other]);
+                m_stats.culledPlayers += mask[other] ? 0 : 1;
+            }
+            visible = mask;
+            if (baseTick >= 0) {
+                baseVisible = &client.visibleHistory[static_cast<size_t>(baseTick % SnapshotEncoder::HISTORY) * maxPlayers];
+            }
+        }
+        const EncodedSnapshot* encoded = nullptr;
+        for (const EncodedSnapshot& candidate : m_encodedSnapshots) {
+            if (candidate.baseTick == baseTick && sameMask(candidate.visible, visible, maxPlayers) &&
+                sameMask(candidate.baseVisible, baseVisible, maxPlayers)) {
+                encoded = &candidate;
+                break;
+            }
+        }
+        if (!encoded) {
+            uint8_t* data = m_encodedData.data() + m_encodedSnapshots.size() * NET_MAX_PACKET;
+            int size = m_encoder.Encode(baseTick, data, NET_MAX_PACKET, visible, baseVisible);
+            m_encodedSnapshots.push_back({baseTick, visible, baseVisible, size, data});
+            encoded = &m_encodedSnapshots.back();
+            m_stats.snapshotEncodes++;
+        }
+        if (encoded->size < 0) {
+            continue;
+        }
+        NetPacket* packet = m_io.AllocateSend();
+        if (!packet) {
+            m_stats.sendDrops++;
+            continue;
+        }
+        ByteWriter writer(packet->data, NET_MAX_PACKET);
+        writer.WriteU8(NET_SNAPSHOT);
+        writer.WriteU32(static_cast<uint32_t>(tick));
+        writer.WriteU32(static_cast<uint32_t>(m_simulation.GetPlayer(slot).lastCommandTick));
+        writer.WriteU16(static_cast<uint16_t>(m_lastTickMicros));
+        WriteMoveState(writer, m_simulation.GetPlayer(slot).state);
+        writer.Write(encoded->data, encoded->size);
+        if (writer.Overflowed()) {
+            m_io.CancelSend(packet);
+            continue;
+        }
+        packet->address = client.address;
+        packet->size = writer.GetSize();
+        m_io.Send(packet);
+        m_stats.packetsOut++;
+        m_stats.bytesOut += packet->size;
+        m_stats.snapshots++;
+        m_stats.fullSnapshots += baseTick < 0 ? 1 : 0;
+    }
+}
+
+void GameServer::RecordDemo() {
+    m_demoPlayers.clear();
+    for (int slot = 0; slot < m_simulation.GetMaxPlayers(); slot++) {
+        const SimPlayer& player = m_simulation.GetPlayer(slot);
+        if (player.active) {
+            m_demoPlayers.push_back(BuildPlayerState(slot, player));
+        }
+    }
+    m_recorder->RecordTick(m_simulation.GetTick() - 1, m_demoPlayers, m_simulation.GetExecutedCommands());
+}
+
+NetPlayerState GameServer::BuildPlayerState(int slot, const SimPlayer& player) {
+    NetPlayerState state;
+    state.slot = static_cast<uint8_t>(slot);
+    state.flags = static_cast<uint8_t>((player.health > 0 ? NetPlayerState::FLAG_ALIVE : 0) |
+                                       (player.state.onGround ? NetPlayerState::FLAG_ON_GROUND : 0));
+    state.health = static_cast<uint8_t>(std::min(std::max(player.health, 0), 255));
+    state.duck = static_cast<uint8_t>(player.state.duckAmount * 255.0f + 0.5f);
+    state.yaw = player.yaw;
+    state.pitch = player.pitch;
+    state.position = player.state.position;
+    state.velocity = player.state.velocity;
+    return state;
+}
+
+void GameServer::Send(const uint8_t* data, int size, const NetAddress& address) {
+    NetPacket* packet = m_io.AllocateSend();
+    if (!packet) {
+        m_stats.sendDrops++;
+        return;
+    }
+    memcpy(packet->data, data, size);
+    packet->address = address;
+    packet->size = size;
+    m_io.Send(packet);
+    m_stats.packetsOut++;
+    m_stats.bytesOut += size;
+}
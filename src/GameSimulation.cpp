@@ -0,0 +1,206 @@
+#include "GameSimulation.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 命中部位的伤害倍数：头、胸、腹、腿
+const float GROUP_DAMAGE[4] = {4.0f, 1.0f, 1.25f, 0.75f};
+// 出生点离墙的距离
+const float SPAWN_MARGIN = 2.0f;
+
+MovementSettings movementSettings(int tickRate) {
+    MovementSettings settings;
+    settings.tickRate = tickRate;
+    return settings;
+}
+
+} // namespace
+
+GameSimulation::GameSimulation(const GameSettings& settings)
+    : m_settings(settings),
+      m_movement(movementSettings(settings.tickRate)),
+      m_history(settings.maxPlayers, settings.tickRate),
+      m_tick(0),
+      m_playerCount(0),
+      m_random(0x2545F491u) {
+    m_level.Build();
+    m_world.AddLevel(m_level);
+    m_world.Build();
+    m_movement.SetWorld(&m_world);
+
+    SimPlayer empty = {};
+    empty.lastCommandTick = -1;
+    m_players.assign(settings.maxPlayers, empty);
+    m_queues.resize(static_cast<size_t>(settings.maxPlayers) * COMMAND_QUEUE_SIZE);
+    m_queueHead.assign(settings.maxPlayers, 0);
+    m_queueCount.assign(settings.maxPlayers, 0);
+    m_executed.reserve(static_cast<size_t>(settings.maxPlayers) * settings.maxCommandsPerTick);
+}
+
+uint32_t GameSimulation::NextRandom() {
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random;
+}
+
+int GameSimulation::AddPlayer() {
+    for (int slot = 0; slot < m_settings.maxPlayers; slot++) {
+        if (!m_players[slot].active) {
+            SimPlayer& player = m_players[slot];
+            player = {};
+            player.active = true;
+            player.lastCommandTick = -1;
+            m_queueCount[slot] = 0;
+            m_playerCount++;
+            Spawn(slot);
+            return slot;
+        }
+    }
+    return -1;
+}
+
+void GameSimulation::RemovePlayer(int slot) {
+    if (slot < 0 || slot >= m_settings.maxPlayers || !m_players[slot].active) {
+        return;
+    }
+    m_players[slot].active = false;
+    m_queueCount[slot] = 0;
+    m_history.Remove(slot);
+    m_playerCount--;
+}
+
+void GameSimulation::QueueCommand(int slot, const PlayerCommand& command, float viewTick) {
+    if (slot < 0 || slot >= m_settings.maxPlayers || !m_players[slot].active) {
+        return;
+    }
+    // 命令包里带着之前的命令，已经执行或已经排队的丢掉
+    int count = m_queueCount[slot];
+    QueuedCommand* queue = &m_queues[static_cast<size_t>(slot) * COMMAND_QUEUE_SIZE];
+    int lastTick = count > 0 ? queue[(m_queueHead[slot] + count - 1) % COMMAND_QUEUE_SIZE].command.tick
+                             : m_players[slot].lastCommandTick;
+    if (command.tick <= lastTick || count == COMMAND_QUEUE_SIZE) {
+        m_stats.droppedCommands++;
+        return;
+    }
+    queue[(m_queueHead[slot] + count) % COMMAND_QUEUE_SIZE] = {command, viewTick};
+    m_queueCount[slot] = count + 1;
+}
+
+void GameSimulation::Tick() {
+    m_executed.clear();
+    for (int slot = 0; slot < m_settings.maxPlayers; slot++) {
+        SimPlayer& player = m_players[slot];
+        if (!player.active) {
+            continue;
+        }
+        if (player.health <= 0 && m_tick >= player.respawnTick) {
+            Spawn(slot);
+        }
+        const QueuedCommand* queue = &m_queues[static_cast<size_t>(slot) * COMMAND_QUEUE_SIZE];
+        for (int executed = 0; executed < m_settings.maxCommandsPerTick && m_queueCount[slot] > 0; executed++) {
+            ExecuteCommand(slot, queue[m_queueHead[slot]]);
+            m_queueHead[slot] = (m_queueHead[slot] + 1) % COMMAND_QUEUE_SIZE;
+            m_queueCount[slot]--;
+        }
+    }
+    RecordHistory();
+    m_tick++;
+}
+
+void GameSimulation::Spawn(int slot) {
+    SimPlayer& player = m_players[slot];
+    float extent = m_level.GetDesc().roomSize * 0.5f - SPAWN_MARGIN;
+    float x = (NextRandom() % 10001) / 10000.0f * 2.0f * extent - extent;
+    float z = (NextRandom() % 10001) / 10000.0f * 2.0f * extent - extent;
+    player.state = {};
+    player.state.position = glm::vec3(x, 0.05f, z);
+    player.health = m_settings.maxHealth;
+    player.nextFireTick = m_tick;
+}
+
+void GameSimulation::ExecuteCommand(int slot, const QueuedCommand& queued) {
+    SimPlayer& player = m_players[slot];
+    player.lastCommandTick = queued.command.tick;
+    player.yaw = queued.command.yaw;
+    player.pitch = queued.command.pitch;
+    m_stats.commands++;
+    m_executed.push_back({slot, queued.command, queued.viewTick});
+    if (player.health <= 0) {
+        return;
+    }
+    m_movement.Simulate(player.state, queued.command);
+    if ((queued.command.buttons & BUTTON_ATTACK) && m_tick >= player.nextFireTick) {
+        player.nextFireTick = m_tick + std::max(1, static_cast<int>(std::lround(m_settings.fireInterval *
+                                                                                m_settings.tickRate)));
+        Fire(slot, queued.viewTick);
+    }
+}
+
+void GameSimulation::Fire(int slot, float viewTick) {
+    SimPlayer& shooter = m_players[slot];
+    float radYaw = shooter.yaw * (2.0f * float(M_PI) / 65536.0f);
+    float radPitch = shooter.pitch * (0.5f * float(M_PI) / 16384.0f);
+    glm::vec3 direction(std::cos(radPitch) * std::cos(radYaw), std::sin(radPitch),
+                        std::cos(radPitch) * std::sin(radYaw));
+    glm::vec3 origin = shooter.state.position + glm::vec3(0.0f, m_movement.GetEyeHeight(shooter.state), 0.0f);
+    m_stats.shots++;
+
+    // 墙挡住的距离以外的玩家打不到
+    LevelHit wall;
+    float range = m_world.Raycast(origin, direction, m_settings.weaponRange, wall) ? wall.distance
+                                                                                   : m_settings.weaponRange;
+    float oldest = m_tick - m_settings.maxRewindSeconds * m_settings.tickRate;
+    float rewindTick = std::min(std::max(viewTick, oldest), static_cast<float>(m_tick));
+    LagRewind rewind(m_history, rewindTick, origin, direction, range, slot);
+    LagHit hit;
+    if (!rewind.Raycast(hit)) {
+        return;
+    }
+    SimPlayer& target = m_players[hit.entity];
+    if (!target.active || target.health <= 0) {
+        return;
+    }
+    m_stats.hits++;
+    int group = std::min(std::max(hit.group, 0), 3);
+    target.health -= static_cast<int>(m_settings.weaponDamage * GROUP_DAMAGE[group]);
+    if (target.health <= 0) {
+        target.health = 0;
+        target.deaths++;
+        target.respawnTick = m_tick + static_cast<int>(m_settings.respawnSeconds * m_settings.tickRate);
+        shooter.kills++;
+        m_stats.kills++;
+        m_history.Remove(hit.entity);
+    }
+}
+
+void GameSimulation::RecordHistory() {
+    for (int slot = 0; slot < m_settings.maxPlayers; slot++) {
+        const SimPlayer& player = m_players[slot];
+        if (!player.active || player.health <= 0) {
+            continue;
+        }
+        EntityPose pose;
+        BuildHitboxes(player.state.position, player.yaw * (360.0f / 65536.0f), player.state.duckAmount, pose);
+        m_history.Record(slot, m_tick, pose);
+    }
+}
+
+void GameSimulation::BuildHitboxes(const glm::vec3& position, float yaw, float duckAmount, EntityPose& pose) {
+    float radYaw = yaw * float(M_PI) / 180.0f;
+    glm::vec3 forward(std::cos(radYaw), 0.0f, std::sin(radYaw));
+    glm::vec3 side(-forward.z, 0.0f, forward.x);
+    // 蹲下时高度约为站立的3/4
+    float scale = 1.0f - 0.25f * duckAmount;
+    glm::vec3 up(0.0f, scale, 0.0f);
+    pose.position = position;
+    pose.yaw = yaw;
+    pose.hitboxCount = 5;
+    glm::vec3 head = position + up * 1.65f + forward * 0.05f;
+    pose.hitboxes[0] = {head, head, 0.12f, 0};
+    pose.hitboxes[1] = {position + up * 1.15f, position + up * 1.4f, 0.2f, 1};
+    pose.hitboxes[2] = {position + up * 0.85f, position + up * 1.1f, 0.18f, 2};
+    pose.hitboxes[3] = {position + side * 0.1f + up * 0.1f, position + side * 0.1f + up * 0.8f, 0.11f, 3};
+    pose.hitboxes[4] = {position - side * 0.1f + up * 0.1f, position - side * 0.1f + up * 0.8f, 0.11f, 3};
+}
@@ -0,0 +1,452 @@
+#include "GpuParticleWorld.h"
+#include "Renderer.h"
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// 子效果嵌套的最大深度，与ParticleWorld相同
+const int MAX_CHILD_DEPTH = 4;
+
+const float PI = 3.14159265358979f;
+
+// 每个粒子的状态：位置和生命值、速度和衰减速率、大小，交错存放
+const int PARTICLE_FLOATS = 9;
+const GLsizei PARTICLE_STRIDE = PARTICLE_FLOATS * sizeof(float);
+
+const char* UPDATE_VARYINGS[] = {"outPositionLife", "outVelocityFade", "outSize"};
+
+// 更新：槽位在本帧某个发射请求的范围内就生成新粒子，否则积分（与ParticleSystem的公式相同）
+// 随机数为 (每帧种子, 槽位) 的整数哈希，与CPU后端的随机序列不同
+const char* UPDATE_VERTEX_SHADER = R"(
+#version 330
+layout(location = 0) in vec4 positionLife; // xyz：位置，w：生命值（1 -> 0，<= 0为空槽位）
+layout(location = 1) in vec4 velocityFade; // xyz：速度，w：每秒减少的生命值
+layout(location = 2) in float size;
+out vec4 outPositionLife;
+out vec4 outVelocityFade;
+out float outSize;
+
+layout(std140) uniform SpawnBlock {
+    vec4 spawnPosition[16];  // xyz：位置，w：起始槽位
+    vec4 spawnDirection[16]; // xyz：方向，w：个数
+    ivec4 spawnHeader;       // x：请求个数，y：本帧的随机数种子
+};
+
+uniform int capacity;
+uniform float deltaTime;
+uniform vec2 lifetimeRange;
+uniform vec2 sizeRange;
+uniform vec2 speedRange;
+uniform float coneAngle;
+uniform float spawnRadius;
+uniform vec3 gravity;
+uniform float turbulence;
+uniform float drag;
+uniform float growth;
+
+const float PI = 3.14159265;
+
+uint hash(uint x) {
+    x ^= x >> 16u;
+    x *= 0x7feb352du;
+    x ^= x >> 15u;
+    x *= 0x846ca68bu;
+    x ^= x >> 16u;
+    return x;
+}
+
+// [0, 1)
+float random(inout uint state) {
+    state = hash(state);
+    return float(state >> 8u) * (1.0 / 16777216.0);
+}
+
+vec3 coneDirection(inout uint state, vec3 axis, float angle) {
+    float cosTheta = 1.0 - random(state) * (1.0 - cos(angle));
+    float sinTheta = sqrt(max(1.0 - cosTheta * cosTheta, 0.0));
+    float phi = random(state) * 2.0 * PI;
+    vec3 helper = abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(helper, axis));
+    vec3 bitangent = cross(axis, tangent);
+    return (tangent * cos(phi) + bitangent * sin(phi)) * sinTheta + axis * cosTheta;
+}
+
+void main() {
+    int slot = gl_VertexID;
+    uint seed = uint(spawnHeader.y);
+
+    for (int i = 0; i < spawnHeader.x; i++) {
+        int offset = slot - int(spawnPosition[i].w);
+        if (offset < 0) {
+            offset += capacity;
+        }
+        if (offset < int(spawnDirection[i].w)) {
+            uint state = hash(seed ^ hash(uint(slot)));
+            vec3 position = spawnPosition[i].xyz;
+            if (spawnRadius > 0.0) {
+                position += coneDirection(state, vec3(0.0, 1.0, 0.0), PI) * (spawnRadius * pow(random(state), 1.0 / 3.0));
+            }
+            vec3 velocity = coneDirection(state, spawnDirection[i].xyz, coneAngle) *
+                            mix(speedRange.x, speedRange.y, random(state));
+            float lifetime = mix(lifetimeRange.x, lifetimeRange.y, random(state));
+            outPositionLife = vec4(position, 1.0);
+            outVelocityFade = vec4(velocity, 1.0 / max(lifetime, 1e-3));
+            outSize = mix(sizeRange.x, sizeRange.y, random(state));
+            return;
+        }
+    }
+
+    if (positionLife.w <= 0.0) {
+        outPositionLife = positionLife;
+        outVelocityFade = velocityFade;
+        outSize = size;
+        return;
+    }
+
+    uint state = hash(seed ^ hash(uint(slot) + 0x9e3779b9u));
+    vec2 r = vec2(random(state), random(state)) * 2.0 - 1.0;
+    vec3 velocity = (velocityFade.xyz + gravity * deltaTime + vec3(r.x, 0.0, r.y) * (turbulence * deltaTime)) *
+                    max(1.0 - drag * deltaTime, 0.0);
+    outPositionLife = vec4(positionLife.xyz + velocity * deltaTime, positionLife.w - velocityFade.w * deltaTime);
+    outVelocityFade = vec4(velocity, velocityFade.w);
+    outSize = size + growth * deltaTime;
+}
+)";
+
+// 绘制：每个实例一个粒子，颜色和大小按年龄在32个采样点之间插值；空槽位放到裁剪空间之外
+const char* DRAW_VERTEX_SHADER = R"(
+#version 120
+attribute vec2 corner;
+attribute vec4 positionLife;
+attribute float size;
+uniform vec4 colorCurve[32];
+uniform float sizeCurve[32];
+varying vec4 color;
+
+void main() {
+    float life = positionLife.w;
+    if (life <= 0.0) {
+        color = vec4(0.0);
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+    float t = clamp(1.0 - life, 0.0, 1.0) * 31.0;
+    int i = int(min(floor(t), 30.0));
+    float f = t - float(i);
+    color = mix(colorCurve[i], colorCurve[i + 1], f);
+    float s = size * mix(sizeCurve[i], sizeCurve[i + 1], f);
+    vec3 position = positionLife.xyz + vec3(corner * (0.5 * s), 0.0);
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 1.0);
+}
+)";
+
+const char* DRAW_FRAGMENT_SHADER = R"(
+#version 120
+varying vec4 color;
+
+void main() {
+    gl_FragColor = color;
+}
+)";
+
+const char* DRAW_ATTRIBUTE_NAMES[] = {"corner", "positionLife", "size"};
+
+} // namespace
+
+GpuParticleWorld::GpuParticleWorld(Renderer& renderer)
+    : m_renderer(renderer), m_effects(nullptr), m_initialized(false), m_seed(1),
+      m_updateShader(0), m_drawShader(0), m_cornerBuffer(0) {
+    for (int i = 0; i < 3; i++) {
+        m_drawAttributes[i] = -1;
+    }
+}
+
+GpuParticleWorld::~GpuParticleWorld() {
+    Shutdown();
+}
+
+bool GpuParticleWorld::Initialize(const ParticleWorld& effects, int capacityScale) {
+    Shutdown();
+
+    // 3.0之前的上下文不认识GL_MAJOR_VERSION，查询失败时保持0
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major * 10 + minor < 33) {
+        std::cerr << "GPU粒子需要OpenGL 3.3，当前为 " << glGetString(GL_VERSION) << std::endl;
+        return false;
+    }
+
+    m_updateShader = m_renderer.CreateTransformFeedbackShader(
+        UPDATE_VERTEX_SHADER, std::vector<const char*>(UPDATE_VARYINGS, UPDATE_VARYINGS + 3));
+    m_drawShader = m_renderer.CreateShader(DRAW_VERTEX_SHADER, DRAW_FRAGMENT_SHADER);
+    GLint linked = 0;
+    if (m_drawShader != 0) {
+        glGetProgramiv(m_drawShader, GL_LINK_STATUS, &linked);
+    }
+    if (m_updateShader == 0 || !linked) {
+        Shutdown();
+        return false;
+    }
+    glUniformBlockBinding(m_updateShader, glGetUniformBlockIndex(m_updateShader, "SpawnBlock"), 0);
+    for (int i = 0; i < 3; i++) {
+        m_drawAttributes[i] = glGetAttribLocation(m_drawShader, DRAW_ATTRIBUTE_NAMES[i]);
+    }
+
+    const float corners[8] = {-1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f};
+    glGenBuffers(1, &m_cornerBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_cornerBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+    m_effects = &effects;
+    m_pools.resize(effects.GetEffectCount());
+    for (int e = 0; e < effects.GetEffectCount(); e++) {
+        const ParticleEffectDesc& desc = effects.GetEffect(e);
+        Pool& pool = m_pools[e];
+        pool.effect = e;
+        pool.capacity = desc.maxParticles * std::max(capacityScale, 1);
+        pool.frame = 0;
+        glGenBuffers(2, pool.buffers);
+        glGenBuffers(1, &pool.spawnBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, pool.spawnBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(SpawnBlock), nullptr, GL_STREAM_DRAW);
+        ResetPool(pool);
+
+        // 曲线按年龄采样，绘制时插值
+        for (int i = 0; i < CURVE_SIZE; i++) {
+            float age = static_cast<float>(i) / (CURVE_SIZE - 1);
+            pool.colorCurve[i] = SampleParticleColor(desc.colorKeys, age);
+            pool.sizeCurve[i] = SampleParticleSize(desc.sizeKeys, age);
+        }
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_initialized = true;
+    return true;
+}
+
+void GpuParticleWorld::Shutdown() {
+    for (Pool& pool : m_pools) {
+        glDeleteBuffers(2, pool.buffers);
+        glDeleteBuffers(1, &pool.spawnBuffer);
+    }
+    m_pools.clear();
+    m_emitters.clear();
+    if (m_cornerBuffer != 0) {
+        glDeleteBuffers(1, &m_cornerBuffer);
+    }
+    m_renderer.DeleteShader(m_updateShader);
+    m_renderer.DeleteShader(m_drawShader);
+    m_cornerBuffer = 0;
+    m_updateShader = 0;
+    m_drawShader = 0;
+    m_effects = nullptr;
+    m_initialized = false;
+}
+
+// 两个缓冲区都清零：生命值为0的槽位是空的
+void GpuParticleWorld::ResetPool(Pool& pool) {
+    std::vector<float> zeros(static_cast<size_t>(pool.capacity) * PARTICLE_FLOATS, 0.0f);
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, pool.buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, zeros.size() * sizeof(float), zeros.data(), GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    pool.next = 0;
+    pool.current = 0;
+    pool.requested = 0;
+    pool.remaining = 0.0f;
+    pool.spawns = SpawnBlock();
+}
+
+int GpuParticleWorld::Spawn(int effect, const glm::vec3& position, const glm::vec3& direction) {
+    int spawned = 0;
+    if (m_initialized && effect >= 0 && effect < static_cast<int>(m_pools.size())) {
+        SpawnEmitter(effect, position, direction, 0, spawned);
+    }
+    return spawned;
+}
+
+void GpuParticleWorld::SpawnEmitter(int effect, const glm::vec3& position, const glm::vec3& direction, int depth,
+                                    int& spawned) {
+    const ParticleEffectDesc& desc = m_effects->GetEffect(effect);
+
+    Emitter emitter;
+    emitter.effect = effect;
+    emitter.position = position;
+    emitter.direction = glm::dot(direction, direction) > 0.0f ? glm::normalize(direction) : desc.direction;
+    emitter.pending = 0;
+    m_emitters.push_back(emitter);
+    spawned++;
+
+    if (depth >= MAX_CHILD_DEPTH) {
+        return;
+    }
+    for (const std::string& child : desc.children) {
+        int childEffect = m_effects->FindEffect(child.c_str());
+        if (childEffect < 0) {
+            std::cerr << "粒子效果 " << desc.name << " 的子效果不存在: " << child << std::endl;
+            continue;
+        }
+        SpawnEmitter(childEffect, position, direction, depth + 1, spawned);
+    }
+}
+
+void GpuParticleWorld::Clear() {
+    m_emitters.clear();
+    for (Pool& pool : m_pools) {
+        ResetPool(pool);
+    }
+    m_stats = GpuParticleWorldStats();
+}
+
+void GpuParticleWorld::Update(float deltaTime) {
+    m_stats = GpuParticleWorldStats();
+    if (!m_initialized) {
+        return;
+    }
+
+    for (Pool& pool : m_pools) {
+        pool.spawns.header[0] = 0;
+        pool.requested = 0;
+    }
+
+    // 发射器只产生发射请求：槽位从粒子池的环形游标连续分配
+    for (Emitter& emitter : m_emitters) {
+        const ParticleEffectDesc& desc = m_effects->GetEffect(emitter.effect);
+        Pool& pool = m_pools[emitter.effect];
+        emitter.pending = std::min(emitter.pending + emitter.clock.Advance(desc, deltaTime), pool.capacity);
+
+        int count = std::min(emitter.pending, pool.capacity - pool.requested);
+        int& requests = pool.spawns.header[0];
+        if (count <= 0 || requests >= MAX_SPAWN_REQUESTS) {
+            continue;
+        }
+        pool.spawns.position[requests] = glm::vec4(emitter.position, static_cast<float>(pool.next));
+        pool.spawns.direction[requests] = glm::vec4(emitter.direction, static_cast<float>(count));
+        requests++;
+        pool.next = (pool.next + count) % pool.capacity;
+        pool.requested += count;
+        pool.remaining = std::max(pool.remaining, desc.lifetimeMax + deltaTime);
+        emitter.pending -= count;
+        m_stats.spawned += count;
+        m_stats.spawnRequests++;
+    }
+
+    m_emitters.erase(std::remove_if(m_emitters.begin(), m_emitters.end(),
+                                    [this](const Emitter& emitter) {
+                                        return emitter.pending == 0 &&
+                                               !emitter.clock.IsEmitting(m_effects->GetEffect(emitter.effect));
+                                    }),
+                     m_emitters.end());
+    m_stats.emitters = static_cast<int>(m_emitters.size());
+
+    // 所有粒子都已经死亡的粒子池不需要更新
+    glEnable(GL_RASTERIZER_DISCARD);
+    m_renderer.UseShader(m_updateShader);
+    for (int location = 0; location < 3; location++) {
+        glEnableVertexAttribArray(location);
+    }
+    for (Pool& pool : m_pools) {
+        if (pool.remaining <= 0.0f) {
+            continue;
+        }
+        UpdatePool(pool, deltaTime);
+        pool.remaining -= deltaTime;
+        m_stats.pools++;
+        m_stats.capacity += pool.capacity;
+    }
+    for (int location = 0; location < 3; location++) {
+        glDisableVertexAttribArray(location);
+    }
+    glUseProgram(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+}
+
+void GpuParticleWorld::UpdatePool(Pool& pool, float deltaTime) {
+    const ParticleEffectDesc& desc = m_effects->GetEffect(pool.effect);
+    const ParticleSimParams& sim = desc.sim;
+
+    pool.spawns.header[1] = static_cast<int32_t>(HashParticleSeed(m_seed, static_cast<uint32_t>(pool.effect), pool.frame++));
+    glBindBuffer(GL_UNIFORM_BUFFER, pool.spawnBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SpawnBlock), &pool.spawns);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, pool.spawnBuffer);
+
+    unsigned int program = m_updateShader;
+    glUniform1i(glGetUniformLocation(program, "capacity"), pool.capacity);
+    glUniform1f(glGetUniformLocation(program, "deltaTime"), deltaTime);
+    glUniform2f(glGetUniformLocation(program, "lifetimeRange"), desc.lifetimeMin, desc.lifetimeMax);
+    glUniform2f(glGetUniformLocation(program, "sizeRange"), desc.sizeMin, desc.sizeMax);
+    glUniform2f(glGetUniformLocation(program, "speedRange"), desc.speedMin, desc.speedMax);
+    glUniform1f(glGetUniformLocation(program, "coneAngle"), std::min(std::max(desc.coneAngle, 0.0f), 180.0f) * PI / 180.0f);
+    glUniform1f(glGetUniformLocation(program, "spawnRadius"), desc.spawnRadius);
+    glUniform3f(glGetUniformLocation(program, "gravity"), sim.gravity.x, sim.gravity.y, sim.gravity.z);
+    glUniform1f(glGetUniformLocation(program, "turbulence"), sim.turbulence);
+    glUniform1f(glGetUniformLocation(program, "drag"), sim.drag);
+    glUniform1f(glGetUniformLocation(program, "growth"), sim.growth);
+
+    const char* offset = nullptr;
+    glBindBuffer(GL_ARRAY_BUFFER, pool.buffers[pool.current]);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, offset);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, offset + 4 * sizeof(float));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, offset + 8 * sizeof(float));
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, pool.buffers[1 - pool.current]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, pool.capacity);
+    glEndTransformFeedback();
+    pool.current = 1 - pool.current;
+}
+
+void GpuParticleWorld::Draw() {
+    if (!m_initialized) {
+        return;
+    }
+
+    m_renderer.UseShader(m_drawShader);
+    if (m_drawAttributes[0] >= 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_cornerBuffer);
+        glVertexAttribPointer(m_drawAttributes[0], 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glEnableVertexAttribArray(m_drawAttributes[0]);
+    }
+    for (int i = 1; i < 3; i++) {
+        if (m_drawAttributes[i] >= 0) {
+            glVertexAttribDivisor(m_drawAttributes[i], 1);
+            glEnableVertexAttribArray(m_drawAttributes[i]);
+        }
+    }
+
+    const char* offset = nullptr;
+    for (const Pool& pool : m_pools) {
+        if (pool.remaining <= 0.0f) {
+            continue;
+        }
+        glUniform4fv(glGetUniformLocation(m_drawShader, "colorCurve"), CURVE_SIZE, &pool.colorCurve[0].x);
+        glUniform1fv(glGetUniformLocation(m_drawShader, "sizeCurve"), CURVE_SIZE, pool.sizeCurve);
+        glBindBuffer(GL_ARRAY_BUFFER, pool.buffers[pool.current]);
+        if (m_drawAttributes[1] >= 0) {
+            glVertexAttribPointer(m_drawAttributes[1], 4, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, offset);
+        }
+        if (m_drawAttributes[2] >= 0) {
+            glVertexAttribPointer(m_drawAttributes[2], 1, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE,
+                                  offset + 8 * sizeof(float));
+        }
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, pool.capacity);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (m_drawAttributes[i] >= 0) {
+            glDisableVertexAttribArray(m_drawAttributes[i]);
+            glVertexAttribDivisor(m_drawAttributes[i], 0);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+}
@@ -0,0 +1,181 @@
+#include "Hitscan.h"
+#include "CollisionWorld.h"
+#include "LevelGeometry.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 距离差小于这个值的表面在同一个平面上
+const float COPLANAR_DISTANCE = 1e-3f;
+// 掠射时按厚度算出的穿过长度最多为厚度的10倍
+const float MIN_COSINE = 0.1f;
+// 排序用的起点格子（米）
+const float ORIGIN_CELL_SIZE = 4.0f;
+
+// 排序键：方向的卦限、起点所在的格子（每轴4位）、量化的方向（每轴4位）
+uint32_t packetKey(const HitscanShot& shot) {
+    const glm::vec3& d = shot.direction;
+    uint32_t octant = (d.x < 0.0f ? 1u : 0u) | (d.y < 0.0f ? 2u : 0u) | (d.z < 0.0f ? 4u : 0u);
+    uint32_t key = octant;
+    for (int axis = 0; axis < 3; axis++) {
+        int cell = static_cast<int>(std::floor(shot.origin[axis] / ORIGIN_CELL_SIZE));
+        key = key << 4 | (static_cast<uint32_t>(cell) & 15u);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        int quantized = std::min(static_cast<int>((d[axis] + 1.0f) * 8.0f), 15);
+        key = key << 4 | static_cast<uint32_t>(std::max(quantized, 0));
+    }
+    return key;
+}
+
+} // namespace
+
+Hitscan::Hitscan() : m_world(nullptr) {
+}
+
+void Hitscan::SetResistance(int surface, float resistance) {
+    if (surface < 0) {
+        return;
+    }
+    if (surface >= static_cast<int>(m_resistances.size())) {
+        m_resistances.resize(surface + 1, 1.0f);
+    }
+    m_resistances[surface] = resistance;
+}
+
+void Hitscan::SetLevelResistances(const LevelGeometry& level) {
+    const std::vector<LevelSurface>& surfaces = level.GetSurfaces();
+    for (size_t s = 0; s < surfaces.size(); s++) {
+        float resistance = 1.0f;
+        if (surfaces[s].translucent) {
+            resistance = 0.1f;
+        } else if (!surfaces[s].occluder) {
+            resistance = 0.5f;
+        }
+        SetResistance(static_cast<int>(s), resistance);
+    }
+}
+
+float Hitscan::GetResistance(int surface) const {
+    return surface >= 0 && surface < static_cast<int>(m_resistances.size()) ? m_resistances[surface] : 1.0f;
+}
+
+void Hitscan::Clear() {
+    m_shots.clear();
+    m_impacts.clear();
+    m_firstImpact.clear();
+    m_impactCount.clear();
+}
+
+int Hitscan::AddShot(const HitscanShot& shot) {
+    m_shots.push_back(shot);
+    return static_cast<int>(m_shots.size()) - 1;
+}
+
+void Hitscan::Process() {
+    int count = static_cast<int>(m_shots.size());
+    m_stats = HitscanStats();
+    m_stats.shots = count;
+    m_impacts.clear();
+    m_firstImpact.assign(count, 0);
+    m_impactCount.assign(count, 0);
+    if (!m_world || count == 0) {
+        return;
+    }
+
+    // 相近的射击排在一起，打进同一个包
+    m_keys.resize(count);
+    m_order.resize(count);
+    for (int i = 0; i < count; i++) {
+        m_keys[i] = packetKey(m_shots[i]);
+        m_order[i] = i;
+    }
+    std::sort(m_order.begin(), m_order.end(), [this](int a, int b) {
+        return m_keys[a] < m_keys[b];
+    });
+
+    const int packetSize = CollisionWorld::RAY_PACKET_SIZE;
+    glm::vec3 origins[packetSize];
+    glm::vec3 directions[packetSize];
+    float maxDistances[packetSize];
+    RayHitList results[packetSize];
+    for (int first = 0; first < count; first += packetSize) {
+        int lanes = std::min(packetSize, count - first);
+        for (int lane = 0; lane < lanes; lane++) {
+            const HitscanShot& shot = m_shots[m_order[first + lane]];
+            origins[lane] = shot.origin;
+            directions[lane] = shot.direction;
+            maxDistances[lane] = shot.range;
+        }
+        m_world->RaycastPacket(origins, directions, maxDistances, lanes, results);
+        m_stats.packets++;
+        for (int lane = 0; lane < lanes; lane++) {
+            m_stats.rayHits += results[lane].count;
+            ResolveShot(m_order[first + lane], results[lane]);
+        }
+    }
+    m_stats.impacts = static_cast<int>(m_impacts.size());
+}
+
+void Hitscan::ResolveShot(int shotIndex, const RayHitList& hits) {
+    const HitscanShot& shot = m_shots[shotIndex];
+    m_firstImpact[shotIndex] = static_cast<int>(m_impacts.size());
+    float power = shot.penetration;
+
+    int i = 0;
+    while (i < hits.count && m_impactCount[shotIndex] < MAX_IMPACTS) {
+        // 同一平面上的表面当作一个：有迎着射线的面时取其中最厚的，否则取最薄的
+        const RayHit* entry = &hits.hits[i];
+        bool front = glm::dot(entry->normal, shot.direction) < 0.0f;
+        int next = i + 1;
+        while (next < hits.count && hits.hits[next].distance - hits.hits[i].distance < COPLANAR_DISTANCE) {
+            const RayHit& other = hits.hits[next];
+            bool otherFront = glm::dot(other.normal, shot.direction) < 0.0f;
+            if ((otherFront && !front) || (otherFront == front && (front ? other.thickness > entry->thickness
+                                                                         : other.thickness < entry->thickness))) {
+                entry = &other;
+                front = otherFront;
+            }
+            next++;
+        }
+
+        // 出口：按厚度算出的出口以内第一个朝着射线方向的面，没有时就是按厚度算出的出口；
+        // 从背面碰到的表面（起点在实体里，或从窗洞里射到外墙面的背面）实体在它前面，穿过它不需要代价
+        float exitDistance = entry->distance;
+        if (front) {
+            float cosine = std::max(-glm::dot(entry->normal, shot.direction), MIN_COSINE);
+            exitDistance += entry->thickness / cosine;
+        }
+        for (int k = next; k < hits.count && hits.hits[k].distance <= exitDistance + COPLANAR_DISTANCE; k++) {
+            if (glm::dot(hits.hits[k].normal, shot.direction) > 0.0f) {
+                exitDistance = hits.hits[k].distance;
+                break;
+            }
+        }
+        // 实体里面和出口上的表面都已经穿过
+        while (next < hits.count && hits.hits[next].distance <= exitDistance + COPLANAR_DISTANCE) {
+            next++;
+        }
+
+        HitscanImpact impact;
+        impact.distance = entry->distance;
+        impact.position = shot.origin + shot.direction * entry->distance;
+        impact.normal = glm::dot(entry->normal, shot.direction) > 0.0f ? -entry->normal : entry->normal;
+        impact.surface = entry->surface;
+        impact.material = entry->material;
+        impact.thickness = exitDistance - entry->distance;
+        float cost = impact.thickness * GetResistance(entry->surface);
+        impact.penetrated = cost < power && exitDistance < shot.range;
+        power = impact.penetrated ? power - cost : 0.0f;
+        impact.damageScale = shot.penetration > 0.0f ? power / shot.penetration : 0.0f;
+        m_impacts.push_back(impact);
+        m_impactCount[shotIndex]++;
+        if (impact.penetrated) {
+            m_stats.penetrations++;
+        } else {
+            break;
+        }
+        i = next;
+    }
+}
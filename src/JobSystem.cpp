@@ -0,0 +1,99 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+JobSystem::JobSystem(int workerCount)
+    : m_func(nullptr), m_count(0), m_grainSize(1),
+      m_nextIndex(0), m_pendingChunks(0), m_activeWorkers(0), m_generation(0), m_quit(false) {
+    if (workerCount <= 0) {
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        workerCount = std::max(cores - 1, 0);
+    }
+
+    for (int i = 0; i < workerCount; i++) {
+        m_workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::ParallelFor(int count, const RangeFunc& func, int grainSize) {
+    if (count <= 0) {
+        return;
+    }
+    grainSize = std::max(grainSize, 1);
+
+    // 没有工作线程或只有一块时直接在调用线程执行
+    if (m_workers.empty() || count <= grainSize) {
+        func(0, count, 0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(m_submitMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_func = &func;
+        m_count = count;
+        m_grainSize = grainSize;
+        m_nextIndex.store(0);
+        m_pendingChunks.store((count + grainSize - 1) / grainSize);
+        m_generation++;
+    }
+    m_wakeCondition.notify_all();
+
+    RunChunks(0);
+
+    // 等待所有块完成，并且没有工作线程还停留在RunChunks里，
+    // 这样下一次ParallelFor修改任务参数时不会和它们竞争
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this] { return m_pendingChunks.load() == 0 && m_activeWorkers == 0; });
+    m_func = nullptr;
+}
+
+void JobSystem::RunChunks(int threadIndex) {
+    for (;;) {
+        int begin = m_nextIndex.fetch_add(m_grainSize);
+        if (begin >= m_count) {
+            break;
+        }
+        int end = std::min(begin + m_grainSize, m_count);
+        (*m_func)(begin, end, threadIndex);
+        m_pendingChunks.fetch_sub(1);
+    }
+}
+
+void JobSystem::WorkerLoop(int threadIndex) {
+    unsigned int seenGeneration = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeCondition.wait(lock, [this, seenGeneration] {
+                return m_quit || (m_generation != seenGeneration && m_func != nullptr);
+            });
+            if (m_quit) {
+                return;
+            }
+            seenGeneration = m_generation;
+            m_activeWorkers++;
+        }
+
+        RunChunks(threadIndex);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_activeWorkers--;
+        }
+        m_doneCondition.notify_one();
+    }
+}
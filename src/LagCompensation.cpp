@@ -0,0 +1,285 @@
+#include "LagCompensation.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 射线与包围盒在 [0, maxDistance] 内的入口距离，不相交时返回false
+bool rayBoxEntry(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const glm::vec3& minBounds,
+                 const glm::vec3& maxBounds, float& entry) {
+    float enter = 0.0f;
+    float leave = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        if (std::fabs(direction[axis]) < 1e-12f) {
+            if (origin[axis] < minBounds[axis] || origin[axis] > maxBounds[axis]) {
+                return false;
+            }
+            continue;
+        }
+        float inverse = 1.0f / direction[axis];
+        float t1 = (minBounds[axis] - origin[axis]) * inverse;
+        float t2 = (maxBounds[axis] - origin[axis]) * inverse;
+        enter = std::max(enter, std::min(t1, t2));
+        leave = std::min(leave, std::max(t1, t2));
+    }
+    entry = enter;
+    return enter <= leave;
+}
+
+// 射线与球，起点在球内时为0
+bool raySphere(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& center, float radius,
+               float& distance) {
+    glm::vec3 offset = origin - center;
+    float b = glm::dot(offset, direction);
+    float c = glm::dot(offset, offset) - radius * radius;
+    if (c <= 0.0f) {
+        distance = 0.0f;
+        return true;
+    }
+    float h = b * b - c;
+    if (b > 0.0f || h < 0.0f) {
+        return false;
+    }
+    distance = -b - std::sqrt(h);
+    return true;
+}
+
+// 角度（度）的最短插值
+float lerpAngle(float from, float to, float t) {
+    float delta = std::fmod(to - from, 360.0f);
+    if (delta > 180.0f) {
+        delta -= 360.0f;
+    } else if (delta < -180.0f) {
+        delta += 360.0f;
+    }
+    return from + delta * t;
+}
+
+} // namespace
+
+// 先求与无限长圆柱的交点，落在线段范围外时改为与端点的球求交
+bool RaycastHitbox(const glm::vec3& origin, const glm::vec3& direction, const Hitbox& hitbox, float& distance) {
+    glm::vec3 axis = hitbox.b - hitbox.a;
+    float axisLength2 = glm::dot(axis, axis);
+    if (axisLength2 < 1e-10f) {
+        return raySphere(origin, direction, hitbox.a, hitbox.radius, distance);
+    }
+    glm::vec3 offset = origin - hitbox.a;
+    float axisDirection = glm::dot(axis, direction);
+    float axisOffset = glm::dot(axis, offset);
+    float a = axisLength2 - axisDirection * axisDirection;
+    float b = axisLength2 * glm::dot(direction, offset) - axisOffset * axisDirection;
+    float c = axisLength2 * glm::dot(offset, offset) - axisOffset * axisOffset -
+              hitbox.radius * hitbox.radius * axisLength2;
+    // 射线与轴平行时a为0，只可能碰到端点的球
+    if (a > 1e-8f * axisLength2) {
+        float h = b * b - a * c;
+        if (h < 0.0f) {
+            return false;
+        }
+        float t = (-b - std::sqrt(h)) / a;
+        float along = axisOffset + t * axisDirection;
+        if (along > 0.0f && along < axisLength2) {
+            if (t >= 0.0f) {
+                distance = t;
+                return true;
+            }
+            // 交点在起点后面：起点在圆柱外时射线在远离，在圆柱里面且在线段范围内时就在胶囊里
+            if (c > 0.0f) {
+                return false;
+            }
+            if (axisOffset > 0.0f && axisOffset < axisLength2) {
+                distance = 0.0f;
+                return true;
+            }
+        }
+    }
+    float first, second;
+    bool hitA = raySphere(origin, direction, hitbox.a, hitbox.radius, first);
+    bool hitB = raySphere(origin, direction, hitbox.b, hitbox.radius, second);
+    if (!hitA && !hitB) {
+        return false;
+    }
+    distance = hitA && hitB ? std::min(first, second) : (hitA ? first : second);
+    return true;
+}
+
+LagCompensation::LagCompensation(int maxEntities, int historyTicks)
+    : m_maxEntities(maxEntities), m_historyTicks(1) {
+    while (m_historyTicks < historyTicks) {
+        m_historyTicks *= 2;
+    }
+    m_tickMask = m_historyTicks - 1;
+    HistoryEntry empty = {};
+    empty.tick = -1;
+    m_records.assign(static_cast<size_t>(m_maxEntities) * m_historyTicks, empty);
+    m_latestTick.assign(m_maxEntities, -1);
+}
+
+void LagCompensation::Record(int entity, int tick, const EntityPose& pose) {
+    if (entity < 0 || entity >= m_maxEntities || tick < 0) {
+        return;
+    }
+    HistoryEntry& record = m_records[static_cast<size_t>(entity) * m_historyTicks + (tick & m_tickMask)];
+    record.tick = tick;
+    record.pose = pose;
+    record.pose.hitboxCount = std::min(pose.hitboxCount, EntityPose::MAX_HITBOXES);
+    glm::vec3 minBounds(pose.position), maxBounds(pose.position);
+    for (int i = 0; i < record.pose.hitboxCount; i++) {
+        const Hitbox& hitbox = pose.hitboxes[i];
+        glm::vec3 radius(hitbox.radius);
+        minBounds = glm::min(minBounds, glm::min(hitbox.a, hitbox.b) - radius);
+        maxBounds = glm::max(maxBounds, glm::max(hitbox.a, hitbox.b) + radius);
+    }
+    record.minBounds = minBounds;
+    record.maxBounds = maxBounds;
+    m_latestTick[entity] = std::max(m_latestTick[entity], tick);
+}
+
+void LagCompensation::Remove(int entity) {
+    if (entity < 0 || entity >= m_maxEntities) {
+        return;
+    }
+    for (int i = 0; i < m_historyTicks; i++) {
+        m_records[static_cast<size_t>(entity) * m_historyTicks + i].tick = -1;
+    }
+    m_latestTick[entity] = -1;
+}
+
+bool LagCompensation::FindRecords(int entity, float tick, const HistoryEntry*& before, const HistoryEntry*& after,
+                                  float& t) const {
+    int latest = m_latestTick[entity];
+    if (latest < 0) {
+        return false;
+    }
+    const HistoryEntry* records = &m_records[static_cast<size_t>(entity) * m_historyTicks];
+    // 比最新的记录还新时不外推
+    if (tick >= static_cast<float>(latest)) {
+        before = after = &records[latest & m_tickMask];
+        t = 0.0f;
+        return true;
+    }
+    int oldest = std::max(latest - m_tickMask, 0);
+    int base = static_cast<int>(std::floor(tick));
+    before = nullptr;
+    for (int candidate = std::min(base, latest); candidate >= oldest; candidate--) {
+        const HistoryEntry& record = records[candidate & m_tickMask];
+        if (record.tick == candidate) {
+            before = &record;
+            break;
+        }
+    }
+    after = nullptr;
+    for (int candidate = std::max(base + 1, oldest); candidate <= latest; candidate++) {
+        const HistoryEntry& record = records[candidate & m_tickMask];
+        if (record.tick == candidate) {
+            after = &record;
+            break;
+        }
+    }
+    // 比最早的记录还早时取最早的
+    if (!before) {
+        if (!after) {
+            return false;
+        }
+        before = after;
+    }
+    t = after != before ? (tick - before->tick) / static_cast<float>(after->tick - before->tick) : 0.0f;
+    return true;
+}
+
+bool LagCompensation::GetPose(int entity, float tick, EntityPose& pose) const {
+    const HistoryEntry* before;
+    const HistoryEntry* after;
+    float t;
+    if (entity < 0 || entity >= m_maxEntities || !FindRecords(entity, tick, before, after, t)) {
+        return false;
+    }
+    const EntityPose& from = before->pose;
+    const EntityPose& to = after->pose;
+    // 两帧的命中盒个数不同（换了姿态）时取较近的一帧
+    if (from.hitboxCount != to.hitboxCount) {
+        pose = t < 0.5f ? from : to;
+        return true;
+    }
+    pose.position = from.position + (to.position - from.position) * t;
+    pose.yaw = lerpAngle(from.yaw, to.yaw, t);
+    pose.hitboxCount = from.hitboxCount;
+    for (int i = 0; i < from.hitboxCount; i++) {
+        const Hitbox& a = from.hitboxes[i];
+        const Hitbox& b = to.hitboxes[i];
+        pose.hitboxes[i].a = a.a + (b.a - a.a) * t;
+        pose.hitboxes[i].b = a.b + (b.b - a.b) * t;
+        pose.hitboxes[i].radius = a.radius + (b.radius - a.radius) * t;
+        pose.hitboxes[i].group = a.group;
+    }
+    return true;
+}
+
+bool LagCompensation::GetBounds(int entity, float tick, glm::vec3& minBounds, glm::vec3& maxBounds) const {
+    const HistoryEntry* before;
+    const HistoryEntry* after;
+    float t;
+    if (entity < 0 || entity >= m_maxEntities || !FindRecords(entity, tick, before, after, t)) {
+        return false;
+    }
+    // 插值的命中盒一定在两帧包围盒的并集里
+    minBounds = glm::min(before->minBounds, after->minBounds);
+    maxBounds = glm::max(before->maxBounds, after->maxBounds);
+    return true;
+}
+
+LagRewind::LagRewind(const LagCompensation& history, float tick, const glm::vec3& origin,
+                     const glm::vec3& direction, float maxDistance, int ignoreEntity)
+    : m_origin(origin), m_direction(direction), m_maxDistance(maxDistance), m_count(0) {
+    for (int entity = 0; entity < history.GetMaxEntities(); entity++) {
+        glm::vec3 minBounds, maxBounds;
+        float entry;
+        if (entity == ignoreEntity || !history.GetBounds(entity, tick, minBounds, maxBounds) ||
+            !rayBoxEntry(origin, direction, maxDistance, minBounds, maxBounds, entry)) {
+            continue;
+        }
+        int slot = m_count;
+        if (m_count == MAX_ENTITIES) {
+            // 满了时替换最远的
+            slot = 0;
+            for (int i = 1; i < m_count; i++) {
+                if (m_entryDistances[i] > m_entryDistances[slot]) {
+                    slot = i;
+                }
+            }
+            if (entry >= m_entryDistances[slot]) {
+                continue;
+            }
+        } else {
+            m_count++;
+        }
+        m_entities[slot] = entity;
+        m_entryDistances[slot] = entry;
+        history.GetPose(entity, tick, m_poses[slot]);
+    }
+}
+
+bool LagRewind::Raycast(LagHit& hit) const {
+    hit.entity = -1;
+    hit.distance = m_maxDistance;
+    for (int i = 0; i < m_count; i++) {
+        if (m_entryDistances[i] >= hit.distance) {
+            continue;
+        }
+        const EntityPose& pose = m_poses[i];
+        for (int h = 0; h < pose.hitboxCount; h++) {
+            float distance;
+            if (RaycastHitbox(m_origin, m_direction, pose.hitboxes[h], distance) && distance < hit.distance) {
+                hit.entity = m_entities[i];
+                hit.group = pose.hitboxes[h].group;
+                hit.distance = distance;
+            }
+        }
+    }
+    if (hit.entity < 0) {
+        return false;
+    }
+    hit.position = m_origin + m_direction * hit.distance;
+    return true;
+}
@@ -0,0 +1,81 @@
+#include "LatencyTracker.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// 一帧里最多记录的输入事件数，高回报率鼠标每帧可能有十几个
+const size_t MAX_EVENTS_PER_FRAME = 256;
+
+} // namespace
+
+LatencyTracker::LatencyTracker(int capacity)
+    : m_samples(std::max(capacity, 1), 0.0f), m_nextSample(0), m_full(false) {
+    m_pending.reserve(MAX_EVENTS_PER_FRAME);
+    m_latched.reserve(MAX_EVENTS_PER_FRAME);
+    m_sorted.reserve(m_samples.size());
+}
+
+void LatencyTracker::Reset() {
+    m_pending.clear();
+    m_latched.clear();
+    m_nextSample = 0;
+    m_full = false;
+}
+
+void LatencyTracker::OnInput(double time) {
+    if (m_pending.size() < MAX_EVENTS_PER_FRAME) {
+        m_pending.push_back(time);
+    }
+}
+
+void LatencyTracker::OnLatch() {
+    // 上一次锁存的输入如果还没有显示（没有调用OnPresent），一起计入这一帧
+    for (double time : m_pending) {
+        if (m_latched.size() < MAX_EVENTS_PER_FRAME) {
+            m_latched.push_back(time);
+        }
+    }
+    m_pending.clear();
+}
+
+void LatencyTracker::OnPresent(double time) {
+    for (double inputTime : m_latched) {
+        m_samples[m_nextSample] = static_cast<float>((time - inputTime) * 1000.0);
+        m_nextSample++;
+        if (m_nextSample == static_cast<int>(m_samples.size())) {
+            m_nextSample = 0;
+            m_full = true;
+        }
+    }
+    m_latched.clear();
+}
+
+int LatencyTracker::GetSampleCount() const {
+    return m_full ? static_cast<int>(m_samples.size()) : m_nextSample;
+}
+
+double LatencyTracker::GetPercentile(double p) const {
+    int count = GetSampleCount();
+    if (count == 0) {
+        return 0.0;
+    }
+
+    m_sorted.assign(m_samples.begin(), m_samples.begin() + count);
+    size_t index = static_cast<size_t>(std::ceil(p / 100.0 * count));
+    index = std::min(std::max(index, static_cast<size_t>(1)), static_cast<size_t>(count)) - 1;
+    std::nth_element(m_sorted.begin(), m_sorted.begin() + index, m_sorted.end());
+    return m_sorted[index];
+}
+
+void LatencyTracker::PrintReport(const char* label) const {
+    int count = GetSampleCount();
+    if (count == 0) {
+        std::cout << label << ": 没有输入样本" << std::endl;
+        return;
+    }
+    std::cout << label << ": " << count << " 个输入事件，输入到显示延迟 p50 " << GetPercentile(50.0)
+              << " ms, p90 " << GetPercentile(90.0) << " ms, p99 " << GetPercentile(99.0)
+              << " ms, 最大 " << GetPercentile(100.0) << " ms" << std::endl;
+}
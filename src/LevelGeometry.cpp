@@ -0,0 +1,321 @@
+#include "LevelGeometry.h"
+#include <algorithm>
+#include <cmath>
+
+LevelGeometry::LevelGeometry(const LevelDesc& desc)
+    : m_desc(desc), m_currentSurface(-1) {
+}
+
+void LevelGeometry::Build() {
+    m_surfaces.assign(SURFACE_COUNT, LevelSurface());
+    m_vertices.clear();
+    m_decals.clear();
+
+    BuildRoom();
+    BuildFrontWall();
+    BuildWindow();
+    BuildPosters();
+    BuildCells();
+}
+
+void LevelGeometry::BeginSurface(LevelSurfaceId id, LevelMaterial material, const glm::vec4& color,
+                                 bool translucent, bool occluder, float thickness) {
+    m_currentSurface = id;
+    LevelSurface& surface = m_surfaces[id];
+    surface.material = material;
+    surface.color = color;
+    surface.translucent = translucent;
+    surface.occluder = occluder;
+    surface.thickness = thickness;
+    surface.firstQuad = static_cast<int>(m_vertices.size() / 4);
+    surface.quadCount = 0;
+    surface.minBounds = glm::vec3(1e30f);
+    surface.maxBounds = glm::vec3(-1e30f);
+}
+
+void LevelGeometry::AddQuad(const glm::vec3& normal,
+                            const glm::vec3& p0, const glm::vec2& t0, const glm::vec3& p1, const glm::vec2& t1,
+                            const glm::vec3& p2, const glm::vec2& t2, const glm::vec3& p3, const glm::vec2& t3) {
+    LevelSurface& surface = m_surfaces[m_currentSurface];
+    const glm::vec3* positions[4] = {&p0, &p1, &p2, &p3};
+    const glm::vec2* uvs[4] = {&t0, &t1, &t2, &t3};
+
+    for (int i = 0; i < 4; i++) {
+        m_vertices.push_back({*positions[i], normal, *uvs[i]});
+        surface.minBounds = glm::min(surface.minBounds, *positions[i]);
+        surface.maxBounds = glm::max(surface.maxBounds, *positions[i]);
+    }
+    surface.quadCount++;
+}
+
+void LevelGeometry::AddQuad(const glm::vec3& normal,
+                            const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3) {
+    glm::vec2 zero(0.0f, 0.0f);
+    AddQuad(normal, p0, zero, p1, zero, p2, zero, p3, zero);
+}
+
+void LevelGeometry::EndSurface() {
+    m_currentSurface = -1;
+}
+
+void LevelGeometry::BuildRoom() {
+    const float half = m_desc.roomSize / 2.0f;
+    const float height = m_desc.roomHeight;
+    const glm::vec4 white(1.0f, 1.0f, 1.0f, 1.0f);
+    const float thickness = m_desc.wallThickness;
+
+    // 地面 - 使用floor纹理，增加重复次数
+    BeginSurface(SURFACE_FLOOR, MATERIAL_FLOOR, white, false, true, thickness);
+    AddQuad(glm::vec3(0, 1, 0),
+            glm::vec3(-half, 0, -half), glm::vec2(0.0f, 0.0f),
+            glm::vec3(half, 0, -half), glm::vec2(8.0f, 0.0f),
+            glm::vec3(half, 0, half), glm::vec2(8.0f, 8.0f),
+            glm::vec3(-half, 0, half), glm::vec2(0.0f, 8.0f));
+    EndSurface();
+
+    // 天花板 - 使用sky纹理，增加重复次数
+    BeginSurface(SURFACE_CEILING, MATERIAL_SKY, white, false, true, thickness);
+    AddQuad(glm::vec3(0, -1, 0),
+            glm::vec3(-half, height, -half), glm::vec2(0.0f, 0.0f),
+            glm::vec3(half, height, -half), glm::vec2(8.0f, 0.0f),
+            glm::vec3(half, height, half), glm::vec2(8.0f, 8.0f),
+            glm::vec3(-half, height, half), glm::vec2(0.0f, 8.0f));
+    EndSurface();
+
+    // 后墙 - 使用wall纹理，增加重复次数
+    BeginSurface(SURFACE_BACK_WALL, MATERIAL_WALL, white, false, true, thickness);
+    AddQuad(glm::vec3(0, 0, -1),
+            glm::vec3(-half, 0, half), glm::vec2(0.0f, 0.0f),
+            glm::vec3(half, 0, half), glm::vec2(8.0f, 0.0f),
+            glm::vec3(half, height, half), glm::vec2(8.0f, 6.0f),
+            glm::vec3(-half, height, half), glm::vec2(0.0f, 6.0f));
+    EndSurface();
+
+    // 左墙
+    BeginSurface(SURFACE_LEFT_WALL, MATERIAL_WALL, white, false, true, thickness);
+    AddQuad(glm::vec3(1, 0, 0),
+            glm::vec3(-half, 0, -half), glm::vec2(0.0f, 0.0f),
+            glm::vec3(-half, 0, half), glm::vec2(8.0f, 0.0f),
+            glm::vec3(-half, height, half), glm::vec2(8.0f, 6.0f),
+            glm::vec3(-half, height, -half), glm::vec2(0.0f, 6.0f));
+    EndSurface();
+
+    // 右墙
+    BeginSurface(SURFACE_RIGHT_WALL, MATERIAL_WALL, white, false, true, thickness);
+    AddQuad(glm::vec3(-1, 0, 0),
+            glm::vec3(half, 0, -half), glm::vec2(0.0f, 0.0f),
+            glm::vec3(half, 0, half), glm::vec2(8.0f, 0.0f),
+            glm::vec3(half, height, half), glm::vec2(8.0f, 6.0f),
+            glm::vec3(half, height, -half), glm::vec2(0.0f, 6.0f));
+    EndSurface();
+}
+
+// 前墙 - 有厚度的墙，带窗户洞
+void LevelGeometry::BuildFrontWall() {
+    const float half = m_desc.roomSize / 2.0f;
+    const float size = m_desc.roomSize;
+    const float height = m_desc.roomHeight;
+    const float innerZ = -half;
+    const float outerZ = -half - m_desc.wallThickness;
+    const float winLeft = m_desc.windowX - m_desc.windowWidth / 2;
+    const float winRight = m_desc.windowX + m_desc.windowWidth / 2;
+    const float winBottom = m_desc.windowY - m_desc.windowHeight / 2;
+    const float winTop = m_desc.windowY + m_desc.windowHeight / 2;
+
+    // 纹理坐标：墙面横向重复8次，纵向重复6次
+    const float texLeft = (winLeft + half) / size * 8.0f;
+    const float texRight = (winRight + half) / size * 8.0f;
+    const float texBottom = winBottom / height * 6.0f;
+    const float texTop = winTop / height * 6.0f;
+    const float texThicknessU = m_desc.wallThickness / size * 8.0f;
+    const float texThicknessV = m_desc.wallThickness / height * 6.0f;
+
+    BeginSurface(SURFACE_FRONT_WALL, MATERIAL_WALL, glm::vec4(1.0f), false, true, m_desc.wallThickness);
+
+    // 内墙（房间内部看到的面）
+    const glm::vec3 inward(0, 0, 1);
+    // 内墙上半部分（窗户上方）
+    AddQuad(inward,
+            glm::vec3(-half, winTop, innerZ), glm::vec2(0.0f, texTop),
+            glm::vec3(half, winTop, innerZ), glm::vec2(8.0f, texTop),
+            glm::vec3(half, height, innerZ), glm::vec2(8.0f, 6.0f),
+            glm::vec3(-half, height, innerZ), glm::vec2(0.0f, 6.0f));
+    // 内墙下半部分（窗户下方）
+    AddQuad(inward,
+            glm::vec3(-half, 0, innerZ), glm::vec2(0.0f, 0.0f),
+            glm::vec3(half, 0, innerZ), glm::vec2(8.0f, 0.0f),
+            glm::vec3(half, winBottom, innerZ), glm::vec2(8.0f, texBottom),
+            glm::vec3(-half, winBottom, innerZ), glm::vec2(0.0f, texBottom));
+    // 内墙左侧部分（窗户左侧）
+    AddQuad(inward,
+            glm::vec3(-half, winBottom, innerZ), glm::vec2(0.0f, texBottom),
+            glm::vec3(winLeft, winBottom, innerZ), glm::vec2(texLeft, texBottom),
+            glm::vec3(winLeft, winTop, innerZ), glm::vec2(texLeft, texTop),
+            glm::vec3(-half, winTop, innerZ), glm::vec2(0.0f, texTop));
+    // 内墙右侧部分（窗户右侧）
+    AddQuad(inward,
+            glm::vec3(winRight, winBottom, innerZ), glm::vec2(texRight, texBottom),
+            glm::vec3(half, winBottom, innerZ), glm::vec2(8.0f, texBottom),
+            glm::vec3(half, winTop, innerZ), glm::vec2(8.0f, texTop),
+            glm::vec3(winRight, winTop, innerZ), glm::vec2(texRight, texTop));
+
+    // 外墙（房间外部看到的面）
+    AddQuad(glm::vec3(0, 0, -1),
+            glm::vec3(-half, 0, outerZ), glm::vec2(0.0f, 0.0f),
+            glm::vec3(half, 0, outerZ), glm::vec2(8.0f, 0.0f),
+            glm::vec3(half, height, outerZ), glm::vec2(8.0f, 6.0f),
+            glm::vec3(-half, height, outerZ), glm::vec2(0.0f, 6.0f));
+
+    // 窗户的侧面（左、右、上、下）- 使用墙壁纹理
+    AddQuad(glm::vec3(1, 0, 0),
+            glm::vec3(winLeft, winBottom, innerZ), glm::vec2(texLeft, texBottom),
+            glm::vec3(winLeft, winTop, innerZ), glm::vec2(texLeft, texTop),
+            glm::vec3(winLeft, winTop, outerZ), glm::vec2(texLeft + texThicknessU, texTop),
+            glm::vec3(winLeft, winBottom, outerZ), glm::vec2(texLeft + texThicknessU, texBottom));
+    AddQuad(glm::vec3(-1, 0, 0),
+            glm::vec3(winRight, winBottom, outerZ), glm::vec2(texRight, texBottom),
+            glm::vec3(winRight, winTop, outerZ), glm::vec2(texRight, texTop),
+            glm::vec3(winRight, winTop, innerZ), glm::vec2(texRight + texThicknessU, texTop),
+            glm::vec3(winRight, winBottom, innerZ), glm::vec2(texRight + texThicknessU, texBottom));
+    AddQuad(glm::vec3(0, -1, 0),
+            glm::vec3(winLeft, winTop, innerZ), glm::vec2(texLeft, texTop),
+            glm::vec3(winRight, winTop, innerZ), glm::vec2(texRight, texTop),
+            glm::vec3(winRight, winTop, outerZ), glm::vec2(texRight, texTop + texThicknessV),
+            glm::vec3(winLeft, winTop, outerZ), glm::vec2(texLeft, texTop + texThicknessV));
+    AddQuad(glm::vec3(0, 1, 0),
+            glm::vec3(winLeft, winBottom, outerZ), glm::vec2(texLeft, texBottom),
+            glm::vec3(winRight, winBottom, outerZ), glm::vec2(texRight, texBottom),
+            glm::vec3(winRight, winBottom, innerZ), glm::vec2(texRight, texBottom + texThicknessV),
+            glm::vec3(winLeft, winBottom, innerZ), glm::vec2(texLeft, texBottom + texThicknessV));
+
+    EndSurface();
+}
+
+void LevelGeometry::BuildWindow() {
+    const float half = m_desc.roomSize / 2.0f;
+    const float innerZ = -half;
+    const float outerZ = -half - m_desc.wallThickness;
+    const float winLeft = m_desc.windowX - m_desc.windowWidth / 2;
+    const float winRight = m_desc.windowX + m_desc.windowWidth / 2;
+    const float winBottom = m_desc.windowY - m_desc.windowHeight / 2;
+    const float winTop = m_desc.windowY + m_desc.windowHeight / 2;
+    const float frame = m_desc.frameThickness;
+
+    // 窗户框架（深棕色），内外两层，每层上下左右四条
+    BeginSurface(SURFACE_WINDOW_FRAME, MATERIAL_NONE, glm::vec4(0.4f, 0.2f, 0.1f, 1.0f), false, false, frame);
+    const float frameZ[2] = {innerZ, outerZ};
+    const glm::vec3 frameNormal[2] = {glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)};
+    for (int layer = 0; layer < 2; layer++) {
+        const float z = frameZ[layer];
+        const glm::vec3& n = frameNormal[layer];
+        AddQuad(n, glm::vec3(winLeft - frame, winTop, z), glm::vec3(winRight + frame, winTop, z),
+                   glm::vec3(winRight + frame, winTop + frame, z), glm::vec3(winLeft - frame, winTop + frame, z));
+        AddQuad(n, glm::vec3(winLeft - frame, winBottom - frame, z), glm::vec3(winRight + frame, winBottom - frame, z),
+                   glm::vec3(winRight + frame, winBottom, z), glm::vec3(winLeft - frame, winBottom, z));
+        AddQuad(n, glm::vec3(winLeft - frame, winBottom, z), glm::vec3(winLeft, winBottom, z),
+                   glm::vec3(winLeft, winTop, z), glm::vec3(winLeft - frame, winTop, z));
+        AddQuad(n, glm::vec3(winRight, winBottom, z), glm::vec3(winRight + frame, winBottom, z),
+                   glm::vec3(winRight + frame, winTop, z), glm::vec3(winRight, winTop, z));
+    }
+    EndSurface();
+
+    // 窗户玻璃（内层，半透明，带阳光效果）
+    BeginSurface(SURFACE_WINDOW_GLASS_INNER, MATERIAL_NONE, glm::vec4(1.0f, 0.9f, 0.7f, 0.1f), true, false, 0.05f);
+    AddQuad(glm::vec3(0, 0, 1),
+            glm::vec3(winLeft, winBottom, innerZ), glm::vec3(winRight, winBottom, innerZ),
+            glm::vec3(winRight, winTop, innerZ), glm::vec3(winLeft, winTop, innerZ));
+    EndSurface();
+
+    // 窗户玻璃（外层，稍微偏蓝）
+    BeginSurface(SURFACE_WINDOW_GLASS_OUTER, MATERIAL_NONE, glm::vec4(0.8f, 0.9f, 1.0f, 0.05f), true, false, 0.05f);
+    AddQuad(glm::vec3(0, 0, -1),
+            glm::vec3(winLeft, winBottom, outerZ), glm::vec3(winRight, winBottom, outerZ),
+            glm::vec3(winRight, winTop, outerZ), glm::vec3(winLeft, winTop, outerZ));
+    EndSurface();
+}
+
+// 装饰画放在各墙内侧面的中央（贴花自己处理离墙的偏移）
+void LevelGeometry::BuildPosters() {
+    const float half = m_desc.roomSize / 2.0f;
+    const float centerY = m_desc.roomHeight * 0.5f; // 垂直居中
+    const glm::vec3 up(0, 1, 0);
+
+    // 右墙上的logo
+    m_decals.push_back({MATERIAL_LOGO, glm::vec3(half, centerY, 0.0f), glm::vec3(-1, 0, 0), up, 3.0f, 3.0f});
+    // 前墙上的daqing
+    m_decals.push_back({MATERIAL_DAQING, glm::vec3(0.0f, centerY, -half), glm::vec3(0, 0, 1), up, 3.0f, 3.0f});
+    // 左墙上的home，尺寸较小
+    m_decals.push_back({MATERIAL_HOME, glm::vec3(-half, centerY, 0.0f), glm::vec3(1, 0, 0), up, 2.0f, 2.0f});
+}
+
+// 三个单元格：房间、前墙上的窗洞和窗外，窗洞的内外两面是开口
+void LevelGeometry::BuildCells() {
+    const float half = m_desc.roomSize / 2.0f;
+    const float height = m_desc.roomHeight;
+    const float innerZ = -half;
+    const float outerZ = -half - m_desc.wallThickness;
+    const glm::vec2 winMin(m_desc.windowX - m_desc.windowWidth / 2, m_desc.windowY - m_desc.windowHeight / 2);
+    const glm::vec2 winMax(m_desc.windowX + m_desc.windowWidth / 2, m_desc.windowY + m_desc.windowHeight / 2);
+
+    m_cells.clear();
+    m_cells.push_back({glm::vec3(-half, 0.0f, -half), glm::vec3(half, height, half)});
+    m_cells.push_back({glm::vec3(winMin.x, winMin.y, outerZ), glm::vec3(winMax.x, winMax.y, innerZ)});
+    m_cells.push_back({glm::vec3(-half, 0.0f, outerZ - m_desc.outsideDepth), glm::vec3(half, height, outerZ)});
+
+    m_openings.clear();
+    m_openings.push_back({{0, 1}, 2, glm::vec3(winMin.x, winMin.y, innerZ), glm::vec3(winMax.x, winMax.y, innerZ)});
+    m_openings.push_back({{1, 2}, 2, glm::vec3(winMin.x, winMin.y, outerZ), glm::vec3(winMax.x, winMax.y, outerZ)});
+}
+
+bool LevelGeometry::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                            LevelHit& hit) const {
+    const float epsilon = 1e-7f;
+    hit.distance = maxDistance;
+    hit.surface = -1;
+
+    for (size_t s = 0; s < m_surfaces.size(); s++) {
+        const LevelSurface& surface = m_surfaces[s];
+        for (int q = 0; q < surface.quadCount; q++) {
+            int quad = surface.firstQuad + q;
+            // 两个三角形 (0,1,2) (0,2,3)，Moller-Trumbore
+            for (int t = 0; t < 2; t++) {
+                const glm::vec3& p0 = GetQuadVertex(quad, 0).position;
+                const glm::vec3& p1 = GetQuadVertex(quad, t + 1).position;
+                const glm::vec3& p2 = GetQuadVertex(quad, t + 2).position;
+                glm::vec3 e1 = p1 - p0;
+                glm::vec3 e2 = p2 - p0;
+                glm::vec3 pv = glm::cross(direction, e2);
+                float det = glm::dot(e1, pv);
+                if (std::fabs(det) < epsilon) {
+                    continue;
+                }
+                float invDet = 1.0f / det;
+                glm::vec3 tv = origin - p0;
+                float u = glm::dot(tv, pv) * invDet;
+                if (u < 0.0f || u > 1.0f) {
+                    continue;
+                }
+                glm::vec3 qv = glm::cross(tv, e1);
+                float v = glm::dot(direction, qv) * invDet;
+                if (v < 0.0f || u + v > 1.0f) {
+                    continue;
+                }
+                float distance = glm::dot(e2, qv) * invDet;
+                if (distance > 0.0f && distance < hit.distance) {
+                    hit.distance = distance;
+                    hit.surface = static_cast<int>(s);
+                    hit.normal = GetQuadVertex(quad, 0).normal;
+                }
+            }
+        }
+    }
+
+    if (hit.surface < 0) {
+        return false;
+    }
+    if (glm::dot(hit.normal, direction) > 0.0f) {
+        hit.normal = -hit.normal;
+    }
+    hit.position = origin + direction * hit.distance;
+    return true;
+}
@@ -0,0 +1,1029 @@
+#include "NavMesh.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include "LevelGeometry.h"
+#include "NetProtocol.h"
+
+namespace {
+
+const uint32_t NAV_FILE_ID = 0x3156414E;           // "NAV1"
+const int NO_CEILING = 0x3FFFFFFF;
+const float SEARCH_RADIUS = 2.0f;                  // 起点和终点不在网格上时往周围找多远
+
+// 四个方向：+x、+z、-x、-z
+const int DIRECTION_X[4] = {1, 0, -1, 0};
+const int DIRECTION_Z[4] = {0, 1, 0, -1};
+
+// 一列里的一段实心体素，[bottom, top]（以cellHeight为单位）
+struct Span {
+    int bottom;
+    int top;
+    bool walkable;                                 // 顶面够平，能站人
+};
+
+// 能站人的格子：一段的顶面
+struct Cell {
+    int x, z;
+    int y;
+    int ceiling;                                   // 上面一段的底，没有时为NO_CEILING
+    int links[4];                                  // 四个方向上连通的格子，-1为没有
+    int region;                                    // -1为离墙太近去掉了
+    int polygon;
+};
+
+// 新的段和重叠的段合并；两段顶面高度差在climb以内时任何一个能站人合并后就能站人，否则看上面那个
+void addSpan(std::vector<Span>& column, Span span, int climb) {
+    size_t i = 0;
+    while (i < column.size()) {
+        const Span& other = column[i];
+        if (other.top < span.bottom) {
+            i++;
+            continue;
+        }
+        if (other.bottom > span.top) {
+            break;
+        }
+        if (std::abs(other.top - span.top) <= climb) {
+            span.walkable = span.walkable || other.walkable;
+        } else if (other.top > span.top) {
+            span.walkable = other.walkable;
+        }
+        span.bottom = std::min(span.bottom, other.bottom);
+        span.top = std::max(span.top, other.top);
+        column.erase(column.begin() + i);
+    }
+    column.insert(column.begin() + i, span);
+}
+
+// 多边形在axis轴上 sign * (p[axis] - value) >= 0 的部分（Sutherland-Hodgman）
+int clipPolygon(const glm::vec3* in, int count, glm::vec3* out, int axis, float value, float sign) {
+    int outCount = 0;
+    for (int i = 0; i < count; i++) {
+        const glm::vec3& a = in[i];
+        const glm::vec3& b = in[(i + 1) % count];
+        float da = sign * (a[axis] - value);
+        float db = sign * (b[axis] - value);
+        if (da >= 0.0f) {
+            out[outCount++] = a;
+        }
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            out[outCount++] = a + (b - a) * (da / (da - db));
+        }
+    }
+    return outCount;
+}
+
+// 在x-z平面上c在a->b的左边为正
+float cross2(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    return (b.x - a.x) * (c.z - a.z) - (b.z - a.z) * (c.x - a.x);
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+void NavMesh::Clear() {
+    m_stats = NavMeshStats();
+    m_width = 0;
+    m_depth = 0;
+    m_polygons.clear();
+    m_links.clear();
+    m_columnStarts.clear();
+    m_columnPolygons.clear();
+    m_clustersX = 0;
+    m_clusterCount = 0;
+    m_entrances.clear();
+    m_entranceOf.clear();
+    m_clusterEntranceStarts.clear();
+    m_clusterEntrances.clear();
+    m_abstractEdgeStarts.clear();
+    m_abstractEdges.clear();
+    m_abstractPaths.clear();
+}
+
+bool NavMesh::Build(const LevelGeometry& level, const NavMeshSettings& settings) {
+    auto start = std::chrono::steady_clock::now();
+    Clear();
+    m_settings = settings;
+    const float cellSize = settings.cellSize;
+    const float cellHeight = settings.cellHeight;
+    const int climb = static_cast<int>(std::floor(settings.agentClimb / cellHeight));
+    const int height = static_cast<int>(std::ceil(settings.agentHeight / cellHeight));
+    const float minNormalY = std::cos(settings.maxSlope / 57.2957795f);
+
+    // 关卡的三角形（每个四边形两个），法线是四边形朝外的一侧
+    std::vector<glm::vec3> triangles;
+    std::vector<uint8_t> walkable;
+    glm::vec3 minBounds(1e30f);
+    glm::vec3 maxBounds(-1e30f);
+    for (const LevelSurface& surface : level.GetSurfaces()) {
+        for (int q = 0; q < surface.quadCount; q++) {
+            int quad = surface.firstQuad + q;
+            const LevelVertex& v0 = level.GetQuadVertex(quad, 0);
+            for (int t = 0; t < 2; t++) {
+                triangles.push_back(v0.position);
+                triangles.push_back(level.GetQuadVertex(quad, t + 1).position);
+                triangles.push_back(level.GetQuadVertex(quad, t + 2).position);
+                walkable.push_back(v0.normal.y >= minNormalY ? 1 : 0);
+            }
+            for (int i = 0; i < 4; i++) {
+                minBounds = glm::min(minBounds, level.GetQuadVertex(quad, i).position);
+                maxBounds = glm::max(maxBounds, level.GetQuadVertex(quad, i).position);
+            }
+        }
+    }
+    if (triangles.empty()) {
+        return false;
+    }
+    // 四周多留一格，贴着包围盒的面也在网格里
+    m_origin = glm::vec3(minBounds.x - cellSize, minBounds.y, minBounds.z - cellSize);
+    m_width = static_cast<int>(std::ceil((maxBounds.x - minBounds.x) / cellSize)) + 2;
+    m_depth = static_cast<int>(std::ceil((maxBounds.z - minBounds.z) / cellSize)) + 2;
+    m_stats.columns = m_width * m_depth;
+
+    // 体素化：每个三角形裁到它经过的每一列里，裁出来的部分的高度范围是一段
+    std::vector<std::vector<Span>> columns(static_cast<size_t>(m_width) * m_depth);
+    glm::vec3 row[8];
+    glm::vec3 rowScratch[8];
+    glm::vec3 piece[8];
+    glm::vec3 pieceScratch[8];
+    for (size_t t = 0; t < walkable.size(); t++) {
+        const glm::vec3* triangle = &triangles[t * 3];
+        glm::vec3 lo = glm::min(glm::min(triangle[0], triangle[1]), triangle[2]);
+        glm::vec3 hi = glm::max(glm::max(triangle[0], triangle[1]), triangle[2]);
+        int x0 = std::max(0, static_cast<int>(std::floor((lo.x - m_origin.x) / cellSize)));
+        int x1 = std::min(m_width - 1, static_cast<int>(std::floor((hi.x - m_origin.x) / cellSize)));
+        int z0 = std::max(0, static_cast<int>(std::floor((lo.z - m_origin.z) / cellSize)));
+        int z1 = std::min(m_depth - 1, static_cast<int>(std::floor((hi.z - m_origin.z) / cellSize)));
+        for (int z = z0; z <= z1; z++) {
+            float minZ = m_origin.z + z * cellSize;
+            int count = clipPolygon(triangle, 3, rowScratch, 2, minZ, 1.0f);
+            count = clipPolygon(rowScratch, count, row, 2, minZ + cellSize, -1.0f);
+            if (count < 3) {
+                continue;
+            }
+            for (int x = x0; x <= x1; x++) {
+                float minX = m_origin.x + x * cellSize;
+                int pieceCount = clipPolygon(row, count, pieceScratch, 0, minX, 1.0f);
+                pieceCount = clipPolygon(pieceScratch, pieceCount, piece, 0, minX + cellSize, -1.0f);
+                if (pieceCount < 3) {
+                    continue;
+                }
+                float low = piece[0].y;
+                float high = piece[0].y;
+                for (int i = 1; i < pieceCount; i++) {
+                    low = std::min(low, piece[i].y);
+                    high = std::max(high, piece[i].y);
+                }
+                Span span;
+                span.bottom = static_cast<int>(std::floor((low - m_origin.y) / cellHeight));
+                span.top = std::max(span.bottom, static_cast<int>(std::ceil((high - m_origin.y) / cellHeight)));
+                span.walkable = walkable[t] != 0;
+                addSpan(columns[static_cast<size_t>(z) * m_width + x], span, climb);
+            }
+        }
+    }
+
+    // 能站人的格子：顶面能站人、到上面一段的空间够站着的玩家
+    std::vector<Cell> cells;
+    std::vector<int> columnCells(columns.size() + 1, 0);
+    for (int z = 0; z < m_depth; z++) {
+        for (int x = 0; x < m_width; x++) {
+            size_t index = static_cast<size_t>(z) * m_width + x;
+            const std::vector<Span>& column = columns[index];
+            columnCells[index] = static_cast<int>(cells.size());
+            m_stats.spans += static_cast<int>(column.size());
+            for (size_t i = 0; i < column.size(); i++) {
+                int ceiling = i + 1 < column.size() ? column[i + 1].bottom : NO_CEILING;
+                if (column[i].walkable && ceiling - column[i].top >= height) {
+                    cells.push_back({x, z, column[i].top, ceiling, {-1, -1, -1, -1}, 0, -1});
+                }
+            }
+        }
+    }
+    columnCells[columns.size()] = static_cast<int>(cells.size());
+    m_stats.walkableCells = static_cast<int>(cells.size());
+
+    // 相邻的格子高度差在climb以内、两个格子共同的头顶空间够高时连通
+    for (Cell& cell : cells) {
+        for (int direction = 0; direction < 4; direction++) {
+            int x = cell.x + DIRECTION_X[direction];
+            int z = cell.z + DIRECTION_Z[direction];
+            if (x < 0 || x >= m_width || z < 0 || z >= m_depth) {
+                continue;
+            }
+            size_t index = static_cast<size_t>(z) * m_width + x;
+            for (int other = columnCells[index]; other < columnCells[index + 1]; other++) {
+                const Cell& neighbor = cells[other];
+                if (std::abs(neighbor.y - cell.y) <= climb &&
+                    std::min(neighbor.ceiling, cell.ceiling) - std::max(neighbor.y, cell.y) >= height) {
+                    cell.links[direction] = other;
+                    break;
+                }
+            }
+        }
+    }
+
+    // 离墙收缩：边上的格子（缺了某个方向的邻居）距离为0，向里宽度优先数格子，近于agentRadius的去掉
+    const int erode = static_cast<int>(std::ceil(settings.agentRadius / cellSize));
+    std::vector<int> distance(cells.size(), NO_CEILING);
+    std::vector<int> queue;
+    queue.reserve(cells.size());
+    for (size_t i = 0; i < cells.size(); i++) {
+        const int* links = cells[i].links;
+        if (links[0] < 0 || links[1] < 0 || links[2] < 0 || links[3] < 0) {
+            distance[i] = 0;
+            queue.push_back(static_cast<int>(i));
+        }
+    }
+    for (size_t head = 0; head < queue.size(); head++) {
+        int current = queue[head];
+        for (int link : cells[current].links) {
+            if (link >= 0 && distance[link] > distance[current] + 1) {
+                distance[link] = distance[current] + 1;
+                queue.push_back(link);
+            }
+        }
+    }
+    for (size_t i = 0; i < cells.size(); i++) {
+        cells[i].region = distance[i] < erode ? -1 : 0;
+    }
+
+    // 连通的区域
+    int regions = 0;
+    for (size_t i = 0; i < cells.size(); i++) {
+        if (cells[i].region != 0) {
+            continue;
+        }
+        regions++;
+        queue.clear();
+        queue.push_back(static_cast<int>(i));
+        cells[i].region = regions;
+        for (size_t head = 0; head < queue.size(); head++) {
+            for (int link : cells[queue[head]].links) {
+                if (link >= 0 && cells[link].region == 0) {
+                    cells[link].region = regions;
+                    queue.push_back(link);
+                }
+            }
+        }
+        m_stats.cells += static_cast<int>(queue.size());
+    }
+    m_stats.regions = regions;
+
+    // 每一块里贪心合并矩形：从还没用的格子开始先沿+x伸到不能再伸，再一行一行沿+z伸，
+    // 新的一行每个格子都要和下面一行连通、互相连通，并且区域和高度相同
+    const int tile = std::max(1, settings.tileCells);
+    auto usable = [&](int index, const Cell& first) {
+        return index >= 0 && cells[index].region == first.region && cells[index].y == first.y && cells[index].polygon < 0;
+    };
+    std::vector<int> lower, upper;
+    for (int tileZ = 0; tileZ < m_depth; tileZ += tile) {
+        for (int tileX = 0; tileX < m_width; tileX += tile) {
+            int tileX1 = std::min(tileX + tile, m_width);
+            int tileZ1 = std::min(tileZ + tile, m_depth);
+            for (int z = tileZ; z < tileZ1; z++) {
+                for (int x = tileX; x < tileX1; x++) {
+                    size_t index = static_cast<size_t>(z) * m_width + x;
+                    for (int c = columnCells[index]; c < columnCells[index + 1]; c++) {
+                        const Cell first = cells[c];
+                        if (first.region <= 0 || first.polygon >= 0) {
+                            continue;
+                        }
+                        int polygon = static_cast<int>(m_polygons.size());
+                        lower.assign(1, c);
+                        while (x + static_cast<int>(lower.size()) < tileX1 && usable(cells[lower.back()].links[0], first)) {
+                            lower.push_back(cells[lower.back()].links[0]);
+                        }
+                        for (int cell : lower) {
+                            cells[cell].polygon = polygon;
+                        }
+                        int rows = 1;
+                        while (z + rows < tileZ1) {
+                            upper.clear();
+                            bool ok = true;
+                            for (size_t i = 0; i < lower.size() && ok; i++) {
+                                int above = cells[lower[i]].links[1];
+                                ok = usable(above, first) && (i == 0 || cells[upper.back()].links[0] == above);
+                                upper.push_back(above);
+                            }
+                            if (!ok) {
+                                break;
+                            }
+                            for (int cell : upper) {
+                                cells[cell].polygon = polygon;
+                            }
+                            lower.swap(upper);
+                            rows++;
+                        }
+                        NavPolygon result = {};
+                        result.x0 = x;
+                        result.z0 = z;
+                        result.x1 = x + static_cast<int>(lower.size());
+                        result.z1 = z + rows;
+                        result.y = m_origin.y + first.y * cellHeight;
+                        result.region = first.region;
+                        m_polygons.push_back(result);
+                    }
+                }
+            }
+        }
+    }
+    m_stats.buildSeconds = secondsSince(start);
+    if (m_polygons.empty()) {
+        return false;
+    }
+    BuildGraph();
+    return true;
+}
+
+glm::vec3 NavMesh::GetPolygonMin(int polygon) const {
+    const NavPolygon& p = m_polygons[polygon];
+    return glm::vec3(m_origin.x + p.x0 * m_settings.cellSize, p.y, m_origin.z + p.z0 * m_settings.cellSize);
+}
+
+glm::vec3 NavMesh::GetPolygonMax(int polygon) const {
+    const NavPolygon& p = m_polygons[polygon];
+    return glm::vec3(m_origin.x + p.x1 * m_settings.cellSize, p.y, m_origin.z + p.z1 * m_settings.cellSize);
+}
+
+void NavMesh::BuildGraph() {
+    auto start = std::chrono::steady_clock::now();
+    m_stats.polygons = static_cast<int>(m_polygons.size());
+    for (int i = 0; i < m_stats.polygons; i++) {
+        m_polygons[i].center = (GetPolygonMin(i) + GetPolygonMax(i)) * 0.5f;
+    }
+
+    // 每列的多边形（计数排序）
+    m_columnStarts.assign(static_cast<size_t>(m_width) * m_depth + 1, 0);
+    for (const NavPolygon& polygon : m_polygons) {
+        for (int z = polygon.z0; z < polygon.z1; z++) {
+            for (int x = polygon.x0; x < polygon.x1; x++) {
+                m_columnStarts[static_cast<size_t>(z) * m_width + x + 1]++;
+            }
+        }
+    }
+    for (size_t i = 1; i < m_columnStarts.size(); i++) {
+        m_columnStarts[i] += m_columnStarts[i - 1];
+    }
+    m_columnPolygons.resize(m_columnStarts.back());
+    std::vector<uint32_t> cursor(m_columnStarts.begin(), m_columnStarts.end() - 1);
+    for (int i = 0; i < m_stats.polygons; i++) {
+        const NavPolygon& polygon = m_polygons[i];
+        for (int z = polygon.z0; z < polygon.z1; z++) {
+            for (int x = polygon.x0; x < polygon.x1; x++) {
+                m_columnPolygons[cursor[static_cast<size_t>(z) * m_width + x]++] = static_cast<uint32_t>(i);
+            }
+        }
+    }
+
+    BuildLinks();
+    BuildHierarchy();
+    m_stats.graphSeconds = secondsSince(start);
+}
+
+void NavMesh::BuildLinks() {
+    // 沿每条边看外面一排格子里的多边形，高度差在agentClimb以内的相连，共用的那段边是通道
+    struct Edge {
+        int polygon;
+        int side;
+        int lo, hi;
+    };
+    std::vector<Edge> edges;
+    m_links.clear();
+    const float cellSize = m_settings.cellSize;
+    for (int i = 0; i < static_cast<int>(m_polygons.size()); i++) {
+        NavPolygon& polygon = m_polygons[i];
+        edges.clear();
+        for (int side = 0; side < 4; side++) {
+            bool alongZ = side == 0 || side == 2;
+            int fixed = side == 0 ? polygon.x1 : side == 1 ? polygon.z1 : side == 2 ? polygon.x0 - 1 : polygon.z0 - 1;
+            int from = alongZ ? polygon.z0 : polygon.x0;
+            int to = alongZ ? polygon.z1 : polygon.x1;
+            for (int along = from; along < to; along++) {
+                int x = alongZ ? fixed : along;
+                int z = alongZ ? along : fixed;
+                if (x < 0 || x >= m_width || z < 0 || z >= m_depth) {
+                    continue;
+                }
+                size_t column = static_cast<size_t>(z) * m_width + x;
+                for (uint32_t k = m_columnStarts[column]; k < m_columnStarts[column + 1]; k++) {
+                    int other = static_cast<int>(m_columnPolygons[k]);
+                    if (std::fabs(m_polygons[other].y - polygon.y) > m_settings.agentClimb) {
+                        continue;
+                    }
+                    bool found = false;
+                    for (Edge& edge : edges) {
+                        if (edge.polygon == other && edge.side == side) {
+                            edge.lo = std::min(edge.lo, along);
+                            edge.hi = std::max(edge.hi, along);
+                            found = true;
+                        }
+                    }
+                    if (!found) {
+                        edges.push_back({other, side, along, along});
+                    }
+                }
+            }
+        }
+        polygon.firstLink = static_cast<int>(m_links.size());
+        polygon.linkCount = static_cast<int>(edges.size());
+        for (const Edge& edge : edges) {
+            const NavPolygon& other = m_polygons[edge.polygon];
+            float y = (polygon.y + other.y) * 0.5f;
+            float lo = (edge.side == 0 || edge.side == 2 ? m_origin.z : m_origin.x) + edge.lo * cellSize;
+            float hi = (edge.side == 0 || edge.side == 2 ? m_origin.z : m_origin.x) + (edge.hi + 1) * cellSize;
+            NavLink link;
+            link.polygon = edge.polygon;
+            if (edge.side == 0 || edge.side == 2) {
+                float x = m_origin.x + (edge.side == 0 ? polygon.x1 : polygon.x0) * cellSize;
+                link.a = glm::vec3(x, y, lo);
+                link.b = glm::vec3(x, y, hi);
+            } else {
+                float z = m_origin.z + (edge.side == 1 ? polygon.z1 : polygon.z0) * cellSize;
+                link.a = glm::vec3(lo, y, z);
+                link.b = glm::vec3(hi, y, z);
+            }
+            link.cost = glm::length(other.center - polygon.center);
+            m_links.push_back(link);
+        }
+    }
+    m_stats.links = static_cast<int>(m_links.size());
+}
+
+void NavMesh::BuildHierarchy() {
+    // 块的边界在tileCells的整数倍上，多边形不跨块，所以也不跨簇
+    const int clusterCells = std::max(1, m_settings.tileCells) * std::max(1, m_settings.clusterTiles);
+    m_clustersX = (m_width + clusterCells - 1) / clusterCells;
+    m_clusterCount = m_clustersX * ((m_depth + clusterCells - 1) / clusterCells);
+    std::vector<uint8_t> used(m_clusterCount, 0);
+    for (NavPolygon& polygon : m_polygons) {
+        polygon.cluster = polygon.x0 / clusterCells + polygon.z0 / clusterCells * m_clustersX;
+        used[polygon.cluster] = 1;
+    }
+    m_stats.clusters = static_cast<int>(std::count(used.begin(), used.end(), 1));
+
+    // 入口：和别的簇相连的多边形
+    const int polygonCount = static_cast<int>(m_polygons.size());
+    m_entranceOf.assign(polygonCount, -1);
+    m_entrances.clear();
+    for (int i = 0; i < polygonCount; i++) {
+        const NavPolygon& polygon = m_polygons[i];
+        for (int l = polygon.firstLink; l < polygon.firstLink + polygon.linkCount; l++) {
+            if (m_polygons[m_links[l].polygon].cluster != polygon.cluster) {
+                m_entranceOf[i] = static_cast<int>(m_entrances.size());
+                m_entrances.push_back(i);
+                break;
+            }
+        }
+    }
+    m_clusterEntranceStarts.assign(m_clusterCount + 1, 0);
+    for (int polygon : m_entrances) {
+        m_clusterEntranceStarts[m_polygons[polygon].cluster + 1]++;
+    }
+    for (int c = 0; c < m_clusterCount; c++) {
+        m_clusterEntranceStarts[c + 1] += m_clusterEntranceStarts[c];
+    }
+    m_clusterEntrances.resize(m_entrances.size());
+    std::vector<int> cursor(m_clusterEntranceStarts.begin(), m_clusterEntranceStarts.end() - 1);
+    for (int e = 0; e < static_cast<int>(m_entrances.size()); e++) {
+        m_clusterEntrances[cursor[m_polygons[m_entrances[e]].cluster]++] = e;
+    }
+
+    // 层次图的边：通到别的簇的入口（路径只有那一个多边形），同簇里能走到的其他入口（簇里的最短路）
+    m_abstractEdgeStarts.assign(1, 0);
+    m_abstractEdges.clear();
+    m_abstractPaths.clear();
+    NavSearchState state;
+    std::vector<int> path;
+    for (int e = 0; e < static_cast<int>(m_entrances.size()); e++) {
+        int polygon = m_entrances[e];
+        const NavPolygon& from = m_polygons[polygon];
+        for (int l = from.firstLink; l < from.firstLink + from.linkCount; l++) {
+            const NavLink& link = m_links[l];
+            if (m_polygons[link.polygon].cluster != from.cluster) {
+                m_abstractEdges.push_back({m_entranceOf[link.polygon], link.cost, static_cast<int>(m_abstractPaths.size()), 1});
+                m_abstractPaths.push_back(link.polygon);
+            }
+        }
+        Search(polygon, -1, from.cluster, state);
+        int count;
+        const int* entrances = GetClusterEntrances(from.cluster, count);
+        for (int i = 0; i < count; i++) {
+            int target = m_entrances[entrances[i]];
+            if (target == polygon || !state.Reached(target)) {
+                continue;
+            }
+            path.clear();
+            for (int p = target; p != polygon; p = state.parent[p]) {
+                path.push_back(p);
+            }
+            m_abstractEdges.push_back({entrances[i], state.cost[target], static_cast<int>(m_abstractPaths.size()),
+                                       static_cast<int>(path.size())});
+            m_abstractPaths.insert(m_abstractPaths.end(), path.rbegin(), path.rend());
+        }
+        m_abstractEdgeStarts.push_back(static_cast<int>(m_abstractEdges.size()));
+    }
+    m_stats.entrances = static_cast<int>(m_entrances.size());
+    m_stats.abstractEdges = static_cast<int>(m_abstractEdges.size());
+}
+
+const int* NavMesh::GetClusterEntrances(int cluster, int& count) const {
+    count = m_clusterEntranceStarts[cluster + 1] - m_clusterEntranceStarts[cluster];
+    return m_clusterEntrances.data() + m_clusterEntranceStarts[cluster];
+}
+
+const NavMesh::AbstractEdge* NavMesh::GetAbstractEdges(int entrance, int& count) const {
+    count = m_abstractEdgeStarts[entrance + 1] - m_abstractEdgeStarts[entrance];
+    return m_abstractEdges.data() + m_abstractEdgeStarts[entrance];
+}
+
+int NavMesh::FindPolygon(const glm::vec3& position) const {
+    int x = static_cast<int>(std::floor((position.x - m_origin.x) / m_settings.cellSize));
+    int z = static_cast<int>(std::floor((position.z - m_origin.z) / m_settings.cellSize));
+    if (x < 0 || x >= m_width || z < 0 || z >= m_depth) {
+        return -1;
+    }
+    size_t column = static_cast<size_t>(z) * m_width + x;
+    int best = -1;
+    for (uint32_t k = m_columnStarts[column]; k < m_columnStarts[column + 1]; k++) {
+        int polygon = static_cast<int>(m_columnPolygons[k]);
+        if (m_polygons[polygon].y <= position.y + m_settings.agentClimb &&
+            (best < 0 || m_polygons[polygon].y > m_polygons[best].y)) {
+            best = polygon;
+        }
+    }
+    return best;
+}
+
+int NavMesh::FindNearestPolygon(const glm::vec3& position, float searchRadius, glm::vec3& point) const {
+    int polygon = FindPolygon(position);
+    if (polygon >= 0) {
+        point = glm::vec3(position.x, m_polygons[polygon].y, position.z);
+        return polygon;
+    }
+    // 周围的列里的多边形，矩形里离得最近的点；高度和脚底差得太多的不算
+    int radius = static_cast<int>(std::ceil(searchRadius / m_settings.cellSize));
+    int cx = static_cast<int>(std::floor((position.x - m_origin.x) / m_settings.cellSize));
+    int cz = static_cast<int>(std::floor((position.z - m_origin.z) / m_settings.cellSize));
+    float bestDistance = searchRadius * searchRadius;
+    int best = -1;
+    for (int z = std::max(cz - radius, 0); z <= std::min(cz + radius, m_depth - 1); z++) {
+        for (int x = std::max(cx - radius, 0); x <= std::min(cx + radius, m_width - 1); x++) {
+            size_t column = static_cast<size_t>(z) * m_width + x;
+            for (uint32_t k = m_columnStarts[column]; k < m_columnStarts[column + 1]; k++) {
+                int candidate = static_cast<int>(m_columnPolygons[k]);
+                float y = m_polygons[candidate].y;
+                if (y > position.y + m_settings.agentClimb || y < position.y - m_settings.agentHeight) {
+                    continue;
+                }
+                glm::vec3 lo = GetPolygonMin(candidate);
+                glm::vec3 hi = GetPolygonMax(candidate);
+                glm::vec3 closest(std::min(std::max(position.x, lo.x), hi.x), y, std::min(std::max(position.z, lo.z), hi.z));
+                float dx = closest.x - position.x;
+                float dz = closest.z - position.z;
+                if (dx * dx + dz * dz <= bestDistance) {
+                    bestDistance = dx * dx + dz * dz;
+                    best = candidate;
+                    point = closest;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+int NavMesh::GetCluster(const glm::vec3& position) const {
+    int polygon = FindPolygon(position);
+    return polygon < 0 ? -1 : m_polygons[polygon].cluster;
+}
+
+bool NavMesh::Search(int start, int goal, int cluster, NavSearchState& state) const {
+    size_t count = m_polygons.size();
+    if (state.cost.size() < count) {
+        state.cost.resize(count);
+        state.parent.resize(count);
+        state.visited.assign(count, 0);
+        state.closed.resize(count);
+        state.generation = 0;
+    }
+    if (++state.generation == 0) {
+        std::fill(state.visited.begin(), state.visited.end(), 0);
+        state.generation = 1;
+    }
+    state.expanded = 0;
+    state.open.clear();
+    // 中心之间的直线距离不会超过实际的代价，A*得到的是最短的
+    auto heuristic = [&](int polygon) {
+        return goal < 0 ? 0.0f : glm::length(m_polygons[goal].center - m_polygons[polygon].center);
+    };
+    std::greater<std::pair<float, int>> compare;
+    state.cost[start] = 0.0f;
+    state.parent[start] = -1;
+    state.visited[start] = state.generation;
+    state.closed[start] = 0;
+    state.open.push_back(std::make_pair(heuristic(start), start));
+    while (!state.open.empty()) {
+        std::pop_heap(state.open.begin(), state.open.end(), compare);
+        int current = state.open.back().second;
+        state.open.pop_back();
+        if (state.closed[current]) {
+            continue;
+        }
+        state.closed[current] = 1;
+        state.expanded++;
+        if (current == goal) {
+            return true;
+        }
+        const NavPolygon& polygon = m_polygons[current];
+        for (int l = polygon.firstLink; l < polygon.firstLink + polygon.linkCount; l++) {
+            const NavLink& link = m_links[l];
+            int next = link.polygon;
+            if (cluster >= 0 && m_polygons[next].cluster != cluster) {
+                continue;
+            }
+            float cost = state.cost[current] + link.cost;
+            if (state.visited[next] != state.generation) {
+                state.visited[next] = state.generation;
+                state.closed[next] = 0;
+            } else if (state.closed[next] || cost >= state.cost[next]) {
+                continue;
+            }
+            state.cost[next] = cost;
+            state.parent[next] = current;
+            state.open.push_back(std::make_pair(cost + heuristic(next), next));
+            std::push_heap(state.open.begin(), state.open.end(), compare);
+        }
+    }
+    return goal < 0;
+}
+
+// 文件（小端序）：标识"NAV1"、NavMeshSettings（6个f32、2个u32）、原点3个f32、格子数2个u32、
+// 统计（体素列、段、格子、收缩后的格子、区域各u32）、多边形数u32、每个多边形x0 z0 x1 z1 u32、高度f32、区域u32
+bool NavMesh::Save(const std::string& path) const {
+    if (m_polygons.empty()) {
+        return false;
+    }
+    size_t size = 96 + m_polygons.size() * 24;
+    std::vector<uint8_t> data(size);
+    ByteWriter writer(data.data(), static_cast<int>(size));
+    writer.WriteU32(NAV_FILE_ID);
+    writer.WriteFloat(m_settings.cellSize);
+    writer.WriteFloat(m_settings.cellHeight);
+    writer.WriteFloat(m_settings.agentHeight);
+    writer.WriteFloat(m_settings.agentRadius);
+    writer.WriteFloat(m_settings.agentClimb);
+    writer.WriteFloat(m_settings.maxSlope);
+    writer.WriteU32(static_cast<uint32_t>(m_settings.tileCells));
+    writer.WriteU32(static_cast<uint32_t>(m_settings.clusterTiles));
+    for (int i = 0; i < 3; i++) {
+        writer.WriteFloat(m_origin[i]);
+    }
+    writer.WriteU32(static_cast<uint32_t>(m_width));
+    writer.WriteU32(static_cast<uint32_t>(m_depth));
+    writer.WriteU32(static_cast<uint32_t>(m_stats.columns));
+    writer.WriteU32(static_cast<uint32_t>(m_stats.spans));
+    writer.WriteU32(static_cast<uint32_t>(m_stats.walkableCells));
+    writer.WriteU32(static_cast<uint32_t>(m_stats.cells));
+    writer.WriteU32(static_cast<uint32_t>(m_stats.regions));
+    writer.WriteU32(static_cast<uint32_t>(m_polygons.size()));
+    for (const NavPolygon& polygon : m_polygons) {
+        writer.WriteU32(static_cast<uint32_t>(polygon.x0));
+        writer.WriteU32(static_cast<uint32_t>(polygon.z0));
+        writer.WriteU32(static_cast<uint32_t>(polygon.x1));
+        writer.WriteU32(static_cast<uint32_t>(polygon.z1));
+        writer.WriteFloat(polygon.y);
+        writer.WriteU32(static_cast<uint32_t>(polygon.region));
+    }
+    if (writer.Overflowed()) {
+        return false;
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, writer.GetSize(), file) == static_cast<size_t>(writer.GetSize());
+    return fclose(file) == 0 && ok;
+}
+
+bool NavMesh::Load(const std::string& path) {
+    Clear();
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[65536];
+    size_t count;
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + count);
+    }
+    fclose(file);
+
+    ByteReader reader(data.data(), static_cast<int>(data.size()));
+    if (reader.ReadU32() != NAV_FILE_ID) {
+        return false;
+    }
+    m_settings.cellSize = reader.ReadFloat();
+    m_settings.cellHeight = reader.ReadFloat();
+    m_settings.agentHeight = reader.ReadFloat();
+    m_settings.agentRadius = reader.ReadFloat();
+    m_settings.agentClimb = reader.ReadFloat();
+    m_settings.maxSlope = reader.ReadFloat();
+    m_settings.tileCells = static_cast<int>(reader.ReadU32());
+    m_settings.clusterTiles = static_cast<int>(reader.ReadU32());
+    for (int i = 0; i < 3; i++) {
+        m_origin[i] = reader.ReadFloat();
+    }
+    m_width = static_cast<int>(reader.ReadU32());
+    m_depth = static_cast<int>(reader.ReadU32());
+    m_stats.columns = static_cast<int>(reader.ReadU32());
+    m_stats.spans = static_cast<int>(reader.ReadU32());
+    m_stats.walkableCells = static_cast<int>(reader.ReadU32());
+    m_stats.cells = static_cast<int>(reader.ReadU32());
+    m_stats.regions = static_cast<int>(reader.ReadU32());
+    uint32_t polygonCount = reader.ReadU32();
+    // 每个多边形24字节，数量不可能超过剩下的数据
+    if (reader.Failed() || !(m_settings.cellSize > 0.0f) || m_settings.tileCells < 1 || m_settings.clusterTiles < 1 ||
+        m_width < 1 || m_width > 65536 || m_depth < 1 || m_depth > 65536 || polygonCount == 0 ||
+        polygonCount > static_cast<uint32_t>(reader.GetRemaining()) / 24) {
+        Clear();
+        return false;
+    }
+    m_polygons.resize(polygonCount);
+    for (NavPolygon& polygon : m_polygons) {
+        polygon = {};
+        polygon.x0 = static_cast<int>(reader.ReadU32());
+        polygon.z0 = static_cast<int>(reader.ReadU32());
+        polygon.x1 = static_cast<int>(reader.ReadU32());
+        polygon.z1 = static_cast<int>(reader.ReadU32());
+        polygon.y = reader.ReadFloat();
+        polygon.region = static_cast<int>(reader.ReadU32());
+        if (polygon.x0 < 0 || polygon.x1 <= polygon.x0 || polygon.x1 > m_width || polygon.z0 < 0 ||
+            polygon.z1 <= polygon.z0 || polygon.z1 > m_depth) {
+            Clear();
+            return false;
+        }
+    }
+    if (reader.Failed()) {
+        Clear();
+        return false;
+    }
+    BuildGraph();
+    return true;
+}
+
+NavPathfinder::NavPathfinder(const NavMesh& mesh, int cacheSize)
+    : m_mesh(mesh), m_cacheEnabled(true), m_hierarchyThreshold(-1), m_abstractGeneration(0) {
+    m_cache.resize(std::max(cacheSize, 1));
+    ClearCache();
+}
+
+void NavPathfinder::ClearCache() {
+    for (CacheEntry& entry : m_cache) {
+        entry.start = -1;
+        entry.goal = -1;
+    }
+}
+
+bool NavPathfinder::FindPath(const glm::vec3& start, const glm::vec3& goal, std::vector<glm::vec3>& path) {
+    auto begin = std::chrono::steady_clock::now();
+    m_stats.queries++;
+    glm::vec3 startPoint, goalPoint;
+    int startPolygon = m_mesh.FindNearestPolygon(start, SEARCH_RADIUS, startPoint);
+    int goalPolygon = m_mesh.FindNearestPolygon(goal, SEARCH_RADIUS, goalPoint);
+    bool found = startPolygon >= 0 && goalPolygon >= 0 && FindCorridor(startPolygon, goalPolygon, m_corridor);
+    if (found) {
+        StringPull(startPoint, goalPoint, m_corridor, path);
+    } else {
+        path.clear();
+        m_stats.failures++;
+    }
+    m_stats.seconds += secondsSince(begin);
+    return found;
+}
+
+bool NavPathfinder::FindCorridor(int startPolygon, int goalPolygon, std::vector<int>& corridor) {
+    const NavPolygon& start = m_mesh.GetPolygon(startPolygon);
+    const NavPolygon& goal = m_mesh.GetPolygon(goalPolygon);
+    if (start.region != goal.region) {
+        return false;
+    }
+    if (startPolygon == goalPolygon) {
+        corridor.assign(1, startPolygon);
+        return true;
+    }
+    CacheEntry& entry = m_cache[(static_cast<uint32_t>(startPolygon) * 73856093u ^ static_cast<uint32_t>(goalPolygon) * 19349663u) %
+                                m_cache.size()];
+    if (m_cacheEnabled && entry.start == startPolygon && entry.goal == goalPolygon) {
+        corridor = entry.corridor;
+        m_stats.cacheHits++;
+        return true;
+    }
+
+    // 簇之间的切比雪夫距离
+    int clustersX = m_mesh.GetClustersX();
+    int clusterDistance = std::max(std::abs(start.cluster % clustersX - goal.cluster % clustersX),
+                                   std::abs(start.cluster / clustersX - goal.cluster / clustersX));
+    bool found;
+    if (m_hierarchyThreshold < 0 || clusterDistance == 0 || clusterDistance <= m_hierarchyThreshold ||
+        m_mesh.GetEntranceCount() == 0) {
+        found = m_mesh.Search(startPolygon, goalPolygon, -1, m_search);
+        m_stats.expanded += m_search.expanded;
+        if (found) {
+            corridor.clear();
+            for (int p = goalPolygon; p >= 0; p = m_search.parent[p]) {
+                corridor.push_back(p);
+            }
+            std::reverse(corridor.begin(), corridor.end());
+        }
+    } else {
+        m_stats.hierarchical++;
+        found = FindHierarchical(startPolygon, goalPolygon, corridor);
+    }
+    if (found && m_cacheEnabled) {
+        entry.start = startPolygon;
+        entry.goal = goalPolygon;
+        entry.corridor = corridor;
+    }
+    return found;
+}
+
+bool NavPathfinder::FindHierarchical(int startPolygon, int goalPolygon, std::vector<int>& corridor) {
+    const NavPolygon& start = m_mesh.GetPolygon(startPolygon);
+    const NavPolygon& goal = m_mesh.GetPolygon(goalPolygon);
+    // 起点和终点各自在簇里到所有多边形的代价，连到簇的入口上
+    m_mesh.Search(startPolygon, -1, start.cluster, m_search);
+    m_mesh.Search(goalPolygon, -1, goal.cluster, m_goalSearch);
+    m_stats.expanded += m_search.expanded + m_goalSearch.expanded;
+
+    const int entranceCount = m_mesh.GetEntranceCount();
+    const int goalNode = entranceCount;
+    size_t nodes = static_cast<size_t>(entranceCount) + 1;
+    if (m_abstractCost.size() < nodes) {
+        m_abstractCost.resize(nodes);
+        m_abstractParent.resize(nodes);
+        m_abstractParentEdge.resize(nodes);
+        m_abstractVisited.assign(nodes, 0);
+        m_abstractClosed.resize(nodes);
+        m_abstractGeneration = 0;
+    }
+    if (++m_abstractGeneration == 0) {
+        std::fill(m_abstractVisited.begin(), m_abstractVisited.end(), 0);
+        m_abstractGeneration = 1;
+    }
+    m_abstractOpen.clear();
+    std::greater<std::pair<float, int>> compare;
+    auto heuristic = [&](int node) {
+        return node == goalNode ? 0.0f
+                                : glm::length(goal.center - m_mesh.GetPolygon(m_mesh.GetEntrancePolygon(node)).center);
+    };
+    auto relax = [&](int node, float cost, int parent, const NavMesh::AbstractEdge* edge) {
+        if (m_abstractVisited[node] != m_abstractGeneration) {
+            m_abstractVisited[node] = m_abstractGeneration;
+            m_abstractClosed[node] = 0;
+        } else if (m_abstractClosed[node] || cost >= m_abstractCost[node]) {
+            return;
+        }
+        m_abstractCost[node] = cost;
+        m_abstractParent[node] = parent;
+        m_abstractParentEdge[node] = edge;
+        m_abstractOpen.push_back(std::make_pair(cost + heuristic(node), node));
+        std::push_heap(m_abstractOpen.begin(), m_abstractOpen.end(), compare);
+    };
+
+    int count;
+    const int* entrances = m_mesh.GetClusterEntrances(start.cluster, count);
+    for (int i = 0; i < count; i++) {
+        int polygon = m_mesh.GetEntrancePolygon(entrances[i]);
+        if (m_search.Reached(polygon)) {
+            relax(entrances[i], m_search.cost[polygon], -1, nullptr);
+        }
+    }
+    bool found = false;
+    while (!m_abstractOpen.empty()) {
+        std::pop_heap(m_abstractOpen.begin(), m_abstractOpen.end(), compare);
+        int current = m_abstractOpen.back().second;
+        m_abstractOpen.pop_back();
+        if (m_abstractClosed[current]) {
+            continue;
+        }
+        m_abstractClosed[current] = 1;
+        m_stats.expanded++;
+        if (current == goalNode) {
+            found = true;
+            break;
+        }
+        int polygon = m_mesh.GetEntrancePolygon(current);
+        if (m_mesh.GetPolygon(polygon).cluster == goal.cluster && m_goalSearch.Reached(polygon)) {
+            relax(goalNode, m_abstractCost[current] + m_goalSearch.cost[polygon], current, nullptr);
+        }
+        int edgeCount;
+        const NavMesh::AbstractEdge* edges = m_mesh.GetAbstractEdges(current, edgeCount);
+        for (int i = 0; i < edgeCount; i++) {
+            relax(edges[i].to, m_abstractCost[current] + edges[i].cost, current, &edges[i]);
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    // 拼起来：起点到第一个入口（起点的搜索倒着取）、层次图的每条边存好的路径、最后一个入口到终点（终点的搜索顺着取）
+    int last = m_abstractParent[goalNode];
+    int first = last;
+    while (m_abstractParent[first] >= 0) {
+        first = m_abstractParent[first];
+    }
+    corridor.clear();
+    for (int p = m_mesh.GetEntrancePolygon(first); p >= 0; p = m_search.parent[p]) {
+        corridor.push_back(p);
+    }
+    std::reverse(corridor.begin(), corridor.end());
+    size_t middle = corridor.size();
+    for (int node = last; m_abstractParent[node] >= 0; node = m_abstractParent[node]) {
+        const NavMesh::AbstractEdge* edge = m_abstractParentEdge[node];
+        const int* path = m_mesh.GetAbstractPath(*edge);
+        // 倒着收集，最后整段翻过来
+        for (int i = edge->pathLength - 1; i >= 0; i--) {
+            corridor.push_back(path[i]);
+        }
+    }
+    std::reverse(corridor.begin() + middle, corridor.end());
+    for (int p = m_goalSearch.parent[m_mesh.GetEntrancePolygon(last)]; p >= 0; p = m_goalSearch.parent[p]) {
+        corridor.push_back(p);
+    }
+    return true;
+}
+
+// 漏斗算法：沿着通道依次收紧左右两条边，一边越过另一边时那一边的端点是拐点，从它重新开始
+void NavPathfinder::StringPull(const glm::vec3& start, const glm::vec3& goal, const std::vector<int>& corridor,
+                               std::vector<glm::vec3>& path) const {
+    path.clear();
+    path.push_back(start);
+    std::vector<std::pair<glm::vec3, glm::vec3>> portals;   // 左、右
+    portals.reserve(corridor.size() + 1);
+    portals.push_back(std::make_pair(start, start));
+    for (size_t i = 0; i + 1 < corridor.size(); i++) {
+        const NavPolygon& from = m_mesh.GetPolygon(corridor[i]);
+        const NavPolygon& to = m_mesh.GetPolygon(corridor[i + 1]);
+        for (int l = from.firstLink; l < from.firstLink + from.linkCount; l++) {
+            const NavLink& link = m_mesh.GetLink(l);
+            if (link.polygon == corridor[i + 1]) {
+                bool aLeft = cross2(from.center, to.center, link.a) > cross2(from.center, to.center, link.b);
+                portals.push_back(aLeft ? std::make_pair(link.a, link.b) : std::make_pair(link.b, link.a));
+                break;
+            }
+        }
+    }
+    portals.push_back(std::make_pair(goal, goal));
+
+    glm::vec3 apex = start;
+    glm::vec3 left = start;
+    glm::vec3 right = start;
+    int apexIndex = 0;
+    int leftIndex = 0;
+    int rightIndex = 0;
+    for (int i = 1; i < static_cast<int>(portals.size()); i++) {
+        const glm::vec3& newLeft = portals[i].first;
+        const glm::vec3& newRight = portals[i].second;
+        // 右边往里收
+        if (cross2(apex, right, newRight) >= 0.0f) {
+            if (apex == right || cross2(apex, left, newRight) < 0.0f) {
+                right = newRight;
+                rightIndex = i;
+            } else {
+                path.push_back(left);
+                apex = left;
+                apexIndex = leftIndex;
+                right = apex;
+                rightIndex = apexIndex;
+                i = apexIndex;
+                continue;
+            }
+        }
+        // 左边往里收
+        if (cross2(apex, left, newLeft) <= 0.0f) {
+            if (apex == left || cross2(apex, right, newLeft) > 0.0f) {
+                left = newLeft;
+                leftIndex = i;
+            } else {
+                path.push_back(right);
+                apex = right;
+                apexIndex = rightIndex;
+                left = apex;
+                leftIndex = apexIndex;
+                i = apexIndex;
+                continue;
+            }
+        }
+    }
+    if (!(path.back() == goal)) {
+        path.push_back(goal);
+    }
+}
@@ -0,0 +1,255 @@
+#include "NetIoThread.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace {
+
+// 没有要发的包、也不在收包间隔里时poll最多等这么久（毫秒），只是为了不永远睡下去
+const int IDLE_POLL_MS = 100;
+
+double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t roundUpPowerOfTwo(int value) {
+    uint32_t result = 1;
+    while (result < static_cast<uint32_t>(std::max(value, 1))) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+PacketQueue::PacketQueue(int capacity) : m_head(0), m_tail(0) {
+    m_items.resize(roundUpPowerOfTwo(capacity));
+    m_mask = static_cast<uint32_t>(m_items.size()) - 1;
+}
+
+bool PacketQueue::Push(int packet) {
+    uint32_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) > m_mask) {
+        return false;
+    }
+    m_items[tail & m_mask] = packet;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool PacketQueue::Pop(int& packet) {
+    uint32_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    packet = m_items[head & m_mask];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool PacketQueue::Empty() const {
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+}
+
+NetIoThread::NetIoThread(const NetIoSettings& settings)
+    : m_settings(settings), m_socket(nullptr), m_running(false), m_wakeRead(-1), m_wakeWrite(-1),
+      m_receivePool(std::max(settings.receivePackets, UdpSocket::MAX_BATCH)),
+      m_sendPool(std::max(settings.sendPackets, 1)),
+      m_receiveFree(static_cast<int>(m_receivePool.size())), m_received(static_cast<int>(m_receivePool.size())),
+      m_sendFree(static_cast<int>(m_sendPool.size())), m_sending(static_cast<int>(m_sendPool.size())),
+      m_pendingFlush(false) {
+    // 线程还没启动，两边的队列都可以在这里填
+    for (int i = 0; i < static_cast<int>(m_receivePool.size()); i++) {
+        m_receiveFree.Push(i);
+    }
+    for (int i = 0; i < static_cast<int>(m_sendPool.size()); i++) {
+        m_sendFree.Push(i);
+    }
+    m_sendSpare.reserve(m_sendPool.size());
+    m_receiveSpare.reserve(UdpSocket::MAX_BATCH);
+}
+
+NetIoThread::~NetIoThread() {
+    Stop();
+}
+
+bool NetIoThread::Start(UdpSocket* socket) {
+    Stop();
+    int pipes[2];
+    if (!socket || !socket->IsOpen() || pipe(pipes) != 0) {
+        return false;
+    }
+    m_wakeRead = pipes[0];
+    m_wakeWrite = pipes[1];
+    fcntl(m_wakeRead, F_SETFL, fcntl(m_wakeRead, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(m_wakeWrite, F_SETFL, fcntl(m_wakeWrite, F_GETFL, 0) | O_NONBLOCK);
+    m_socket = socket;
+    m_running = true;
+    m_thread = std::thread(&NetIoThread::Run, this);
+    return true;
+}
+
+void NetIoThread::Stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_running.store(false, std::memory_order_release);
+    uint8_t wake = 0;
+    ssize_t written = write(m_wakeWrite, &wake, 1);
+    (void)written;
+    m_thread.join();
+    close(m_wakeRead);
+    close(m_wakeWrite);
+    m_wakeRead = -1;
+    m_wakeWrite = -1;
+    m_socket = nullptr;
+    m_pendingFlush = false;
+}
+
+NetPacket* NetIoThread::Receive() {
+    int packet;
+    return m_received.Pop(packet) ? &m_receivePool[packet] : nullptr;
+}
+
+void NetIoThread::Release(NetPacket* packet) {
+    m_receiveFree.Push(static_cast<int>(packet - m_receivePool.data()));
+}
+
+NetPacket* NetIoThread::AllocateSend() {
+    int packet;
+    if (!m_sendSpare.empty()) {
+        packet = m_sendSpare.back();
+        m_sendSpare.pop_back();
+    } else if (!m_sendFree.Pop(packet)) {
+        m_stats.sendPoolFull++;
+        return nullptr;
+    }
+    return &m_sendPool[packet];
+}
+
+void NetIoThread::Send(NetPacket* packet) {
+    // 队列和池一样大，不会满
+    m_sending.Push(static_cast<int>(packet - m_sendPool.data()));
+    m_pendingFlush = true;
+}
+
+void NetIoThread::CancelSend(NetPacket* packet) {
+    m_sendSpare.push_back(static_cast<int>(packet - m_sendPool.data()));
+}
+
+void NetIoThread::Flush() {
+    if (!m_pendingFlush || !m_thread.joinable()) {
+        return;
+    }
+    // 管道满时I/O线程反正会醒
+    uint8_t wake = 0;
+    ssize_t written = write(m_wakeWrite, &wake, 1);
+    (void)written;
+    m_pendingFlush = false;
+    m_stats.flushes++;
+}
+
+void NetIoThread::Run() {
+    double nextReceive = 0.0;
+    while (true) {
+        // Stop之前Send的包都在队列里了，发完再退出
+        bool running = m_running.load(std::memory_order_acquire);
+        SendAll();
+        if (!running) {
+            break;
+        }
+        double now = nowSeconds();
+        bool canReceive = now >= nextReceive;
+        pollfd fds[2];
+        fds[0].fd = m_wakeRead;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = m_socket->GetHandle();
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        int timeout = canReceive ? IDLE_POLL_MS : std::max(1, static_cast<int>(std::ceil((nextReceive - now) * 1000.0)));
+        int ready = poll(fds, canReceive ? 2 : 1, timeout);
+        m_stats.wakeups++;
+        if (ready <= 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            uint8_t drain[64];
+            while (read(m_wakeRead, drain, sizeof(drain)) > 0) {
+            }
+        }
+        if (canReceive && (fds[1].revents & POLLIN)) {
+            ReceiveAll();
+            nextReceive = nowSeconds() + m_settings.receiveInterval;
+        }
+    }
+}
+
+void NetIoThread::ReceiveAll() {
+    NetDatagram datagrams[UdpSocket::MAX_BATCH];
+    int packets[UdpSocket::MAX_BATCH];
+    while (true) {
+        int count = 0;
+        while (count < UdpSocket::MAX_BATCH) {
+            if (!m_receiveSpare.empty()) {
+                packets[count] = m_receiveSpare.back();
+                m_receiveSpare.pop_back();
+            } else if (!m_receiveFree.Pop(packets[count])) {
+                break;
+            }
+            NetPacket& packet = m_receivePool[packets[count]];
+            datagrams[count].data = packet.data;
+            datagrams[count].capacity = NET_MAX_PACKET;
+            count++;
+        }
+        if (count == 0) {
+            m_stats.receivePoolFull++;
+            return;
+        }
+        int received = std::max(m_socket->ReceiveBatch(datagrams, count), 0);
+        m_stats.receiveCalls++;
+        for (int i = 0; i < received; i++) {
+            NetPacket& packet = m_receivePool[packets[i]];
+            packet.address = datagrams[i].address;
+            packet.size = datagrams[i].size;
+            m_received.Push(packets[i]);
+        }
+        m_stats.packetsIn += received;
+        // 没用上的编号I/O线程自己留着（它不能往m_receiveFree里放）
+        for (int i = received; i < count; i++) {
+            m_receiveSpare.push_back(packets[i]);
+        }
+        if (received < count) {
+            return;
+        }
+    }
+}
+
+void NetIoThread::SendAll() {
+    NetDatagram datagrams[UdpSocket::MAX_BATCH];
+    int packets[UdpSocket::MAX_BATCH];
+    while (true) {
+        int count = 0;
+        while (count < UdpSocket::MAX_BATCH && m_sending.Pop(packets[count])) {
+            NetPacket& packet = m_sendPool[packets[count]];
+            datagrams[count].address = packet.address;
+            datagrams[count].data = packet.data;
+            datagrams[count].size = packet.size;
+            count++;
+        }
+        if (count == 0) {
+            return;
+        }
+        // 发不出去的（套接字缓冲区满）和以前逐个发时一样丢掉
+        int sent = std::max(m_socket->SendBatch(datagrams, count), 0);
+        m_stats.sendCalls++;
+        m_stats.packetsOut += sent;
+        m_stats.sendFailures += count - sent;
+        for (int i = 0; i < count; i++) {
+            m_sendFree.Push(packets[i]);
+        }
+    }
+}
@@ -0,0 +1,142 @@
+#include "NetProtocol.h"
+#include <cstring>
+
+void ByteWriter::Write(const void* data, int size) {
+    if (m_overflow || m_size + size > m_capacity) {
+        m_overflow = true;
+        return;
+    }
+    memcpy(m_data + m_size, data, static_cast<size_t>(size));
+    m_size += size;
+}
+
+void ByteWriter::WriteU16(uint16_t value) {
+    uint8_t bytes[2] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)};
+    Write(bytes, 2);
+}
+
+void ByteWriter::WriteU32(uint32_t value) {
+    uint8_t bytes[4] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+                        static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+    Write(bytes, 4);
+}
+
+void ByteWriter::WriteFloat(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    WriteU32(bits);
+}
+
+void ByteReader::Read(void* data, int size) {
+    if (m_failed || m_offset + size > m_size) {
+        m_failed = true;
+        memset(data, 0, static_cast<size_t>(size));
+        return;
+    }
+    memcpy(data, m_data + m_offset, static_cast<size_t>(size));
+    m_offset += size;
+}
+
+uint8_t ByteReader::ReadU8() {
+    uint8_t value;
+    Read(&value, 1);
+    return value;
+}
+
+uint16_t ByteReader::ReadU16() {
+    uint8_t bytes[2];
+    Read(bytes, 2);
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t ByteReader::ReadU32() {
+    uint8_t bytes[4];
+    Read(bytes, 4);
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+float ByteReader::ReadFloat() {
+    uint32_t bits = ReadU32();
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void WriteCommand(ByteWriter& writer, const PlayerCommand& command) {
+    writer.WriteU32(static_cast<uint32_t>(command.tick));
+    writer.WriteU16(command.yaw);
+    writer.WriteU16(static_cast<uint16_t>(command.pitch));
+    writer.WriteU8(static_cast<uint8_t>(command.forward));
+    writer.WriteU8(static_cast<uint8_t>(command.side));
+    writer.WriteU8(command.buttons);
+}
+
+PlayerCommand ReadCommand(ByteReader& reader) {
+    PlayerCommand command;
+    command.tick = static_cast<int>(reader.ReadU32());
+    command.yaw = reader.ReadU16();
+    command.pitch = static_cast<int16_t>(reader.ReadU16());
+    command.forward = static_cast<int8_t>(reader.ReadU8());
+    command.side = static_cast<int8_t>(reader.ReadU8());
+    command.buttons = reader.ReadU8();
+    return command;
+}
+
+void WriteMoveState(ByteWriter& writer, const PlayerState& state) {
+    for (int axis = 0; axis < 3; axis++) {
+        writer.WriteFloat(state.position[axis]);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        writer.WriteFloat(state.velocity[axis]);
+    }
+    writer.WriteFloat(state.duckAmount);
+    writer.WriteU8(state.onGround);
+    writer.WriteU8(state.previousButtons);
+}
+
+PlayerState ReadMoveState(ByteReader& reader) {
+    PlayerState state;
+    for (int axis = 0; axis < 3; axis++) {
+        state.position[axis] = reader.ReadFloat();
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        state.velocity[axis] = reader.ReadFloat();
+    }
+    state.duckAmount = reader.ReadFloat();
+    state.onGround = reader.ReadU8();
+    state.previousButtons = reader.ReadU8();
+    return state;
+}
+
+void WritePlayerState(ByteWriter& writer, const NetPlayerState& state) {
+    writer.WriteU8(state.slot);
+    writer.WriteU8(state.flags);
+    writer.WriteU8(state.health);
+    writer.WriteU8(state.duck);
+    writer.WriteU16(state.yaw);
+    writer.WriteU16(static_cast<uint16_t>(state.pitch));
+    for (int axis = 0; axis < 3; axis++) {
+        writer.WriteFloat(state.position[axis]);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        writer.WriteFloat(state.velocity[axis]);
+    }
+}
+
+NetPlayerState ReadPlayerState(ByteReader& reader) {
+    NetPlayerState state;
+    state.slot = reader.ReadU8();
+    state.flags = reader.ReadU8();
+    state.health = reader.ReadU8();
+    state.duck = reader.ReadU8();
+    state.yaw = reader.ReadU16();
+    state.pitch = static_cast<int16_t>(reader.ReadU16());
+    for (int axis = 0; axis < 3; axis++) {
+        state.position[axis] = reader.ReadFloat();
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        state.velocity[axis] = reader.ReadFloat();
+    }
+    return state;
+}
@@ -0,0 +1,192 @@
+#include "NetSocket.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+sockaddr_in toSockaddr(const NetAddress& address) {
+    sockaddr_in result;
+    memset(&result, 0, sizeof(result));
+    result.sin_family = AF_INET;
+    result.sin_addr.s_addr = htonl(address.ip);
+    result.sin_port = htons(address.port);
+    return result;
+}
+
+} // namespace
+
+UdpSocket::UdpSocket() : m_socket(-1), m_port(0) {
+}
+
+UdpSocket::~UdpSocket() {
+    Close();
+}
+
+bool UdpSocket::Open(uint16_t port, bool loopbackOnly) {
+    Close();
+    m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (m_socket < 0) {
+        return false;
+    }
+    NetAddress local = {loopbackOnly ? 0x7F000001u : INADDR_ANY, port};
+    sockaddr_in address = toSockaddr(local);
+    if (bind(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        fcntl(m_socket, F_SETFL, fcntl(m_socket, F_GETFL, 0) | O_NONBLOCK) != 0) {
+        Close();
+        return false;
+    }
+    socklen_t length = sizeof(address);
+    getsockname(m_socket, reinterpret_cast<sockaddr*>(&address), &length);
+    m_port = ntohs(address.sin_port);
+    return true;
+}
+
+void UdpSocket::Close() {
+    if (m_socket >= 0) {
+        close(m_socket);
+    }
+    m_socket = -1;
+    m_port = 0;
+}
+
+void UdpSocket::SetBufferSize(int bytes) {
+    if (m_socket >= 0) {
+        setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+        setsockopt(m_socket, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+    }
+}
+
+int UdpSocket::SendTo(const void* data, int size, const NetAddress& address) {
+    sockaddr_in target = toSockaddr(address);
+    ssize_t sent = sendto(m_socket, data, static_cast<size_t>(size), 0, reinterpret_cast<sockaddr*>(&target),
+                          sizeof(target));
+    if (sent < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    return static_cast<int>(sent);
+}
+
+#if defined(__linux__)
+
+int UdpSocket::SendBatch(const NetDatagram* datagrams, int count) {
+    count = std::min(count, MAX_BATCH);
+    mmsghdr messages[MAX_BATCH];
+    iovec vectors[MAX_BATCH];
+    sockaddr_in targets[MAX_BATCH];
+    for (int i = 0; i < count; i++) {
+        targets[i] = toSockaddr(datagrams[i].address);
+        vectors[i].iov_base = datagrams[i].data;
+        vectors[i].iov_len = static_cast<size_t>(datagrams[i].size);
+        memset(&messages[i], 0, sizeof(messages[i]));
+        messages[i].msg_hdr.msg_name = &targets[i];
+        messages[i].msg_hdr.msg_namelen = sizeof(targets[i]);
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    int sent = sendmmsg(m_socket, messages, static_cast<unsigned int>(count), 0);
+    if (sent < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    return sent;
+}
+
+int UdpSocket::ReceiveBatch(NetDatagram* datagrams, int count) {
+    count = std::min(count, MAX_BATCH);
+    mmsghdr messages[MAX_BATCH];
+    iovec vectors[MAX_BATCH];
+    sockaddr_in sources[MAX_BATCH];
+    for (int i = 0; i < count; i++) {
+        vectors[i].iov_base = datagrams[i].data;
+        vectors[i].iov_len = static_cast<size_t>(datagrams[i].capacity);
+        memset(&messages[i], 0, sizeof(messages[i]));
+        messages[i].msg_hdr.msg_name = &sources[i];
+        messages[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    int received = recvmmsg(m_socket, messages, static_cast<unsigned int>(count), MSG_DONTWAIT, nullptr);
+    if (received < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    for (int i = 0; i < received; i++) {
+        datagrams[i].address.ip = ntohl(sources[i].sin_addr.s_addr);
+        datagrams[i].address.port = ntohs(sources[i].sin_port);
+        datagrams[i].size = static_cast<int>(messages[i].msg_len);
+    }
+    return received;
+}
+
+#else
+
+int UdpSocket::SendBatch(const NetDatagram* datagrams, int count) {
+    count = std::min(count, MAX_BATCH);
+    for (int i = 0; i < count; i++) {
+        int sent = SendTo(datagrams[i].data, datagrams[i].size, datagrams[i].address);
+        if (sent <= 0) {
+            return i > 0 ? i : sent;
+        }
+    }
+    return count;
+}
+
+int UdpSocket::ReceiveBatch(NetDatagram* datagrams, int count) {
+    count = std::min(count, MAX_BATCH);
+    for (int i = 0; i < count; i++) {
+        int received = ReceiveFrom(datagrams[i].data, datagrams[i].capacity, datagrams[i].address);
+        if (received <= 0) {
+            return i > 0 ? i : received;
+        }
+        datagrams[i].size = received;
+    }
+    return count;
+}
+
+#endif
+
+int UdpSocket::ReceiveFrom(void* buffer, int capacity, NetAddress& address) {
+    sockaddr_in source;
+    socklen_t length = sizeof(source);
+    ssize_t received = recvfrom(m_socket, buffer, static_cast<size_t>(capacity), 0,
+                                reinterpret_cast<sockaddr*>(&source), &length);
+    if (received < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    address.ip = ntohl(source.sin_addr.s_addr);
+    address.port = ntohs(source.sin_port);
+    return static_cast<int>(received);
+}
+
+bool ParseNetAddress(const char* text, NetAddress& address) {
+    const char* colon = strrchr(text, ':');
+    address.ip = 0x7F000001u;
+    if (colon) {
+        char host[64];
+        size_t length = static_cast<size_t>(colon - text);
+        if (length >= sizeof(host)) {
+            return false;
+        }
+        memcpy(host, text, length);
+        host[length] = '\0';
+        in_addr parsed;
+        if (strcmp(host, "localhost") != 0) {
+            if (inet_pton(AF_INET, host, &parsed) != 1) {
+                return false;
+            }
+            address.ip = ntohl(parsed.s_addr);
+        }
+        text = colon + 1;
+    }
+    int port = atoi(text);
+    if (port <= 0 || port > 65535) {
+        return false;
+    }
+    address.port = static_cast<uint16_t>(port);
+    return true;
+}
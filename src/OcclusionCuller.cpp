@@ -0,0 +1,319 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int TILE_SIZE = 8;
+
+// 近平面附近的w下限，避免除零
+const float MIN_CLIP_W = 1e-4f;
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+    : m_jobs(nullptr), m_viewProjection(1.0f) {
+    // 宽高取整到块大小，保证每行可以按4像素对齐处理
+    m_width = std::max((width + TILE_SIZE - 1) / TILE_SIZE, 1) * TILE_SIZE;
+    m_height = std::max((height + TILE_SIZE - 1) / TILE_SIZE, 1) * TILE_SIZE;
+    m_tilesX = m_width / TILE_SIZE;
+    m_tilesY = m_height / TILE_SIZE;
+
+    m_depth.assign(static_cast<size_t>(m_width) * m_height, 1.0f);
+    m_tileMax.assign(static_cast<size_t>(m_tilesX) * m_tilesY, 1.0f);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+}
+
+void OcclusionCuller::ClearOccluders() {
+    m_occluders.clear();
+}
+
+void OcclusionCuller::AddOccluderTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    m_occluders.push_back(a);
+    m_occluders.push_back(b);
+    m_occluders.push_back(c);
+}
+
+void OcclusionCuller::AddOccluderQuad(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d) {
+    AddOccluderTriangle(a, b, c);
+    AddOccluderTriangle(c, d, a);
+}
+
+void OcclusionCuller::RenderOccluders(const glm::mat4& viewProjection) {
+    m_viewProjection = viewProjection;
+
+    // 变换和裁剪在调用线程完成（遮挡体数量很少），光栅化按条带并行
+    SetupTriangles();
+
+    if (m_jobs) {
+        m_jobs->ParallelFor(m_tilesY, [this](int begin, int end, int) {
+            for (int band = begin; band < end; band++) {
+                RasterizeBand(band);
+            }
+        });
+    } else {
+        for (int band = 0; band < m_tilesY; band++) {
+            RasterizeBand(band);
+        }
+    }
+}
+
+void OcclusionCuller::SetupTriangles() {
+    m_triangles.clear();
+
+    for (size_t i = 0; i + 2 < m_occluders.size(); i += 3) {
+        glm::vec4 clip[3];
+        for (int v = 0; v < 3; v++) {
+            clip[v] = m_viewProjection * glm::vec4(m_occluders[i + v], 1.0f);
+        }
+        ClipAndAddTriangle(clip);
+    }
+}
+
+// 只需要对近平面 (z + w >= 0) 裁剪，其余方向在光栅化时按屏幕范围截断
+void OcclusionCuller::ClipAndAddTriangle(const glm::vec4 clip[3]) {
+    glm::vec4 polygon[4];
+    int count = 0;
+
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4& a = clip[i];
+        const glm::vec4& b = clip[(i + 1) % 3];
+        float da = a.z + a.w;
+        float db = b.z + b.w;
+
+        if (da >= 0.0f) {
+            polygon[count++] = a;
+        }
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            float t = da / (da - db);
+            polygon[count++] = a + (b - a) * t;
+        }
+    }
+
+    for (int i = 1; i + 1 < count; i++) {
+        AddScreenTriangle(polygon[0], polygon[i], polygon[i + 1]);
+    }
+}
+
+void OcclusionCuller::AddScreenTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+    const glm::vec4* verts[3] = {&a, &b, &c};
+    ScreenTriangle tri;
+
+    for (int i = 0; i < 3; i++) {
+        float invW = 1.0f / std::max(verts[i]->w, MIN_CLIP_W);
+        tri.x[i] = (verts[i]->x * invW * 0.5f + 0.5f) * m_width;
+        tri.y[i] = (verts[i]->y * invW * 0.5f + 0.5f) * m_height;
+        tri.z[i] = std::clamp(verts[i]->z * invW * 0.5f + 0.5f, 0.0f, 1.0f);
+    }
+
+    // 统一成逆时针，遮挡体两面都有效
+    float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+    if (area == 0.0f) {
+        return;
+    }
+    if (area < 0.0f) {
+        std::swap(tri.x[1], tri.x[2]);
+        std::swap(tri.y[1], tri.y[2]);
+        std::swap(tri.z[1], tri.z[2]);
+    }
+
+    float minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+    float maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+    float minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+    float maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+    if (maxY < 0.0f || minY > m_height || maxX < 0.0f || minX > m_width) {
+        return;
+    }
+
+    tri.minY = std::max(static_cast<int>(std::floor(minY)), 0);
+    tri.maxY = std::min(static_cast<int>(std::ceil(maxY)), m_height);
+    m_triangles.push_back(tri);
+}
+
+void OcclusionCuller::RasterizeBand(int band) {
+    int rowBegin = band * TILE_SIZE;
+    int rowEnd = rowBegin + TILE_SIZE;
+
+    std::fill(m_depth.begin() + static_cast<size_t>(rowBegin) * m_width,
+              m_depth.begin() + static_cast<size_t>(rowEnd) * m_width, 1.0f);
+
+    for (const ScreenTriangle& tri : m_triangles) {
+        if (tri.maxY <= rowBegin || tri.minY >= rowEnd) {
+            continue;
+        }
+        RasterizeTriangle(tri, std::max(tri.minY, rowBegin), std::min(tri.maxY, rowEnd));
+    }
+
+    UpdateTileMax(rowBegin, rowEnd);
+}
+
+// 边函数 E(a, b, p) = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x)
+// 三条边都 >= 0 时像素中心在三角形内，深度按重心坐标插值
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& tri, int rowBegin, int rowEnd) {
+    float minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+    float maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+    int xBegin = std::max(static_cast<int>(std::floor(minX)), 0) & ~3;
+    int xEnd = std::min(static_cast<int>(std::ceil(maxX)), m_width);
+
+    // 边i对应顶点i的对边
+    float stepX[3], stepY[3], origin[3];
+    for (int i = 0; i < 3; i++) {
+        int a = (i + 1) % 3;
+        int b = (i + 2) % 3;
+        stepX[i] = -(tri.y[b] - tri.y[a]);
+        stepY[i] = tri.x[b] - tri.x[a];
+        // 在 (xBegin + 0.5, rowBegin + 0.5) 处的值
+        float px = xBegin + 0.5f;
+        float py = rowBegin + 0.5f;
+        origin[i] = stepY[i] * (py - tri.y[a]) + stepX[i] * (px - tri.x[a]);
+    }
+
+    float area = origin[0] + origin[1] + origin[2];
+    if (area <= 0.0f) {
+        return;
+    }
+    float invArea = 1.0f / area;
+    float dz1 = (tri.z[1] - tri.z[0]) * invArea;
+    float dz2 = (tri.z[2] - tri.z[0]) * invArea;
+
+#if defined(__SSE2__)
+    const __m128 laneOffset = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 z0 = _mm_set1_ps(tri.z[0]);
+    const __m128 vdz1 = _mm_set1_ps(dz1);
+    const __m128 vdz2 = _mm_set1_ps(dz2);
+    __m128 step4[3], rowStart[3];
+    for (int i = 0; i < 3; i++) {
+        step4[i] = _mm_set1_ps(stepX[i] * 4.0f);
+        rowStart[i] = _mm_add_ps(_mm_set1_ps(origin[i]), _mm_mul_ps(laneOffset, _mm_set1_ps(stepX[i])));
+    }
+
+    for (int y = rowBegin; y < rowEnd; y++) {
+        float* row = &m_depth[static_cast<size_t>(y) * m_width];
+        __m128 e0 = rowStart[0];
+        __m128 e1 = rowStart[1];
+        __m128 e2 = rowStart[2];
+
+        for (int x = xBegin; x < xEnd; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                                       _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside)) {
+                __m128 z = _mm_add_ps(z0, _mm_add_ps(_mm_mul_ps(e1, vdz1), _mm_mul_ps(e2, vdz2)));
+                __m128 old = _mm_load_ps(row + x);
+                __m128 nearest = _mm_min_ps(old, z);
+                _mm_store_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+            }
+            e0 = _mm_add_ps(e0, step4[0]);
+            e1 = _mm_add_ps(e1, step4[1]);
+            e2 = _mm_add_ps(e2, step4[2]);
+        }
+
+        for (int i = 0; i < 3; i++) {
+            rowStart[i] = _mm_add_ps(rowStart[i], _mm_set1_ps(stepY[i]));
+        }
+    }
+#else
+    for (int y = rowBegin; y < rowEnd; y++) {
+        float* row = &m_depth[static_cast<size_t>(y) * m_width];
+        float rowOffset = static_cast<float>(y - rowBegin);
+        for (int x = xBegin; x < xEnd; x++) {
+            float colOffset = static_cast<float>(x - xBegin);
+            float e0 = origin[0] + stepX[0] * colOffset + stepY[0] * rowOffset;
+            float e1 = origin[1] + stepX[1] * colOffset + stepY[1] * rowOffset;
+            float e2 = origin[2] + stepX[2] * colOffset + stepY[2] * rowOffset;
+            if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+                float z = tri.z[0] + e1 * dz1 + e2 * dz2;
+                row[x] = std::min(row[x], z);
+            }
+        }
+    }
+#endif
+}
+
+void OcclusionCuller::UpdateTileMax(int rowBegin, int rowEnd) {
+    int tileY = rowBegin / TILE_SIZE;
+    for (int tileX = 0; tileX < m_tilesX; tileX++) {
+        float farthest = 0.0f;
+        for (int y = rowBegin; y < rowEnd; y++) {
+            const float* row = &m_depth[static_cast<size_t>(y) * m_width + tileX * TILE_SIZE];
+            for (int x = 0; x < TILE_SIZE; x++) {
+                farthest = std::max(farthest, row[x]);
+            }
+        }
+        m_tileMax[static_cast<size_t>(tileY) * m_tilesX + tileX] = farthest;
+    }
+}
+
+bool OcclusionCuller::IsBoxVisible(const glm::vec3& minBounds, const glm::vec3& maxBounds) const {
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    float minZ = 1.0f;
+    int behindNear = 0;
+
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? maxBounds.x : minBounds.x,
+                         (i & 2) ? maxBounds.y : minBounds.y,
+                         (i & 4) ? maxBounds.z : minBounds.z);
+        glm::vec4 clip = m_viewProjection * glm::vec4(corner, 1.0f);
+
+        if (clip.z + clip.w < 0.0f || clip.w < MIN_CLIP_W) {
+            behindNear++;
+            continue;
+        }
+
+        float invW = 1.0f / clip.w;
+        float x = (clip.x * invW * 0.5f + 0.5f) * m_width;
+        float y = (clip.y * invW * 0.5f + 0.5f) * m_height;
+        float z = clip.z * invW * 0.5f + 0.5f;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, z);
+    }
+
+    // 全部在近平面之后看不到；跨过近平面时无法可靠投影，保守地认为可见
+    if (behindNear == 8) {
+        return false;
+    }
+    if (behindNear > 0) {
+        return true;
+    }
+
+    int x0 = std::max(static_cast<int>(std::floor(minX)), 0);
+    int y0 = std::max(static_cast<int>(std::floor(minY)), 0);
+    int x1 = std::min(static_cast<int>(std::ceil(maxX)), m_width);
+    int y1 = std::min(static_cast<int>(std::ceil(maxY)), m_height);
+    if (x0 >= x1 || y0 >= y1) {
+        return false; // 完全在屏幕外
+    }
+
+    for (int tileY = y0 / TILE_SIZE; tileY <= (y1 - 1) / TILE_SIZE; tileY++) {
+        for (int tileX = x0 / TILE_SIZE; tileX <= (x1 - 1) / TILE_SIZE; tileX++) {
+            // 整块的遮挡都比包围盒最近点更近，直接跳过
+            if (minZ >= m_tileMax[static_cast<size_t>(tileY) * m_tilesX + tileX]) {
+                continue;
+            }
+
+            int rowBegin = std::max(tileY * TILE_SIZE, y0);
+            int rowEnd = std::min((tileY + 1) * TILE_SIZE, y1);
+            int colBegin = std::max(tileX * TILE_SIZE, x0);
+            int colEnd = std::min((tileX + 1) * TILE_SIZE, x1);
+            for (int y = rowBegin; y < rowEnd; y++) {
+                const float* row = &m_depth[static_cast<size_t>(y) * m_width];
+                for (int x = colBegin; x < colEnd; x++) {
+                    if (minZ < row[x]) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,538 @@
+#include "ParticleCollider.h"
+#include "LevelGeometry.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// 距离场中表面的最小厚度（格子数）：两个格子才能在表面背后留下一个负的采样点
+const float MIN_FIELD_THICKNESS_CELLS = 2.0f;
+
+// 距离场的格子大小和在窗户四周多留的范围（米）
+const float LEVEL_FIELD_CELL_SIZE = 0.25f;
+const float LEVEL_FIELD_MARGIN = 1.0f;
+
+// 点到三角形的距离（Ericson, Real-Time Collision Detection 5.1.5）
+float pointTriangleDistance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap);
+    float d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        return glm::length(ap);
+    }
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp);
+    float d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        return glm::length(bp);
+    }
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return glm::length(ap - ab * (d1 / (d1 - d3)));
+    }
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp);
+    float d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        return glm::length(cp);
+    }
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return glm::length(ap - ac * (d2 / (d2 - d6)));
+    }
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return glm::length(bp - (c - b) * w);
+    }
+    float denom = 1.0f / (va + vb + vc);
+    return glm::length(ap - ab * (vb * denom) - ac * (vc * denom));
+}
+
+// 把粒子沿normal推出depth，再按效果处理速度
+void resolveContact(const ParticleCollisionParams& params, const glm::vec3& normal, float depth,
+                    glm::vec3& position, glm::vec3& velocity, float& life) {
+    position += normal * depth;
+    switch (params.response) {
+        case PARTICLE_COLLISION_BOUNCE: {
+            // 只处理朝表面运动的粒子：切向速度乘 (1 - friction)，法向速度反向乘restitution
+            float normalSpeed = glm::dot(velocity, normal);
+            if (normalSpeed < 0.0f) {
+                glm::vec3 tangent = velocity - normal * normalSpeed;
+                velocity = tangent * (1.0f - params.friction) - normal * (normalSpeed * params.restitution);
+            }
+            break;
+        }
+        case PARTICLE_COLLISION_STICK:
+            velocity = glm::vec3(0.0f);
+            break;
+        case PARTICLE_COLLISION_KILL:
+            life = 0.0f;
+            break;
+        case PARTICLE_COLLISION_NONE:
+            break;
+    }
+}
+
+// 点在（已按半径扩大的）盒子内部时，求推出盒子最近的可用面：面的顺序为 -x +x -y +y -z +z，
+// 与BoxFace的位相同
+bool boxPenetration(const glm::vec3& lo, const glm::vec3& hi, int faces, const glm::vec3& p, glm::vec3& normal,
+                    float& depth) {
+    const float distances[6] = {p.x - lo.x, hi.x - p.x, p.y - lo.y, hi.y - p.y, p.z - lo.z, hi.z - p.z};
+    float inside = distances[0];
+    for (int k = 1; k < 6; k++) {
+        inside = std::min(inside, distances[k]);
+    }
+    if (inside <= 0.0f) {
+        return false;
+    }
+    int face = -1;
+    for (int k = 0; k < 6; k++) {
+        if ((faces & (1 << k)) && (face < 0 || distances[k] < distances[face])) {
+            face = k;
+        }
+    }
+    normal = glm::vec3(0.0f);
+    normal[face / 2] = face % 2 == 0 ? -1.0f : 1.0f;
+    depth = distances[face];
+    return true;
+}
+
+#if defined(__SSE2__)
+inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// 与resolveContact相同，4个粒子一起处理；mask以外的通道depth为0
+inline void resolveContacts(const ParticleCollisionParams& params, __m128 mask, __m128 nx, __m128 ny, __m128 nz,
+                            __m128 depth, __m128& x, __m128& y, __m128& z, __m128& vx, __m128& vy, __m128& vz,
+                            __m128& life) {
+    x = _mm_add_ps(x, _mm_mul_ps(nx, depth));
+    y = _mm_add_ps(y, _mm_mul_ps(ny, depth));
+    z = _mm_add_ps(z, _mm_mul_ps(nz, depth));
+    switch (params.response) {
+        case PARTICLE_COLLISION_BOUNCE: {
+            __m128 normalSpeed = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, nx), _mm_mul_ps(vy, ny)), _mm_mul_ps(vz, nz));
+            __m128 into = _mm_and_ps(mask, _mm_cmplt_ps(normalSpeed, _mm_setzero_ps()));
+            __m128 keep = _mm_set1_ps(1.0f - params.friction);
+            __m128 reflected = _mm_mul_ps(normalSpeed, _mm_set1_ps(params.restitution));
+            __m128 bx = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(vx, _mm_mul_ps(nx, normalSpeed)), keep), _mm_mul_ps(nx, reflected));
+            __m128 by = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(vy, _mm_mul_ps(ny, normalSpeed)), keep), _mm_mul_ps(ny, reflected));
+            __m128 bz = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(vz, _mm_mul_ps(nz, normalSpeed)), keep), _mm_mul_ps(nz, reflected));
+            vx = select(into, bx, vx);
+            vy = select(into, by, vy);
+            vz = select(into, bz, vz);
+            break;
+        }
+        case PARTICLE_COLLISION_STICK:
+            vx = _mm_andnot_ps(mask, vx);
+            vy = _mm_andnot_ps(mask, vy);
+            vz = _mm_andnot_ps(mask, vz);
+            break;
+        case PARTICLE_COLLISION_KILL:
+            life = _mm_andnot_ps(mask, life);
+            break;
+        case PARTICLE_COLLISION_NONE:
+            break;
+    }
+}
+#endif
+
+} // namespace
+
+ParticleCollider::ParticleCollider() : m_fieldMin(0.0f), m_fieldMax(0.0f), m_cellSize(1.0f) {
+    m_fieldSize[0] = m_fieldSize[1] = m_fieldSize[2] = 0;
+}
+
+void ParticleCollider::Clear() {
+    m_planes.clear();
+    m_boxes.clear();
+    m_field.clear();
+    m_fieldSize[0] = m_fieldSize[1] = m_fieldSize[2] = 0;
+}
+
+bool ParticleCollider::AddPlane(const glm::vec3& normal, float distance) {
+    if (static_cast<int>(m_planes.size()) >= MAX_PLANES) {
+        return false;
+    }
+    float length = glm::length(normal);
+    m_planes.push_back({normal / length, distance / length});
+    return true;
+}
+
+bool ParticleCollider::AddBox(const glm::vec3& minBounds, const glm::vec3& maxBounds, int faces) {
+    if (static_cast<int>(m_boxes.size()) >= MAX_BOXES || (faces & BOX_FACE_ALL) == 0) {
+        return false;
+    }
+    m_boxes.push_back({glm::min(minBounds, maxBounds), glm::max(minBounds, maxBounds), faces & BOX_FACE_ALL});
+    return true;
+}
+
+void ParticleCollider::BuildDistanceField(const LevelGeometry& level, const std::vector<int>& surfaces,
+                                          const glm::vec3& minBounds, const glm::vec3& maxBounds, float cellSize) {
+    struct FieldQuad {
+        glm::vec3 corners[4];
+        glm::vec3 normal;
+        float thickness;
+    };
+    std::vector<FieldQuad> quads;
+    for (int id : surfaces) {
+        const LevelSurface& surface = level.GetSurface(id);
+        for (int q = 0; q < surface.quadCount; q++) {
+            FieldQuad quad;
+            for (int k = 0; k < 4; k++) {
+                quad.corners[k] = level.GetQuadVertex(surface.firstQuad + q, k).position;
+            }
+            quad.normal = level.GetQuadVertex(surface.firstQuad + q, 0).normal;
+            quad.thickness = std::max(surface.thickness, cellSize * MIN_FIELD_THICKNESS_CELLS);
+            quads.push_back(quad);
+        }
+    }
+
+    m_cellSize = cellSize;
+    m_fieldMin = minBounds;
+    for (int axis = 0; axis < 3; axis++) {
+        m_fieldSize[axis] = std::max(static_cast<int>(std::ceil((maxBounds[axis] - minBounds[axis]) / cellSize)), 1) + 1;
+        m_fieldMax[axis] = minBounds[axis] + (m_fieldSize[axis] - 1) * cellSize;
+    }
+    m_field.assign(static_cast<size_t>(m_fieldSize[0]) * m_fieldSize[1] * m_fieldSize[2], 0.0f);
+
+    // 四边形前方和侧面取到表面的距离；投影落在四边形内、且在挤出的厚度以内时为负，取到前后两面中较近的
+    size_t index = 0;
+    for (int z = 0; z < m_fieldSize[2]; z++) {
+        for (int y = 0; y < m_fieldSize[1]; y++) {
+            for (int x = 0; x < m_fieldSize[0]; x++) {
+                glm::vec3 p = minBounds + glm::vec3(x, y, z) * cellSize;
+                float distance = 1e30f;
+                for (const FieldQuad& quad : quads) {
+                    float unsignedDistance = std::min(
+                        pointTriangleDistance(p, quad.corners[0], quad.corners[1], quad.corners[2]),
+                        pointTriangleDistance(p, quad.corners[0], quad.corners[2], quad.corners[3]));
+                    float height = glm::dot(p - quad.corners[0], quad.normal);
+                    bool behind = height <= 0.0f && height > -quad.thickness;
+                    if (behind && unsignedDistance <= -height + 1e-4f) {
+                        distance = std::min(distance, -std::min(-height, quad.thickness + height));
+                    } else {
+                        distance = std::min(distance, unsignedDistance);
+                    }
+                }
+                m_field[index++] = distance;
+            }
+        }
+    }
+}
+
+void ParticleCollider::BuildLevel(const LevelGeometry& level) {
+    const LevelDesc& desc = level.GetDesc();
+    const float half = desc.roomSize / 2.0f;
+    const float height = desc.roomHeight;
+    const float innerZ = -half;
+    const float outerZ = -half - desc.wallThickness;
+    const float winLeft = desc.windowX - desc.windowWidth / 2;
+    const float winRight = desc.windowX + desc.windowWidth / 2;
+    const float winBottom = desc.windowY - desc.windowHeight / 2;
+    const float winTop = desc.windowY + desc.windowHeight / 2;
+    const float frame = desc.frameThickness;
+
+    Clear();
+    AddPlane(glm::vec3(0, 1, 0), 0.0f);      // 地面
+    AddPlane(glm::vec3(0, -1, 0), -height);  // 天花板
+    AddPlane(glm::vec3(1, 0, 0), -half);     // 左墙
+    AddPlane(glm::vec3(-1, 0, 0), -half);    // 右墙
+    AddPlane(glm::vec3(0, 0, -1), -half);    // 后墙
+
+    // 前墙：窗洞的下、上、左、右四块，只从内外墙面和窗洞一侧推出去
+    const int wallFaces = BOX_FACE_NEG_Z | BOX_FACE_POS_Z;
+    AddBox(glm::vec3(-half, 0.0f, outerZ), glm::vec3(half, winBottom, innerZ), wallFaces | BOX_FACE_POS_Y);
+    AddBox(glm::vec3(-half, winTop, outerZ), glm::vec3(half, height, innerZ), wallFaces | BOX_FACE_NEG_Y);
+    AddBox(glm::vec3(-half, winBottom, outerZ), glm::vec3(winLeft, winTop, innerZ), wallFaces | BOX_FACE_POS_X);
+    AddBox(glm::vec3(winRight, winBottom, outerZ), glm::vec3(half, winTop, innerZ), wallFaces | BOX_FACE_NEG_X);
+
+    // 窗户框架和两层玻璃
+    std::vector<int> window;
+    window.push_back(SURFACE_WINDOW_FRAME);
+    window.push_back(SURFACE_WINDOW_GLASS_INNER);
+    window.push_back(SURFACE_WINDOW_GLASS_OUTER);
+    glm::vec3 margin(LEVEL_FIELD_MARGIN);
+    BuildDistanceField(level, window, glm::vec3(winLeft - frame, winBottom - frame, outerZ) - margin,
+                       glm::vec3(winRight + frame, winTop + frame, innerZ) + margin, LEVEL_FIELD_CELL_SIZE);
+}
+
+bool ParticleCollider::SampleDistanceField(const glm::vec3& position, float& distance, glm::vec3& gradient) const {
+    if (m_field.empty() || position.x < m_fieldMin.x || position.y < m_fieldMin.y || position.z < m_fieldMin.z ||
+        position.x > m_fieldMax.x || position.y > m_fieldMax.y || position.z > m_fieldMax.z) {
+        return false;
+    }
+
+    glm::vec3 grid = (position - m_fieldMin) * (1.0f / m_cellSize);
+    int x = std::min(static_cast<int>(grid.x), m_fieldSize[0] - 2);
+    int y = std::min(static_cast<int>(grid.y), m_fieldSize[1] - 2);
+    int z = std::min(static_cast<int>(grid.z), m_fieldSize[2] - 2);
+    float fx = grid.x - x;
+    float fy = grid.y - y;
+    float fz = grid.z - z;
+
+    float c000 = FieldValue(x, y, z), c100 = FieldValue(x + 1, y, z);
+    float c010 = FieldValue(x, y + 1, z), c110 = FieldValue(x + 1, y + 1, z);
+    float c001 = FieldValue(x, y, z + 1), c101 = FieldValue(x + 1, y, z + 1);
+    float c011 = FieldValue(x, y + 1, z + 1), c111 = FieldValue(x + 1, y + 1, z + 1);
+
+    // 三线性插值，梯度为插值函数的偏导数
+    float c00 = c000 + (c100 - c000) * fx;
+    float c10 = c010 + (c110 - c010) * fx;
+    float c01 = c001 + (c101 - c001) * fx;
+    float c11 = c011 + (c111 - c011) * fx;
+    float c0 = c00 + (c10 - c00) * fy;
+    float c1 = c01 + (c11 - c01) * fy;
+    distance = c0 + (c1 - c0) * fz;
+
+    float dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * fy;
+    float dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * fy;
+    gradient.x = dx0 + (dx1 - dx0) * fz;
+    gradient.y = (c10 - c00) + ((c11 - c01) - (c10 - c00)) * fz;
+    gradient.z = c1 - c0;
+    gradient = gradient * (1.0f / m_cellSize);
+    return true;
+}
+
+void ParticleCollider::FindActiveShapes(const ParticleStreams& particles, float radius,
+                                        ActiveShapes& active) const {
+    glm::vec3 lo(1e30f);
+    glm::vec3 hi(-1e30f);
+    int i = 0;
+#if defined(__SSE2__)
+    __m128 minX = _mm_set1_ps(1e30f), minY = minX, minZ = minX;
+    __m128 maxX = _mm_set1_ps(-1e30f), maxY = maxX, maxZ = maxX;
+    for (; i + 4 <= particles.count; i += 4) {
+        __m128 x = _mm_loadu_ps(particles.posX + i);
+        __m128 y = _mm_loadu_ps(particles.posY + i);
+        __m128 z = _mm_loadu_ps(particles.posZ + i);
+        minX = _mm_min_ps(minX, x);
+        minY = _mm_min_ps(minY, y);
+        minZ = _mm_min_ps(minZ, z);
+        maxX = _mm_max_ps(maxX, x);
+        maxY = _mm_max_ps(maxY, y);
+        maxZ = _mm_max_ps(maxZ, z);
+    }
+    alignas(16) float lanes[6][4];
+    _mm_store_ps(lanes[0], minX);
+    _mm_store_ps(lanes[1], minY);
+    _mm_store_ps(lanes[2], minZ);
+    _mm_store_ps(lanes[3], maxX);
+    _mm_store_ps(lanes[4], maxY);
+    _mm_store_ps(lanes[5], maxZ);
+    for (int lane = 0; lane < 4; lane++) {
+        lo = glm::min(lo, glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]));
+        hi = glm::max(hi, glm::vec3(lanes[3][lane], lanes[4][lane], lanes[5][lane]));
+    }
+#endif
+    for (; i < particles.count; i++) {
+        glm::vec3 p(particles.posX[i], particles.posY[i], particles.posZ[i]);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+
+    // 平面：包围盒上离实体最近的角也没有碰到时跳过
+    active.planeCount = 0;
+    for (const Plane& plane : m_planes) {
+        glm::vec3 corner(plane.normal.x >= 0.0f ? lo.x : hi.x, plane.normal.y >= 0.0f ? lo.y : hi.y,
+                         plane.normal.z >= 0.0f ? lo.z : hi.z);
+        if (glm::dot(plane.normal, corner) < plane.distance + radius) {
+            active.planes[active.planeCount++] = plane;
+        }
+    }
+    active.boxCount = 0;
+    for (const Box& box : m_boxes) {
+        glm::vec3 boxMin = box.minBounds - glm::vec3(radius);
+        glm::vec3 boxMax = box.maxBounds + glm::vec3(radius);
+        if (lo.x < boxMax.x && hi.x > boxMin.x && lo.y < boxMax.y && hi.y > boxMin.y && lo.z < boxMax.z &&
+            hi.z > boxMin.z) {
+            active.boxes[active.boxCount++] = {boxMin, boxMax, box.faces};
+        }
+    }
+    active.field = !m_field.empty() && lo.x <= m_fieldMax.x && hi.x >= m_fieldMin.x && lo.y <= m_fieldMax.y &&
+                   hi.y >= m_fieldMin.y && lo.z <= m_fieldMax.z && hi.z >= m_fieldMin.z;
+}
+
+int ParticleCollider::Collide(const ParticleStreams& particles, const ParticleCollisionParams& params) const {
+    if (params.response == PARTICLE_COLLISION_NONE || IsEmpty() || particles.count <= 0) {
+        return 0;
+    }
+    ActiveShapes active;
+    FindActiveShapes(particles, params.radius, active);
+    if (active.planeCount == 0 && active.boxCount == 0 && !active.field) {
+        return 0;
+    }
+#if defined(__SSE2__)
+    int groups = particles.count / 4 * 4;
+    int contacts = CollideSSE2(particles, params, active, groups);
+    return contacts + CollideScalar(particles, params, active, groups, particles.count, true);
+#else
+    return CollideScalar(particles, params, active, 0, particles.count, true);
+#endif
+}
+
+int ParticleCollider::CollideScalar(const ParticleStreams& particles, const ParticleCollisionParams& params,
+                                    const ActiveShapes& active, int begin, int end, bool shapes) const {
+    const float radius = params.radius;
+    int contacts = 0;
+    for (int i = begin; i < end; i++) {
+        glm::vec3 position(particles.posX[i], particles.posY[i], particles.posZ[i]);
+        glm::vec3 velocity(particles.velX[i], particles.velY[i], particles.velZ[i]);
+        float life = particles.life[i];
+        int touched = 0;
+
+        if (shapes) {
+            for (int k = 0; k < active.planeCount; k++) {
+                const Plane& plane = active.planes[k];
+                float depth = radius + plane.distance - glm::dot(plane.normal, position);
+                if (depth > 0.0f) {
+                    resolveContact(params, plane.normal, depth, position, velocity, life);
+                    touched++;
+                }
+            }
+            for (int k = 0; k < active.boxCount; k++) {
+                glm::vec3 normal;
+                float depth;
+                const Box& box = active.boxes[k];
+                if (boxPenetration(box.minBounds, box.maxBounds, box.faces, position, normal, depth)) {
+                    resolveContact(params, normal, depth, position, velocity, life);
+                    touched++;
+                }
+            }
+        }
+
+        float distance;
+        glm::vec3 gradient;
+        if (active.field && SampleDistanceField(position, distance, gradient) && distance < radius) {
+            float length = glm::length(gradient);
+            if (length > 1e-6f) {
+                resolveContact(params, gradient * (1.0f / length), radius - distance, position, velocity, life);
+                touched++;
+            }
+        }
+
+        if (touched > 0) {
+            particles.posX[i] = position.x;
+            particles.posY[i] = position.y;
+            particles.posZ[i] = position.z;
+            particles.velX[i] = velocity.x;
+            particles.velY[i] = velocity.y;
+            particles.velZ[i] = velocity.z;
+            particles.life[i] = life;
+            contacts += touched;
+        }
+    }
+    return contacts;
+}
+
+#if defined(__SSE2__)
+int ParticleCollider::CollideSSE2(const ParticleStreams& particles, const ParticleCollisionParams& params,
+                                  const ActiveShapes& active, int end) const {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 radius = _mm_set1_ps(params.radius);
+    const __m128 fieldMinX = _mm_set1_ps(m_fieldMin.x - params.radius);
+    const __m128 fieldMinY = _mm_set1_ps(m_fieldMin.y - params.radius);
+    const __m128 fieldMinZ = _mm_set1_ps(m_fieldMin.z - params.radius);
+    const __m128 fieldMaxX = _mm_set1_ps(m_fieldMax.x + params.radius);
+    const __m128 fieldMaxY = _mm_set1_ps(m_fieldMax.y + params.radius);
+    const __m128 fieldMaxZ = _mm_set1_ps(m_fieldMax.z + params.radius);
+
+    int contacts = 0;
+    for (int base = 0; base < end; base += 4) {
+        __m128 x = _mm_loadu_ps(particles.posX + base);
+        __m128 y = _mm_loadu_ps(particles.posY + base);
+        __m128 z = _mm_loadu_ps(particles.posZ + base);
+        __m128 vx = _mm_loadu_ps(particles.velX + base);
+        __m128 vy = _mm_loadu_ps(particles.velY + base);
+        __m128 vz = _mm_loadu_ps(particles.velZ + base);
+        __m128 life = _mm_loadu_ps(particles.life + base);
+        bool touched = false;
+
+        for (int k = 0; k < active.planeCount; k++) {
+            const Plane& plane = active.planes[k];
+            __m128 nx = _mm_set1_ps(plane.normal.x);
+            __m128 ny = _mm_set1_ps(plane.normal.y);
+            __m128 nz = _mm_set1_ps(plane.normal.z);
+            __m128 height = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, x), _mm_mul_ps(ny, y)), _mm_mul_ps(nz, z));
+            __m128 depth = _mm_sub_ps(_mm_add_ps(radius, _mm_set1_ps(plane.distance)), height);
+            __m128 mask = _mm_cmpgt_ps(depth, zero);
+            int bits = _mm_movemask_ps(mask);
+            if (bits == 0) {
+                continue;
+            }
+            resolveContacts(params, mask, nx, ny, nz, _mm_and_ps(mask, depth), x, y, z, vx, vy, vz, life);
+            contacts += __builtin_popcount(static_cast<unsigned int>(bits));
+            touched = true;
+        }
+
+        for (int k = 0; k < active.boxCount; k++) {
+            const Box& box = active.boxes[k];
+            // 到6个面的距离，顺序与boxPenetration相同
+            __m128 distances[6] = {
+                _mm_sub_ps(x, _mm_set1_ps(box.minBounds.x)),
+                _mm_sub_ps(_mm_set1_ps(box.maxBounds.x), x),
+                _mm_sub_ps(y, _mm_set1_ps(box.minBounds.y)),
+                _mm_sub_ps(_mm_set1_ps(box.maxBounds.y), y),
+                _mm_sub_ps(z, _mm_set1_ps(box.minBounds.z)),
+                _mm_sub_ps(_mm_set1_ps(box.maxBounds.z), z),
+            };
+            __m128 depth = distances[0];
+            for (int face = 1; face < 6; face++) {
+                depth = _mm_min_ps(depth, distances[face]);
+            }
+            __m128 mask = _mm_cmpgt_ps(depth, zero);
+            int bits = _mm_movemask_ps(mask);
+            if (bits == 0) {
+                continue;
+            }
+
+            // 最近的可用面，距离相同时取前面的
+            __m128 normal[3] = {zero, zero, zero};
+            __m128 nearest = _mm_set1_ps(1e30f);
+            for (int face = 0; face < 6; face++) {
+                if (!(box.faces & (1 << face))) {
+                    continue;
+                }
+                __m128 closer = _mm_cmplt_ps(distances[face], nearest);
+                nearest = _mm_min_ps(nearest, distances[face]);
+                for (int axis = 0; axis < 3; axis++) {
+                    float value = axis == face / 2 ? (face % 2 == 0 ? -1.0f : 1.0f) : 0.0f;
+                    normal[axis] = select(closer, _mm_set1_ps(value), normal[axis]);
+                }
+            }
+            resolveContacts(params, mask, normal[0], normal[1], normal[2], _mm_and_ps(mask, nearest), x, y, z, vx,
+                            vy, vz, life);
+            contacts += __builtin_popcount(static_cast<unsigned int>(bits));
+            touched = true;
+        }
+
+        if (touched) {
+            _mm_storeu_ps(particles.posX + base, x);
+            _mm_storeu_ps(particles.posY + base, y);
+            _mm_storeu_ps(particles.posZ + base, z);
+            _mm_storeu_ps(particles.velX + base, vx);
+            _mm_storeu_ps(particles.velY + base, vy);
+            _mm_storeu_ps(particles.velZ + base, vz);
+            _mm_storeu_ps(particles.life + base, life);
+        }
+
+        // 组内有粒子在距离场范围内时才逐个采样
+        if (active.field) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(x, fieldMinX), _mm_cmple_ps(x, fieldMaxX)),
+                                       _mm_and_ps(_mm_cmpge_ps(y, fieldMinY), _mm_cmple_ps(y, fieldMaxY)));
+            inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(z, fieldMinZ), _mm_cmple_ps(z, fieldMaxZ)));
+            if (_mm_movemask_ps(inside) != 0) {
+                contacts += CollideScalar(particles, params, active, base, base + 4, false);
+            }
+        }
+    }
+    return contacts;
+}
+#endif
@@ -0,0 +1,455 @@
+#include "ParticleSystem.h"
+#include "ParticleCollider.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+inline uint32_t xorshift32(uint32_t x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// 高23位作为尾数，得到 [-1, 1) 的均匀分布：[2, 4) - 3
+inline float bitsToSigned(uint32_t x) {
+    uint32_t bits = (x >> 9) | 0x40000000u;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f - 3.0f;
+}
+
+inline uint8_t toByte(float v) {
+    return static_cast<uint8_t>(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// 有效粒子的掩码，最后一组可能不满
+inline int validMask(int base, int end, int lanes) {
+    int remaining = end - base;
+    return remaining >= lanes ? (1 << lanes) - 1 : (1 << remaining) - 1;
+}
+
+#if defined(__AVX2__)
+// 8位存活掩码 -> 把存活的通道按顺序移到前面的排列
+struct CompactTable {
+    alignas(32) int32_t indices[256][8];
+
+    CompactTable() {
+        for (int mask = 0; mask < 256; mask++) {
+            int n = 0;
+            for (int lane = 0; lane < 8; lane++) {
+                if (mask & (1 << lane)) {
+                    indices[mask][n++] = lane;
+                }
+            }
+            while (n < 8) {
+                indices[mask][n++] = 0;
+            }
+        }
+    }
+};
+
+const CompactTable compactTable;
+
+inline __m256i xorshift32(__m256i x) {
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+    return x;
+}
+
+inline __m256 bitsToSigned(__m256i x) {
+    __m256i bits = _mm256_or_si256(_mm256_srli_epi32(x, 9), _mm256_set1_epi32(0x40000000));
+    return _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(3.0f));
+}
+#elif defined(__SSE2__)
+inline __m128i xorshift32(__m128i x) {
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    return x;
+}
+
+inline __m128 bitsToSigned(__m128i x) {
+    __m128i bits = _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x40000000));
+    return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(3.0f));
+}
+#endif
+
+} // namespace
+
+uint32_t HashParticleSeed(uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t h = a * 0x9E3779B9u;
+    h ^= b + 0x85EBCA6Bu + (h << 6) + (h >> 2);
+    h ^= c + 0xC2B2AE35u + (h << 6) + (h >> 2);
+    h = (h ^ (h >> 16)) * 0x85EBCA6Bu;
+    h = (h ^ (h >> 13)) * 0xC2B2AE35u;
+    h ^= h >> 16;
+    // xorshift的状态不能为0
+    return h != 0 ? h : 0x6D2B79F5u;
+}
+
+ParticleRandom::ParticleRandom(uint32_t seed) : state(seed != 0 ? seed : 0x6D2B79F5u) {
+}
+
+float ParticleRandom::Next() {
+    state = xorshift32(state);
+    return bitsToSigned(state) * 0.5f + 0.5f;
+}
+
+ParticleSystem::ParticleSystem(int capacity)
+    : m_capacity(std::max(capacity, 1)), m_count(0), m_seed(1), m_step(0), m_spawnRandom(1) {
+    size_t padded = static_cast<size_t>(m_capacity) + LANES;
+    m_posX.assign(padded, 0.0f);
+    m_posY.assign(padded, 0.0f);
+    m_posZ.assign(padded, 0.0f);
+    m_velX.assign(padded, 0.0f);
+    m_velY.assign(padded, 0.0f);
+    m_velZ.assign(padded, 0.0f);
+    m_life.assign(padded, 0.0f);
+    m_fade.assign(padded, 0.0f);
+    m_size.assign(padded, 0.0f);
+    m_color.assign(padded, 0u);
+
+    Seed(1);
+    SetColorGradient([](float life) { return glm::vec4(1.0f, 1.0f, 1.0f, life); });
+    SetSizeCurve([](float) { return 1.0f; });
+}
+
+void ParticleSystem::Seed(uint32_t seed) {
+    m_seed = seed;
+    m_step = 0;
+    m_spawnRandom = ParticleRandom(HashParticleSeed(seed, 0xFFFFFFFFu));
+}
+
+void ParticleSystem::SetColorGradient(const ColorFunc& color) {
+    for (int i = 0; i < LUT_SIZE; i++) {
+        glm::vec4 c = color(static_cast<float>(i) / (LUT_SIZE - 1));
+        m_colorLut[i] = static_cast<uint32_t>(toByte(c.x)) | (static_cast<uint32_t>(toByte(c.y)) << 8) |
+                        (static_cast<uint32_t>(toByte(c.z)) << 16) | (static_cast<uint32_t>(toByte(c.w)) << 24);
+    }
+}
+
+void ParticleSystem::SetSizeCurve(const SizeFunc& size) {
+    for (int i = 0; i < LUT_SIZE; i++) {
+        m_sizeLut[i] = size(static_cast<float>(i) / (LUT_SIZE - 1));
+    }
+}
+
+glm::vec4 ParticleSystem::UnpackColor(uint32_t color) {
+    return glm::vec4(color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, color >> 24) * (1.0f / 255.0f);
+}
+
+int ParticleSystem::LutIndex(float life) {
+    return static_cast<int>(std::min(std::max(life, 0.0f), 1.0f) * (LUT_SIZE - 1) + 0.5f);
+}
+
+int ParticleSystem::Spawn(const glm::vec3& position, const glm::vec3& velocity, float size, float lifetime) {
+    if (m_count >= m_capacity) {
+        return -1;
+    }
+    int i = m_count++;
+    m_posX[i] = position.x;
+    m_posY[i] = position.y;
+    m_posZ[i] = position.z;
+    m_velX[i] = velocity.x;
+    m_velY[i] = velocity.y;
+    m_velZ[i] = velocity.z;
+    m_life[i] = 1.0f;
+    m_fade[i] = 1.0f / std::max(lifetime, 1e-3f);
+    m_size[i] = size;
+    m_color[i] = m_colorLut[LUT_SIZE - 1];
+    return i;
+}
+
+void ParticleSystem::Update(float deltaTime) {
+    int chunks = BeginUpdate();
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        UpdateChunk(chunk, deltaTime);
+    }
+    EndUpdate();
+}
+
+int ParticleSystem::BeginUpdate() {
+    m_step++;
+    int chunks = (m_count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    m_chunkCounts.assign(chunks, 0);
+    return chunks;
+}
+
+void ParticleSystem::UpdateChunk(int chunk, float deltaTime) {
+    int begin = chunk * CHUNK_SIZE;
+    int end = std::min(begin + CHUNK_SIZE, m_count);
+    uint32_t laneState[LANES];
+    for (int lane = 0; lane < LANES; lane++) {
+        laneState[lane] = HashParticleSeed(m_seed, m_step, static_cast<uint32_t>(chunk * LANES + lane));
+    }
+#if defined(__AVX2__)
+    m_chunkCounts[chunk] = UpdateAVX2(begin, end, deltaTime, laneState);
+#elif defined(__SSE2__)
+    m_chunkCounts[chunk] = UpdateSSE2(begin, end, deltaTime, laneState);
+#else
+    m_chunkCounts[chunk] = UpdateScalar(begin, end, deltaTime, laneState);
+#endif
+}
+
+int ParticleSystem::CollideChunk(int chunk, const ParticleCollider& collider) {
+    const ParticleCollisionParams& params = m_params.collision;
+    int begin = chunk * CHUNK_SIZE;
+    int count = m_chunkCounts[chunk];
+    if (params.response == PARTICLE_COLLISION_NONE || count == 0) {
+        return 0;
+    }
+
+    ParticleStreams streams = {&m_posX[begin], &m_posY[begin], &m_posZ[begin], &m_velX[begin], &m_velY[begin],
+                               &m_velZ[begin], &m_life[begin], count};
+    int contacts = collider.Collide(streams, params);
+
+    // 被杀死的粒子生命值为0，与更新时一样无分支地压缩掉
+    if (params.response == PARTICLE_COLLISION_KILL && contacts > 0) {
+        int j = begin;
+        for (int i = begin; i < begin + count; i++) {
+            m_posX[j] = m_posX[i];
+            m_posY[j] = m_posY[i];
+            m_posZ[j] = m_posZ[i];
+            m_velX[j] = m_velX[i];
+            m_velY[j] = m_velY[i];
+            m_velZ[j] = m_velZ[i];
+            m_life[j] = m_life[i];
+            m_fade[j] = m_fade[i];
+            m_size[j] = m_size[i];
+            m_color[j] = m_color[i];
+            j += m_life[i] > 0.0f ? 1 : 0;
+        }
+        m_chunkCounts[chunk] = j - begin;
+    }
+    return contacts;
+}
+
+void ParticleSystem::EndUpdate() {
+    // 各块存活的粒子按块的顺序接在一起
+    int count = 0;
+    for (size_t chunk = 0; chunk < m_chunkCounts.size(); chunk++) {
+        int source = static_cast<int>(chunk) * CHUNK_SIZE;
+        int n = m_chunkCounts[chunk];
+        if (source != count && n > 0) {
+            size_t bytes = static_cast<size_t>(n) * sizeof(float);
+            std::memmove(&m_posX[count], &m_posX[source], bytes);
+            std::memmove(&m_posY[count], &m_posY[source], bytes);
+            std::memmove(&m_posZ[count], &m_posZ[source], bytes);
+            std::memmove(&m_velX[count], &m_velX[source], bytes);
+            std::memmove(&m_velY[count], &m_velY[source], bytes);
+            std::memmove(&m_velZ[count], &m_velZ[source], bytes);
+            std::memmove(&m_life[count], &m_life[source], bytes);
+            std::memmove(&m_fade[count], &m_fade[source], bytes);
+            std::memmove(&m_size[count], &m_size[source], bytes);
+            std::memmove(&m_color[count], &m_color[source], static_cast<size_t>(n) * sizeof(uint32_t));
+        }
+        count += n;
+    }
+    m_count = count;
+    m_chunkCounts.clear();
+}
+
+int ParticleSystem::UpdateScalar(int begin, int end, float deltaTime, uint32_t laneState[LANES]) {
+    const ParticleSimParams& p = m_params;
+    const float turbulence = p.turbulence * deltaTime;
+    const float damping = std::max(1.0f - p.drag * deltaTime, 0.0f);
+    const float growth = p.growth * deltaTime;
+    const glm::vec3 gravity = p.gravity * deltaTime;
+
+    // 写入位置j不会超过读取位置i，可以原地压缩
+    int j = begin;
+    for (int base = begin; base < end; base += LANES) {
+        for (int lane = 0; lane < LANES; lane++) {
+            // 不满的最后一组也消耗随机数，与SIMD路径一致
+            uint32_t s1 = xorshift32(laneState[lane]);
+            uint32_t s2 = xorshift32(s1);
+            laneState[lane] = s2;
+
+            int i = base + lane;
+            if (i >= end) {
+                continue;
+            }
+            float vx = (m_velX[i] + gravity.x + bitsToSigned(s1) * turbulence) * damping;
+            float vy = (m_velY[i] + gravity.y) * damping;
+            float vz = (m_velZ[i] + gravity.z + bitsToSigned(s2) * turbulence) * damping;
+            float life = m_life[i] - m_fade[i] * deltaTime;
+
+            m_posX[j] = m_posX[i] + vx * deltaTime;
+            m_posY[j] = m_posY[i] + vy * deltaTime;
+            m_posZ[j] = m_posZ[i] + vz * deltaTime;
+            m_velX[j] = vx;
+            m_velY[j] = vy;
+            m_velZ[j] = vz;
+            m_life[j] = life;
+            m_fade[j] = m_fade[i];
+            m_size[j] = m_size[i] + growth;
+            m_color[j] = m_colorLut[LutIndex(life)];
+            j += life > 0.0f ? 1 : 0;
+        }
+    }
+    return j - begin;
+}
+
+#if defined(__AVX2__)
+int ParticleSystem::UpdateAVX2(int begin, int end, float deltaTime, uint32_t laneState[LANES]) {
+    const ParticleSimParams& p = m_params;
+    const __m256 dt = _mm256_set1_ps(deltaTime);
+    const __m256 turbulence = _mm256_set1_ps(p.turbulence * deltaTime);
+    const __m256 damping = _mm256_set1_ps(std::max(1.0f - p.drag * deltaTime, 0.0f));
+    const __m256 growth = _mm256_set1_ps(p.growth * deltaTime);
+    const __m256 gravityX = _mm256_set1_ps(p.gravity.x * deltaTime);
+    const __m256 gravityY = _mm256_set1_ps(p.gravity.y * deltaTime);
+    const __m256 gravityZ = _mm256_set1_ps(p.gravity.z * deltaTime);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 lutScale = _mm256_set1_ps(static_cast<float>(LUT_SIZE - 1));
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const int* lut = reinterpret_cast<const int*>(m_colorLut);
+
+    __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(laneState));
+    float* posX = m_posX.data();
+    float* posY = m_posY.data();
+    float* posZ = m_posZ.data();
+    float* velX = m_velX.data();
+    float* velY = m_velY.data();
+    float* velZ = m_velZ.data();
+    float* lifes = m_life.data();
+    float* fades = m_fade.data();
+    float* sizes = m_size.data();
+    uint32_t* colors = m_color.data();
+
+    int j = begin;
+    for (int base = begin; base < end; base += LANES) {
+        __m256i s1 = xorshift32(state);
+        state = xorshift32(s1);
+
+        __m256 vx = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(velX + base), gravityX),
+                                                _mm256_mul_ps(bitsToSigned(s1), turbulence)), damping);
+        __m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(velY + base), gravityY), damping);
+        __m256 vz = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(velZ + base), gravityZ),
+                                                _mm256_mul_ps(bitsToSigned(state), turbulence)), damping);
+        __m256 x = _mm256_add_ps(_mm256_loadu_ps(posX + base), _mm256_mul_ps(vx, dt));
+        __m256 y = _mm256_add_ps(_mm256_loadu_ps(posY + base), _mm256_mul_ps(vy, dt));
+        __m256 z = _mm256_add_ps(_mm256_loadu_ps(posZ + base), _mm256_mul_ps(vz, dt));
+        __m256 fade = _mm256_loadu_ps(fades + base);
+        __m256 life = _mm256_sub_ps(_mm256_loadu_ps(lifes + base), _mm256_mul_ps(fade, dt));
+        __m256 size = _mm256_add_ps(_mm256_loadu_ps(sizes + base), growth);
+
+        __m256 t = _mm256_min_ps(_mm256_max_ps(life, zero), one);
+        __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(t, lutScale), half));
+        __m256i color = _mm256_i32gather_epi32(lut, index, 4);
+
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(life, zero, _CMP_GT_OQ)) & validMask(base, end, LANES);
+        __m256i perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(compactTable.indices[mask]));
+
+        // 存活的通道移到前面整组写出，多写的部分会被后面的组覆盖；
+        // 不会写过本组的末尾，所以不会碰到相邻的块
+        _mm256_storeu_ps(posX + j, _mm256_permutevar8x32_ps(x, perm));
+        _mm256_storeu_ps(posY + j, _mm256_permutevar8x32_ps(y, perm));
+        _mm256_storeu_ps(posZ + j, _mm256_permutevar8x32_ps(z, perm));
+        _mm256_storeu_ps(velX + j, _mm256_permutevar8x32_ps(vx, perm));
+        _mm256_storeu_ps(velY + j, _mm256_permutevar8x32_ps(vy, perm));
+        _mm256_storeu_ps(velZ + j, _mm256_permutevar8x32_ps(vz, perm));
+        _mm256_storeu_ps(lifes + j, _mm256_permutevar8x32_ps(life, perm));
+        _mm256_storeu_ps(fades + j, _mm256_permutevar8x32_ps(fade, perm));
+        _mm256_storeu_ps(sizes + j, _mm256_permutevar8x32_ps(size, perm));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(colors + j), _mm256_permutevar8x32_epi32(color, perm));
+        j += __builtin_popcount(static_cast<unsigned int>(mask));
+    }
+    return j - begin;
+}
+#elif defined(__SSE2__)
+int ParticleSystem::UpdateSSE2(int begin, int end, float deltaTime, uint32_t laneState[LANES]) {
+    const ParticleSimParams& p = m_params;
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    const __m128 turbulence = _mm_set1_ps(p.turbulence * deltaTime);
+    const __m128 damping = _mm_set1_ps(std::max(1.0f - p.drag * deltaTime, 0.0f));
+    const __m128 growth = _mm_set1_ps(p.growth * deltaTime);
+    const __m128 gravityX = _mm_set1_ps(p.gravity.x * deltaTime);
+    const __m128 gravityY = _mm_set1_ps(p.gravity.y * deltaTime);
+    const __m128 gravityZ = _mm_set1_ps(p.gravity.z * deltaTime);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 lutScale = _mm_set1_ps(static_cast<float>(LUT_SIZE - 1));
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    // 8路状态分成低4路和高4路
+    __m128i state[2] = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(laneState)),
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(laneState + 4))};
+    float* posX = m_posX.data();
+    float* posY = m_posY.data();
+    float* posZ = m_posZ.data();
+    float* velX = m_velX.data();
+    float* velY = m_velY.data();
+    float* velZ = m_velZ.data();
+    float* lifes = m_life.data();
+    float* fades = m_fade.data();
+    float* sizes = m_size.data();
+    uint32_t* colors = m_color.data();
+
+    int j = begin;
+    for (int base = begin; base < end; base += LANES) {
+        int mask = validMask(base, end, LANES);
+        for (int h = 0; h < 2; h++) {
+            int i = base + h * 4;
+            __m128i s1 = xorshift32(state[h]);
+            state[h] = xorshift32(s1);
+
+            __m128 vx = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_loadu_ps(velX + i), gravityX),
+                                              _mm_mul_ps(bitsToSigned(s1), turbulence)), damping);
+            __m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velY + i), gravityY), damping);
+            __m128 vz = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_loadu_ps(velZ + i), gravityZ),
+                                              _mm_mul_ps(bitsToSigned(state[h]), turbulence)), damping);
+            __m128 life = _mm_sub_ps(_mm_loadu_ps(lifes + i), _mm_mul_ps(_mm_loadu_ps(fades + i), dt));
+            _mm_storeu_ps(posX + i, _mm_add_ps(_mm_loadu_ps(posX + i), _mm_mul_ps(vx, dt)));
+            _mm_storeu_ps(posY + i, _mm_add_ps(_mm_loadu_ps(posY + i), _mm_mul_ps(vy, dt)));
+            _mm_storeu_ps(posZ + i, _mm_add_ps(_mm_loadu_ps(posZ + i), _mm_mul_ps(vz, dt)));
+            _mm_storeu_ps(velX + i, vx);
+            _mm_storeu_ps(velY + i, vy);
+            _mm_storeu_ps(velZ + i, vz);
+            _mm_storeu_ps(lifes + i, life);
+            _mm_storeu_ps(sizes + i, _mm_add_ps(_mm_loadu_ps(sizes + i), growth));
+
+            // SSE2没有gather，查表逐个做
+            __m128 t = _mm_min_ps(_mm_max_ps(life, zero), one);
+            alignas(16) int32_t index[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(t, lutScale), half)));
+            for (int k = 0; k < 4; k++) {
+                colors[i + k] = m_colorLut[index[k]];
+            }
+
+            mask &= ~((~_mm_movemask_ps(_mm_cmpgt_ps(life, zero)) & 0xF) << (h * 4));
+        }
+
+        // 前面没有空洞且整组存活时原地不动，否则逐个无分支地压缩
+        if (j == base && mask == 0xFF) {
+            j += LANES;
+            continue;
+        }
+        for (int lane = 0; lane < LANES; lane++) {
+            int i = base + lane;
+            posX[j] = posX[i];
+            posY[j] = posY[i];
+            posZ[j] = posZ[i];
+            velX[j] = velX[i];
+            velY[j] = velY[i];
+            velZ[j] = velZ[i];
+            lifes[j] = lifes[i];
+            fades[j] = fades[i];
+            sizes[j] = sizes[i];
+            colors[j] = colors[i];
+            j += (mask >> lane) & 1;
+        }
+    }
+    return j - begin;
+}
+#endif
@@ -0,0 +1,427 @@
+#include "ParticleWorld.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// 每批发射的粒子数
+const int SPAWN_BATCH_SIZE = 512;
+
+// 子效果嵌套的最大深度，防止互相引用的效果无限展开
+const int MAX_CHILD_DEPTH = 4;
+
+const float PI = 3.14159265358979f;
+
+// 以axis为中心、半角为angle（弧度）的圆锥内均匀分布的方向
+glm::vec3 RandomConeDirection(ParticleRandom& random, const glm::vec3& axis, float angle) {
+    float cosTheta = 1.0f - random.Next() * (1.0f - std::cos(angle));
+    float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+    float phi = random.Next() * 2.0f * PI;
+
+    glm::vec3 helper = std::fabs(axis.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 tangent = glm::normalize(glm::cross(helper, axis));
+    glm::vec3 bitangent = glm::cross(axis, tangent);
+    return (tangent * std::cos(phi) + bitangent * std::sin(phi)) * sinTheta + axis * cosTheta;
+}
+
+// 半径为radius的球内均匀分布的点
+glm::vec3 RandomInSphere(ParticleRandom& random, float radius) {
+    if (radius <= 0.0f) {
+        return glm::vec3(0.0f);
+    }
+    glm::vec3 direction = RandomConeDirection(random, glm::vec3(0.0f, 1.0f, 0.0f), PI);
+    return direction * (radius * std::cbrt(random.Next()));
+}
+
+} // namespace
+
+glm::vec4 SampleParticleColor(const std::vector<ParticleColorKey>& keys, float age) {
+    if (keys.empty()) {
+        return glm::vec4(1.0f, 1.0f, 1.0f, 1.0f - age);
+    }
+    // 第一个age大于当前年龄的关键点；同一age有两个点时取后一个的颜色
+    size_t next = 0;
+    while (next < keys.size() && keys[next].age <= age) {
+        next++;
+    }
+    if (next == 0) {
+        return keys.front().color;
+    }
+    if (next == keys.size()) {
+        return keys.back().color;
+    }
+    const ParticleColorKey& a = keys[next - 1];
+    const ParticleColorKey& b = keys[next];
+    float t = (age - a.age) / (b.age - a.age);
+    return a.color + (b.color - a.color) * t;
+}
+
+float SampleParticleSize(const std::vector<ParticleSizeKey>& keys, float age) {
+    if (keys.empty()) {
+        return 1.0f;
+    }
+    size_t next = 0;
+    while (next < keys.size() && keys[next].age <= age) {
+        next++;
+    }
+    if (next == 0) {
+        return keys.front().scale;
+    }
+    if (next == keys.size()) {
+        return keys.back().scale;
+    }
+    const ParticleSizeKey& a = keys[next - 1];
+    const ParticleSizeKey& b = keys[next];
+    float t = (age - a.age) / (b.age - a.age);
+    return a.scale + (b.scale - a.scale) * t;
+}
+
+int ParticleEmitterClock::Advance(const ParticleEffectDesc& effect, float deltaTime) {
+    int count = 0;
+    if (!burstDone) {
+        count += effect.burst;
+        burstDone = true;
+    }
+    if (effect.spawnRate > 0.0f && (effect.duration <= 0.0f || age < effect.duration)) {
+        spawnAccumulator += effect.spawnRate * deltaTime;
+        int due = static_cast<int>(spawnAccumulator);
+        spawnAccumulator -= static_cast<float>(due);
+        count += due;
+    }
+    age += deltaTime;
+    return count;
+}
+
+bool ParticleEmitterClock::IsEmitting(const ParticleEffectDesc& effect) const {
+    if (!burstDone) {
+        return true;
+    }
+    if (effect.spawnRate <= 0.0f) {
+        return false;
+    }
+    return effect.duration <= 0.0f || age < effect.duration;
+}
+
+ParticleWorld::ParticleWorld() : m_jobs(nullptr), m_collider(nullptr), m_seed(1), m_spawnSerial(0) {
+}
+
+ParticleWorld::~ParticleWorld() {
+}
+
+bool ParticleWorld::LoadEffects(const char* path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "无法打开粒子效果文件: " << path << std::endl;
+        return false;
+    }
+
+    // 文件格式：[名字] 开始一个效果，之后每行为 "键 值..."，#开始的行是注释
+    std::vector<ParticleEffectDesc> effects;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        std::istringstream in(line);
+        std::string key;
+        if (!(in >> key)) {
+            continue;
+        }
+
+        if (key.front() == '[') {
+            if (key.back() != ']' || key.size() < 3) {
+                std::cerr << path << ":" << lineNumber << ": 效果名格式错误" << std::endl;
+                return false;
+            }
+            effects.emplace_back();
+            effects.back().name = key.substr(1, key.size() - 2);
+            continue;
+        }
+        if (effects.empty()) {
+            std::cerr << path << ":" << lineNumber << ": 键值出现在第一个效果之前" << std::endl;
+            return false;
+        }
+
+        ParticleEffectDesc& effect = effects.back();
+        bool ok = true;
+        if (key == "max_particles") {
+            ok = static_cast<bool>(in >> effect.maxParticles);
+        } else if (key == "rate") {
+            ok = static_cast<bool>(in >> effect.spawnRate);
+        } else if (key == "burst") {
+            ok = static_cast<bool>(in >> effect.burst);
+        } else if (key == "duration") {
+            ok = static_cast<bool>(in >> effect.duration);
+        } else if (key == "lifetime") {
+            ok = static_cast<bool>(in >> effect.lifetimeMin >> effect.lifetimeMax);
+        } else if (key == "start_size") {
+            ok = static_cast<bool>(in >> effect.sizeMin >> effect.sizeMax);
+        } else if (key == "speed") {
+            ok = static_cast<bool>(in >> effect.speedMin >> effect.speedMax);
+        } else if (key == "direction") {
+            ok = static_cast<bool>(in >> effect.direction.x >> effect.direction.y >> effect.direction.z);
+        } else if (key == "cone") {
+            ok = static_cast<bool>(in >> effect.coneAngle);
+        } else if (key == "radius") {
+            ok = static_cast<bool>(in >> effect.spawnRadius);
+        } else if (key == "gravity") {
+            ok = static_cast<bool>(in >> effect.sim.gravity.x >> effect.sim.gravity.y >> effect.sim.gravity.z);
+        } else if (key == "turbulence") {
+            ok = static_cast<bool>(in >> effect.sim.turbulence);
+        } else if (key == "drag") {
+            ok = static_cast<bool>(in >> effect.sim.drag);
+        } else if (key == "growth") {
+            ok = static_cast<bool>(in >> effect.sim.growth);
+        } else if (key == "collision") {
+            std::string response;
+            ok = static_cast<bool>(in >> response);
+            if (response == "none") {
+                effect.sim.collision.response = PARTICLE_COLLISION_NONE;
+            } else if (response == "bounce") {
+                effect.sim.collision.response = PARTICLE_COLLISION_BOUNCE;
+            } else if (response == "stick") {
+                effect.sim.collision.response = PARTICLE_COLLISION_STICK;
+            } else if (response == "kill") {
+                effect.sim.collision.response = PARTICLE_COLLISION_KILL;
+            } else {
+                ok = false;
+            }
+        } else if (key == "collision_radius") {
+            ok = static_cast<bool>(in >> effect.sim.collision.radius);
+        } else if (key == "restitution") {
+            ok = static_cast<bool>(in >> effect.sim.collision.restitution);
+        } else if (key == "friction") {
+            ok = static_cast<bool>(in >> effect.sim.collision.friction);
+        } else if (key == "color") {
+            ParticleColorKey colorKey;
+            ok = static_cast<bool>(in >> colorKey.age >> colorKey.color.x >> colorKey.color.y >> colorKey.color.z
+                                      >> colorKey.color.w);
+            if (ok) {
+                effect.colorKeys.push_back(colorKey);
+            }
+        } else if (key == "size") {
+            ParticleSizeKey sizeKey;
+            ok = static_cast<bool>(in >> sizeKey.age >> sizeKey.scale);
+            if (ok) {
+                effect.sizeKeys.push_back(sizeKey);
+            }
+        } else if (key == "children") {
+            std::string child;
+            while (in >> child) {
+                effect.children.push_back(child);
+            }
+        } else {
+            std::cerr << path << ":" << lineNumber << ": 未知的键 " << key << std::endl;
+            return false;
+        }
+        if (!ok) {
+            std::cerr << path << ":" << lineNumber << ": " << key << " 的值格式错误" << std::endl;
+            return false;
+        }
+    }
+
+    for (const ParticleEffectDesc& effect : effects) {
+        AddEffect(effect);
+    }
+    return true;
+}
+
+int ParticleWorld::AddEffect(const ParticleEffectDesc& effect) {
+    ParticleEffectDesc desc = effect;
+    desc.maxParticles = std::max(desc.maxParticles, 1);
+    desc.lifetimeMax = std::max(desc.lifetimeMax, desc.lifetimeMin);
+    desc.sizeMax = std::max(desc.sizeMax, desc.sizeMin);
+    desc.speedMax = std::max(desc.speedMax, desc.speedMin);
+    desc.direction = glm::dot(desc.direction, desc.direction) > 0.0f ? glm::normalize(desc.direction)
+                                                                    : glm::vec3(0.0f, 1.0f, 0.0f);
+    std::stable_sort(desc.colorKeys.begin(), desc.colorKeys.end(),
+                     [](const ParticleColorKey& a, const ParticleColorKey& b) { return a.age < b.age; });
+    std::stable_sort(desc.sizeKeys.begin(), desc.sizeKeys.end(),
+                     [](const ParticleSizeKey& a, const ParticleSizeKey& b) { return a.age < b.age; });
+
+    int existing = FindEffect(desc.name.c_str());
+    if (existing >= 0) {
+        m_effects[existing] = desc;
+        return existing;
+    }
+    m_effects.push_back(desc);
+    return static_cast<int>(m_effects.size()) - 1;
+}
+
+int ParticleWorld::FindEffect(const char* name) const {
+    for (size_t i = 0; i < m_effects.size(); i++) {
+        if (m_effects[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int ParticleWorld::Spawn(int effect, const glm::vec3& position, const glm::vec3& direction) {
+    int spawned = 0;
+    if (effect >= 0 && effect < GetEffectCount()) {
+        SpawnEmitter(effect, position, direction, 0, spawned);
+    }
+    return spawned;
+}
+
+void ParticleWorld::SpawnEmitter(int effect, const glm::vec3& position, const glm::vec3& direction, int depth,
+                                 int& spawned) {
+    const ParticleEffectDesc& desc = m_effects[effect];
+
+    std::unique_ptr<Emitter> emitter(new Emitter(desc.maxParticles));
+    emitter->effect = effect;
+    emitter->position = position;
+    emitter->direction = glm::dot(direction, direction) > 0.0f ? glm::normalize(direction) : desc.direction;
+    emitter->seed = HashParticleSeed(m_seed, m_spawnSerial++);
+    emitter->frame = 0;
+
+    ParticleSystem& particles = emitter->particles;
+    particles.Seed(emitter->seed);
+    particles.SetParams(desc.sim);
+    // 查找表按生命值（1 -> 0）采样，曲线按年龄（0 -> 1）定义
+    particles.SetColorGradient([&desc](float life) { return SampleParticleColor(desc.colorKeys, 1.0f - life); });
+    particles.SetSizeCurve([&desc](float life) { return SampleParticleSize(desc.sizeKeys, 1.0f - life); });
+
+    m_emitters.push_back(std::move(emitter));
+    spawned++;
+
+    if (depth >= MAX_CHILD_DEPTH) {
+        return;
+    }
+    for (const std::string& child : desc.children) {
+        int childEffect = FindEffect(child.c_str());
+        if (childEffect < 0) {
+            std::cerr << "粒子效果 " << desc.name << " 的子效果不存在: " << child << std::endl;
+            continue;
+        }
+        SpawnEmitter(childEffect, position, direction, depth + 1, spawned);
+    }
+}
+
+void ParticleWorld::Clear() {
+    m_emitters.clear();
+    m_stats = ParticleWorldStats();
+}
+
+void ParticleWorld::RunSpawnBatch(SpawnBatch& batch, int thread) {
+    const Emitter& emitter = *m_emitters[batch.emitter];
+    const ParticleEffectDesc& desc = m_effects[emitter.effect];
+    const float coneAngle = std::min(std::max(desc.coneAngle, 0.0f), 180.0f) * PI / 180.0f;
+
+    std::vector<SpawnRecord>& buffer = m_spawnBuffers[thread];
+    batch.thread = thread;
+    batch.offset = buffer.size();
+
+    ParticleRandom random(batch.seed);
+    for (int i = 0; i < batch.count; i++) {
+        SpawnRecord record;
+        record.position = emitter.position + RandomInSphere(random, desc.spawnRadius);
+        record.velocity = RandomConeDirection(random, emitter.direction, coneAngle) *
+                          random.Range(desc.speedMin, desc.speedMax);
+        record.size = random.Range(desc.sizeMin, desc.sizeMax);
+        record.lifetime = random.Range(desc.lifetimeMin, desc.lifetimeMax);
+        buffer.push_back(record);
+    }
+}
+
+void ParticleWorld::Update(float deltaTime) {
+    m_updateTasks.clear();
+    m_spawnBatches.clear();
+    m_stats = ParticleWorldStats();
+
+    // 1. 串行：决定每个发射器本帧发射多少，拆成批；登记更新的块
+    for (size_t e = 0; e < m_emitters.size(); e++) {
+        Emitter& emitter = *m_emitters[e];
+        const ParticleEffectDesc& desc = m_effects[emitter.effect];
+
+        int count = std::min(emitter.clock.Advance(desc, deltaTime), emitter.particles.GetCapacity());
+
+        for (int first = 0, batchIndex = 0; first < count; first += SPAWN_BATCH_SIZE, batchIndex++) {
+            SpawnBatch batch;
+            batch.emitter = static_cast<int>(e);
+            batch.count = std::min(SPAWN_BATCH_SIZE, count - first);
+            batch.seed = HashParticleSeed(emitter.seed, emitter.frame, static_cast<uint32_t>(batchIndex));
+            batch.thread = 0;
+            batch.offset = 0;
+            m_spawnBatches.push_back(batch);
+        }
+        emitter.frame++;
+
+        int chunks = emitter.particles.BeginUpdate();
+        for (int chunk = 0; chunk < chunks; chunk++) {
+            m_updateTasks.push_back({static_cast<int>(e), chunk, 0});
+        }
+    }
+
+    // 2. 并行：更新已有粒子的各个块，生成新粒子写进各线程的缓冲区
+    int threadCount = m_jobs ? m_jobs->GetThreadCount() : 1;
+    if (static_cast<int>(m_spawnBuffers.size()) < threadCount) {
+        m_spawnBuffers.resize(threadCount);
+    }
+    for (std::vector<SpawnRecord>& buffer : m_spawnBuffers) {
+        buffer.clear();
+    }
+
+    int updateCount = static_cast<int>(m_updateTasks.size());
+    int taskCount = updateCount + static_cast<int>(m_spawnBatches.size());
+    auto runTasks = [this, updateCount, deltaTime](int begin, int end, int thread) {
+        for (int task = begin; task < end; task++) {
+            if (task < updateCount) {
+                UpdateTask& update = m_updateTasks[task];
+                ParticleSystem& particles = m_emitters[update.emitter]->particles;
+                particles.UpdateChunk(update.chunk, deltaTime);
+                if (m_collider) {
+                    update.contacts = particles.CollideChunk(update.chunk, *m_collider);
+                }
+            } else {
+                RunSpawnBatch(m_spawnBatches[task - updateCount], thread);
+            }
+        }
+    };
+    if (m_jobs) {
+        m_jobs->ParallelFor(taskCount, runTasks, 1);
+    } else {
+        runTasks(0, taskCount, 0);
+    }
+
+    // 3. 串行：合并各块，按发射器和批的顺序加入新粒子
+    for (std::unique_ptr<Emitter>& emitter : m_emitters) {
+        emitter->particles.EndUpdate();
+    }
+    for (const SpawnBatch& batch : m_spawnBatches) {
+        ParticleSystem& particles = m_emitters[batch.emitter]->particles;
+        const SpawnRecord* records = &m_spawnBuffers[batch.thread][batch.offset];
+        for (int i = 0; i < batch.count; i++) {
+            if (particles.Spawn(records[i].position, records[i].velocity, records[i].size, records[i].lifetime) < 0) {
+                break;
+            }
+            m_stats.spawned++;
+        }
+    }
+
+    // 4. 删除不再发射且没有粒子的发射器，保持其余的顺序
+    m_emitters.erase(std::remove_if(m_emitters.begin(), m_emitters.end(),
+                                    [this](const std::unique_ptr<Emitter>& emitter) {
+                                        return !emitter->clock.IsEmitting(m_effects[emitter->effect]) &&
+                                               emitter->particles.GetCount() == 0;
+                                    }),
+                     m_emitters.end());
+
+    m_stats.emitters = static_cast<int>(m_emitters.size());
+    for (const std::unique_ptr<Emitter>& emitter : m_emitters) {
+        m_stats.particles += emitter->particles.GetCount();
+    }
+    m_stats.updateChunks = updateCount;
+    for (const UpdateTask& update : m_updateTasks) {
+        m_stats.collisions += update.contacts;
+    }
+    m_stats.spawnBatches = static_cast<int>(m_spawnBatches.size());
+}
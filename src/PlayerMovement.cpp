@@ -0,0 +1,274 @@
+#include "PlayerMovement.h"
+#include "CollisionWorld.h"
+#include "LevelGeometry.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 离开地面的检测距离：在地面上时向下找这么远，能跟着走下小台阶和斜坡
+const float GROUND_PROBE = 0.05f;
+// 站在地面上时离表面的距离，与MoveCapsule停下的距离相同
+const float GROUND_SKIN = 1e-3f;
+// 检查台阶边上面的表面时，从接触点向台阶里面偏移的距离
+const float EDGE_OFFSET = 0.01f;
+const float HALF_PI = 1.57079632679f;
+
+// [0, pi/2) 上的sin和cos，泰勒级数到x^13，误差小于1e-7；只用加法和乘法，各平台结果相同
+void sinCosQuadrant(float x, float& s, float& c) {
+    float x2 = x * x;
+    s = x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f + x2 * (1.0f / 362880.0f +
+        x2 * (-1.0f / 39916800.0f + x2 * (1.0f / 6227020800.0f)))))));
+    c = 1.0f + x2 * (-0.5f + x2 * (1.0f / 24.0f + x2 * (-1.0f / 720.0f + x2 * (1.0f / 40320.0f +
+        x2 * (-1.0f / 3628800.0f + x2 * (1.0f / 479001600.0f))))));
+}
+
+// 保留速度中不指向表面的部分
+void clipVelocity(glm::vec3& velocity, const glm::vec3& normal) {
+    float into = glm::dot(velocity, normal);
+    if (into < 0.0f) {
+        velocity -= normal * into;
+    }
+}
+
+} // namespace
+
+PlayerMovement::PlayerMovement(const MovementSettings& settings) : m_settings(settings), m_world(nullptr) {
+}
+
+uint16_t PlayerMovement::QuantizeYaw(float degrees) {
+    float turns = degrees / 360.0f;
+    turns -= std::floor(turns);
+    return static_cast<uint16_t>(static_cast<int>(std::lround(turns * 65536.0f)) & 0xFFFF);
+}
+
+int16_t PlayerMovement::QuantizePitch(float degrees) {
+    float clamped = glm::clamp(degrees, -90.0f, 90.0f);
+    return static_cast<int16_t>(std::lround(clamped / 90.0f * 16384.0f));
+}
+
+void PlayerMovement::YawVectors(uint16_t yaw, glm::vec3& forward, glm::vec3& right) {
+    // 象限由高两位决定，象限内的角度精确地换成弧度
+    int quadrant = yaw >> 14;
+    float x = static_cast<float>(yaw & 0x3FFF) * (HALF_PI / 16384.0f);
+    float s, c;
+    sinCosQuadrant(x, s, c);
+    float sinYaw, cosYaw;
+    switch (quadrant) {
+    case 0:  sinYaw = s;  cosYaw = c;  break;
+    case 1:  sinYaw = c;  cosYaw = -s; break;
+    case 2:  sinYaw = -s; cosYaw = -c; break;
+    default: sinYaw = -c; cosYaw = s;  break;
+    }
+    forward = glm::vec3(cosYaw, 0.0f, sinYaw);
+    right = glm::vec3(-sinYaw, 0.0f, cosYaw);
+}
+
+float PlayerMovement::GetHeight(const PlayerState& state) const {
+    return m_settings.standHeight + (m_settings.duckHeight - m_settings.standHeight) * state.duckAmount;
+}
+
+float PlayerMovement::GetEyeHeight(const PlayerState& state) const {
+    return m_settings.standEyeHeight + (m_settings.duckEyeHeight - m_settings.standEyeHeight) * state.duckAmount;
+}
+
+void PlayerMovement::Simulate(PlayerState& state, const PlayerCommand& command) const {
+    const float dt = GetTickSeconds();
+    UpdateDuck(state, (command.buttons & BUTTON_DUCK) != 0);
+
+    // 想要的移动方向和速度
+    glm::vec3 forward, right;
+    YawVectors(command.yaw, forward, right);
+    glm::vec3 wish = forward * (command.forward / 127.0f) + right * (command.side / 127.0f);
+    float wishLength = std::sqrt(glm::dot(wish, wish));
+    glm::vec3 wishDirection(0.0f);
+    float wishSpeed = 0.0f;
+    if (wishLength > 1e-6f) {
+        wishDirection = wish / wishLength;
+        wishSpeed = m_settings.maxSpeed * std::min(wishLength, 1.0f);
+        if (command.buttons & BUTTON_WALK) {
+            wishSpeed *= m_settings.walkScale;
+        }
+        wishSpeed *= 1.0f + (m_settings.duckScale - 1.0f) * state.duckAmount;
+    }
+
+    bool jumpPressed = (command.buttons & BUTTON_JUMP) && !(state.previousButtons & BUTTON_JUMP);
+    state.previousButtons = command.buttons;
+    if (state.onGround && jumpPressed) {
+        state.velocity.y = m_settings.jumpSpeed;
+        state.onGround = 0;
+    }
+
+    if (state.onGround) {
+        // 摩擦：慢的时候按stopSpeed计算，很快停下
+        glm::vec3 horizontal(state.velocity.x, 0.0f, state.velocity.z);
+        float speed = std::sqrt(glm::dot(horizontal, horizontal));
+        if (speed > 1e-4f) {
+            float drop = std::max(speed, m_settings.stopSpeed) * m_settings.friction * dt;
+            float scale = std::max(speed - drop, 0.0f) / speed;
+            state.velocity.x *= scale;
+            state.velocity.z *= scale;
+        } else {
+            state.velocity.x = 0.0f;
+            state.velocity.z = 0.0f;
+        }
+        // 加速：只补足wishDirection方向上缺的速度
+        float current = glm::dot(state.velocity, wishDirection);
+        float add = wishSpeed - current;
+        if (add > 0.0f) {
+            float accelerate = std::min(m_settings.acceleration * wishSpeed * dt, add);
+            state.velocity += wishDirection * accelerate;
+        }
+        state.velocity.y = 0.0f;
+        GroundMove(state, state.velocity * dt);
+    } else {
+        // 空中加速时缺的速度按maxAirWishSpeed算，但加速度按完整的wishSpeed，可以在空中转向（扫射跳）
+        float current = glm::dot(state.velocity, wishDirection);
+        float add = std::min(wishSpeed, m_settings.maxAirWishSpeed) - current;
+        if (add > 0.0f) {
+            float accelerate = std::min(m_settings.airAcceleration * wishSpeed * dt, add);
+            state.velocity += wishDirection * accelerate;
+        }
+        // 重力在移动前后各加一半，抛物线与帧率无关
+        state.velocity.y -= m_settings.gravity * dt * 0.5f;
+        AirMove(state, state.velocity * dt);
+        state.velocity.y -= m_settings.gravity * dt * 0.5f;
+    }
+
+    CategorizePosition(state, state.onGround ? m_settings.stepHeight : GROUND_PROBE);
+    if (state.onGround) {
+        state.velocity.y = 0.0f;
+    }
+}
+
+void PlayerMovement::UpdateDuck(PlayerState& state, bool duck) const {
+    const float step = m_settings.duckSpeed * GetTickSeconds();
+    if (duck) {
+        state.duckAmount = std::min(state.duckAmount + step, 1.0f);
+        return;
+    }
+    if (state.duckAmount <= 0.0f) {
+        return;
+    }
+    // 站起来需要头顶有空间
+    float target = std::max(state.duckAmount - step, 0.0f);
+    float grow = (m_settings.duckHeight - m_settings.standHeight) * (target - state.duckAmount);
+    if (m_world) {
+        float radius = m_settings.radius;
+        float height = GetHeight(state);
+        SweepHit hit;
+        if (m_world->SweepCapsule(state.position + glm::vec3(0.0f, radius, 0.0f),
+                                  glm::vec3(0.0f, height - 2.0f * radius, 0.0f), glm::vec3(0.0f, grow, 0.0f),
+                                  radius, hit)) {
+            return;
+        }
+    }
+    state.duckAmount = target;
+}
+
+glm::vec3 PlayerMovement::SlideMove(const glm::vec3& position, float height, const glm::vec3& delta, bool ground,
+                                    glm::vec3* velocity, bool& blocked) const {
+    blocked = false;
+    if (!m_world) {
+        return position + delta;
+    }
+    const float radius = m_settings.radius;
+    glm::vec3 lift(0.0f, radius, 0.0f);
+    CollisionMoveResult result = m_world->MoveCapsule(position + lift, glm::vec3(0.0f, height - 2.0f * radius, 0.0f),
+                                                      delta, radius);
+    for (int i = 0; i < result.contactCount; i++) {
+        // 在地面上碰到能站住的面（斜坡、台阶的边）不减速，贴地由CategorizePosition处理
+        bool walkable = result.normals[i].y >= m_settings.maxWalkSlope;
+        if (velocity && !(walkable && ground)) {
+            clipVelocity(*velocity, result.normals[i]);
+        }
+        if (!walkable) {
+            blocked = true;
+        }
+    }
+    return result.position - lift;
+}
+
+void PlayerMovement::GroundMove(PlayerState& state, const glm::vec3& delta) const {
+    float height = GetHeight(state);
+    glm::vec3 velocity = state.velocity;
+    bool blocked;
+    glm::vec3 moved = SlideMove(state.position, height, delta, true, &velocity, blocked);
+    if (blocked) {
+        StepMove(state, height, delta, moved, velocity);
+    }
+    state.position = moved;
+    state.velocity = velocity;
+    // 在地面上顺着台阶边滑动时不会获得向上的速度
+    state.velocity.y = 0.0f;
+}
+
+void PlayerMovement::StepMove(const PlayerState& state, float height, const glm::vec3& delta, glm::vec3& moved,
+                              glm::vec3& velocity) const {
+    // 抬高一个台阶再走，然后落回地面，走得更远就上台阶
+    bool ignored;
+    glm::vec3 raised = SlideMove(state.position, height, glm::vec3(0.0f, m_settings.stepHeight, 0.0f), true,
+                                 nullptr, ignored);
+    glm::vec3 stepVelocity = state.velocity;
+    glm::vec3 across = SlideMove(raised, height, glm::vec3(delta.x, 0.0f, delta.z), true, &stepVelocity,
+                                 ignored);
+    SweepHit hit;
+    const float radius = m_settings.radius;
+    float drop = across.y - state.position.y + GROUND_PROBE;
+    bool landed = m_world->SweepCapsule(across + glm::vec3(0.0f, radius, 0.0f),
+                                        glm::vec3(0.0f, height - 2.0f * radius, 0.0f), glm::vec3(0.0f, -drop, 0.0f),
+                                        radius, hit);
+    if (landed && hit.depth == 0.0f && IsStandable(hit)) {
+        glm::vec3 stepped = hit.position - glm::vec3(0.0f, radius - GROUND_SKIN, 0.0f);
+        float movedDistance = glm::length(glm::vec3(moved.x - state.position.x, 0.0f, moved.z - state.position.z));
+        float steppedDistance = glm::length(glm::vec3(stepped.x - state.position.x, 0.0f,
+                                                      stepped.z - state.position.z));
+        if (steppedDistance >= movedDistance - 1e-4f) {
+            moved = stepped;
+            velocity = stepVelocity;
+        }
+    }
+}
+
+void PlayerMovement::AirMove(PlayerState& state, const glm::vec3& delta) const {
+    bool blocked;
+    state.position = SlideMove(state.position, GetHeight(state), delta, false, &state.velocity, blocked);
+}
+
+void PlayerMovement::CategorizePosition(PlayerState& state, float probe) const {
+    // 向上跳的时候不会落地
+    if (!m_world || state.velocity.y > 0.0f) {
+        state.onGround = 0;
+        return;
+    }
+    const float radius = m_settings.radius;
+    float height = GetHeight(state);
+    SweepHit hit;
+    bool found = m_world->SweepCapsule(state.position + glm::vec3(0.0f, radius, 0.0f),
+                                       glm::vec3(0.0f, height - 2.0f * radius, 0.0f), glm::vec3(0.0f, -probe, 0.0f),
+                                       radius, hit);
+    if (!found || !IsStandable(hit)) {
+        state.onGround = 0;
+        return;
+    }
+    state.onGround = 1;
+    // 贴到地面上（开始时已经相交的沿法线推出来）
+    state.position = hit.position + hit.normal * (hit.depth + GROUND_SKIN) - glm::vec3(0.0f, radius, 0.0f);
+}
+
+bool PlayerMovement::IsStandable(const SweepHit& hit) const {
+    if (hit.normal.y >= m_settings.maxWalkSlope) {
+        return true;
+    }
+    if (hit.normal.y <= 0.0f) {
+        return false;
+    }
+    // 胶囊底部的球搭在边上时法线是斜的，看接触点里面一点的表面是不是平缓的
+    glm::vec3 inward(-hit.normal.x, 0.0f, -hit.normal.z);
+    inward /= std::sqrt(glm::dot(inward, inward));
+    glm::vec3 contact = hit.position - hit.normal * m_settings.radius;
+    LevelHit below;
+    return m_world->Raycast(contact + inward * EDGE_OFFSET + glm::vec3(0.0f, GROUND_PROBE, 0.0f),
+                            glm::vec3(0.0f, -1.0f, 0.0f), 2.0f * GROUND_PROBE, below) &&
+           below.normal.y >= m_settings.maxWalkSlope;
+}
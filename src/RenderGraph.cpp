@@ -0,0 +1,537 @@
+#include "RenderGraph.h"
+#include "Renderer.h"
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// 所有全屏pass共用的顶点shader，兼容固定管线上下文（GLSL 1.20）
+const char* FULLSCREEN_VERTEX_SHADER = R"(
+#version 120
+varying vec2 uv;
+void main() {
+    uv = gl_MultiTexCoord0.xy;
+    gl_Position = gl_Vertex;
+}
+)";
+
+const int MAX_PASS_INPUTS = 4;
+
+} // namespace
+
+RenderGraph::RenderGraph(Renderer& renderer)
+    : m_renderer(renderer), m_compiled(false) {
+}
+
+void RenderGraph::Reset() {
+    m_resources.clear();
+    m_passes.clear();
+    m_groups.clear();
+    m_stats = RenderGraphStats();
+    m_compiled = false;
+}
+
+int RenderGraph::ImportTexture(const char* name, unsigned int texture, unsigned int framebuffer,
+                               int width, int height, int usedWidth, int usedHeight) {
+    ResourceNode resource;
+    resource.name = name;
+    resource.width = width;
+    resource.height = height;
+    resource.usedWidth = usedWidth;
+    resource.usedHeight = usedHeight;
+    resource.imported = true;
+    resource.texture = texture;
+    resource.framebuffer = framebuffer;
+    resource.writer = -1;
+    resource.readers = 0;
+    resource.physical = -1;
+    m_resources.push_back(resource);
+    return static_cast<int>(m_resources.size()) - 1;
+}
+
+int RenderGraph::ImportBackbuffer(int width, int height) {
+    return ImportTexture("backbuffer", 0, 0, width, height, width, height);
+}
+
+int RenderGraph::CreateTexture(const char* name, int width, int height, int usedWidth, int usedHeight) {
+    int index = ImportTexture(name, 0, 0, std::max(width, 1), std::max(height, 1),
+                              std::max(std::min(usedWidth, width), 1), std::max(std::min(usedHeight, height), 1));
+    m_resources[index].imported = false;
+    return index;
+}
+
+int RenderGraph::AddFullscreenPass(const char* name, FullscreenPassType type, const char* code,
+                                   const std::vector<int>& inputs, int output, const glm::vec4& params) {
+    if (inputs.empty() || inputs.size() > MAX_PASS_INPUTS) {
+        std::cerr << "RenderGraph: pass " << name << " needs 1-" << MAX_PASS_INPUTS << " inputs" << std::endl;
+        return -1;
+    }
+    int index = AddPass(name, inputs, output, ExecuteFunc());
+    if (index >= 0) {
+        m_passes[index].fullscreen = true;
+        m_passes[index].type = type;
+        m_passes[index].code = code;
+        m_passes[index].params = params;
+    }
+    return index;
+}
+
+int RenderGraph::AddPass(const char* name, const std::vector<int>& reads, int output, const ExecuteFunc& execute) {
+    int resourceCount = static_cast<int>(m_resources.size());
+    for (int read : reads) {
+        if (read < 0 || read >= resourceCount || read == output) {
+            std::cerr << "RenderGraph: pass " << name << " has an invalid input" << std::endl;
+            return -1;
+        }
+    }
+    if (output < 0 || output >= resourceCount || m_resources[output].writer >= 0) {
+        std::cerr << "RenderGraph: pass " << name << " has an invalid output" << std::endl;
+        return -1;
+    }
+    if (m_resources[output].imported && m_resources[output].framebuffer == 0 && m_resources[output].texture != 0) {
+        std::cerr << "RenderGraph: " << m_resources[output].name << " is read-only" << std::endl;
+        return -1;
+    }
+
+    PassNode pass;
+    pass.name = name;
+    pass.fullscreen = false;
+    pass.type = FULLSCREEN_SAMPLE;
+    pass.inputs = reads;
+    pass.output = output;
+    pass.params = glm::vec4(0.0f);
+    pass.execute = execute;
+    pass.alive = false;
+    pass.group = -1;
+    m_passes.push_back(pass);
+
+    int index = static_cast<int>(m_passes.size()) - 1;
+    m_resources[output].writer = index;
+    return index;
+}
+
+bool RenderGraph::Compile() {
+    m_groups.clear();
+    m_stats = RenderGraphStats();
+    m_stats.declaredPasses = static_cast<int>(m_passes.size());
+    for (const ResourceNode& resource : m_resources) {
+        if (!resource.imported) {
+            m_stats.virtualTextures++;
+        }
+    }
+
+    CullPasses();
+    FusePasses();
+    m_compiled = SortGroups();
+    if (m_compiled) {
+        AllocateTextures();
+    }
+    return m_compiled;
+}
+
+void RenderGraph::CullPasses() {
+    // 从写入导入资源的pass出发，沿读取关系向上标记
+    std::vector<int> stack;
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        m_passes[i].alive = m_resources[m_passes[i].output].imported;
+        if (m_passes[i].alive) {
+            stack.push_back(static_cast<int>(i));
+        }
+    }
+    while (!stack.empty()) {
+        int pass = stack.back();
+        stack.pop_back();
+        for (int input : m_passes[pass].inputs) {
+            int writer = m_resources[input].writer;
+            if (writer >= 0 && !m_passes[writer].alive) {
+                m_passes[writer].alive = true;
+                stack.push_back(writer);
+            }
+        }
+    }
+
+    for (ResourceNode& resource : m_resources) {
+        resource.readers = 0;
+        resource.physical = -1;
+    }
+    for (const PassNode& pass : m_passes) {
+        if (pass.alive) {
+            for (int input : pass.inputs) {
+                m_resources[input].readers++;
+            }
+        } else {
+            m_stats.culledPasses++;
+        }
+    }
+}
+
+void RenderGraph::FusePasses() {
+    std::vector<std::vector<int> > groups(m_passes.size());
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        if (m_passes[i].alive) {
+            groups[i].push_back(static_cast<int>(i));
+            m_passes[i].group = static_cast<int>(i);
+        }
+    }
+
+    // 考虑每个逐像素pass时它一定还在组的开头（只有它自己的第一个输入能合并到它前面），
+    // 所以把写入者的整个组接到前面即可，链可以任意长
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        const PassNode& pass = m_passes[i];
+        if (!pass.alive || !pass.fullscreen || pass.type != FULLSCREEN_POINTWISE) {
+            continue;
+        }
+        const ResourceNode& input = m_resources[pass.inputs[0]];
+        const ResourceNode& output = m_resources[pass.output];
+        if (input.imported || input.readers != 1 || input.writer < 0 || !m_passes[input.writer].fullscreen) {
+            continue;
+        }
+        if (input.usedWidth != output.usedWidth || input.usedHeight != output.usedHeight) {
+            continue;
+        }
+
+        int from = m_passes[input.writer].group;
+        int to = pass.group;
+        groups[to].insert(groups[to].begin(), groups[from].begin(), groups[from].end());
+        for (int moved : groups[from]) {
+            m_passes[moved].group = to;
+        }
+        groups[from].clear();
+        m_stats.fusedPasses++;
+    }
+
+    for (size_t g = 0; g < groups.size(); g++) {
+        if (groups[g].empty()) {
+            continue;
+        }
+        PassGroup group;
+        group.passes = groups[g];
+        for (int pass : group.passes) {
+            m_passes[pass].group = static_cast<int>(m_groups.size());
+        }
+        group.output = m_passes[groups[g].back()].output;
+        for (size_t i = 0; i < group.passes.size(); i++) {
+            const PassNode& pass = m_passes[group.passes[i]];
+            // 组内后续pass的第一个输入来自前一个pass
+            for (size_t k = (i > 0 ? 1 : 0); k < pass.inputs.size(); k++) {
+                if (std::find(group.inputs.begin(), group.inputs.end(), pass.inputs[k]) == group.inputs.end()) {
+                    group.inputs.push_back(pass.inputs[k]);
+                }
+            }
+        }
+        m_groups.push_back(group);
+    }
+}
+
+bool RenderGraph::SortGroups() {
+    // Kahn拓扑排序，m_groups已经按输出pass的声明顺序排列，可选的组里取最早的
+    size_t count = m_groups.size();
+    std::vector<std::vector<int> > dependencies(count);
+    for (size_t g = 0; g < count; g++) {
+        for (int input : m_groups[g].inputs) {
+            int writer = m_resources[input].writer;
+            if (writer >= 0 && m_passes[writer].alive) {
+                dependencies[g].push_back(m_passes[writer].group);
+            }
+        }
+    }
+
+    std::vector<PassGroup> sorted;
+    std::vector<bool> done(count, false);
+    sorted.reserve(count);
+    while (sorted.size() < count) {
+        int next = -1;
+        for (size_t g = 0; g < count && next < 0; g++) {
+            if (done[g]) {
+                continue;
+            }
+            bool ready = true;
+            for (int dependency : dependencies[g]) {
+                if (!done[dependency]) {
+                    ready = false;
+                    break;
+                }
+            }
+            if (ready) {
+                next = static_cast<int>(g);
+            }
+        }
+        if (next < 0) {
+            std::cerr << "RenderGraph: dependency cycle" << std::endl;
+            m_groups.clear();
+            return false;
+        }
+        done[next] = true;
+        sorted.push_back(m_groups[next]);
+    }
+
+    m_groups.swap(sorted);
+    for (size_t g = 0; g < m_groups.size(); g++) {
+        for (int pass : m_groups[g].passes) {
+            m_passes[pass].group = static_cast<int>(g);
+        }
+    }
+    m_stats.executedPasses = static_cast<int>(m_groups.size());
+    return true;
+}
+
+void RenderGraph::AllocateTextures() {
+    // 每个临时资源的最后一次读取（组下标）
+    std::vector<int> lastUse(m_resources.size(), -1);
+    for (size_t g = 0; g < m_groups.size(); g++) {
+        for (int input : m_groups[g].inputs) {
+            lastUse[input] = static_cast<int>(g);
+        }
+    }
+
+    for (PhysicalTexture& texture : m_pool) {
+        texture.used = false;
+    }
+    std::vector<bool> busy(m_pool.size(), false);
+    for (size_t g = 0; g < m_groups.size(); g++) {
+        // 先分配输出再释放输入：同一个pass不能读写同一张纹理
+        ResourceNode& output = m_resources[m_groups[g].output];
+        if (!output.imported) {
+            output.physical = AcquirePhysical(output.width, output.height, busy);
+        }
+        for (int input : m_groups[g].inputs) {
+            const ResourceNode& resource = m_resources[input];
+            if (!resource.imported && resource.physical >= 0 && lastUse[input] == static_cast<int>(g)) {
+                busy[resource.physical] = false;
+            }
+        }
+    }
+
+    // 本帧没有用到的纹理释放掉（窗口大小改变、效果关闭），其余的下标保持不变
+    std::vector<int> remap(m_pool.size(), -1);
+    std::vector<PhysicalTexture> kept;
+    for (size_t i = 0; i < m_pool.size(); i++) {
+        if (m_pool[i].used) {
+            remap[i] = static_cast<int>(kept.size());
+            kept.push_back(m_pool[i]);
+            m_stats.physicalBytes += static_cast<size_t>(m_pool[i].width) * m_pool[i].height * 4;
+        } else {
+            glDeleteFramebuffers(1, &m_pool[i].framebuffer);
+            glDeleteTextures(1, &m_pool[i].texture);
+        }
+    }
+    m_pool.swap(kept);
+    for (ResourceNode& resource : m_resources) {
+        if (resource.physical >= 0) {
+            resource.physical = remap[resource.physical];
+        }
+    }
+    m_stats.physicalTextures = static_cast<int>(m_pool.size());
+}
+
+int RenderGraph::AcquirePhysical(int width, int height, std::vector<bool>& busy) {
+    for (size_t i = 0; i < m_pool.size(); i++) {
+        if (!busy[i] && m_pool[i].width == width && m_pool[i].height == height) {
+            busy[i] = true;
+            m_pool[i].used = true;
+            return static_cast<int>(i);
+        }
+    }
+
+    PhysicalTexture texture;
+    texture.width = width;
+    texture.height = height;
+    texture.used = true;
+
+    glGenTextures(1, &texture.texture);
+    glBindTexture(GL_TEXTURE_2D, texture.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &texture.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, texture.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture.texture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "RenderGraph framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+    }
+
+    m_pool.push_back(texture);
+    busy.push_back(true);
+    return static_cast<int>(m_pool.size()) - 1;
+}
+
+std::string RenderGraph::GenerateShader(const PassGroup& group) const {
+    std::ostringstream source;
+    source << "#version 120\nvarying vec2 uv;\n";
+
+    // 每个外部输入一个采样函数，坐标从使用区域的[0, 1]换算到纹理并限制在使用区域内
+    for (size_t k = 0; k < group.inputs.size(); k++) {
+        source << "uniform sampler2D t" << k << ";\n"
+               << "uniform vec2 t" << k << "_scale;\n"
+               << "uniform vec2 t" << k << "_texel;\n"
+               << "vec4 sample" << k << "(vec2 p) {\n"
+               << "    vec2 h = 0.5 * t" << k << "_texel * t" << k << "_scale;\n"
+               << "    return texture2D(t" << k << ", clamp(p * t" << k << "_scale, h, t" << k << "_scale - h));\n"
+               << "}\n";
+    }
+
+    for (size_t i = 0; i < group.passes.size(); i++) {
+        const PassNode& pass = m_passes[group.passes[i]];
+        source << "uniform vec4 p" << i << ";\n";
+
+        // 替换占位符
+        const std::string& code = pass.code;
+        for (size_t c = 0; c < code.size(); c++) {
+            if (code[c] != '$') {
+                source << code[c];
+                continue;
+            }
+            size_t rest = c + 1;
+            if (code.compare(rest, 2, "fn") == 0) {
+                source << "pass" << i;
+                c = rest + 1;
+            } else if (code.compare(rest, 5, "texel") == 0 && rest + 5 < code.size() && isdigit(code[rest + 5])) {
+                int input = code[rest + 5] - '0';
+                size_t slot = std::find(group.inputs.begin(), group.inputs.end(), pass.inputs[input]) - group.inputs.begin();
+                source << "t" << slot << "_texel";
+                c = rest + 5;
+            } else if (rest < code.size() && isdigit(code[rest])) {
+                int input = code[rest] - '0';
+                size_t slot = std::find(group.inputs.begin(), group.inputs.end(), pass.inputs[input]) - group.inputs.begin();
+                source << "sample" << slot;
+                c = rest;
+            } else if (rest < code.size() && code[rest] == 'p') {
+                source << "p" << i;
+                c = rest;
+            } else {
+                source << code[c];
+            }
+        }
+        source << "\n";
+    }
+
+    const PassNode& head = m_passes[group.passes[0]];
+    source << "void main() {\n";
+    if (head.type == FULLSCREEN_SAMPLE) {
+        source << "    vec4 c = pass0(uv);\n";
+    } else {
+        size_t slot = std::find(group.inputs.begin(), group.inputs.end(), head.inputs[0]) - group.inputs.begin();
+        source << "    vec4 c = pass0(sample" << slot << "(uv), uv);\n";
+    }
+    for (size_t i = 1; i < group.passes.size(); i++) {
+        source << "    c = pass" << i << "(c, uv);\n";
+    }
+    source << "    gl_FragColor = c;\n}\n";
+    return source.str();
+}
+
+unsigned int RenderGraph::GetProgram(const PassGroup& group) {
+    std::string key;
+    for (int pass : group.passes) {
+        key += m_passes[pass].name;
+        key += '+';
+    }
+    std::map<std::string, unsigned int>::iterator found = m_programs.find(key);
+    if (found != m_programs.end()) {
+        return found->second;
+    }
+    unsigned int program = m_renderer.CreateShader(FULLSCREEN_VERTEX_SHADER, GenerateShader(group));
+    m_programs[key] = program;
+    return program;
+}
+
+void RenderGraph::Execute() {
+    if (!m_compiled) {
+        return;
+    }
+
+    glPushAttrib(GL_ENABLE_BIT | GL_DEPTH_BUFFER_BIT | GL_VIEWPORT_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glDepthMask(GL_FALSE);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    for (const PassGroup& group : m_groups) {
+        ExecuteGroup(group);
+    }
+
+    glUseProgram(0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glPopAttrib();
+}
+
+void RenderGraph::ExecuteGroup(const PassGroup& group) {
+    const ResourceNode& output = m_resources[group.output];
+    unsigned int framebuffer = output.imported ? output.framebuffer : m_pool[output.physical].framebuffer;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, output.usedWidth, output.usedHeight);
+
+    const PassNode& head = m_passes[group.passes[0]];
+    if (!head.fullscreen) {
+        if (head.execute) {
+            head.execute();
+        }
+        return;
+    }
+
+    unsigned int program = GetProgram(group);
+    m_renderer.UseShader(program);
+    for (size_t k = 0; k < group.inputs.size(); k++) {
+        const ResourceNode& input = m_resources[group.inputs[k]];
+        unsigned int texture = input.imported ? input.texture : m_pool[input.physical].texture;
+        glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(k));
+        glBindTexture(GL_TEXTURE_2D, texture);
+
+        std::string name = "t" + std::to_string(k);
+        m_renderer.SetUniform1i(program, name, static_cast<int>(k));
+        glUniform2f(glGetUniformLocation(program, (name + "_scale").c_str()),
+                    float(input.usedWidth) / input.width, float(input.usedHeight) / input.height);
+        glUniform2f(glGetUniformLocation(program, (name + "_texel").c_str()),
+                    1.0f / input.usedWidth, 1.0f / input.usedHeight);
+    }
+    for (size_t i = 0; i < group.passes.size(); i++) {
+        const glm::vec4& params = m_passes[group.passes[i]].params;
+        glUniform4f(glGetUniformLocation(program, ("p" + std::to_string(i)).c_str()),
+                    params.x, params.y, params.z, params.w);
+    }
+
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f); glVertex2f(-1.0f, -1.0f);
+    glTexCoord2f(1.0f, 0.0f); glVertex2f(1.0f, -1.0f);
+    glTexCoord2f(1.0f, 1.0f); glVertex2f(1.0f, 1.0f);
+    glTexCoord2f(0.0f, 1.0f); glVertex2f(-1.0f, 1.0f);
+    glEnd();
+}
+
+void RenderGraph::Release() {
+    for (PhysicalTexture& texture : m_pool) {
+        glDeleteFramebuffers(1, &texture.framebuffer);
+        glDeleteTextures(1, &texture.texture);
+    }
+    m_pool.clear();
+    for (std::map<std::string, unsigned int>::iterator it = m_programs.begin(); it != m_programs.end(); ++it) {
+        m_renderer.DeleteShader(it->second);
+    }
+    m_programs.clear();
+    Reset();
+}
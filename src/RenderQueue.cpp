@@ -0,0 +1,132 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const int KEY_BITS = 44;
+const int RADIX_BITS = 11;
+const int RADIX_SIZE = 1 << RADIX_BITS;
+const int RADIX_PASSES = (KEY_BITS + RADIX_BITS - 1) / RADIX_BITS;
+
+const int PASS_SHIFT = 42;
+const uint64_t DEPTH_MASK = 0xFFFFFF;
+const uint64_t PROGRAM_MASK = RenderQueue::MAX_PROGRAMS - 1;
+const uint64_t MATERIAL_MASK = RenderQueue::MAX_MATERIALS - 1;
+
+uint64_t QuantizeDepth(float depth) {
+    depth = std::clamp(depth, 0.0f, 1.0f);
+    return static_cast<uint64_t>(depth * static_cast<float>(DEPTH_MASK)) & DEPTH_MASK;
+}
+
+} // namespace
+
+RenderQueue::RenderQueue() {
+}
+
+void RenderQueue::Reserve(size_t count) {
+    m_items.reserve(count);
+    m_payloads.reserve(count);
+    m_tempItems.reserve(count);
+}
+
+void RenderQueue::Clear() {
+    m_items.clear();
+    m_payloads.clear();
+}
+
+void RenderQueue::Submit(Pass pass, uint32_t program, uint32_t material, float depth, uint32_t payload) {
+    if (m_items.size() >= MAX_DRAWS) {
+        return;
+    }
+    uint64_t index = m_items.size();
+    m_items.push_back((MakeKey(pass, program, material, depth) << INDEX_BITS) | index);
+    m_payloads.push_back(payload);
+}
+
+uint64_t RenderQueue::MakeKey(Pass pass, uint32_t program, uint32_t material, float depth) {
+    uint64_t key = static_cast<uint64_t>(pass & 0x3) << PASS_SHIFT;
+    uint64_t d = QuantizeDepth(depth);
+
+    if (pass != PASS_TRANSLUCENT) {
+        key |= (program & PROGRAM_MASK) << 36;
+        key |= (material & MATERIAL_MASK) << 24;
+        key |= d;
+    } else {
+        // 深度取反，升序排序即得到由远到近
+        key |= (~d & DEPTH_MASK) << 18;
+        key |= (program & PROGRAM_MASK) << 12;
+        key |= (material & MATERIAL_MASK);
+    }
+    return key;
+}
+
+RenderQueue::Pass RenderQueue::GetPass(uint64_t key) {
+    return static_cast<Pass>((key >> PASS_SHIFT) & 0x3);
+}
+
+uint32_t RenderQueue::GetProgram(uint64_t key) {
+    if (GetPass(key) != PASS_TRANSLUCENT) {
+        return static_cast<uint32_t>((key >> 36) & PROGRAM_MASK);
+    }
+    return static_cast<uint32_t>((key >> 12) & PROGRAM_MASK);
+}
+
+uint32_t RenderQueue::GetMaterial(uint64_t key) {
+    if (GetPass(key) != PASS_TRANSLUCENT) {
+        return static_cast<uint32_t>((key >> 24) & MATERIAL_MASK);
+    }
+    return static_cast<uint32_t>(key & MATERIAL_MASK);
+}
+
+void RenderQueue::Sort() {
+    const size_t count = m_items.size();
+    if (count < 2) {
+        return;
+    }
+
+    m_tempItems.resize(count);
+
+    // 一次遍历同时统计所有位段的直方图，低20位的提交序号不参与排序
+    // （LSD基数排序是稳定的，相同键保持提交顺序）
+    uint32_t histograms[RADIX_PASSES][RADIX_SIZE];
+    std::memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = m_items[i] >> INDEX_BITS;
+        for (int pass = 0; pass < RADIX_PASSES; pass++) {
+            histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+        }
+    }
+
+    uint64_t* src = m_items.data();
+    uint64_t* dst = m_tempItems.data();
+
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+        uint32_t* histogram = histograms[pass];
+        const int shift = INDEX_BITS + pass * RADIX_BITS;
+
+        // 所有键在这一位段相同时（例如同一状态的大量绘制），整轮可以跳过
+        if (histogram[(src[0] >> shift) & (RADIX_SIZE - 1)] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < RADIX_SIZE; bucket++) {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            uint64_t item = src[i];
+            dst[histogram[(item >> shift) & (RADIX_SIZE - 1)]++] = item;
+        }
+
+        std::swap(src, dst);
+    }
+
+    // 奇数轮结束时结果在临时缓冲里
+    if (src != m_items.data()) {
+        m_items.swap(m_tempItems);
+    }
+}
@@ -1,11 +1,221 @@
 #include "Renderer.h"
-#include <GLFW/glfw3.h>
-#include <GL/glew.h>
+#include "DecalSystem.h"
+#include <GL/gl.h>
+#include <GL/glext.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
-Renderer::Renderer() : m_initialized(false), m_currentShader(0) {
+namespace {
+
+// 后处理pass，占位符的含义见RenderGraph.h
+
+// 双线性放大 + 对比度自适应锐化：
+// 在源分辨率上取十字邻域，局部对比度越低锐化越强，高对比边缘不过冲
+const char* UPSCALE_PASS = R"(
+vec4 $fn(vec2 uv) {
+    vec3 c = $0(uv).rgb;
+    if ($p.x <= 0.0) {
+        return vec4(c, 1.0);
+    }
+    vec3 n = $0(uv + vec2(0.0, $texel0.y)).rgb;
+    vec3 s = $0(uv - vec2(0.0, $texel0.y)).rgb;
+    vec3 e = $0(uv + vec2($texel0.x, 0.0)).rgb;
+    vec3 w = $0(uv - vec2($texel0.x, 0.0)).rgb;
+
+    vec3 mn = min(c, min(min(n, s), min(e, w)));
+    vec3 mx = max(c, max(max(n, s), max(e, w)));
+    vec3 amount = sqrt(clamp(min(mn, 1.0 - mx) / max(mx, vec3(1e-4)), 0.0, 1.0));
+    vec3 weight = -amount * mix(0.125, 0.2, $p.x);
+    vec3 result = (c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight);
+    return vec4(clamp(result, 0.0, 1.0), 1.0);
+}
+)";
+
+// 泛光亮部提取：4个双线性采样覆盖4x4源像素降到半分辨率，阈值附近平滑过渡
+const char* BLOOM_EXTRACT_PASS = R"(
+vec4 $fn(vec2 uv) {
+    vec2 o = $texel0;
+    vec3 c = ($0(uv + vec2(-o.x, -o.y)).rgb + $0(uv + vec2(o.x, -o.y)).rgb +
+              $0(uv + vec2(-o.x, o.y)).rgb + $0(uv + vec2(o.x, o.y)).rgb) * 0.25;
+    float brightness = max(c.r, max(c.g, c.b));
+    float weight = clamp((brightness - $p.x) / max($p.y, 1e-4), 0.0, 1.0);
+    return vec4(c * weight, 1.0);
+}
+)";
+
+// 9抽头高斯模糊，利用双线性过滤只需5次采样，方向为$p.xy
+const char* BLOOM_BLUR_PASS = R"(
+vec4 $fn(vec2 uv) {
+    vec2 d = $p.xy * $texel0;
+    vec3 c = $0(uv).rgb * 0.2270270270;
+    c += ($0(uv + d * 1.3846153846).rgb + $0(uv - d * 1.3846153846).rgb) * 0.3162162162;
+    c += ($0(uv + d * 3.2307692308).rgb + $0(uv - d * 3.2307692308).rgb) * 0.0702702703;
+    return vec4(c, 1.0);
+}
+)";
+
+// 逐像素叠加泛光，可以和放大合并成一个pass
+const char* BLOOM_COMPOSITE_PASS = R"(
+vec4 $fn(vec4 color, vec2 uv) {
+    return vec4(color.rgb + $1(uv).rgb * $p.x, color.a);
+}
+)";
+
+// 贴花实例化绘制：四个角点共用，每个实例一组SoA属性
+// 光照按固定管线的公式逐顶点计算（GL_COLOR_MATERIAL的环境光和漫反射，点光源衰减，无高光），
+// 与关卡表面的光照一致
+const char* DECAL_VERTEX_SHADER = R"(
+#version 120
+attribute vec2 corner;
+attribute vec3 decalCenter;
+attribute vec3 decalAxisU;
+attribute vec3 decalAxisV;
+attribute vec4 decalUv;
+attribute vec4 decalColor;
+uniform int lightCount;
+varying vec2 uv;
+varying vec4 color;
+
+void main() {
+    vec3 position = decalCenter + decalAxisU * corner.x + decalAxisV * corner.y;
+    vec4 eyePosition = gl_ModelViewMatrix * vec4(position, 1.0);
+    vec3 eyeNormal = normalize(gl_NormalMatrix * cross(decalAxisU, decalAxisV));
+
+    vec4 lit = gl_LightModel.ambient * decalColor;
+    for (int i = 0; i < lightCount; i++) {
+        vec3 toLight = gl_LightSource[i].position.xyz - eyePosition.xyz;
+        float d = length(toLight);
+        float attenuation = 1.0 / (gl_LightSource[i].constantAttenuation +
+                                   gl_LightSource[i].linearAttenuation * d +
+                                   gl_LightSource[i].quadraticAttenuation * d * d);
+        float nDotL = max(dot(eyeNormal, toLight / d), 0.0);
+        lit += attenuation * (gl_LightSource[i].ambient + nDotL * gl_LightSource[i].diffuse) * decalColor;
+    }
+    color = vec4(clamp(lit.rgb, 0.0, 1.0), decalColor.a);
+
+    vec2 t = corner * 0.5 + 0.5;
+    uv = vec2(mix(decalUv.x, decalUv.z, t.x), mix(decalUv.w, decalUv.y, t.y));
+    gl_Position = gl_ProjectionMatrix * eyePosition;
+}
+)";
+
+const char* DECAL_FRAGMENT_SHADER = R"(
+#version 120
+uniform sampler2D atlas;
+varying vec2 uv;
+varying vec4 color;
+
+void main() {
+    gl_FragColor = texture2D(atlas, uv) * color;
+}
+)";
+
+// 粒子层共用的顶点shader：输入已经是裁剪坐标
+const char* PARTICLE_LAYER_VERTEX_SHADER = R"(
+#version 120
+void main() {
+    gl_Position = gl_Vertex;
+}
+)";
+
+// 场景深度缩小：层的每个像素取场景中对应 divisor x divisor 个像素里最近的深度，
+// 同时把颜色清为(0, 0, 0, 1)：没有颜色，透过率为1
+const char* PARTICLE_DEPTH_FRAGMENT_SHADER = R"(
+#version 120
+uniform sampler2D sceneDepth;
+uniform vec2 sceneTexel;
+uniform vec2 sceneUsed;
+uniform int divisor;
+
+void main() {
+    vec2 base = floor(gl_FragCoord.xy) * float(divisor);
+    float depth = 1.0;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            if (x < divisor && y < divisor) {
+                vec2 p = min(base + vec2(x, y), sceneUsed - 1.0) + 0.5;
+                depth = min(depth, texture2D(sceneDepth, p * sceneTexel).r);
+            }
+        }
+    }
+    gl_FragDepth = depth;
+    gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
+)";
+
+// 深度感知的双边放大：取层中相邻的4个像素，双线性权重乘以深度接近程度，
+// 距离相差超过10%的不参与；都不接近时（前景边缘）取深度最接近的一个。
+// 输出预乘颜色和透过率，混合为 GL_ONE, GL_SRC_ALPHA
+const char* PARTICLE_COMPOSITE_FRAGMENT_SHADER = R"(
+#version 120
+uniform sampler2D sceneDepth;
+uniform sampler2D layerColor;
+uniform sampler2D layerDepth;
+uniform vec2 sceneTexel;
+uniform vec2 layerTexel;
+uniform vec2 layerUsed;
+uniform float divisor;
+uniform vec2 depthParams;
+
+float linearDepth(float depth) {
+    return depthParams.x / (depth * 2.0 - 1.0 + depthParams.y);
+}
+
+void main() {
+    float distance = linearDepth(texture2D(sceneDepth, gl_FragCoord.xy * sceneTexel).r);
+    vec2 p = gl_FragCoord.xy / divisor - 0.5;
+    vec2 base = floor(p);
+    vec2 f = p - base;
+
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    vec4 nearest = vec4(0.0, 0.0, 0.0, 1.0);
+    float nearestDifference = 1e30;
+    for (int i = 0; i < 4; i++) {
+        vec2 offset = vec2(mod(float(i), 2.0), floor(float(i) * 0.5));
+        vec2 uv = (clamp(base + offset, vec2(0.0), layerUsed - 1.0) + 0.5) * layerTexel;
+        vec4 color = texture2D(layerColor, uv);
+        float difference = abs(linearDepth(texture2D(layerDepth, uv).r) - distance);
+        if (difference < nearestDifference) {
+            nearest = color;
+            nearestDifference = difference;
+        }
+        vec2 bilinear = mix(1.0 - f, f, offset);
+        float weight = bilinear.x * bilinear.y * max(1.0 - difference / (distance * 0.1), 0.0);
+        sum += color * weight;
+        weightSum += weight;
+    }
+    gl_FragColor = weightSum < 1e-4 ? nearest : sum / weightSum;
+}
+)";
+
+const char* DECAL_ATTRIBUTE_NAMES[] = {
+    "corner", "decalCenter", "decalAxisU", "decalAxisV", "decalUv", "decalColor"
+};
+
+} // namespace
+
+Renderer::Renderer()
+    : m_initialized(false), m_currentShader(0),
+      m_sceneFramebuffer(0), m_sceneColorFramebuffer(0), m_sceneColor(0), m_sceneDepth(0),
+      m_sceneTargetWidth(0), m_sceneTargetHeight(0), m_sceneWidth(0), m_sceneHeight(0),
+      m_postGraph(*this), m_particleFramebuffer(0), m_particleColor(0), m_particleDepth(0),
+      m_particleTargetWidth(0), m_particleTargetHeight(0), m_particleWidth(0), m_particleHeight(0),
+      m_particleDivisor(1), m_particleDepthParams(0.0f), m_particleDepthShader(0), m_particleCompositeShader(0),
+      m_decalShader(0), m_decalCornerBuffer(0), m_decalCapacity(0),
+      m_decalUploaded(0), m_decalGeneration(0),
+      m_timerWrite(0), m_timerRead(0), m_timerActive(false) {
+    for (int i = 0; i < GPU_TIMER_QUERIES; i++) {
+        m_timerQueries[i] = 0;
+    }
+    for (int i = 0; i < DECAL_STREAMS; i++) {
+        m_decalBuffers[i] = 0;
+    }
+    for (int i = 0; i <= DECAL_STREAMS; i++) {
+        m_decalAttributes[i] = -1;
+    }
 }
 
 Renderer::~Renderer() {
@@ -21,16 +231,38 @@ bool Renderer::Initialize() {
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
     
-    // 启用面剔除
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    glFrontFace(GL_CCW);
+    // 不启用面剔除：关卡的四边形没有统一的环绕方向，前墙和窗户两面都可见
+    
+    glGenQueries(GPU_TIMER_QUERIES, m_timerQueries);
+    
+    m_decalShader = CreateShaderProgram(DECAL_VERTEX_SHADER, DECAL_FRAGMENT_SHADER);
+    for (int i = 0; i <= DECAL_STREAMS; i++) {
+        m_decalAttributes[i] = glGetAttribLocation(m_decalShader, DECAL_ATTRIBUTE_NAMES[i]);
+    }
+    
+    m_particleDepthShader = CreateShaderProgram(PARTICLE_LAYER_VERTEX_SHADER, PARTICLE_DEPTH_FRAGMENT_SHADER);
+    m_particleCompositeShader = CreateShaderProgram(PARTICLE_LAYER_VERTEX_SHADER, PARTICLE_COMPOSITE_FRAGMENT_SHADER);
     
     m_initialized = true;
     return true;
 }
 
 void Renderer::Shutdown() {
+    if (!m_initialized) {
+        return;
+    }
+    
+    DestroySceneTarget();
+    DestroyParticleTarget();
+    m_postGraph.Release();
+    DestroyDecalBuffers();
+    DeleteShader(m_decalShader);
+    DeleteShader(m_particleDepthShader);
+    DeleteShader(m_particleCompositeShader);
+    m_decalShader = 0;
+    m_particleDepthShader = 0;
+    m_particleCompositeShader = 0;
+    glDeleteQueries(GPU_TIMER_QUERIES, m_timerQueries);
     m_initialized = false;
 }
 
@@ -38,8 +270,422 @@ void Renderer::BeginFrame() {
     Clear();
 }
 
-void Renderer::EndFrame() {
-    // 可以在这里添加后处理效果
+void Renderer::EndFrame(int windowWidth, int windowHeight, const PostProcessSettings& settings) {
+    m_postGraph.Reset();
+    int scene = m_postGraph.ImportTexture("scene", m_sceneColor, m_sceneFramebuffer, m_sceneTargetWidth,
+                                          m_sceneTargetHeight, m_sceneWidth, m_sceneHeight);
+    int backbuffer = m_postGraph.ImportBackbuffer(windowWidth, windowHeight);
+    
+    // 泛光在半分辨率上做，纹理按场景目标的一半分配，跟随动态分辨率只使用一部分
+    int halfWidth = std::max(m_sceneTargetWidth / 2, 1);
+    int halfHeight = std::max(m_sceneTargetHeight / 2, 1);
+    int usedWidth = std::max(m_sceneWidth / 2, 1);
+    int usedHeight = std::max(m_sceneHeight / 2, 1);
+    int bright = m_postGraph.CreateTexture("bloom_bright", halfWidth, halfHeight, usedWidth, usedHeight);
+    int blurred = m_postGraph.CreateTexture("bloom_blur", halfWidth, halfHeight, usedWidth, usedHeight);
+    int bloom = m_postGraph.CreateTexture("bloom", halfWidth, halfHeight, usedWidth, usedHeight);
+    m_postGraph.AddFullscreenPass("bloom_extract", FULLSCREEN_SAMPLE, BLOOM_EXTRACT_PASS, {scene}, bright,
+                                  glm::vec4(settings.bloomThreshold, settings.bloomKnee, 0.0f, 0.0f));
+    m_postGraph.AddFullscreenPass("bloom_blur_h", FULLSCREEN_SAMPLE, BLOOM_BLUR_PASS, {bright}, blurred,
+                                  glm::vec4(1.0f, 0.0f, 0.0f, 0.0f));
+    m_postGraph.AddFullscreenPass("bloom_blur_v", FULLSCREEN_SAMPLE, BLOOM_BLUR_PASS, {blurred}, bloom,
+                                  glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+    
+    // 关闭泛光时没有pass读取bloom，上面三个pass在Compile中被剔除；
+    // 开启时叠加与放大合并成一个pass，放大的中间结果不分配纹理
+    int upscaled = backbuffer;
+    if (settings.bloom) {
+        upscaled = m_postGraph.CreateTexture("upscaled", windowWidth, windowHeight, windowWidth, windowHeight);
+    }
+    m_postGraph.AddFullscreenPass("upscale", FULLSCREEN_SAMPLE, UPSCALE_PASS, {scene}, upscaled,
+                                  glm::vec4(settings.sharpness, 0.0f, 0.0f, 0.0f));
+    if (settings.bloom) {
+        m_postGraph.AddFullscreenPass("bloom_composite", FULLSCREEN_POINTWISE, BLOOM_COMPOSITE_PASS,
+                                      {upscaled, bloom}, backbuffer,
+                                      glm::vec4(settings.bloomIntensity, 0.0f, 0.0f, 0.0f));
+    }
+    
+    if (m_postGraph.Compile()) {
+        m_postGraph.Execute();
+    }
+}
+
+bool Renderer::CreateSceneTarget(int width, int height) {
+    DestroySceneTarget();
+    
+    glGenTextures(1, &m_sceneColor);
+    glBindTexture(GL_TEXTURE_2D, m_sceneColor);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    
+    // 深度用纹理，粒子层需要采样
+    glGenTextures(1, &m_sceneDepth);
+    glBindTexture(GL_TEXTURE_2D, m_sceneDepth);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    glGenFramebuffers(1, &m_sceneFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_sceneColor, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_sceneDepth, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    
+    glGenFramebuffers(1, &m_sceneColorFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneColorFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_sceneColor, 0);
+    if (status == GL_FRAMEBUFFER_COMPLETE) {
+        status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    }
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Scene framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+        DestroySceneTarget();
+        return false;
+    }
+    
+    m_sceneTargetWidth = width;
+    m_sceneTargetHeight = height;
+    return true;
+}
+
+void Renderer::DestroySceneTarget() {
+    if (m_sceneFramebuffer != 0) {
+        glDeleteFramebuffers(1, &m_sceneFramebuffer);
+    }
+    if (m_sceneColorFramebuffer != 0) {
+        glDeleteFramebuffers(1, &m_sceneColorFramebuffer);
+    }
+    if (m_sceneDepth != 0) {
+        glDeleteTextures(1, &m_sceneDepth);
+    }
+    if (m_sceneColor != 0) {
+        glDeleteTextures(1, &m_sceneColor);
+    }
+    m_sceneFramebuffer = 0;
+    m_sceneColorFramebuffer = 0;
+    m_sceneDepth = 0;
+    m_sceneColor = 0;
+    m_sceneTargetWidth = 0;
+    m_sceneTargetHeight = 0;
+}
+
+void Renderer::BeginScene(int width, int height) {
+    m_sceneWidth = std::min(width, m_sceneTargetWidth);
+    m_sceneHeight = std::min(height, m_sceneTargetHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFramebuffer);
+    glViewport(0, 0, m_sceneWidth, m_sceneHeight);
+    
+    // 清屏只清使用的区域
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, m_sceneWidth, m_sceneHeight);
+}
+
+void Renderer::EndScene() {
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool Renderer::CreateParticleTarget(int width, int height) {
+    DestroyParticleTarget();
+    
+    // 放大时手动取4个像素，不需要过滤
+    glGenTextures(1, &m_particleColor);
+    glBindTexture(GL_TEXTURE_2D, m_particleColor);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    
+    glGenTextures(1, &m_particleDepth);
+    glBindTexture(GL_TEXTURE_2D, m_particleDepth);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    glGenFramebuffers(1, &m_particleFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_particleFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_particleColor, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_particleDepth, 0);
+    
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Particle framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+        DestroyParticleTarget();
+        return false;
+    }
+    
+    m_particleTargetWidth = width;
+    m_particleTargetHeight = height;
+    return true;
+}
+
+void Renderer::DestroyParticleTarget() {
+    if (m_particleFramebuffer != 0) {
+        glDeleteFramebuffers(1, &m_particleFramebuffer);
+    }
+    if (m_particleDepth != 0) {
+        glDeleteTextures(1, &m_particleDepth);
+    }
+    if (m_particleColor != 0) {
+        glDeleteTextures(1, &m_particleColor);
+    }
+    m_particleFramebuffer = 0;
+    m_particleDepth = 0;
+    m_particleColor = 0;
+    m_particleTargetWidth = 0;
+    m_particleTargetHeight = 0;
+}
+
+void Renderer::DrawFullscreenQuad() {
+    glBegin(GL_QUADS);
+    glVertex2f(-1.0f, -1.0f);
+    glVertex2f(1.0f, -1.0f);
+    glVertex2f(1.0f, 1.0f);
+    glVertex2f(-1.0f, 1.0f);
+    glEnd();
+}
+
+void Renderer::BeginParticleLayer(int divisor, const glm::mat4& projection) {
+    divisor = std::min(std::max(divisor, 1), 4);
+    int targetWidth = (m_sceneTargetWidth + divisor - 1) / divisor;
+    int targetHeight = (m_sceneTargetHeight + divisor - 1) / divisor;
+    if (targetWidth != m_particleTargetWidth || targetHeight != m_particleTargetHeight) {
+        CreateParticleTarget(targetWidth, targetHeight);
+    }
+    m_particleDivisor = divisor;
+    m_particleWidth = (m_sceneWidth + divisor - 1) / divisor;
+    m_particleHeight = (m_sceneHeight + divisor - 1) / divisor;
+    m_particleDepthParams = glm::vec2(projection[3][2], projection[2][2]);
+    
+    // EndParticleLayer恢复
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_VIEWPORT_BIT | GL_SCISSOR_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_particleFramebuffer);
+    glViewport(0, 0, m_particleWidth, m_particleHeight);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    
+    // 缩小场景深度，同时清空颜色
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    glDepthMask(GL_TRUE);
+    UseShader(m_particleDepthShader);
+    SetUniform1i(m_particleDepthShader, "sceneDepth", 0);
+    SetUniform1i(m_particleDepthShader, "divisor", divisor);
+    glUniform2f(glGetUniformLocation(m_particleDepthShader, "sceneTexel"),
+                1.0f / m_sceneTargetWidth, 1.0f / m_sceneTargetHeight);
+    glUniform2f(glGetUniformLocation(m_particleDepthShader, "sceneUsed"), float(m_sceneWidth), float(m_sceneHeight));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_sceneDepth);
+    DrawFullscreenQuad();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    m_currentShader = 0;
+    
+    // 粒子：rgb按顺序混合预乘颜色，alpha乘上 (1 - 不透明度) 得到透过率
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void Renderer::EndParticleLayer() {
+    // 场景 * 透过率 + 预乘颜色
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneColorFramebuffer);
+    glViewport(0, 0, m_sceneWidth, m_sceneHeight);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_SRC_ALPHA);
+    
+    UseShader(m_particleCompositeShader);
+    SetUniform1i(m_particleCompositeShader, "sceneDepth", 0);
+    SetUniform1i(m_particleCompositeShader, "layerColor", 1);
+    SetUniform1i(m_particleCompositeShader, "layerDepth", 2);
+    glUniform2f(glGetUniformLocation(m_particleCompositeShader, "sceneTexel"),
+                1.0f / m_sceneTargetWidth, 1.0f / m_sceneTargetHeight);
+    glUniform2f(glGetUniformLocation(m_particleCompositeShader, "layerTexel"),
+                1.0f / m_particleTargetWidth, 1.0f / m_particleTargetHeight);
+    glUniform2f(glGetUniformLocation(m_particleCompositeShader, "layerUsed"),
+                float(m_particleWidth), float(m_particleHeight));
+    glUniform1f(glGetUniformLocation(m_particleCompositeShader, "divisor"), float(m_particleDivisor));
+    glUniform2f(glGetUniformLocation(m_particleCompositeShader, "depthParams"),
+                m_particleDepthParams.x, m_particleDepthParams.y);
+    const unsigned int textures[3] = {m_sceneDepth, m_particleColor, m_particleDepth};
+    for (int i = 2; i >= 0; i--) {
+        glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    }
+    DrawFullscreenQuad();
+    for (int i = 2; i >= 0; i--) {
+        glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glUseProgram(0);
+    m_currentShader = 0;
+    
+    glPopAttrib();
+    glBindFramebuffer(GL_FRAMEBUFFER, m_sceneFramebuffer);
+}
+
+void Renderer::CreateDecalBuffers(int capacity) {
+    DestroyDecalBuffers();
+    
+    const float corners[8] = {-1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f};
+    glGenBuffers(1, &m_decalCornerBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_decalCornerBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    
+    // 按容量一次分配，之后只用glBufferSubData更新
+    const size_t streamSizes[DECAL_STREAMS] = {
+        sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec4), sizeof(glm::vec4)
+    };
+    glGenBuffers(DECAL_STREAMS, m_decalBuffers);
+    for (int i = 0; i < DECAL_STREAMS; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_decalBuffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, streamSizes[i] * capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    m_decalCapacity = capacity;
+    m_decalUploaded = 0;
+}
+
+void Renderer::DestroyDecalBuffers() {
+    if (m_decalCornerBuffer != 0) {
+        glDeleteBuffers(1, &m_decalCornerBuffer);
+        glDeleteBuffers(DECAL_STREAMS, m_decalBuffers);
+    }
+    m_decalCornerBuffer = 0;
+    for (int i = 0; i < DECAL_STREAMS; i++) {
+        m_decalBuffers[i] = 0;
+    }
+    m_decalCapacity = 0;
+}
+
+void Renderer::UploadDecals(const DecalSystem& decals, int firstSlot, int count) {
+    if (count <= 0) {
+        return;
+    }
+    const void* streams[DECAL_STREAMS] = {
+        decals.GetCenters() + firstSlot, decals.GetAxesU() + firstSlot, decals.GetAxesV() + firstSlot,
+        decals.GetUvRects() + firstSlot, decals.GetColors() + firstSlot
+    };
+    const size_t streamSizes[DECAL_STREAMS] = {
+        sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec4), sizeof(glm::vec4)
+    };
+    for (int i = 0; i < DECAL_STREAMS; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_decalBuffers[i]);
+        glBufferSubData(GL_ARRAY_BUFFER, streamSizes[i] * firstSlot, streamSizes[i] * count, streams[i]);
+    }
+}
+
+void Renderer::DrawDecals(const DecalSystem& decals, unsigned int atlasTexture, int lightCount) {
+    int count = decals.GetCount();
+    if (count == 0 || m_decalShader == 0) {
+        return;
+    }
+    
+    int capacity = decals.GetCapacity();
+    if (capacity != m_decalCapacity) {
+        CreateDecalBuffers(capacity);
+    }
+    
+    // 只上传新增的槽位；新增超过容量或者被清空过就全部上传
+    unsigned long long added = decals.GetAddedCount();
+    if (decals.GetGeneration() != m_decalGeneration || added < m_decalUploaded ||
+        added - m_decalUploaded >= static_cast<unsigned long long>(capacity)) {
+        UploadDecals(decals, 0, count);
+    } else if (added > m_decalUploaded) {
+        int begin = static_cast<int>(m_decalUploaded % capacity);
+        int end = static_cast<int>(added % capacity);
+        if (begin < end) {
+            UploadDecals(decals, begin, end - begin);
+        } else {
+            UploadDecals(decals, begin, capacity - begin);
+            UploadDecals(decals, 0, end);
+        }
+    }
+    m_decalUploaded = added;
+    m_decalGeneration = decals.GetGeneration();
+    
+    UseShader(m_decalShader);
+    SetUniform1i(m_decalShader, "atlas", 0);
+    SetUniform1i(m_decalShader, "lightCount", lightCount);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+    
+    const int components[DECAL_STREAMS + 1] = {2, 3, 3, 3, 4, 4};
+    for (int i = 0; i <= DECAL_STREAMS; i++) {
+        int location = m_decalAttributes[i];
+        if (location < 0) {
+            continue;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, i == 0 ? m_decalCornerBuffer : m_decalBuffers[i - 1]);
+        glVertexAttribPointer(location, components[i], GL_FLOAT, GL_FALSE, 0, nullptr);
+        glVertexAttribDivisor(location, i == 0 ? 0 : 1);
+        glEnableVertexAttribArray(location);
+    }
+    
+    glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, count);
+    
+    for (int i = 0; i <= DECAL_STREAMS; i++) {
+        int location = m_decalAttributes[i];
+        if (location >= 0) {
+            glDisableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 0);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+    m_currentShader = 0;
+}
+
+void Renderer::BeginGpuTimer() {
+    // 所有查询都还没有结果时跳过这一帧，避免等待GPU
+    m_timerActive = m_timerWrite - m_timerRead < GPU_TIMER_QUERIES;
+    if (m_timerActive) {
+        glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[m_timerWrite % GPU_TIMER_QUERIES]);
+    }
+}
+
+void Renderer::EndGpuTimer() {
+    if (m_timerActive) {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_timerWrite++;
+        m_timerActive = false;
+    }
+}
+
+bool Renderer::ReadGpuTime(float& milliseconds) {
+    bool found = false;
+    while (m_timerRead < m_timerWrite) {
+        unsigned int query = m_timerQueries[m_timerRead % GPU_TIMER_QUERIES];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        milliseconds = static_cast<float>(elapsed / 1.0e6);
+        m_timerRead++;
+        found = true;
+    }
+    return found;
 }
 
 void Renderer::SetViewport(int x, int y, int width, int height) {
@@ -149,6 +795,28 @@ unsigned int Renderer::CreateShaderProgram(const std::string& vertexSource, cons
     return program;
 }
 
+unsigned int Renderer::CreateTransformFeedbackShader(const std::string& vertexSource,
+                                                    const std::vector<const char*>& varyings) {
+    unsigned int vertexShader = CompileShader(GL_VERTEX_SHADER, vertexSource);
+    
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glTransformFeedbackVaryings(program, static_cast<GLsizei>(varyings.size()), varyings.data(),
+                                GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program);
+    
+    CheckShaderError(program, "PROGRAM");
+    glDeleteShader(vertexShader);
+    
+    int linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
 void Renderer::CheckShaderError(unsigned int shader, const std::string& type) {
     int success;
     char infoLog[1024];
@@ -0,0 +1,299 @@
+#include "SnapshotEncoder.h"
+#include "BitStream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// 能表示0 - maxValue的最少位数
+int bitsFor(uint32_t maxValue) {
+    int bits = 1;
+    while (bits < 31 && (1u << bits) - 1 < maxValue) {
+        bits++;
+    }
+    return bits;
+}
+
+uint32_t quantizeRange(float value, float extent, float step, uint32_t maxValue) {
+    float scaled = std::floor((value + extent) / step + 0.5f);
+    return static_cast<uint32_t>(std::min(std::max(scaled, 0.0f), static_cast<float>(maxValue)));
+}
+
+// 一个字段：变没变1位；变了时8位以下的字段直接写新值，更宽的字段写和基准的差：
+// 差按zigzag变成无符号数再减1（差不为0），按大小分4档：0+3位、10+7位、110+11位、111+新值本身
+void writeField(BitWriter& writer, uint32_t value, uint32_t base, int bits) {
+    if (value == base) {
+        writer.WriteBool(false);
+        return;
+    }
+    writer.WriteBool(true);
+    if (bits <= 8) {
+        writer.WriteBits(value, bits);
+        return;
+    }
+    // 差按字段位数回绕，水平角跨过0度时差仍然很小
+    uint32_t wrapped = (value - base) & ((1u << bits) - 1);
+    int32_t delta = static_cast<int32_t>(wrapped << (32 - bits)) >> (32 - bits);
+    uint32_t code = ((static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31)) - 1;
+    if (code < (1u << 3)) {
+        writer.WriteBits(0, 1);
+        writer.WriteBits(code, 3);
+    } else if (code < (1u << 7)) {
+        writer.WriteBits(1, 2);
+        writer.WriteBits(code, 7);
+    } else if (code < (1u << 11)) {
+        writer.WriteBits(3, 3);
+        writer.WriteBits(code, 11);
+    } else {
+        writer.WriteBits(7, 3);
+        writer.WriteBits(value, bits);
+    }
+}
+
+uint32_t readField(BitReader& reader, uint32_t base, int bits) {
+    if (!reader.ReadBool()) {
+        return base;
+    }
+    if (bits <= 8) {
+        return reader.ReadBits(bits);
+    }
+    uint32_t code;
+    if (!reader.ReadBool()) {
+        code = reader.ReadBits(3);
+    } else if (!reader.ReadBool()) {
+        code = reader.ReadBits(7);
+    } else if (!reader.ReadBool()) {
+        code = reader.ReadBits(11);
+    } else {
+        return reader.ReadBits(bits);
+    }
+    uint32_t zigzag = code + 1;
+    uint32_t delta = (zigzag >> 1) ^ (0u - (zigzag & 1));
+    return (base + delta) & ((1u << bits) - 1);
+}
+
+// 槽位间隔：小于4时0+2位，否则1+8位
+void writeGap(BitWriter& writer, int gap) {
+    if (gap < 4) {
+        writer.WriteBits(static_cast<uint32_t>(gap) << 1, 3);
+    } else {
+        writer.WriteBits(1, 1);
+        writer.WriteBits(static_cast<uint32_t>(gap), 8);
+    }
+}
+
+int readGap(BitReader& reader) {
+    if (!reader.ReadBool()) {
+        return static_cast<int>(reader.ReadBits(2));
+    }
+    return static_cast<int>(reader.ReadBits(8));
+}
+
+void initSnapshot(QuantizedSnapshot& snapshot, int maxPlayers) {
+    snapshot.tick = -1;
+    snapshot.present.assign(maxPlayers, 0);
+    snapshot.fields.assign(static_cast<size_t>(maxPlayers) * SNAPSHOT_FIELD_COUNT, 0);
+}
+
+} // namespace
+
+SnapshotQuantizer::SnapshotQuantizer(const SnapshotFormat& format) : m_format(format) {
+    m_format.yawBits = std::min(std::max(m_format.yawBits, 1), 16);
+    m_format.pitchBits = std::min(std::max(m_format.pitchBits, 1), 16);
+    m_positionMax = static_cast<uint32_t>(std::ceil(2.0f * m_format.positionExtent / m_format.positionStep));
+    m_velocityMax = static_cast<uint32_t>(std::ceil(2.0f * m_format.velocityExtent / m_format.velocityStep));
+    m_bits[SNAPSHOT_FLAGS] = 2;
+    m_bits[SNAPSHOT_HEALTH] = 8;
+    m_bits[SNAPSHOT_DUCK] = 8;
+    m_bits[SNAPSHOT_YAW] = m_format.yawBits;
+    m_bits[SNAPSHOT_PITCH] = m_format.pitchBits;
+    for (int axis = 0; axis < 3; axis++) {
+        m_bits[SNAPSHOT_POSITION_X + axis] = bitsFor(m_positionMax);
+        m_bits[SNAPSHOT_VELOCITY_X + axis] = bitsFor(m_velocityMax);
+    }
+}
+
+void SnapshotQuantizer::Quantize(const NetPlayerState& state, uint32_t* fields) const {
+    fields[SNAPSHOT_FLAGS] = state.flags & 3u;
+    fields[SNAPSHOT_HEALTH] = state.health;
+    fields[SNAPSHOT_DUCK] = state.duck;
+    // 水平角四舍五入到yawBits位，回绕
+    int yawShift = 16 - m_format.yawBits;
+    uint32_t yawRound = yawShift > 0 ? 1u << (yawShift - 1) : 0u;
+    fields[SNAPSHOT_YAW] = ((state.yaw + yawRound) & 0xFFFFu) >> yawShift;
+    // 俯仰角 -16384 - 16384 映射到 0 - 2^pitchBits-1
+    int64_t pitchMax = (1 << m_format.pitchBits) - 1;
+    int64_t pitch = std::min(std::max<int>(state.pitch, -16384), 16384) + 16384;
+    fields[SNAPSHOT_PITCH] = static_cast<uint32_t>((pitch * pitchMax / 16384 + 1) / 2);
+    for (int axis = 0; axis < 3; axis++) {
+        fields[SNAPSHOT_POSITION_X + axis] =
+            quantizeRange(state.position[axis], m_format.positionExtent, m_format.positionStep, m_positionMax);
+        fields[SNAPSHOT_VELOCITY_X + axis] =
+            quantizeRange(state.velocity[axis], m_format.velocityExtent, m_format.velocityStep, m_velocityMax);
+    }
+}
+
+NetPlayerState SnapshotQuantizer::Dequantize(int slot, const uint32_t* fields) const {
+    NetPlayerState state;
+    state.slot = static_cast<uint8_t>(slot);
+    state.flags = static_cast<uint8_t>(fields[SNAPSHOT_FLAGS]);
+    state.health = static_cast<uint8_t>(fields[SNAPSHOT_HEALTH]);
+    state.duck = static_cast<uint8_t>(fields[SNAPSHOT_DUCK]);
+    state.yaw = static_cast<uint16_t>(fields[SNAPSHOT_YAW] << (16 - m_format.yawBits));
+    int64_t pitchMax = (1 << m_format.pitchBits) - 1;
+    int64_t pitch = (fields[SNAPSHOT_PITCH] * static_cast<int64_t>(65536) / pitchMax + 1) / 2;
+    state.pitch = static_cast<int16_t>(pitch - 16384);
+    for (int axis = 0; axis < 3; axis++) {
+        state.position[axis] = fields[SNAPSHOT_POSITION_X + axis] * m_format.positionStep - m_format.positionExtent;
+        state.velocity[axis] = fields[SNAPSHOT_VELOCITY_X + axis] * m_format.velocityStep - m_format.velocityExtent;
+    }
+    return state;
+}
+
+SnapshotEncoder::SnapshotEncoder(int maxPlayers, const SnapshotFormat& format)
+    : m_quantizer(format), m_maxPlayers(maxPlayers), m_history(HISTORY), m_current(nullptr) {
+    for (QuantizedSnapshot& snapshot : m_history) {
+        initSnapshot(snapshot, maxPlayers);
+    }
+    initSnapshot(m_empty, maxPlayers);
+}
+
+void SnapshotEncoder::BeginSnapshot(int tick) {
+    m_current = &m_history[tick % HISTORY];
+    m_current->tick = tick;
+    std::fill(m_current->present.begin(), m_current->present.end(), 0);
+}
+
+void SnapshotEncoder::AddPlayer(const NetPlayerState& player) {
+    if (!m_current || player.slot >= m_maxPlayers) {
+        return;
+    }
+    m_current->present[player.slot] = 1;
+    m_quantizer.Quantize(player, &m_current->fields[player.slot * SNAPSHOT_FIELD_COUNT]);
+}
+
+bool SnapshotEncoder::HasBaseline(int baseTick) const {
+    return m_current && baseTick >= 0 && baseTick < m_current->tick && m_current->tick - baseTick < HISTORY &&
+           m_history[baseTick % HISTORY].tick == baseTick;
+}
+
+int SnapshotEncoder::Encode(int baseTick, uint8_t* buffer, int capacity, const uint8_t* visible,
+                            const uint8_t* baseVisible) const {
+    if (!m_current) {
+        return -1;
+    }
+    const QuantizedSnapshot& current = *m_current;
+    const QuantizedSnapshot* base = HasBaseline(baseTick) ? &m_history[baseTick % HISTORY] : &m_empty;
+
+    BitWriter writer(buffer, capacity);
+    writer.WriteBool(base != &m_empty);
+    if (base != &m_empty) {
+        writer.WriteBits(static_cast<uint32_t>(current.tick - baseTick), 8);
+    }
+    int previous = -1;
+    for (int slot = 0; slot < m_maxPlayers; slot++) {
+        bool present = current.present[slot] != 0 && (!visible || visible[slot]);
+        bool basePresent = base->present[slot] != 0 && (base == &m_empty || !baseVisible || baseVisible[slot]);
+        const uint32_t* fields = &current.fields[slot * SNAPSHOT_FIELD_COUNT];
+        const uint32_t* baseFields = basePresent ? &base->fields[slot * SNAPSHOT_FIELD_COUNT]
+                                                 : &m_empty.fields[slot * SNAPSHOT_FIELD_COUNT];
+        if (!present && !basePresent) {
+            continue;
+        }
+        if (present && basePresent && memcmp(fields, baseFields, sizeof(uint32_t) * SNAPSHOT_FIELD_COUNT) == 0) {
+            continue;
+        }
+        writer.WriteBool(true);
+        writeGap(writer, slot - previous - 1);
+        previous = slot;
+        writer.WriteBool(!present);
+        if (present) {
+            for (int field = 0; field < SNAPSHOT_FIELD_COUNT; field++) {
+                writeField(writer, fields[field], baseFields[field], m_quantizer.GetFieldBits(field));
+            }
+        }
+    }
+    writer.WriteBool(false);
+    int size = writer.Flush();
+    return writer.Overflowed() ? -1 : size;
+}
+
+void SnapshotEncoder::GetPlayers(std::vector<NetPlayerState>& players) const {
+    players.clear();
+    if (!m_current) {
+        return;
+    }
+    for (int slot = 0; slot < m_maxPlayers; slot++) {
+        if (m_current->present[slot]) {
+            players.push_back(m_quantizer.Dequantize(slot, &m_current->fields[slot * SNAPSHOT_FIELD_COUNT]));
+        }
+    }
+}
+
+SnapshotDecoder::SnapshotDecoder(int maxPlayers, const SnapshotFormat& format)
+    : m_quantizer(format), m_maxPlayers(maxPlayers), m_history(SnapshotEncoder::HISTORY) {
+    for (QuantizedSnapshot& snapshot : m_history) {
+        initSnapshot(snapshot, maxPlayers);
+    }
+    initSnapshot(m_empty, maxPlayers);
+    initSnapshot(m_scratch, maxPlayers);
+}
+
+void SnapshotDecoder::Reset() {
+    for (QuantizedSnapshot& snapshot : m_history) {
+        snapshot.tick = -1;
+    }
+}
+
+bool SnapshotDecoder::Decode(int tick, const uint8_t* data, int size, std::vector<NetPlayerState>& players) {
+    if (tick < 0) {
+        return false;
+    }
+    BitReader reader(data, size);
+    const QuantizedSnapshot* base = &m_empty;
+    if (reader.ReadBool()) {
+        int baseTick = tick - static_cast<int>(reader.ReadBits(8));
+        if (baseTick < 0 || baseTick == tick || m_history[baseTick % SnapshotEncoder::HISTORY].tick != baseTick) {
+            return false;
+        }
+        base = &m_history[baseTick % SnapshotEncoder::HISTORY];
+    }
+    m_scratch.present = base->present;
+    m_scratch.fields = base->fields;
+
+    int slot = -1;
+    while (reader.ReadBool()) {
+        slot += readGap(reader) + 1;
+        if (reader.Failed() || slot >= m_maxPlayers) {
+            return false;
+        }
+        uint32_t* fields = &m_scratch.fields[slot * SNAPSHOT_FIELD_COUNT];
+        if (reader.ReadBool()) {
+            m_scratch.present[slot] = 0;
+            continue;
+        }
+        // 新出现的玩家相对全0编码
+        if (!m_scratch.present[slot]) {
+            std::fill(fields, fields + SNAPSHOT_FIELD_COUNT, 0u);
+            m_scratch.present[slot] = 1;
+        }
+        for (int field = 0; field < SNAPSHOT_FIELD_COUNT; field++) {
+            fields[field] = readField(reader, fields[field], m_quantizer.GetFieldBits(field));
+        }
+    }
+    if (reader.Failed()) {
+        return false;
+    }
+
+    QuantizedSnapshot& stored = m_history[tick % SnapshotEncoder::HISTORY];
+    std::swap(stored, m_scratch);
+    stored.tick = tick;
+    players.clear();
+    for (int i = 0; i < m_maxPlayers; i++) {
+        if (stored.present[i]) {
+            players.push_back(m_quantizer.Dequantize(i, &stored.fields[i * SNAPSHOT_FIELD_COUNT]));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,136 @@
+#include "SnapshotInterpolator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double OFFSET_GAIN = 0.02;
+const double JITTER_GAIN = 0.05;
+const double JITTER_MARGIN = 2.0;       // 缓冲几倍的抖动
+const double RESYNC_TICKS = 64.0;       // 偏移突然变化这么多时（服务器卡住、重连）重新估计
+
+NetPlayerState interpolate(const NetPlayerState& a, const NetPlayerState& b, float alpha) {
+    NetPlayerState state = a;
+    if (glm::length(b.position - a.position) > SnapshotInterpolator::TELEPORT_DISTANCE) {
+        return alpha < 0.5f ? a : b;
+    }
+    state.position = a.position + (b.position - a.position) * alpha;
+    state.velocity = a.velocity + (b.velocity - a.velocity) * alpha;
+    state.duck = static_cast<uint8_t>(a.duck + (b.duck - a.duck) * alpha + 0.5f);
+    // 水平角走短的那边
+    int16_t yawDelta = static_cast<int16_t>(b.yaw - a.yaw);
+    state.yaw = static_cast<uint16_t>(a.yaw + static_cast<int>(std::lround(yawDelta * alpha)));
+    state.pitch = static_cast<int16_t>(a.pitch + static_cast<int>(std::lround((b.pitch - a.pitch) * alpha)));
+    return state;
+}
+
+} // namespace
+
+SnapshotInterpolator::SnapshotInterpolator(int tickRate) {
+    Reset(tickRate);
+}
+
+void SnapshotInterpolator::Reset(int tickRate) {
+    m_tickRate = tickRate;
+    m_entries.resize(BUFFER_SIZE);
+    for (Entry& entry : m_entries) {
+        entry.tick = -1;
+        entry.players.clear();
+    }
+    m_newestTick = -1;
+    m_offset = 0.0;
+    m_jitter = 0.0;
+    m_lastRenderTick = -1.0f;
+    m_stats = InterpolationStats();
+}
+
+const SnapshotInterpolator::Entry* SnapshotInterpolator::Find(int tick) const {
+    if (tick < 0) {
+        return nullptr;
+    }
+    const Entry& entry = m_entries[tick % BUFFER_SIZE];
+    return entry.tick == tick ? &entry : nullptr;
+}
+
+void SnapshotInterpolator::Push(int tick, const std::vector<NetPlayerState>& players, double receiveTime) {
+    if (tick < 0 || tick <= m_newestTick - BUFFER_SIZE || Find(tick)) {
+        return;
+    }
+    if (tick < m_lastRenderTick) {
+        m_stats.late++;
+    }
+    Entry& entry = m_entries[tick % BUFFER_SIZE];
+    entry.tick = tick;
+    entry.players = players;
+    m_stats.snapshots++;
+
+    // 只用最新的快照估计时钟，乱序到达的旧快照晚到是正常的
+    if (tick <= m_newestTick) {
+        return;
+    }
+    double sample = tick - receiveTime * m_tickRate;
+    double error = sample - m_offset;
+    if (m_newestTick < 0 || std::fabs(error) > RESYNC_TICKS) {
+        m_offset = sample;
+        m_jitter = 0.0;
+    } else {
+        m_offset += error * OFFSET_GAIN;
+        m_jitter += (std::fabs(error) - m_jitter) * JITTER_GAIN;
+    }
+    m_newestTick = tick;
+}
+
+float SnapshotInterpolator::GetDelayTicks() const {
+    return std::min(MIN_DELAY_TICKS + static_cast<float>(JITTER_MARGIN * m_jitter), MAX_DELAY_TICKS);
+}
+
+float SnapshotInterpolator::GetRenderTick(double now) const {
+    if (m_newestTick < 0) {
+        return -1.0f;
+    }
+    return static_cast<float>(now * m_tickRate + m_offset - GetDelayTicks());
+}
+
+bool SnapshotInterpolator::Sample(float renderTick, std::vector<NetPlayerState>& players) {
+    if (m_newestTick < 0) {
+        return false;
+    }
+    m_stats.samples++;
+    m_lastRenderTick = std::max(m_lastRenderTick, renderTick);
+    if (renderTick >= m_newestTick) {
+        m_stats.underruns++;
+        players = Find(m_newestTick)->players;
+        return true;
+    }
+
+    // renderTick之前最近的快照和之后最近的快照
+    int base = static_cast<int>(std::floor(renderTick));
+    const Entry* from = nullptr;
+    for (int tick = base; tick > m_newestTick - BUFFER_SIZE && tick >= 0 && !from; tick--) {
+        from = Find(tick);
+    }
+    const Entry* to = nullptr;
+    for (int tick = std::max(base + 1, m_newestTick - BUFFER_SIZE + 1); tick <= m_newestTick && !to; tick++) {
+        to = Find(tick);
+    }
+    if (!from) {
+        players = to->players;
+        return true;
+    }
+    float alpha = (renderTick - from->tick) / static_cast<float>(to->tick - from->tick);
+
+    // 两个快照里的玩家都按槽位排好了序；只在新快照里的玩家还不显示，只在旧快照里的保持不动
+    players.clear();
+    size_t j = 0;
+    for (const NetPlayerState& a : from->players) {
+        while (j < to->players.size() && to->players[j].slot < a.slot) {
+            j++;
+        }
+        if (j < to->players.size() && to->players[j].slot == a.slot) {
+            players.push_back(interpolate(a, to->players[j], alpha));
+        } else {
+            players.push_back(a);
+        }
+    }
+    return true;
+}
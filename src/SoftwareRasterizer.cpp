@@ -0,0 +1,716 @@
+#include "SoftwareRasterizer.h"
+#include "Image.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// 固定管线默认的全局环境光 (GL_LIGHT_MODEL_AMBIENT)
+const float GLOBAL_AMBIENT = 0.2f;
+
+// 屏幕坐标对齐到1/256像素，与硬件的定点子像素精度相当
+const float SUBPIXEL_SCALE = 256.0f;
+
+// 低分辨率层清屏：没有颜色，透过率为1
+const uint32_t LAYER_CLEAR = 0xFF000000u;
+
+// 双边放大：层中像素的距离与当前像素相差超过这个比例时不参与加权
+const float UPSAMPLE_DEPTH_TOLERANCE = 0.1f;
+
+inline uint32_t PackColor(float r, float g, float b, float a) {
+    uint32_t ir = static_cast<uint32_t>(std::min(std::max(r, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t ig = static_cast<uint32_t>(std::min(std::max(g, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t ib = static_cast<uint32_t>(std::min(std::max(b, 0.0f), 1.0f) * 255.0f + 0.5f);
+    uint32_t ia = static_cast<uint32_t>(std::min(std::max(a, 0.0f), 1.0f) * 255.0f + 0.5f);
+    return ir | (ig << 8) | (ib << 16) | (ia << 24);
+}
+
+inline float Snap(float v) {
+    return std::floor(v * SUBPIXEL_SCALE + 0.5f) / SUBPIXEL_SCALE;
+}
+
+inline float EvalPlane(const float plane[3], float x, float y) {
+    return plane[0] * x + plane[1] * y + plane[2];
+}
+
+// GL_LINEAR + GL_REPEAT：纹素中心在 (i + 0.5) / size
+void SampleBilinear(const Image& image, float u, float v, float out[4]) {
+    float fx = u * image.width - 0.5f;
+    float fy = v * image.height - 0.5f;
+    float x0f = std::floor(fx);
+    float y0f = std::floor(fy);
+    float tx = fx - x0f;
+    float ty = fy - y0f;
+
+    int x0 = static_cast<int>(x0f) % image.width;
+    int y0 = static_cast<int>(y0f) % image.height;
+    if (x0 < 0) x0 += image.width;
+    if (y0 < 0) y0 += image.height;
+    int x1 = (x0 + 1 == image.width) ? 0 : x0 + 1;
+    int y1 = (y0 + 1 == image.height) ? 0 : y0 + 1;
+
+    const uint8_t* row0 = &image.pixels[static_cast<size_t>(y0) * image.width * 4];
+    const uint8_t* row1 = &image.pixels[static_cast<size_t>(y1) * image.width * 4];
+    const uint8_t* p00 = row0 + x0 * 4;
+    const uint8_t* p10 = row0 + x1 * 4;
+    const uint8_t* p01 = row1 + x0 * 4;
+    const uint8_t* p11 = row1 + x1 * 4;
+
+    for (int c = 0; c < 4; c++) {
+        float top = p00[c] + (p10[c] - p00[c]) * tx;
+        float bottom = p01[c] + (p11[c] - p01[c]) * tx;
+        out[c] = (top + (bottom - top) * ty) * (1.0f / 255.0f);
+    }
+}
+
+} // namespace
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height)
+    : m_jobs(nullptr), m_view(1.0f), m_projection(1.0f), m_lightCount(0), m_clearColor(0), m_batchCount(0),
+      m_layerScene(nullptr), m_layerDivisor(1) {
+    Resize(width, height);
+}
+
+void SoftwareRasterizer::Resize(int width, int height) {
+    m_width = std::max(width, 1);
+    m_height = std::max(height, 1);
+    m_tilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+
+    size_t pixels = static_cast<size_t>(m_tilesX) * m_tilesY * TILE_SIZE * TILE_SIZE;
+    m_color.assign(pixels, 0);
+    m_depth.assign(pixels, 1.0f);
+}
+
+void SoftwareRasterizer::SetLights(const RasterLight* lights, int count) {
+    m_lightCount = std::min(count, static_cast<int>(MAX_LIGHTS));
+    for (int i = 0; i < m_lightCount; i++) {
+        m_lights[i] = lights[i];
+    }
+}
+
+void SoftwareRasterizer::SetMatrices(const glm::mat4& view, const glm::mat4& projection) {
+    m_view = view;
+    m_projection = projection;
+}
+
+void SoftwareRasterizer::Begin(const glm::vec4& clearColor) {
+    m_clearColor = PackColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
+    m_states.clear();
+    m_input.clear();
+    m_layerScene = nullptr;
+}
+
+void SoftwareRasterizer::BeginLayer(const SoftwareRasterizer& scene, int divisor) {
+    divisor = std::min(std::max(divisor, 1), static_cast<int>(MAX_LAYER_DIVISOR));
+    int width = (scene.m_width + divisor - 1) / divisor;
+    int height = (scene.m_height + divisor - 1) / divisor;
+    if (width != m_width || height != m_height) {
+        Resize(width, height);
+    }
+
+    m_view = scene.m_view;
+    m_projection = scene.m_projection;
+    m_lightCount = scene.m_lightCount;
+    for (int i = 0; i < m_lightCount; i++) {
+        m_lights[i] = scene.m_lights[i];
+    }
+    m_clearColor = LAYER_CLEAR;
+    m_states.clear();
+    m_input.clear();
+    m_layerScene = &scene;
+    m_layerDivisor = divisor;
+}
+
+void SoftwareRasterizer::SetState(const Image* texture, bool lighting, bool blend) {
+    if (!m_states.empty()) {
+        const DrawState& last = m_states.back();
+        if (last.texture == texture && last.lighting == lighting && last.blend == blend) {
+            return;
+        }
+    }
+    m_states.push_back({texture, lighting, blend});
+}
+
+void SoftwareRasterizer::AddTriangle(const RasterVertex& a, const RasterVertex& b, const RasterVertex& c,
+                                     const glm::vec4& color) {
+    if (m_states.empty()) {
+        SetState(nullptr, false, false);
+    }
+    InputTriangle tri;
+    tri.v[0] = a;
+    tri.v[1] = b;
+    tri.v[2] = c;
+    tri.color = color;
+    tri.state = static_cast<int>(m_states.size()) - 1;
+    m_input.push_back(tri);
+}
+
+void SoftwareRasterizer::AddQuad(const RasterVertex v[4], const glm::vec4& color) {
+    AddTriangle(v[0], v[1], v[2], color);
+    AddTriangle(v[0], v[2], v[3], color);
+}
+
+void SoftwareRasterizer::End() {
+    int triangleCount = static_cast<int>(m_input.size());
+    int tileCount = m_tilesX * m_tilesY;
+
+    m_batchCount = (triangleCount + BATCH_SIZE - 1) / BATCH_SIZE;
+    if (static_cast<int>(m_batches.size()) < m_batchCount) {
+        m_batches.resize(m_batchCount);
+    }
+
+    // 阶段1：建立三角形并分块
+    // 阶段2：逐块光栅化
+    if (m_jobs) {
+        m_jobs->ParallelFor(m_batchCount, [this](int begin, int end, int) {
+            for (int batch = begin; batch < end; batch++) {
+                SetupBatch(batch);
+            }
+        });
+        m_jobs->ParallelFor(tileCount, [this](int begin, int end, int) {
+            for (int tile = begin; tile < end; tile++) {
+                RasterizeTile(tile);
+            }
+        });
+    } else {
+        for (int batch = 0; batch < m_batchCount; batch++) {
+            SetupBatch(batch);
+        }
+        for (int tile = 0; tile < tileCount; tile++) {
+            RasterizeTile(tile);
+        }
+    }
+}
+
+void SoftwareRasterizer::SetupBatch(int batchIndex) {
+    Batch& batch = m_batches[batchIndex];
+    batch.triangles.clear();
+    batch.tiles.resize(m_tilesX * m_tilesY);
+    for (std::vector<uint32_t>& list : batch.tiles) {
+        list.clear();
+    }
+
+    int begin = batchIndex * BATCH_SIZE;
+    int end = std::min(begin + BATCH_SIZE, static_cast<int>(m_input.size()));
+
+    for (int i = begin; i < end; i++) {
+        const InputTriangle& input = m_input[i];
+        const DrawState& state = m_states[input.state];
+
+        ClipVertex vertices[3];
+        for (int k = 0; k < 3; k++) {
+            const RasterVertex& v = input.v[k];
+            glm::vec4 eye = m_view * glm::vec4(v.position, 1.0f);
+            vertices[k].clip = m_projection * eye;
+            vertices[k].uv = v.uv;
+            if (state.lighting) {
+                glm::vec3 normal = glm::normalize(glm::vec3(m_view * glm::vec4(v.normal, 0.0f)));
+                vertices[k].color = Light(glm::vec3(eye), normal, input.color);
+            } else {
+                vertices[k].color = input.color;
+            }
+        }
+
+        // 整个三角形在某个裁剪面外侧时直接丢弃
+        bool outside = false;
+        for (int axis = 0; axis < 3 && !outside; axis++) {
+            bool allBelow = true, allAbove = true;
+            for (int k = 0; k < 3; k++) {
+                const glm::vec4& c = vertices[k].clip;
+                allBelow = allBelow && c[axis] < -c.w;
+                allAbove = allAbove && c[axis] > c.w;
+            }
+            outside = allBelow || allAbove;
+        }
+        if (outside) {
+            continue;
+        }
+
+        // 近平面和远平面裁剪，x/y超出屏幕的部分由包围盒限制处理
+        bool needsClip = false;
+        for (int k = 0; k < 3; k++) {
+            const glm::vec4& c = vertices[k].clip;
+            needsClip = needsClip || c.z < -c.w || c.z > c.w;
+        }
+        if (!needsClip) {
+            SetupScreenTriangle(batch, vertices[0], vertices[1], vertices[2], input.state);
+            continue;
+        }
+
+        ClipVertex nearClipped[4];
+        ClipVertex farClipped[5];
+        int count = ClipPolygon(vertices, 3, 1.0f, nearClipped);
+        count = ClipPolygon(nearClipped, count, -1.0f, farClipped);
+        for (int k = 1; k + 1 < count; k++) {
+            SetupScreenTriangle(batch, farClipped[0], farClipped[k], farClipped[k + 1], input.state);
+        }
+    }
+}
+
+// 固定管线逐顶点光照：GL_COLOR_MATERIAL把颜色同时作为环境光和漫反射材质，
+// 默认材质没有镜面反射，所以只计算环境光和漫反射
+glm::vec4 SoftwareRasterizer::Light(const glm::vec3& eyePosition, const glm::vec3& eyeNormal,
+                                    const glm::vec4& color) const {
+    float r = GLOBAL_AMBIENT * color.x;
+    float g = GLOBAL_AMBIENT * color.y;
+    float b = GLOBAL_AMBIENT * color.z;
+
+    for (int i = 0; i < m_lightCount; i++) {
+        const RasterLight& light = m_lights[i];
+        glm::vec3 toLight;
+        float attenuation = 1.0f;
+        if (light.position.w != 0.0f) {
+            toLight = glm::vec3(light.position) - eyePosition;
+            float distance = glm::length(toLight);
+            toLight = toLight / std::max(distance, 1e-6f);
+            attenuation = 1.0f / (light.constantAttenuation + light.linearAttenuation * distance +
+                                  light.quadraticAttenuation * distance * distance);
+        } else {
+            toLight = glm::normalize(glm::vec3(light.position));
+        }
+
+        float diffuse = std::max(glm::dot(eyeNormal, toLight), 0.0f);
+        r += attenuation * (light.ambient.x + diffuse * light.diffuse.x) * color.x;
+        g += attenuation * (light.ambient.y + diffuse * light.diffuse.y) * color.y;
+        b += attenuation * (light.ambient.z + diffuse * light.diffuse.z) * color.z;
+    }
+
+    return glm::vec4(std::min(r, 1.0f), std::min(g, 1.0f), std::min(b, 1.0f), color.w);
+}
+
+// Sutherland-Hodgman：sign为1时保留 z >= -w（近平面），为-1时保留 z <= w（远平面）
+int SoftwareRasterizer::ClipPolygon(const ClipVertex* vertices, int count, float sign, ClipVertex* out) const {
+    int outCount = 0;
+    for (int i = 0; i < count; i++) {
+        const ClipVertex& a = vertices[i];
+        const ClipVertex& b = vertices[(i + 1) % count];
+        float da = a.clip.w + sign * a.clip.z;
+        float db = b.clip.w + sign * b.clip.z;
+
+        if (da >= 0.0f) {
+            out[outCount++] = a;
+        }
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            float t = da / (da - db);
+            ClipVertex& v = out[outCount++];
+            v.clip = a.clip + (b.clip - a.clip) * t;
+            v.uv = a.uv + (b.uv - a.uv) * t;
+            v.color = a.color + (b.color - a.color) * t;
+        }
+    }
+    return outCount;
+}
+
+void SoftwareRasterizer::SetupScreenTriangle(Batch& batch, const ClipVertex& a, const ClipVertex& b,
+                                             const ClipVertex& c, int state) {
+    const ClipVertex* vertices[3] = {&a, &b, &c};
+    float x[3], y[3];
+    float attributes[3][PLANE_COUNT];
+
+    for (int k = 0; k < 3; k++) {
+        const ClipVertex& v = *vertices[k];
+        float invW = 1.0f / v.clip.w;
+        // 屏幕坐标y向下，第0行在最上面
+        x[k] = Snap((v.clip.x * invW * 0.5f + 0.5f) * m_width);
+        y[k] = Snap((0.5f - v.clip.y * invW * 0.5f) * m_height);
+        attributes[k][PLANE_Z] = v.clip.z * invW * 0.5f + 0.5f;
+        attributes[k][PLANE_INV_W] = invW;
+        attributes[k][PLANE_U] = v.uv.x * invW;
+        attributes[k][PLANE_V] = v.uv.y * invW;
+        attributes[k][PLANE_R] = v.color.x * invW;
+        attributes[k][PLANE_G] = v.color.y * invW;
+        attributes[k][PLANE_B] = v.color.z * invW;
+        attributes[k][PLANE_A] = v.color.w * invW;
+    }
+
+    // 不做背面剔除（与固定管线默认一致），统一成面积为正的顺序
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f) {
+        return;
+    }
+    int order[3] = {0, 1, 2};
+    if (area < 0.0f) {
+        order[1] = 2;
+        order[2] = 1;
+        area = -area;
+    }
+
+    SetupTriangle tri;
+    tri.state = state;
+
+    float minX = std::min(std::min(x[0], x[1]), x[2]);
+    float maxX = std::max(std::max(x[0], x[1]), x[2]);
+    float minY = std::min(std::min(y[0], y[1]), y[2]);
+    float maxY = std::max(std::max(y[0], y[1]), y[2]);
+    tri.minX = std::max(static_cast<int>(std::floor(minX)), 0);
+    tri.minY = std::max(static_cast<int>(std::floor(minY)), 0);
+    tri.maxX = std::min(static_cast<int>(std::ceil(maxX)), m_width - 1);
+    tri.maxY = std::min(static_cast<int>(std::ceil(maxY)), m_height - 1);
+    if (tri.minX > tri.maxX || tri.minY > tri.maxY) {
+        return;
+    }
+
+    // 边i与顶点i相对，E_i(p) > 0 表示p在内侧，E_i(v_i) == area
+    // 左上规则：内法线朝右（左边）或朝下（上边，y向下）的边拥有恰好落在边上的像素
+    for (int i = 0; i < 3; i++) {
+        int j = order[(i + 1) % 3];
+        int k = order[(i + 2) % 3];
+        float ea = y[j] - y[k];
+        float eb = x[k] - x[j];
+        tri.edgeA[i] = ea;
+        tri.edgeB[i] = eb;
+        tri.edgeC[i] = -(ea * x[j] + eb * y[j]);
+        tri.topLeft[i] = ea > 0.0f || (ea == 0.0f && eb > 0.0f);
+    }
+
+    // 属性的平面方程：f = sum(f_i * E_i) / area
+    float invArea = 1.0f / area;
+    for (int p = 0; p < PLANE_COUNT; p++) {
+        float pa = 0.0f, pb = 0.0f, pc = 0.0f;
+        for (int i = 0; i < 3; i++) {
+            float f = attributes[order[i]][p] * invArea;
+            pa += f * tri.edgeA[i];
+            pb += f * tri.edgeB[i];
+            pc += f * tri.edgeC[i];
+        }
+        tri.planes[p][0] = pa;
+        tri.planes[p][1] = pb;
+        tri.planes[p][2] = pc;
+    }
+
+    // 分块：包围盒覆盖的块中，再用三条边排除完全在外侧的块
+    uint32_t index = static_cast<uint32_t>(batch.triangles.size());
+    bool binned = false;
+    int tileMinX = tri.minX / TILE_SIZE, tileMaxX = tri.maxX / TILE_SIZE;
+    int tileMinY = tri.minY / TILE_SIZE, tileMaxY = tri.maxY / TILE_SIZE;
+    for (int ty = tileMinY; ty <= tileMaxY; ty++) {
+        float y0 = ty * TILE_SIZE + 0.5f;
+        float y1 = y0 + TILE_SIZE - 1;
+        for (int tx = tileMinX; tx <= tileMaxX; tx++) {
+            float x0 = tx * TILE_SIZE + 0.5f;
+            float x1 = x0 + TILE_SIZE - 1;
+            bool rejected = false;
+            for (int i = 0; i < 3 && !rejected; i++) {
+                float px = tri.edgeA[i] > 0.0f ? x1 : x0;
+                float py = tri.edgeB[i] > 0.0f ? y1 : y0;
+                rejected = tri.edgeA[i] * px + tri.edgeB[i] * py + tri.edgeC[i] < 0.0f;
+            }
+            if (!rejected) {
+                batch.tiles[ty * m_tilesX + tx].push_back(index);
+                binned = true;
+            }
+        }
+    }
+    if (binned) {
+        batch.triangles.push_back(tri);
+    }
+}
+
+void SoftwareRasterizer::RasterizeTile(int tile) {
+    size_t offset = static_cast<size_t>(tile) * TILE_SIZE * TILE_SIZE;
+    std::fill(m_color.begin() + offset, m_color.begin() + offset + TILE_SIZE * TILE_SIZE, m_clearColor);
+    if (m_layerScene) {
+        DownsampleDepth(tile);
+    } else {
+        std::fill(m_depth.begin() + offset, m_depth.begin() + offset + TILE_SIZE * TILE_SIZE, 1.0f);
+    }
+
+    // 按批次顺序，批内按提交顺序
+    for (int b = 0; b < m_batchCount; b++) {
+        const Batch& batch = m_batches[b];
+        for (uint32_t index : batch.tiles[tile]) {
+            RasterizeTriangle(batch.triangles[index], tile);
+        }
+    }
+}
+
+void SoftwareRasterizer::RasterizeTriangle(const SetupTriangle& tri, int tile) {
+    const DrawState& state = m_states[tri.state];
+    int tileX0 = (tile % m_tilesX) * TILE_SIZE;
+    int tileY0 = (tile / m_tilesX) * TILE_SIZE;
+    int tileX1 = std::min(tileX0 + TILE_SIZE, m_width);
+    int tileY1 = std::min(tileY0 + TILE_SIZE, m_height);
+
+    int xStart = std::max(tri.minX, tileX0);
+    int xEnd = std::min(tri.maxX, tileX1 - 1);
+    int yStart = std::max(tri.minY, tileY0);
+    int yEnd = std::min(tri.maxY, tileY1 - 1);
+    if (xStart > xEnd || yStart > yEnd) {
+        return;
+    }
+    // 按4像素对齐，块宽是4的倍数，不会越过块的存储
+    xStart = tileX0 + ((xStart - tileX0) & ~3);
+
+    uint32_t* color = &m_color[static_cast<size_t>(tile) * TILE_SIZE * TILE_SIZE];
+    float* depth = &m_depth[static_cast<size_t>(tile) * TILE_SIZE * TILE_SIZE];
+    const float* zPlane = tri.planes[PLANE_Z];
+
+#if defined(__SSE2__)
+    const __m128 laneOffset = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 columnLimit = _mm_set1_ps(static_cast<float>(tileX1));
+    __m128 edgeA[3], topLeft[3];
+    for (int i = 0; i < 3; i++) {
+        edgeA[i] = _mm_set1_ps(tri.edgeA[i]);
+        topLeft[i] = _mm_castsi128_ps(_mm_set1_epi32(tri.topLeft[i] ? -1 : 0));
+    }
+    const __m128 zA = _mm_set1_ps(zPlane[0]);
+#endif
+
+    for (int y = yStart; y <= yEnd; y++) {
+        float py = y + 0.5f;
+        uint32_t* colorRow = color + (y - tileY0) * TILE_SIZE;
+        float* depthRow = depth + (y - tileY0) * TILE_SIZE;
+
+#if defined(__SSE2__)
+        __m128 edgeRow[3];
+        for (int i = 0; i < 3; i++) {
+            edgeRow[i] = _mm_set1_ps(tri.edgeB[i] * py + tri.edgeC[i]);
+        }
+        const __m128 zRow = _mm_set1_ps(zPlane[1] * py + zPlane[2]);
+#endif
+
+        for (int x = xStart; x <= xEnd; x += 4) {
+            int lx = x - tileX0;
+            float z[4];
+            int mask = 0;
+
+#if defined(__SSE2__)
+            __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffset);
+            __m128 inside = _mm_cmplt_ps(px, columnLimit);
+            for (int i = 0; i < 3; i++) {
+                __m128 e = _mm_add_ps(_mm_mul_ps(edgeA[i], px), edgeRow[i]);
+                __m128 edgeInside = _mm_or_ps(_mm_cmpgt_ps(e, zero),
+                                              _mm_and_ps(_mm_cmpeq_ps(e, zero), topLeft[i]));
+                inside = _mm_and_ps(inside, edgeInside);
+            }
+            if (!_mm_movemask_ps(inside)) {
+                continue;
+            }
+
+            // 深度测试 GL_LESS
+            __m128 zv = _mm_add_ps(_mm_mul_ps(zA, px), zRow);
+            __m128 old = _mm_loadu_ps(depthRow + lx);
+            __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(zv, old));
+            mask = _mm_movemask_ps(pass);
+            if (!mask) {
+                continue;
+            }
+            if (!state.blend) {
+                _mm_storeu_ps(depthRow + lx, _mm_or_ps(_mm_and_ps(pass, zv), _mm_andnot_ps(pass, old)));
+            }
+            _mm_storeu_ps(z, zv);
+#else
+            for (int lane = 0; lane < 4; lane++) {
+                if (x + lane >= tileX1) {
+                    break;
+                }
+                float px = x + lane + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < 3 && inside; i++) {
+                    float e = tri.edgeA[i] * px + tri.edgeB[i] * py + tri.edgeC[i];
+                    inside = e > 0.0f || (e == 0.0f && tri.topLeft[i]);
+                }
+                z[lane] = EvalPlane(zPlane, px, py);
+                if (inside && z[lane] < depthRow[lx + lane]) {
+                    mask |= 1 << lane;
+                    if (!state.blend) {
+                        depthRow[lx + lane] = z[lane];
+                    }
+                }
+            }
+            if (!mask) {
+                continue;
+            }
+#endif
+
+            for (int lane = 0; lane < 4; lane++) {
+                if (mask & (1 << lane)) {
+                    colorRow[lx + lane] = Shade(tri, state, x + lane + 0.5f, py, colorRow[lx + lane]);
+                }
+            }
+        }
+    }
+}
+
+uint32_t SoftwareRasterizer::Shade(const SetupTriangle& tri, const DrawState& state, float x, float y,
+                                   uint32_t dst) const {
+    // 透视校正：插值 attr/w 和 1/w，再相除
+    float w = 1.0f / EvalPlane(tri.planes[PLANE_INV_W], x, y);
+    float r = EvalPlane(tri.planes[PLANE_R], x, y) * w;
+    float g = EvalPlane(tri.planes[PLANE_G], x, y) * w;
+    float b = EvalPlane(tri.planes[PLANE_B], x, y) * w;
+    float a = EvalPlane(tri.planes[PLANE_A], x, y) * w;
+
+    // GL_MODULATE
+    if (state.texture) {
+        float texel[4];
+        SampleBilinear(*state.texture, EvalPlane(tri.planes[PLANE_U], x, y) * w,
+                       EvalPlane(tri.planes[PLANE_V], x, y) * w, texel);
+        r *= texel[0];
+        g *= texel[1];
+        b *= texel[2];
+        a *= texel[3];
+    }
+
+    if (state.blend) {
+        a = std::min(std::max(a, 0.0f), 1.0f);
+        float inv = 1.0f - a;
+        const float scale = 1.0f / 255.0f;
+        r = r * a + (dst & 0xFF) * scale * inv;
+        g = g * a + ((dst >> 8) & 0xFF) * scale * inv;
+        b = b * a + ((dst >> 16) & 0xFF) * scale * inv;
+        // 低分辨率层的alpha是透过率
+        a = m_layerScene ? (dst >> 24) * scale * inv : a * a + (dst >> 24) * scale * inv;
+    }
+
+    return PackColor(r, g, b, a);
+}
+
+float SoftwareRasterizer::LinearDepth(float depth) const {
+    // 透视投影：z_ndc = (P22 * z + P32) / -z，距离 = -z
+    return m_projection[3][2] / (depth * 2.0f - 1.0f + m_projection[2][2]);
+}
+
+// 层的深度：场景中对应像素块里最近的深度
+// 取最近而不是平均，层里不会出现跨过前景边缘的粒子，边缘交给Composite按深度选择
+void SoftwareRasterizer::DownsampleDepth(int tile) {
+    const SoftwareRasterizer& scene = *m_layerScene;
+    int tileX0 = (tile % m_tilesX) * TILE_SIZE;
+    int tileY0 = (tile / m_tilesX) * TILE_SIZE;
+    float* depth = &m_depth[static_cast<size_t>(tile) * TILE_SIZE * TILE_SIZE];
+
+    for (int ly = 0; ly < TILE_SIZE; ly++) {
+        int sy0 = (tileY0 + ly) * m_layerDivisor;
+        int sy1 = std::min(sy0 + m_layerDivisor, scene.m_height);
+        for (int lx = 0; lx < TILE_SIZE; lx++) {
+            int sx0 = (tileX0 + lx) * m_layerDivisor;
+            int sx1 = std::min(sx0 + m_layerDivisor, scene.m_width);
+            float nearest = 1.0f;
+            for (int sy = sy0; sy < sy1; sy++) {
+                for (int sx = sx0; sx < sx1; sx++) {
+                    nearest = std::min(nearest, scene.m_depth[scene.PixelIndex(sx, sy)]);
+                }
+            }
+            depth[ly * TILE_SIZE + lx] = nearest;
+        }
+    }
+}
+
+void SoftwareRasterizer::Composite(const SoftwareRasterizer& layer) {
+    int tileCount = m_tilesX * m_tilesY;
+    if (m_jobs) {
+        m_jobs->ParallelFor(tileCount, [this, &layer](int begin, int end, int) {
+            for (int tile = begin; tile < end; tile++) {
+                CompositeTile(layer, tile);
+            }
+        });
+    } else {
+        for (int tile = 0; tile < tileCount; tile++) {
+            CompositeTile(layer, tile);
+        }
+    }
+}
+
+void SoftwareRasterizer::CompositeTile(const SoftwareRasterizer& layer, int tile) {
+    int tileX0 = (tile % m_tilesX) * TILE_SIZE;
+    int tileY0 = (tile / m_tilesX) * TILE_SIZE;
+    int tileX1 = std::min(tileX0 + TILE_SIZE, m_width);
+    int tileY1 = std::min(tileY0 + TILE_SIZE, m_height);
+    uint32_t* color = &m_color[static_cast<size_t>(tile) * TILE_SIZE * TILE_SIZE];
+    const float* depth = &m_depth[static_cast<size_t>(tile) * TILE_SIZE * TILE_SIZE];
+
+    const float invDivisor = 1.0f / layer.m_layerDivisor;
+    const float scale = 1.0f / 255.0f;
+
+    for (int y = tileY0; y < tileY1; y++) {
+        // 像素中心在层中的位置，与GL的双线性采样相同
+        float fy = (y + 0.5f) * invDivisor - 0.5f;
+        int y0 = static_cast<int>(std::floor(fy));
+        float ty = fy - y0;
+        int rows[2] = {std::max(y0, 0), std::min(y0 + 1, layer.m_height - 1)};
+
+        for (int x = tileX0; x < tileX1; x++) {
+            float fx = (x + 0.5f) * invDivisor - 0.5f;
+            int x0 = static_cast<int>(std::floor(fx));
+            float tx = fx - x0;
+            int columns[2] = {std::max(x0, 0), std::min(x0 + 1, layer.m_width - 1)};
+
+            size_t samples[4];
+            bool empty = true;
+            for (int k = 0; k < 4; k++) {
+                samples[k] = layer.PixelIndex(columns[k & 1], rows[k >> 1]);
+                empty = empty && layer.m_color[samples[k]] == LAYER_CLEAR;
+            }
+            // 大部分像素附近没有粒子
+            if (empty) {
+                continue;
+            }
+
+            int local = (y - tileY0) * TILE_SIZE + (x - tileX0);
+            float distance = LinearDepth(depth[local]);
+            float tolerance = distance * UPSAMPLE_DEPTH_TOLERANCE;
+            const float bilinear[4] = {(1.0f - tx) * (1.0f - ty), tx * (1.0f - ty), (1.0f - tx) * ty, tx * ty};
+
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            float weightSum = 0.0f;
+            int nearest = 0;
+            float nearestDifference = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                float difference = std::fabs(layer.LinearDepth(layer.m_depth[samples[k]]) - distance);
+                if (k == 0 || difference < nearestDifference) {
+                    nearest = k;
+                    nearestDifference = difference;
+                }
+                float weight = bilinear[k] * std::max(1.0f - difference / tolerance, 0.0f);
+                uint32_t c = layer.m_color[samples[k]];
+                sum[0] += (c & 0xFF) * weight;
+                sum[1] += ((c >> 8) & 0xFF) * weight;
+                sum[2] += ((c >> 16) & 0xFF) * weight;
+                sum[3] += (c >> 24) * weight;
+                weightSum += weight;
+            }
+            if (weightSum < 1e-4f) {
+                uint32_t c = layer.m_color[samples[nearest]];
+                sum[0] = static_cast<float>(c & 0xFF);
+                sum[1] = static_cast<float>((c >> 8) & 0xFF);
+                sum[2] = static_cast<float>((c >> 16) & 0xFF);
+                sum[3] = static_cast<float>(c >> 24);
+                weightSum = 1.0f;
+            }
+
+            // 场景 * 透过率 + 预乘颜色
+            float inv = scale / weightSum;
+            float transmittance = sum[3] * inv;
+            uint32_t dst = color[local];
+            color[local] = PackColor((dst & 0xFF) * scale * transmittance + sum[0] * inv,
+                                     ((dst >> 8) & 0xFF) * scale * transmittance + sum[1] * inv,
+                                     ((dst >> 16) & 0xFF) * scale * transmittance + sum[2] * inv,
+                                     (dst >> 24) * scale);
+        }
+    }
+}
+
+void SoftwareRasterizer::ReadPixels(uint8_t* rgba, bool bottomUp) const {
+    for (int y = 0; y < m_height; y++) {
+        int ty = y / TILE_SIZE;
+        int ly = y % TILE_SIZE;
+        int outY = bottomUp ? m_height - 1 - y : y;
+        uint8_t* out = rgba + static_cast<size_t>(outY) * m_width * 4;
+
+        for (int tx = 0; tx < m_tilesX; tx++) {
+            int x0 = tx * TILE_SIZE;
+            int count = std::min(TILE_SIZE, m_width - x0);
+            size_t tile = static_cast<size_t>(ty) * m_tilesX + tx;
+            const uint32_t* src = &m_color[tile * TILE_SIZE * TILE_SIZE + ly * TILE_SIZE];
+            memcpy(out + x0 * 4, src, count * 4);
+        }
+    }
+}
@@ -0,0 +1,489 @@
+#include "VisibilitySet.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include "LevelGeometry.h"
+#include "NetProtocol.h"
+
+namespace {
+
+const uint32_t VISIBILITY_FILE_ID = 0x31535650;    // "PVS1"
+const float MIN_LEAF_THICKNESS = 1e-3f;            // 网格和单元格相交的部分比这个薄时不算叶子
+const float OPENING_MARGIN = 1e-3f;                // 开口放大一点，浮点误差只会让结果更保守
+
+struct Box {
+    glm::vec3 minBounds;
+    glm::vec3 maxBounds;
+};
+
+Box openingBox(const LevelOpening& opening) {
+    return {opening.minBounds, opening.maxBounds};
+}
+
+// alpha + beta * t <= gamma，和[t0, t1]求交，空了时返回false
+bool clipLinear(float alpha, float beta, float gamma, float& t0, float& t1) {
+    if (beta > 0.0f) {
+        t1 = std::min(t1, (gamma - alpha) / beta);
+    } else if (beta < 0.0f) {
+        t0 = std::max(t0, (gamma - alpha) / beta);
+    } else if (alpha > gamma) {
+        return false;
+    }
+    return t0 <= t1;
+}
+
+// 是否存在一条从from里的点到to里的点、在开口的矩形里穿过开口平面的线段（from和to必须在平面两侧）。
+// 线段在平面上的交点是 (1 - t) * a + t * b，t = da / (da + db)，da、db是两端到平面的距离，
+// 两个盒子的距离范围决定t的范围；t固定时交点在另外两个轴上的范围是区间，端点随t线性变化，
+// 和开口的矩形相交要满足四个线性不等式。三个轴上的坐标可以分别选，所以结果是精确的。
+bool throughOpening(const Box& from, const LevelOpening& opening, const Box& to) {
+    const int axis = opening.axis;
+    const float plane = opening.minBounds[axis];
+    const float fromCenter = (from.minBounds[axis] + from.maxBounds[axis]) * 0.5f - plane;
+    const float side = fromCenter >= 0.0f ? 1.0f : -1.0f;
+    const float fromA = side * (from.minBounds[axis] - plane);
+    const float fromB = side * (from.maxBounds[axis] - plane);
+    const float toA = -side * (to.minBounds[axis] - plane);
+    const float toB = -side * (to.maxBounds[axis] - plane);
+    const float fromNear = std::max(std::min(fromA, fromB), 0.0f);
+    const float fromFar = std::max(std::max(fromA, fromB), 0.0f);
+    const float toNear = std::max(std::min(toA, toB), 0.0f);
+    const float toFar = std::max(std::max(toA, toB), 0.0f);
+    if (toFar <= 0.0f) {
+        return false;
+    }
+
+    float t0 = fromNear / (fromNear + toFar);
+    float t1 = fromFar + toNear > 0.0f ? fromFar / (fromFar + toNear) : 1.0f;
+    for (int i = 0; i < 3; i++) {
+        if (i == axis) {
+            continue;
+        }
+        const float low = from.minBounds[i];
+        const float high = from.maxBounds[i];
+        // 交点的最小值不超过开口的最大值，交点的最大值不小于开口的最小值
+        if (!clipLinear(low, to.minBounds[i] - low, opening.maxBounds[i] + OPENING_MARGIN, t0, t1) ||
+            !clipLinear(-high, -(to.maxBounds[i] - high), -opening.minBounds[i] + OPENING_MARGIN, t0, t1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 穿过path里的每个开口都要过得去：从源头直接过，以及从上一个开口过。真正可见时这些都成立，所以是保守的
+bool chainVisible(const Box& source, const std::vector<const LevelOpening*>& path, const Box& target) {
+    for (size_t i = 0; i < path.size(); i++) {
+        if (!throughOpening(source, *path[i], target)) {
+            return false;
+        }
+        if (i > 0 && !throughOpening(openingBox(*path[i - 1]), *path[i], target)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct FloodContext {
+    const std::vector<LevelOpening>* openings;
+    std::vector<std::vector<int>> cellOpenings;
+    std::vector<Box> leaves;
+    std::vector<int> cellFirst;      // 每个单元格的叶子，最后多一个结尾
+    std::vector<const LevelOpening*> path;
+    std::vector<uint8_t> onPath;     // 按单元格
+};
+
+void setBit(uint64_t* row, int bit) {
+    row[bit >> 6] |= 1ull << (bit & 63);
+}
+
+// 从source穿过当前的开口串进入cell之后，继续穿过cell的其他开口
+void flood(FloodContext& context, const Box& source, int cell, uint64_t* row) {
+    for (int index : context.cellOpenings[cell]) {
+        const LevelOpening& opening = (*context.openings)[index];
+        int next = opening.cells[0] == cell ? opening.cells[1] : opening.cells[0];
+        if (context.onPath[next] || !chainVisible(source, context.path, openingBox(opening))) {
+            continue;
+        }
+        context.path.push_back(&opening);
+        context.onPath[next] = 1;
+        bool any = false;
+        for (int leaf = context.cellFirst[next]; leaf < context.cellFirst[next + 1]; leaf++) {
+            if (chainVisible(source, context.path, context.leaves[leaf])) {
+                setBit(row, leaf);
+                any = true;
+            }
+        }
+        // 真正能穿过这个单元格的视线一定经过它的某个叶子
+        if (any) {
+            flood(context, source, next, row);
+        }
+        context.onPath[next] = 0;
+        context.path.pop_back();
+    }
+}
+
+// 行的字节按小端序排；0x00和0xFF后面跟一个重复次数（1-255），其他字节原样
+void compressRow(const uint64_t* words, int wordCount, std::vector<uint8_t>& out) {
+    const int byteCount = wordCount * 8;
+    auto byteAt = [words](int i) { return static_cast<uint8_t>(words[i >> 3] >> ((i & 7) * 8)); };
+    for (int i = 0; i < byteCount;) {
+        uint8_t value = byteAt(i);
+        out.push_back(value);
+        if (value != 0x00 && value != 0xFF) {
+            i++;
+            continue;
+        }
+        int run = 1;
+        while (i + run < byteCount && run < 255 && byteAt(i + run) == value) {
+            run++;
+        }
+        out.push_back(static_cast<uint8_t>(run));
+        i += run;
+    }
+}
+
+bool decompressRow(const uint8_t* data, int size, uint64_t* words, int wordCount) {
+    const int byteCount = wordCount * 8;
+    std::fill(words, words + wordCount, 0ull);
+    int written = 0;
+    for (int i = 0; i < size;) {
+        uint8_t value = data[i++];
+        int run = 1;
+        if (value == 0x00 || value == 0xFF) {
+            if (i >= size) {
+                return false;
+            }
+            run = data[i++];
+        }
+        if (run == 0 || written + run > byteCount) {
+            return false;
+        }
+        for (int j = 0; j < run; j++, written++) {
+            words[written >> 3] |= static_cast<uint64_t>(value) << ((written & 7) * 8);
+        }
+    }
+    return written == byteCount;
+}
+
+int popCount(uint64_t value) {
+    int count = 0;
+    while (value) {
+        value &= value - 1;
+        count++;
+    }
+    return count;
+}
+
+} // namespace
+
+void VisibilitySet::Clear() {
+    m_leaves.clear();
+    m_leafRows.clear();
+    m_compressed.clear();
+    m_rowOffsets.clear();
+    m_rows.clear();
+    m_rowWords = 0;
+    m_gridStarts.clear();
+    m_gridLeaves.clear();
+    m_stats = VisibilityStats();
+}
+
+bool VisibilitySet::Compile(const LevelGeometry& level, const VisibilitySettings& settings) {
+    auto start = std::chrono::steady_clock::now();
+    Clear();
+    const std::vector<LevelCell>& cells = level.GetCells();
+    if (cells.empty() || settings.leafSize <= 0.0f) {
+        return false;
+    }
+
+    // 所有单元格共用一个网格，叶子是网格的格子和单元格的交
+    glm::vec3 minBounds = cells[0].minBounds;
+    glm::vec3 maxBounds = cells[0].maxBounds;
+    for (const LevelCell& cell : cells) {
+        minBounds = glm::min(minBounds, cell.minBounds);
+        maxBounds = glm::max(maxBounds, cell.maxBounds);
+    }
+    m_leafSize = settings.leafSize;
+    m_gridOrigin = minBounds;
+    for (int i = 0; i < 3; i++) {
+        m_gridSize[i] = std::max(static_cast<int>(std::ceil((maxBounds[i] - minBounds[i]) / m_leafSize)), 1);
+    }
+
+    FloodContext context;
+    context.openings = &level.GetOpenings();
+    context.cellOpenings.resize(cells.size());
+    for (size_t i = 0; i < level.GetOpenings().size(); i++) {
+        const LevelOpening& opening = level.GetOpenings()[i];
+        context.cellOpenings[opening.cells[0]].push_back(static_cast<int>(i));
+        context.cellOpenings[opening.cells[1]].push_back(static_cast<int>(i));
+    }
+    context.onPath.assign(cells.size(), 0);
+    for (int c = 0; c < static_cast<int>(cells.size()); c++) {
+        context.cellFirst.push_back(static_cast<int>(m_leaves.size()));
+        const LevelCell& cell = cells[c];
+        int first[3];
+        int last[3];
+        for (int i = 0; i < 3; i++) {
+            first[i] = GridCoordinate(cell.minBounds[i], i);
+            last[i] = GridCoordinate(cell.maxBounds[i], i);
+        }
+        for (int z = first[2]; z <= last[2]; z++) {
+            for (int y = first[1]; y <= last[1]; y++) {
+                for (int x = first[0]; x <= last[0]; x++) {
+                    glm::vec3 voxelMin = m_gridOrigin + glm::vec3(static_cast<float>(x), static_cast<float>(y),
+                                                                  static_cast<float>(z)) * m_leafSize;
+                    Leaf leaf;
+                    leaf.minBounds = glm::max(voxelMin, cell.minBounds);
+                    leaf.maxBounds = glm::min(voxelMin + glm::vec3(m_leafSize), cell.maxBounds);
+                    leaf.cell = c;
+                    glm::vec3 extent = leaf.maxBounds - leaf.minBounds;
+                    if (std::min(std::min(extent.x, extent.y), extent.z) > MIN_LEAF_THICKNESS) {
+                        m_leaves.push_back(leaf);
+                        context.leaves.push_back({leaf.minBounds, leaf.maxBounds});
+                    }
+                }
+            }
+        }
+    }
+    context.cellFirst.push_back(static_cast<int>(m_leaves.size()));
+
+    // 每个叶子一行，相同的行（比如都看不到窗外的叶子）只存一次
+    const int leafCount = static_cast<int>(m_leaves.size());
+    m_rowWords = (leafCount + 63) / 64;
+    std::vector<uint64_t> row(m_rowWords);
+    std::map<std::vector<uint64_t>, uint32_t> uniqueRows;
+    m_leafRows.resize(leafCount);
+    m_rowOffsets.push_back(0);
+    for (int leaf = 0; leaf < leafCount; leaf++) {
+        std::fill(row.begin(), row.end(), 0ull);
+        int cell = m_leaves[leaf].cell;
+        for (int other = context.cellFirst[cell]; other < context.cellFirst[cell + 1]; other++) {
+            setBit(row.data(), other);
+        }
+        context.onPath[cell] = 1;
+        flood(context, context.leaves[leaf], cell, row.data());
+        context.onPath[cell] = 0;
+
+        auto found = uniqueRows.find(row);
+        if (found == uniqueRows.end()) {
+            found = uniqueRows.emplace(row, static_cast<uint32_t>(uniqueRows.size())).first;
+            compressRow(row.data(), m_rowWords, m_compressed);
+            m_rowOffsets.push_back(static_cast<uint32_t>(m_compressed.size()));
+        }
+        m_leafRows[leaf] = found->second;
+    }
+
+    m_stats.cells = static_cast<int>(cells.size());
+    if (!DecompressRows()) {
+        Clear();
+        return false;
+    }
+    BuildGrid();
+    m_stats.compileSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool VisibilitySet::DecompressRows() {
+    const int rowCount = static_cast<int>(m_rowOffsets.size()) - 1;
+    m_rows.assign(static_cast<size_t>(rowCount) * m_rowWords, 0ull);
+    for (int r = 0; r < rowCount; r++) {
+        uint32_t begin = m_rowOffsets[r];
+        uint32_t end = m_rowOffsets[r + 1];
+        if (begin > end || end > m_compressed.size() ||
+            !decompressRow(m_compressed.data() + begin, static_cast<int>(end - begin),
+                           &m_rows[static_cast<size_t>(r) * m_rowWords], m_rowWords)) {
+            return false;
+        }
+    }
+
+    const int leafCount = static_cast<int>(m_leaves.size());
+    long long visiblePairs = 0;
+    for (int leaf = 0; leaf < leafCount; leaf++) {
+        if (m_leafRows[leaf] >= static_cast<uint32_t>(rowCount)) {
+            return false;
+        }
+        const uint64_t* words = &m_rows[static_cast<size_t>(m_leafRows[leaf]) * m_rowWords];
+        for (int w = 0; w < m_rowWords; w++) {
+            visiblePairs += popCount(words[w]);
+        }
+    }
+    m_stats.leaves = leafCount;
+    m_stats.uniqueRows = rowCount;
+    m_stats.rawBytes = leafCount * m_rowWords * 8;
+    m_stats.compressedBytes = static_cast<int>(m_compressed.size());
+    m_stats.visibleFraction = leafCount > 0 ? static_cast<float>(visiblePairs) / (static_cast<float>(leafCount) * leafCount)
+                                            : 0.0f;
+    return true;
+}
+
+int VisibilitySet::GridCoordinate(float value, int axis) const {
+    int coordinate = static_cast<int>(std::floor((value - m_gridOrigin[axis]) / m_leafSize));
+    return std::min(std::max(coordinate, 0), m_gridSize[axis] - 1);
+}
+
+int VisibilitySet::GridIndex(const glm::vec3& position) const {
+    return (GridCoordinate(position.z, 2) * m_gridSize[1] + GridCoordinate(position.y, 1)) * m_gridSize[0] +
+           GridCoordinate(position.x, 0);
+}
+
+// 叶子按所在的格子计数排序
+void VisibilitySet::BuildGrid() {
+    const size_t cellCount = static_cast<size_t>(m_gridSize[0]) * m_gridSize[1] * m_gridSize[2];
+    std::vector<uint32_t> voxels(m_leaves.size());
+    m_gridStarts.assign(cellCount + 1, 0);
+    for (size_t i = 0; i < m_leaves.size(); i++) {
+        voxels[i] = static_cast<uint32_t>(GridIndex((m_leaves[i].minBounds + m_leaves[i].maxBounds) * 0.5f));
+        m_gridStarts[voxels[i] + 1]++;
+    }
+    for (size_t i = 0; i < cellCount; i++) {
+        m_gridStarts[i + 1] += m_gridStarts[i];
+    }
+    std::vector<uint32_t> cursor(m_gridStarts.begin(), m_gridStarts.end() - 1);
+    m_gridLeaves.resize(m_leaves.size());
+    for (size_t i = 0; i < m_leaves.size(); i++) {
+        m_gridLeaves[cursor[voxels[i]]++] = static_cast<uint32_t>(i);
+    }
+}
+
+int VisibilitySet::FindLeaf(const glm::vec3& position) const {
+    if (m_leaves.empty()) {
+        return -1;
+    }
+    // 网格外的点夹到边上的格子，格子里的叶子再按盒子精确判断
+    int voxel = GridIndex(position);
+    for (uint32_t i = m_gridStarts[voxel]; i < m_gridStarts[voxel + 1]; i++) {
+        const Leaf& leaf = m_leaves[m_gridLeaves[i]];
+        if (position.x >= leaf.minBounds.x && position.y >= leaf.minBounds.y && position.z >= leaf.minBounds.z &&
+            position.x <= leaf.maxBounds.x && position.y <= leaf.maxBounds.y && position.z <= leaf.maxBounds.z) {
+            return static_cast<int>(m_gridLeaves[i]);
+        }
+    }
+    return -1;
+}
+
+// 文件格式（小端序）：标识、叶子边长、网格原点和大小、单元格数、叶子（盒子和单元格）、
+// 每个叶子的行号、行数和每行的字数、每行压缩数据的起点、压缩数据
+bool VisibilitySet::Save(const std::string& path) const {
+    if (m_leaves.empty()) {
+        return false;
+    }
+    const int rowCount = static_cast<int>(m_rowOffsets.size()) - 1;
+    size_t size = 64 + m_leaves.size() * 32 + m_leafRows.size() * 4 + m_rowOffsets.size() * 4 + m_compressed.size();
+    std::vector<uint8_t> data(size);
+    ByteWriter writer(data.data(), static_cast<int>(size));
+    writer.WriteU32(VISIBILITY_FILE_ID);
+    writer.WriteFloat(m_leafSize);
+    for (int i = 0; i < 3; i++) {
+        writer.WriteFloat(m_gridOrigin[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        writer.WriteU32(static_cast<uint32_t>(m_gridSize[i]));
+    }
+    writer.WriteU32(static_cast<uint32_t>(m_stats.cells));
+    writer.WriteU32(static_cast<uint32_t>(m_leaves.size()));
+    for (const Leaf& leaf : m_leaves) {
+        for (int i = 0; i < 3; i++) {
+            writer.WriteFloat(leaf.minBounds[i]);
+        }
+        for (int i = 0; i < 3; i++) {
+            writer.WriteFloat(leaf.maxBounds[i]);
+        }
+        writer.WriteU32(static_cast<uint32_t>(leaf.cell));
+    }
+    for (uint32_t row : m_leafRows) {
+        writer.WriteU32(row);
+    }
+    writer.WriteU32(static_cast<uint32_t>(rowCount));
+    writer.WriteU32(static_cast<uint32_t>(m_rowWords));
+    for (uint32_t offset : m_rowOffsets) {
+        writer.WriteU32(offset);
+    }
+    writer.Write(m_compressed.data(), static_cast<int>(m_compressed.size()));
+    if (writer.Overflowed()) {
+        return false;
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, writer.GetSize(), file) == static_cast<size_t>(writer.GetSize());
+    return fclose(file) == 0 && ok;
+}
+
+bool VisibilitySet::Load(const std::string& path) {
+    Clear();
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[65536];
+    size_t count;
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + count);
+    }
+    fclose(file);
+
+    ByteReader reader(data.data(), static_cast<int>(data.size()));
+    if (reader.ReadU32() != VISIBILITY_FILE_ID) {
+        return false;
+    }
+    m_leafSize = reader.ReadFloat();
+    for (int i = 0; i < 3; i++) {
+        m_gridOrigin[i] = reader.ReadFloat();
+    }
+    for (int i = 0; i < 3; i++) {
+        m_gridSize[i] = static_cast<int>(reader.ReadU32());
+    }
+    m_stats.cells = static_cast<int>(reader.ReadU32());
+    uint32_t leafCount = reader.ReadU32();
+    // 每个叶子至少28字节，数量不可能超过剩下的数据
+    bool gridValid = true;
+    for (int i = 0; i < 3; i++) {
+        gridValid = gridValid && m_gridSize[i] >= 1 && m_gridSize[i] <= 4096;
+    }
+    if (reader.Failed() || !(m_leafSize > 0.0f) || !gridValid || leafCount == 0 ||
+        leafCount > static_cast<uint32_t>(reader.GetRemaining()) / 28) {
+        Clear();
+        return false;
+    }
+    m_leaves.resize(leafCount);
+    for (Leaf& leaf : m_leaves) {
+        for (int i = 0; i < 3; i++) {
+            leaf.minBounds[i] = reader.ReadFloat();
+        }
+        for (int i = 0; i < 3; i++) {
+            leaf.maxBounds[i] = reader.ReadFloat();
+        }
+        leaf.cell = static_cast<int>(reader.ReadU32());
+    }
+    m_leafRows.resize(leafCount);
+    for (uint32_t& row : m_leafRows) {
+        row = reader.ReadU32();
+    }
+    uint32_t rowCount = reader.ReadU32();
+    m_rowWords = static_cast<int>(reader.ReadU32());
+    if (reader.Failed() || rowCount == 0 || rowCount > leafCount ||
+        m_rowWords != static_cast<int>((leafCount + 63) / 64)) {
+        Clear();
+        return false;
+    }
+    m_rowOffsets.resize(rowCount + 1);
+    for (uint32_t& offset : m_rowOffsets) {
+        offset = reader.ReadU32();
+    }
+    if (reader.Failed() || m_rowOffsets[0] != 0 || m_rowOffsets.back() != static_cast<uint32_t>(reader.GetRemaining())) {
+        Clear();
+        return false;
+    }
+    m_compressed.assign(reader.GetCursor(), reader.GetCursor() + reader.GetRemaining());
+    if (!DecompressRows()) {
+        Clear();
+        return false;
+    }
+    BuildGrid();
+    return true;
+}
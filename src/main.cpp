@@ -4,69 +4,44 @@
 #include <iostream>
 #include <chrono>
 #include <cmath>
-#include <png.h>
 #include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "RenderQueue.h"
+#include "JobSystem.h"
+#include "OcclusionCuller.h"
+#include "LevelGeometry.h"
+#include "DecalSystem.h"
+#include "ParticleWorld.h"
+#include "ParticleCollider.h"
+#include "GpuParticleWorld.h"
+#include "CollisionWorld.h"
+#include "Hitscan.h"
+#include "GameSimulation.h"
+#include "PlayerMovement.h"
+#include "Image.h"
+#include "SoftwareRasterizer.h"
+#include "Renderer.h"
+#include "DynamicResolution.h"
+#include "LatencyTracker.h"
+#include "FramePacer.h"
 
 // 房间大小常量 - 在这里修改房间尺寸
 const float ROOM_SIZE = 60.0f;  // 房间的宽度和长度 (从-30到+30)
 const float ROOM_HEIGHT = 25.0f; // 房间的高度 (从0到25)
 const float ROOM_HALF = ROOM_SIZE / 2.0f; // 房间的一半大小
 
-// 纹理加载函数
-GLuint loadTexture(const char* filename) {
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
-        std::cerr << "无法打开纹理文件: " << filename << std::endl;
-        return 0;
-    }
-    
-    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-    if (!png) {
-        fclose(file);
-        return 0;
-    }
-    
-    png_infop info = png_create_info_struct(png);
-    if (!info) {
-        png_destroy_read_struct(&png, nullptr, nullptr);
-        fclose(file);
-        return 0;
-    }
-    
-    if (setjmp(png_jmpbuf(png))) {
-        png_destroy_read_struct(&png, &info, nullptr);
-        fclose(file);
-        return 0;
-    }
-    
-    png_init_io(png, file);
-    png_read_info(png, info);
-    
-    int width = png_get_image_width(png, info);
-    int height = png_get_image_height(png, info);
-    png_byte color_type = png_get_color_type(png, info);
-    png_byte bit_depth = png_get_bit_depth(png, info);
-    
-    if (bit_depth == 16) png_set_strip_16(png);
-    if (color_type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png);
-    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) png_set_expand_gray_1_2_4_to_8(png);
-    if (png_get_valid(png, info, PNG_INFO_tRNS)) png_set_tRNS_to_alpha(png);
-    if (color_type == PNG_COLOR_TYPE_RGB || color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_PALETTE)
-        png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
-    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
-        png_set_gray_to_rgb(png);
-    
-    png_read_update_info(png, info);
-    
-    png_bytep* row_pointers = (png_bytep*)malloc(sizeof(png_bytep) * height);
-    for (int y = 0; y < height; y++) {
-        row_pointers[y] = (png_byte*)malloc(png_get_rowbytes(png, info));
-    }
-    
-    png_read_image(png, row_pointers);
-    fclose(file);
-    
-    // 创建OpenGL纹理
+// 窗口和软件渲染的默认帧缓冲大小
+const int SCREEN_WIDTH = 1024;
+const int SCREEN_HEIGHT = 768;
+
+// 用解码好的图像创建OpenGL纹理
+GLuint createTexture(const Image& image) {
     GLuint texture;
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
@@ -78,31 +53,27 @@ GLuint loadTexture(const char* filename) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     
     // 上传纹理数据
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    
-    // 将PNG数据上传到纹理
-    for (int y = 0; y < height; y++) {
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, 1, GL_RGBA, GL_UNSIGNED_BYTE, row_pointers[y]);
-    }
-    
-    // 清理
-    for (int y = 0; y < height; y++) {
-        free(row_pointers[y]);
-    }
-    free(row_pointers);
-    png_destroy_read_struct(&png, &info, nullptr);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 image.pixels.data());
     
     return texture;
 }
 
-// 简单的相机类
+// 关卡三角形的BVH，相机和其他移动物体的连续碰撞
+CollisionWorld collisionWorld;
+
+// 射击：鼠标点击时加入，每帧一起处理
+Hitscan hitscan;
+const float RIFLE_PENETRATION = 2.5f;  // 步枪子弹能穿过2.5米墙
+
+// 简单的相机类（有窗口时位置跟着本地玩家的眼睛）
 class SimpleCamera {
 public:
     float x, y, z;
     float yaw, pitch;
-    float radius; // 碰撞检测半径
     
-    SimpleCamera() : x(0), y(3), z(0), yaw(-90), pitch(0), radius(0.5f) {}
+    SimpleCamera() : x(0), y(3), z(0), yaw(-90), pitch(0) {}
     
     void update() {
         // 更新相机位置
@@ -113,45 +84,6 @@ public:
         if (pitch > 89.0f) pitch = 89.0f;
         if (pitch < -89.0f) pitch = -89.0f;
     }
-    
-    // 检查是否与墙壁碰撞
-    bool checkCollision(float newX, float newY, float newZ) {
-        // 检查X轴边界（左右墙壁）
-        if (newX - radius < -ROOM_HALF || newX + radius > ROOM_HALF) {
-            return true;
-        }
-        
-        // 检查Y轴边界（地面和天花板）
-        if (newY - radius < 0.5f || newY + radius > ROOM_HEIGHT - 0.5f) {
-            return true;
-        }
-        
-        // 检查Z轴边界（前后墙壁）
-        if (newZ - radius < -ROOM_HALF || newZ + radius > ROOM_HALF) {
-            return true;
-        }
-        
-        return false;
-    }
-    
-    void move(float dx, float dy, float dz) {
-        float newX = x + dx;
-        float newY = y + dy;
-        float newZ = z + dz;
-        
-        // 分别检查每个轴的移动，只阻止碰撞的轴
-        if (!checkCollision(newX, y, z)) {
-            x = newX;
-        }
-        
-        if (!checkCollision(x, newY, z)) {
-            y = newY;
-        }
-        
-        if (!checkCollision(x, y, newZ)) {
-            z = newZ;
-        }
-    }
 };
 
 // 全局变量
@@ -160,36 +92,69 @@ bool keys[1024] = {false};
 double lastX = 400, lastY = 300;
 bool firstMouse = true;
 bool mouseCaptured = true; // 鼠标是否被捕获
-GLuint wallTexture = 0;
-GLuint floorTexture = 0;
-GLuint skyTexture = 0;
-GLuint logoTexture = 0;
-GLuint daqingTexture = 0;
-GLuint homeTexture = 0;
-
-// 窗户相关变量
-float windowWidth = 8.0f;  // 窗户宽度
-float windowHeight = 6.0f; // 窗户高度
-float windowX = -8.0f;     // 窗户X位置（往左移动8单位）
-float windowY = 8.0f;      // 窗户Y位置（离地面8单位）
-float windowZ = -ROOM_HALF - 0.01f; // 窗户Z位置（在前墙上）
-float wallThickness = 2.0f; // 墙壁厚度
-
-// 火焰粒子系统
-struct Particle {
-    float x, y, z;        // 位置
-    float vx, vy, vz;     // 速度
-    float life;           // 生命值 (0.0 - 1.0)
-    float size;           // 大小
-    float r, g, b, a;     // 颜色
-};
+bool occlusionCullingEnabled = true; // 是否启用软件遮挡剔除
+
+// 本地玩家：键盘输入变成命令，按固定的128Hz模拟，相机在最近两帧之间插值
+PlayerMovement playerMovement;
+PlayerState playerState = {};
+PlayerState previousPlayerState = {};
+int playerTick = 0;
+float movementAccumulator = 0.0f;
+
+// 命令行选项
+bool useSoftwareRenderer = false; // --renderer software：用CPU光栅化代替OpenGL
+int frameLimit = 0;                // --frames N：以固定1/60秒步长运行N帧后退出
+const char* outputPath = nullptr;  // --output file.png：最后一帧保存为PNG
+const char* comparePath = nullptr; // --compare ref.png：与参考图像比较并输出PSNR
 
-const int MAX_PARTICLES = 200;
-Particle particles[MAX_PARTICLES];
-int particleCount = 0;
-float fireX = 0.0f;       // 火焰X位置
-float fireY = 1.0f;       // 火焰Y位置（地面附近）
-float fireZ = 0.0f;       // 火焰Z位置
+// 动态分辨率（OpenGL路径）：场景渲染到离屏目标，分辨率由GPU计时驱动，再放大锐化到窗口
+Renderer renderer;
+DynamicResolution dynamicResolution;
+bool dynamicResolutionEnabled = true; // R键切换
+float fixedResolutionScale = 1.0f;    // --resolution-scale S：关闭动态分辨率时的固定缩放
+float upscaleSharpness = 0.5f;        // --sharpness S：放大时的锐化强度 [0, 1]
+bool bloomEnabled = false;            // --bloom 或 B键：火焰泛光
+int framebufferWidth = SCREEN_WIDTH;  // 当前窗口帧缓冲大小
+int framebufferHeight = SCREEN_HEIGHT;
+
+// 低延迟模式：在setupCamera之前重新采样鼠标，并推迟帧开始时间
+bool lateLatchEnabled = false; // --late-latch 或 L键切换
+LatencyTracker latencyTracker;
+FramePacer framePacer;
+
+// 单调时钟（秒），输入时间戳、帧节奏和延迟统计共用
+double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 关卡几何（房间、前墙、窗户、装饰画）
+LevelGeometry level;
+
+// 材质纹理：CPU端的图像供软件光栅化使用，GL纹理供OpenGL使用
+Image materialImages[MATERIAL_COUNT];
+GLuint materialTextures[MATERIAL_COUNT] = {0};
+
+// 贴花：装饰画和弹孔共用一张图集，一次实例化绘制
+DecalAtlas decalAtlas;
+DecalSystem decals;
+GLuint decalAtlasTexture = 0;
+int bulletHoleRegion = -1;
+int initialBulletHoles = 0;           // --bullet-holes N：启动时随机射出N发
+
+// 粒子效果：效果定义在res/effects.txt，火焰、烟雾、火花、手雷可以同时存在
+ParticleWorld particleWorld;
+ParticleCollider particleCollider;    // 房间的平面、前墙的盒子和窗户的距离场
+int grenadeEffect = -1;
+int impactEffect = -1;
+std::vector<int> particleDrawOffsets;  // 每个发射器第一个粒子在渲染队列payload中的偏移
+int particleBenchCount = 0;           // --particle-bench N：测试N个粒子的更新速度后退出
+int initialGrenades = 0;              // --grenades N：启动时在房间里随机引爆N颗手雷
+int particleResolution = 2;           // --particle-resolution 1|2|4 或 P键：粒子层为场景分辨率的1/N，1为直接画在场景上
+int queuedParticleCount = 0;          // 本帧渲染队列中的粒子个数
+bool gpuParticles = false;            // --particle-backend gpu：粒子状态留在GPU上，用transform feedback更新
+GpuParticleWorld gpuParticleWorld(renderer);
+const int GPU_PARTICLE_CAPACITY_SCALE = 8; // GPU粒子池按效果共用，容量为效果的maxParticles的倍数
+const glm::vec3 FIRE_POSITION(0.0f, 1.0f, 0.0f); // 火焰位置（地面附近）
 
 // 光照变量
 float lightIntensity = 6.0f; // 光源亮度 (0.0 - 10.0)
@@ -198,6 +163,124 @@ float lightAmbient[4] = {0.8f, 0.8f, 0.8f, 1.0f}; // 环境光
 float lightDiffuse[4] = {6.0f, 6.0f, 6.0f, 1.0f}; // 漫反射光
 float lightSpecular[4] = {6.0f, 6.0f, 6.0f, 1.0f}; // 镜面反射光
 
+// 场景中的所有光源，固定管线和软件光栅化共用
+const int LIGHT_COUNT = 4;
+RasterLight sceneLights[LIGHT_COUNT];
+
+// 在表面上留下弹孔
+void addBulletHole(const glm::vec3& position, const glm::vec3& normal) {
+    if (bulletHoleRegion < 0) {
+        return;
+    }
+    // 随机旋转，大小略有不同
+    float angle = (rand() % 360) * float(M_PI) / 180.0f;
+    glm::vec3 reference = std::fabs(normal.y) < 0.9f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+    glm::vec3 tangent = glm::normalize(glm::cross(reference, normal));
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+    glm::vec3 up = tangent * std::cos(angle) + bitangent * std::sin(angle);
+    float size = 0.15f + (rand() % 100) / 1000.0f;
+    decals.Add(position, normal, up, size, size, decalAtlas.GetRegion(bulletHoleRegion));
+}
+
+// 从origin沿direction射击，在命中的表面上留下弹孔
+bool spawnBulletHole(const glm::vec3& origin, const glm::vec3& direction, LevelHit& hit) {
+    if (bulletHoleRegion < 0 || !collisionWorld.Raycast(origin, direction, 1000.0f, hit)) {
+        return false;
+    }
+    addBulletHole(hit.position, hit.normal);
+    return true;
+}
+
+// 相机朝向，与updateCameraMatrices相同
+glm::vec3 cameraForward() {
+    float radYaw = camera.yaw * M_PI / 180.0f;
+    float radPitch = camera.pitch * M_PI / 180.0f;
+    return glm::vec3(cos(radPitch) * cos(radYaw), sin(radPitch), cos(radPitch) * sin(radYaw));
+}
+
+// 在当前的粒子后端上启动效果
+void spawnParticleEffect(int effect, const glm::vec3& position, const glm::vec3& direction = glm::vec3(0.0f)) {
+    if (gpuParticles) {
+        gpuParticleWorld.Spawn(effect, position, direction);
+    } else {
+        particleWorld.Spawn(effect, position, direction);
+    }
+}
+
+// 在准星指向的位置引爆手雷，最远15米
+void throwGrenade() {
+    const float maxDistance = 15.0f;
+    glm::vec3 origin(camera.x, camera.y, camera.z);
+    glm::vec3 direction = cameraForward();
+    LevelHit hit;
+    glm::vec3 position = collisionWorld.Raycast(origin, direction, maxDistance, hit)
+                             ? hit.position + hit.normal * 0.3f
+                             : origin + direction * maxDistance;
+    spawnParticleEffect(grenadeEffect, position);
+}
+
+// 处理这一帧所有的射击：子弹穿过的每个表面都留下弹孔，第一个表面溅出火花
+void processShots() {
+    if (hitscan.GetShotCount() == 0) {
+        return;
+    }
+    hitscan.Process();
+    for (int shot = 0; shot < hitscan.GetShotCount(); shot++) {
+        for (int i = 0; i < hitscan.GetImpactCount(shot); i++) {
+            const HitscanImpact& impact = hitscan.GetImpact(shot, i);
+            addBulletHole(impact.position, impact.normal);
+            if (i == 0) {
+                spawnParticleEffect(impactEffect, impact.position + impact.normal * 0.02f, impact.normal);
+            }
+        }
+    }
+    hitscan.Clear();
+}
+
+// 本地玩家站在相机下面（眼睛在相机的位置）
+void resetPlayer() {
+    playerState = {};
+    playerState.position = glm::vec3(camera.x, camera.y - playerMovement.GetSettings().standEyeHeight, camera.z);
+    previousPlayerState = playerState;
+    movementAccumulator = 0.0f;
+}
+
+// 把当前的按键和视角变成这一帧的命令（鼠标没有被捕获时不移动）
+PlayerCommand buildPlayerCommand() {
+    PlayerCommand command = {};
+    command.tick = playerTick;
+    command.yaw = PlayerMovement::QuantizeYaw(camera.yaw);
+    command.pitch = PlayerMovement::QuantizePitch(camera.pitch);
+    if (!mouseCaptured) {
+        return command;
+    }
+    command.forward = static_cast<int8_t>((keys[GLFW_KEY_W] ? 127 : 0) - (keys[GLFW_KEY_S] ? 127 : 0));
+    command.side = static_cast<int8_t>((keys[GLFW_KEY_D] ? 127 : 0) - (keys[GLFW_KEY_A] ? 127 : 0));
+    command.buttons = (keys[GLFW_KEY_SPACE] ? BUTTON_JUMP : 0) | (keys[GLFW_KEY_LEFT_CONTROL] ? BUTTON_DUCK : 0) |
+                      (keys[GLFW_KEY_LEFT_SHIFT] ? BUTTON_WALK : 0);
+    return command;
+}
+
+// 累积帧时间，按固定帧率模拟本地玩家，再把相机放到前后两帧之间插值的眼睛位置
+void updatePlayer(float deltaTime) {
+    const float tickSeconds = playerMovement.GetTickSeconds();
+    // 卡顿之后最多补0.25秒，不会越补越慢
+    movementAccumulator = std::min(movementAccumulator + deltaTime, 0.25f);
+    while (movementAccumulator >= tickSeconds) {
+        previousPlayerState = playerState;
+        playerMovement.Simulate(playerState, buildPlayerCommand());
+        playerTick++;
+        movementAccumulator -= tickSeconds;
+    }
+    float t = movementAccumulator / tickSeconds;
+    glm::vec3 position = previousPlayerState.position + (playerState.position - previousPlayerState.position) * t;
+    float previousEye = playerMovement.GetEyeHeight(previousPlayerState);
+    float eye = previousEye + (playerMovement.GetEyeHeight(playerState) - previousEye) * t;
+    camera.x = position.x;
+    camera.y = position.y + eye;
+    camera.z = position.z;
+}
+
 // 键盘回调
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (action == GLFW_PRESS) {
@@ -217,19 +300,63 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
         }
     }
     
+    // R键：切换动态分辨率
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        dynamicResolutionEnabled = !dynamicResolutionEnabled;
+        if (!dynamicResolutionEnabled) {
+            dynamicResolution.Reset(fixedResolutionScale);
+        }
+        std::cout << "动态分辨率: " << (dynamicResolutionEnabled ? "开" : "关") << std::endl;
+    }
+    
+    // L键：切换低延迟模式，先输出当前模式的延迟统计
+    if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+        latencyTracker.PrintReport(lateLatchEnabled ? "低延迟模式" : "普通模式");
+        latencyTracker.Reset();
+        lateLatchEnabled = !lateLatchEnabled;
+        // 普通模式不开垂直同步，和启动时一样
+        glfwSwapInterval(lateLatchEnabled ? 1 : 0);
+        std::cout << "低延迟模式: " << (lateLatchEnabled ? "开" : "关") << std::endl;
+    }
+    
+    // B键：切换泛光
+    if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+        bloomEnabled = !bloomEnabled;
+        std::cout << "泛光: " << (bloomEnabled ? "开" : "关") << std::endl;
+    }
+    
+    // P键：切换粒子层分辨率（全分辨率 -> 1/2 -> 1/4）
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        particleResolution = particleResolution >= 4 ? 1 : particleResolution * 2;
+        std::cout << "粒子分辨率: 1/" << particleResolution << std::endl;
+    }
+    
+    // G键：引爆手雷
+    if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+        throwGrenade();
+    }
+    
+    // O键：切换遮挡剔除
+    if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+        occlusionCullingEnabled = !occlusionCullingEnabled;
+        std::cout << "遮挡剔除: " << (occlusionCullingEnabled ? "开" : "关") << std::endl;
+    }
+    
     // Q键：退出应用
     if (key == GLFW_KEY_Q && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
 }
 
-// 鼠标回调
-void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
-    // 只有在鼠标被捕获时才处理视角
-    if (!mouseCaptured) {
-        return;
+// 鼠标左键：射击，在这一帧的processShots中处理
+void mouseButtonCallback(GLFWwindow*, int button, int action, int) {
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && mouseCaptured) {
+        hitscan.AddShot({glm::vec3(camera.x, camera.y, camera.z), cameraForward(), 1000.0f, RIFLE_PENETRATION});
     }
-    
+}
+
+// 用鼠标位置更新视角
+void applyCursorPosition(double xpos, double ypos) {
     if (firstMouse) {
         lastX = xpos;
         lastY = ypos;
@@ -251,760 +378,1179 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
     camera.update();
 }
 
+// 鼠标回调
+void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
+    // 只有在鼠标被捕获时才处理视角
+    if (!mouseCaptured) {
+        return;
+    }
+    
+    latencyTracker.OnInput(nowSeconds());
+    
+    // 低延迟模式下位置在latchCameraInput中采样
+    if (lateLatchEnabled) {
+        return;
+    }
+    applyCursorPosition(xpos, ypos);
+}
+
+// 低延迟模式：在构建视图矩阵之前处理最新的事件并采样鼠标位置
+void latchCameraInput(GLFWwindow* window) {
+    glfwPollEvents();
+    if (mouseCaptured) {
+        double xpos, ypos;
+        glfwGetCursorPos(window, &xpos, &ypos);
+        applyCursorPosition(xpos, ypos);
+    }
+}
+
 // 鼠标滚轮回调
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
     // 滚轮调整光亮度功能已禁用
     // 可以在这里添加其他滚轮功能
 }
 
-// 绘制带纹理的房间
-void drawRoom() {
-    // 启用纹理
-    glEnable(GL_TEXTURE_2D);
-    
-    // 地面 - 使用floor纹理，增加重复次数
-    glBindTexture(GL_TEXTURE_2D, floorTexture);
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-ROOM_HALF, 0, -ROOM_HALF);
-    glTexCoord2f(8.0f, 0.0f); glVertex3f(ROOM_HALF, 0, -ROOM_HALF);
-    glTexCoord2f(8.0f, 8.0f); glVertex3f(ROOM_HALF, 0, ROOM_HALF);
-    glTexCoord2f(0.0f, 8.0f); glVertex3f(-ROOM_HALF, 0, ROOM_HALF);
-    glEnd();
-    
-    // 天花板 - 使用sky纹理，增加重复次数
-    glBindTexture(GL_TEXTURE_2D, skyTexture);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-ROOM_HALF, ROOM_HEIGHT, -ROOM_HALF);
-    glTexCoord2f(8.0f, 0.0f); glVertex3f(ROOM_HALF, ROOM_HEIGHT, -ROOM_HALF);
-    glTexCoord2f(8.0f, 8.0f); glVertex3f(ROOM_HALF, ROOM_HEIGHT, ROOM_HALF);
-    glTexCoord2f(0.0f, 8.0f); glVertex3f(-ROOM_HALF, ROOM_HEIGHT, ROOM_HALF);
-    glEnd();
-    
-    // 前墙 - 有厚度的墙，带窗户洞
-    glBindTexture(GL_TEXTURE_2D, wallTexture);
-    
-    // 内墙（房间内部看到的面）
-    float innerZ = -ROOM_HALF;
-    float outerZ = -ROOM_HALF - wallThickness;
-    
-    // 内墙上半部分（窗户上方）
-    float topTexBottom = (windowY + windowHeight/2) / ROOM_HEIGHT * 6.0f;
-    float topTexTop = 6.0f;
-    
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, topTexBottom); glVertex3f(-ROOM_HALF, windowY + windowHeight/2, innerZ);
-    glTexCoord2f(8.0f, topTexBottom); glVertex3f(ROOM_HALF, windowY + windowHeight/2, innerZ);
-    glTexCoord2f(8.0f, topTexTop); glVertex3f(ROOM_HALF, ROOM_HEIGHT, innerZ);
-    glTexCoord2f(0.0f, topTexTop); glVertex3f(-ROOM_HALF, ROOM_HEIGHT, innerZ);
-    glEnd();
-    
-    // 内墙下半部分（窗户下方）
-    float bottomTexTop = (windowY - windowHeight/2) / ROOM_HEIGHT * 6.0f;
-    float bottomTexBottom = 0.0f;
+// 绘制关卡中的一个表面（房间、前墙、窗户）
+void drawSurface(int id) {
+    const LevelSurface& surface = level.GetSurface(id);
+    glColor4f(surface.color.x, surface.color.y, surface.color.z, surface.color.w);
     
     glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, bottomTexBottom); glVertex3f(-ROOM_HALF, 0, innerZ);
-    glTexCoord2f(8.0f, bottomTexBottom); glVertex3f(ROOM_HALF, 0, innerZ);
-    glTexCoord2f(8.0f, bottomTexTop); glVertex3f(ROOM_HALF, windowY - windowHeight/2, innerZ);
-    glTexCoord2f(0.0f, bottomTexTop); glVertex3f(-ROOM_HALF, windowY - windowHeight/2, innerZ);
-    glEnd();
-    
-    // 内墙左侧部分（窗户左侧）
-    float leftTexStart = 0.0f;
-    float leftTexEnd = (windowX - windowWidth/2 - (-ROOM_HALF)) / ROOM_SIZE * 8.0f;
-    float leftTexHeight = windowHeight / ROOM_HEIGHT * 6.0f;
-    float leftTexBottom = (windowY - windowHeight/2) / ROOM_HEIGHT * 6.0f;
-    
-    glBegin(GL_QUADS);
-    glTexCoord2f(leftTexStart, leftTexBottom); glVertex3f(-ROOM_HALF, windowY - windowHeight/2, innerZ);
-    glTexCoord2f(leftTexEnd, leftTexBottom); glVertex3f(windowX - windowWidth/2, windowY - windowHeight/2, innerZ);
-    glTexCoord2f(leftTexEnd, leftTexBottom + leftTexHeight); glVertex3f(windowX - windowWidth/2, windowY + windowHeight/2, innerZ);
-    glTexCoord2f(leftTexStart, leftTexBottom + leftTexHeight); glVertex3f(-ROOM_HALF, windowY + windowHeight/2, innerZ);
-    glEnd();
-    
-    // 内墙右侧部分（窗户右侧）
-    float rightTexStart = (windowX + windowWidth/2 - (-ROOM_HALF)) / ROOM_SIZE * 8.0f;
-    float rightTexEnd = 8.0f;
-    float rightTexHeight = windowHeight / ROOM_HEIGHT * 6.0f;
-    float rightTexBottom = (windowY - windowHeight/2) / ROOM_HEIGHT * 6.0f;
-    
-    glBegin(GL_QUADS);
-    glTexCoord2f(rightTexStart, rightTexBottom); glVertex3f(windowX + windowWidth/2, windowY - windowHeight/2, innerZ);
-    glTexCoord2f(rightTexEnd, rightTexBottom); glVertex3f(ROOM_HALF, windowY - windowHeight/2, innerZ);
-    glTexCoord2f(rightTexEnd, rightTexBottom + rightTexHeight); glVertex3f(ROOM_HALF, windowY + windowHeight/2, innerZ);
-    glTexCoord2f(rightTexStart, rightTexBottom + rightTexHeight); glVertex3f(windowX + windowWidth/2, windowY + windowHeight/2, innerZ);
-    glEnd();
-    
-    // 注意：窗户的玻璃区域不在这里绘制，它在drawWindow()函数中单独绘制
-    
-    // 外墙（房间外部看到的面）
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-ROOM_HALF, 0, outerZ);
-    glTexCoord2f(8.0f, 0.0f); glVertex3f(ROOM_HALF, 0, outerZ);
-    glTexCoord2f(8.0f, 6.0f); glVertex3f(ROOM_HALF, ROOM_HEIGHT, outerZ);
-    glTexCoord2f(0.0f, 6.0f); glVertex3f(-ROOM_HALF, ROOM_HEIGHT, outerZ);
+    for (int q = 0; q < surface.quadCount; q++) {
+        for (int i = 0; i < 4; i++) {
+            const LevelVertex& v = level.GetQuadVertex(surface.firstQuad + q, i);
+            glNormal3f(v.normal.x, v.normal.y, v.normal.z);
+            glTexCoord2f(v.uv.x, v.uv.y);
+            glVertex3f(v.position.x, v.position.y, v.position.z);
+        }
+    }
     glEnd();
+}
+
+// 初始化粒子系统：读取效果定义，点燃房间中央的火焰
+// GPU后端使用同一份效果定义，初始化失败时回到CPU后端
+void initParticles() {
+    uint32_t seed = static_cast<uint32_t>(rand()); // 跟随--seed
+    particleWorld.Seed(seed);
+    particleWorld.Clear();
+    particleCollider.BuildLevel(level);
+    particleWorld.SetCollider(&particleCollider);
+    if (!particleWorld.LoadEffects("res/effects.txt")) {
+        std::cerr << "Warning: 没有粒子效果" << std::endl;
+        return;
+    }
+    if (gpuParticles) {
+        gpuParticleWorld.Seed(seed);
+        if (!gpuParticleWorld.Initialize(particleWorld, GPU_PARTICLE_CAPACITY_SCALE)) {
+            std::cerr << "Warning: GPU粒子初始化失败，使用CPU粒子" << std::endl;
+            gpuParticles = false;
+        }
+    }
+    grenadeEffect = particleWorld.FindEffect("grenade");
+    impactEffect = particleWorld.FindEffect("impact_sparks");
+    spawnParticleEffect(particleWorld.FindEffect("fire"), FIRE_POSITION);
+}
+
+// 更新粒子：CPU后端在工作线程上并行执行所有发射器的更新和发射，GPU后端只提交命令
+void updateParticles(float deltaTime) {
+    if (gpuParticles) {
+        gpuParticleWorld.Update(deltaTime);
+    } else {
+        particleWorld.Update(deltaTime);
+    }
+}
+
+// 测试粒子更新的吞吐量：先预热到年龄分布稳定，每帧都有一部分粒子死亡、一部分新生
+// 单线程的帧另外测量与关卡碰撞（反弹）的时间
+void runParticleBenchmark(int count) {
+    JobSystem jobs;
+    ParticleSystem bench(count);
+    ParticleSimParams params;
+    params.gravity = glm::vec3(0.0f, -0.06f, 0.0f);
+    params.turbulence = 1.8f;
+    params.collision.response = PARTICLE_COLLISION_BOUNCE;
+    params.collision.radius = 0.05f;
+    bench.SetParams(params);
+    bench.Seed(1);
+    
+    LevelGeometry benchLevel;
+    benchLevel.Build();
+    ParticleCollider collider;
+    collider.BuildLevel(benchLevel);
+    
+    const int warmup = 150;
+    const int iterations = 200;
+    const float deltaTime = 1.0f / 60.0f;
+    const int spawnPerFrame = std::max(count / 100, 1);
+    double updateSeconds[2] = {0.0, 0.0};
+    double collideSeconds = 0.0;
+    long long updated = 0;
+    long long contacts = 0;
+    for (int iteration = 0; iteration < warmup + iterations; iteration++) {
+        for (int i = 0; i < spawnPerFrame; i++) {
+            glm::vec3 position(bench.Random(), bench.Random(), bench.Random());
+            glm::vec3 velocity(bench.Random() - 0.5f, bench.Random() * 3.0f, bench.Random() - 0.5f);
+            if (bench.Spawn(position, velocity, 0.1f, 1.5f + bench.Random()) < 0) {
+                break;
+            }
+        }
+        int alive = bench.GetCount();
+        // 偶数帧单线程，奇数帧按块分给所有线程
+        bool parallel = iteration % 2 == 1;
+        double start = nowSeconds();
+        if (parallel) {
+            int chunks = bench.BeginUpdate();
+            jobs.ParallelFor(chunks, [&bench, deltaTime](int begin, int end, int) {
+                for (int chunk = begin; chunk < end; chunk++) {
+                    bench.UpdateChunk(chunk, deltaTime);
+                }
+            });
+            bench.EndUpdate();
+        } else {
+            int chunks = bench.BeginUpdate();
+            for (int chunk = 0; chunk < chunks; chunk++) {
+                bench.UpdateChunk(chunk, deltaTime);
+            }
+            double collideStart = nowSeconds();
+            for (int chunk = 0; chunk < chunks; chunk++) {
+                int touched = bench.CollideChunk(chunk, collider);
+                if (iteration >= warmup) {
+                    contacts += touched;
+                }
+            }
+            if (iteration >= warmup) {
+                collideSeconds += nowSeconds() - collideStart;
+            }
+            bench.EndUpdate();
+        }
+        if (iteration >= warmup) {
+            updateSeconds[parallel ? 1 : 0] += nowSeconds() - start;
+            updated += alive;
+        }
+    }
     
-    // 窗户的侧面（左、右、上、下）- 使用墙壁纹理
-    // 注意：这里绘制的是窗户的侧面（墙壁部分），不是玻璃
-    // 窗户左侧面
-    float leftSideTexStart = (windowX - windowWidth/2 - (-ROOM_HALF)) / ROOM_SIZE * 8.0f;
-    float leftSideTexEnd = leftSideTexStart + (wallThickness / ROOM_SIZE * 8.0f);
-    float leftSideTexHeight = windowHeight / ROOM_HEIGHT * 6.0f;
-    float leftSideTexBottom = (windowY - windowHeight/2) / ROOM_HEIGHT * 6.0f;
+    double perPass = updated / 2.0;
+    std::cout << "粒子更新: " << static_cast<long long>(perPass) << " 次" << std::endl;
+    updateSeconds[0] -= collideSeconds;
+    std::cout << "  单线程: " << updateSeconds[0] * 1000.0 << " ms, "
+              << perPass / (updateSeconds[0] * 1000.0) / 1e6 << " 百万次/ms" << std::endl;
+    std::cout << "  " << jobs.GetThreadCount() << " 个线程: " << updateSeconds[1] * 1000.0 << " ms, "
+              << perPass / (updateSeconds[1] * 1000.0) / 1e6 << " 百万次/ms" << std::endl;
+    std::cout << "  碰撞（单线程，接触 " << contacts << " 次）: " << collideSeconds * 1000.0 << " ms, "
+              << perPass / (collideSeconds * 1000.0) / 1e6 << " 百万次/ms" << std::endl;
+}
+
+// 与runParticleBenchmark相同的粒子参数，在GPU上更新：粒子池保持满载，每帧用glFinish等待更新完成
+void runGpuParticleBenchmark(int count) {
+    ParticleWorld effects;
+    ParticleEffectDesc desc;
+    desc.name = "bench";
+    desc.maxParticles = count;
+    desc.burst = count;
+    desc.spawnRate = count / 2.5f;
+    desc.lifetimeMin = 1.5f;
+    desc.lifetimeMax = 2.5f;
+    desc.speedMin = 0.5f;
+    desc.speedMax = 3.0f;
+    desc.coneAngle = 20.0f;
+    desc.spawnRadius = 1.0f;
+    desc.sim.gravity = glm::vec3(0.0f, -0.06f, 0.0f);
+    desc.sim.turbulence = 1.8f;
+    effects.AddEffect(desc);
+    
+    GpuParticleWorld bench(renderer);
+    bench.Seed(1);
+    if (!bench.Initialize(effects, 1)) {
+        return;
+    }
+    bench.Spawn(0, glm::vec3(0.0f));
+    
+    const int warmup = 150;
+    const int iterations = 200;
+    const float deltaTime = 1.0f / 60.0f;
+    double updateSeconds = 0.0;
+    for (int iteration = 0; iteration < warmup + iterations; iteration++) {
+        double start = nowSeconds();
+        bench.Update(deltaTime);
+        glFinish();
+        if (iteration >= warmup) {
+            updateSeconds += nowSeconds() - start;
+        }
+    }
     
+    double updated = static_cast<double>(count) * iterations;
+    std::cout << "GPU粒子更新: " << static_cast<long long>(updated) << " 次（" << glGetString(GL_RENDERER) << "）"
+              << std::endl;
+    std::cout << "  " << updateSeconds * 1000.0 << " ms, 每帧 " << updateSeconds * 1000.0 / iterations << " ms, "
+              << updated / (updateSeconds * 1000.0) / 1e6 << " 百万次/ms" << std::endl;
+    bench.Shutdown();
+}
+
+// 绘制单个粒子（混合与光照状态由渲染队列设置）
+void drawParticle(const ParticleSystem& particles, int index) {
+    uint32_t color = particles.GetColor(index);
+    glColor4ub(color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, color >> 24);
+    
+    glm::vec3 position = particles.GetPosition(index);
+    float size = particles.GetSize(index);
+    glPushMatrix();
+    glTranslatef(position.x, position.y, position.z);
+    glScalef(size, size, size);
+    
+    // 绘制简单的四边形作为粒子
     glBegin(GL_QUADS);
-    glTexCoord2f(leftSideTexStart, leftSideTexBottom); glVertex3f(windowX - windowWidth/2, windowY - windowHeight/2, innerZ);
-    glTexCoord2f(leftSideTexStart, leftSideTexBottom + leftSideTexHeight); glVertex3f(windowX - windowWidth/2, windowY + windowHeight/2, innerZ);
-    glTexCoord2f(leftSideTexEnd, leftSideTexBottom + leftSideTexHeight); glVertex3f(windowX - windowWidth/2, windowY + windowHeight/2, outerZ);
-    glTexCoord2f(leftSideTexEnd, leftSideTexBottom); glVertex3f(windowX - windowWidth/2, windowY - windowHeight/2, outerZ);
+    glVertex3f(-0.5f, -0.5f, 0.0f);
+    glVertex3f(0.5f, -0.5f, 0.0f);
+    glVertex3f(0.5f, 0.5f, 0.0f);
+    glVertex3f(-0.5f, 0.5f, 0.0f);
     glEnd();
     
-    // 窗户右侧面
-    float rightSideTexStart = (windowX + windowWidth/2 - (-ROOM_HALF)) / ROOM_SIZE * 8.0f;
-    float rightSideTexEnd = rightSideTexStart + (wallThickness / ROOM_SIZE * 8.0f);
-    float rightSideTexHeight = windowHeight / ROOM_HEIGHT * 6.0f;
-    float rightSideTexBottom = (windowY - windowHeight/2) / ROOM_HEIGHT * 6.0f;
-    
-    glBegin(GL_QUADS);
-    glTexCoord2f(rightSideTexStart, rightSideTexBottom); glVertex3f(windowX + windowWidth/2, windowY - windowHeight/2, outerZ);
-    glTexCoord2f(rightSideTexStart, rightSideTexBottom + rightSideTexHeight); glVertex3f(windowX + windowWidth/2, windowY + windowHeight/2, outerZ);
-    glTexCoord2f(rightSideTexEnd, rightSideTexBottom + rightSideTexHeight); glVertex3f(windowX + windowWidth/2, windowY + windowHeight/2, innerZ);
-    glTexCoord2f(rightSideTexEnd, rightSideTexBottom); glVertex3f(windowX + windowWidth/2, windowY - windowHeight/2, innerZ);
-    glEnd();
+    glPopMatrix();
+}
+
+// 初始化光源表
+void initLights() {
+    // 主光源
+    sceneLights[0] = {glm::make_vec4(lightPosition), glm::make_vec4(lightAmbient),
+                      glm::make_vec4(lightDiffuse), glm::make_vec4(lightSpecular),
+                      1.0f, 0.05f, 0.005f};
+    
+    // 第二个光源（补充光源）
+    sceneLights[1] = {glm::vec4(0.0f, 8.0f, 0.0f, 1.0f), glm::vec4(0.4f, 0.4f, 0.4f, 1.0f),
+                      glm::vec4(4.0f, 4.0f, 4.0f, 1.0f), glm::vec4(4.0f, 4.0f, 4.0f, 1.0f),
+                      1.0f, 0.1f, 0.01f};
+    
+    // 第三个光源（角落光源）
+    sceneLights[2] = {glm::vec4(15.0f, 10.0f, 15.0f, 1.0f), glm::vec4(0.3f, 0.3f, 0.3f, 1.0f),
+                      glm::vec4(3.0f, 3.0f, 3.0f, 1.0f), glm::vec4(3.0f, 3.0f, 3.0f, 1.0f),
+                      1.0f, 0.15f, 0.02f};
+    
+    // 太阳光源（从窗户照射进来），在窗户外面15单位处，更近一些
+    // 增强太阳环境光，大幅增强阳光强度；减少衰减，让光源更强
+    const LevelDesc& desc = level.GetDesc();
+    float windowZ = -ROOM_HALF - 0.01f;
+    sceneLights[3] = {glm::vec4(desc.windowX, desc.windowY, windowZ + 15.0f, 1.0f), glm::vec4(0.3f, 0.3f, 0.2f, 1.0f),
+                      glm::vec4(5.0f, 4.5f, 3.5f, 1.0f), glm::vec4(4.0f, 3.5f, 2.8f, 1.0f),
+                      1.0f, 0.01f, 0.0005f};
+}
+
+// 设置光照
+void setupLighting() {
+    // 启用光照
+    glEnable(GL_LIGHTING);
     
-    // 窗户上侧面
-    float topSideTexStart = (windowX - windowWidth/2 - (-ROOM_HALF)) / ROOM_SIZE * 8.0f;
-    float topSideTexEnd = (windowX + windowWidth/2 - (-ROOM_HALF)) / ROOM_SIZE * 8.0f;
-    float topSideTexHeight = wallThickness / ROOM_HEIGHT * 6.0f;
-    float topSideTexBottom = (windowY + windowHeight/2) / ROOM_HEIGHT * 6.0f;
+    // 光源位置在单位模型视图下设置，即相对相机固定
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        const RasterLight& light = sceneLights[i];
+        GLenum id = GL_LIGHT0 + i;
+        glEnable(id);
+        glLightfv(id, GL_POSITION, glm::value_ptr(light.position));
+        glLightfv(id, GL_AMBIENT, glm::value_ptr(light.ambient));
+        glLightfv(id, GL_DIFFUSE, glm::value_ptr(light.diffuse));
+        glLightfv(id, GL_SPECULAR, glm::value_ptr(light.specular));
+        glLightf(id, GL_CONSTANT_ATTENUATION, light.constantAttenuation);
+        glLightf(id, GL_LINEAR_ATTENUATION, light.linearAttenuation);
+        glLightf(id, GL_QUADRATIC_ATTENUATION, light.quadraticAttenuation);
+    }
     
-    glBegin(GL_QUADS);
-    glTexCoord2f(topSideTexStart, topSideTexBottom); glVertex3f(windowX - windowWidth/2, windowY + windowHeight/2, innerZ);
-    glTexCoord2f(topSideTexEnd, topSideTexBottom); glVertex3f(windowX + windowWidth/2, windowY + windowHeight/2, innerZ);
-    glTexCoord2f(topSideTexEnd, topSideTexBottom + topSideTexHeight); glVertex3f(windowX + windowWidth/2, windowY + windowHeight/2, outerZ);
-    glTexCoord2f(topSideTexStart, topSideTexBottom + topSideTexHeight); glVertex3f(windowX - windowWidth/2, windowY + windowHeight/2, outerZ);
-    glEnd();
+    // 启用颜色材质
+    glEnable(GL_COLOR_MATERIAL);
+    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+}
+
+// 本帧的相机矩阵，GL和软件光栅化共用
+glm::mat4 viewMatrix(1.0f);
+glm::mat4 projectionMatrix(1.0f);
+
+void updateCameraMatrices() {
+    projectionMatrix = glm::perspective(glm::radians(45.0f), float(framebufferWidth) / float(framebufferHeight), 0.1f, 100.0f);
     
-    // 窗户下侧面
-    float bottomSideTexStart = (windowX - windowWidth/2 - (-ROOM_HALF)) / ROOM_SIZE * 8.0f;
-    float bottomSideTexEnd = (windowX + windowWidth/2 - (-ROOM_HALF)) / ROOM_SIZE * 8.0f;
-    float bottomSideTexHeight = wallThickness / ROOM_HEIGHT * 6.0f;
-    float bottomSideTexBottom = (windowY - windowHeight/2) / ROOM_HEIGHT * 6.0f;
+    float radYaw = camera.yaw * M_PI / 180.0f;
+    float radPitch = camera.pitch * M_PI / 180.0f;
     
-    glBegin(GL_QUADS);
-    glTexCoord2f(bottomSideTexStart, bottomSideTexBottom); glVertex3f(windowX - windowWidth/2, windowY - windowHeight/2, outerZ);
-    glTexCoord2f(bottomSideTexEnd, bottomSideTexBottom); glVertex3f(windowX + windowWidth/2, windowY - windowHeight/2, outerZ);
-    glTexCoord2f(bottomSideTexEnd, bottomSideTexBottom + bottomSideTexHeight); glVertex3f(windowX + windowWidth/2, windowY - windowHeight/2, innerZ);
-    glTexCoord2f(bottomSideTexStart, bottomSideTexBottom + bottomSideTexHeight); glVertex3f(windowX - windowWidth/2, windowY - windowHeight/2, innerZ);
-    glEnd();
+    float lookX = cos(radPitch) * cos(radYaw);
+    float lookY = sin(radPitch);
+    float lookZ = cos(radPitch) * sin(radYaw);
     
-    // 后墙 - 使用wall纹理，增加重复次数
-    glBindTexture(GL_TEXTURE_2D, wallTexture);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-ROOM_HALF, 0, ROOM_HALF);
-    glTexCoord2f(8.0f, 0.0f); glVertex3f(ROOM_HALF, 0, ROOM_HALF);
-    glTexCoord2f(8.0f, 6.0f); glVertex3f(ROOM_HALF, ROOM_HEIGHT, ROOM_HALF);
-    glTexCoord2f(0.0f, 6.0f); glVertex3f(-ROOM_HALF, ROOM_HEIGHT, ROOM_HALF);
-    glEnd();
+    glm::vec3 eye(camera.x, camera.y, camera.z);
+    viewMatrix = glm::lookAt(eye, eye + glm::vec3(lookX, lookY, lookZ), glm::vec3(0, 1, 0));
+}
+
+// 设置相机
+void setupCamera() {
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(glm::value_ptr(projectionMatrix));
     
-    // 左墙 - 使用wall纹理，增加重复次数
-    glBindTexture(GL_TEXTURE_2D, wallTexture);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-ROOM_HALF, 0, -ROOM_HALF);
-    glTexCoord2f(8.0f, 0.0f); glVertex3f(-ROOM_HALF, 0, ROOM_HALF);
-    glTexCoord2f(8.0f, 6.0f); glVertex3f(-ROOM_HALF, ROOM_HEIGHT, ROOM_HALF);
-    glTexCoord2f(0.0f, 6.0f); glVertex3f(-ROOM_HALF, ROOM_HEIGHT, -ROOM_HALF);
-    glEnd();
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(glm::value_ptr(viewMatrix));
+}
+
+// 渲染队列
+// 固定管线下的"program"即一组状态开关：纹理、光照
+enum RenderProgram {
+    PROGRAM_TEXTURED = 0, // 纹理 + 光照
+    PROGRAM_COLORED,      // 纯色 + 光照
+    PROGRAM_PARTICLE,     // 纯色，无光照
+    PROGRAM_DECAL         // 贴花实例化shader
+};
+
+// 队列payload：关卡表面为表面编号，粒子为 DRAW_PARTICLE_BASE + 所有发射器连续编号后的粒子索引，
+// 全部贴花为DRAW_DECALS
+const uint32_t DRAW_PARTICLE_BASE = 0x10000;
+const uint32_t DRAW_DECALS = 0xFFFFFFFFu;
+
+const float CAMERA_FAR = 100.0f;
+
+RenderQueue renderQueue;
+OcclusionCuller occlusionCuller;
+SoftwareRasterizer softwareRasterizer(SCREEN_WIDTH, SCREEN_HEIGHT);
+SoftwareRasterizer particleLayer(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2); // 软件路径的低分辨率粒子层
+
+// 设置遮挡体：关卡中标记为遮挡体的表面（房间内侧各面、带窗洞的厚前墙）
+void initOccluders() {
+    occlusionCuller.ClearOccluders();
     
-    // 右墙 - 使用wall纹理，增加重复次数
-    glBindTexture(GL_TEXTURE_2D, wallTexture);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(ROOM_HALF, 0, -ROOM_HALF);
-    glTexCoord2f(8.0f, 0.0f); glVertex3f(ROOM_HALF, 0, ROOM_HALF);
-    glTexCoord2f(8.0f, 6.0f); glVertex3f(ROOM_HALF, ROOM_HEIGHT, ROOM_HALF);
-    glTexCoord2f(0.0f, 6.0f); glVertex3f(ROOM_HALF, ROOM_HEIGHT, -ROOM_HALF);
-    glEnd();
+    for (const LevelSurface& surface : level.GetSurfaces()) {
+        if (!surface.occluder) {
+            continue;
+        }
+        for (int q = 0; q < surface.quadCount; q++) {
+            int quad = surface.firstQuad + q;
+            occlusionCuller.AddOccluderQuad(level.GetQuadVertex(quad, 0).position, level.GetQuadVertex(quad, 1).position,
+                                            level.GetQuadVertex(quad, 2).position, level.GetQuadVertex(quad, 3).position);
+        }
+    }
+}
+
+// 用本帧的相机矩阵光栅化遮挡体（在updateCameraMatrices之后调用）
+void renderOccluders() {
+    if (!occlusionCullingEnabled) {
+        return;
+    }
     
-    glDisable(GL_TEXTURE_2D);
+    occlusionCuller.RenderOccluders(projectionMatrix * viewMatrix);
 }
 
-// 绘制logo装饰画
-void drawLogo() {
-    // 启用纹理
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, logoTexture);
+bool isBoxOccluded(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) {
+    return occlusionCullingEnabled &&
+           !occlusionCuller.IsBoxVisible(glm::vec3(minX, minY, minZ), glm::vec3(maxX, maxY, maxZ));
+}
+
+// 相机到包围盒最近点的归一化距离
+float boxDepth(const glm::vec3& minBounds, const glm::vec3& maxBounds) {
+    float dx = std::max(std::max(minBounds.x - camera.x, 0.0f), camera.x - maxBounds.x);
+    float dy = std::max(std::max(minBounds.y - camera.y, 0.0f), camera.y - maxBounds.y);
+    float dz = std::max(std::max(minBounds.z - camera.z, 0.0f), camera.z - maxBounds.z);
+    return sqrt(dx * dx + dy * dy + dz * dz) / CAMERA_FAR;
+}
+
+// 收集本帧所有绘制并排序
+void buildRenderQueue() {
+    renderQueue.Clear();
+    
+    const std::vector<LevelSurface>& surfaces = level.GetSurfaces();
+    for (size_t i = 0; i < surfaces.size(); i++) {
+        const LevelSurface& surface = surfaces[i];
+        // 纹理没有加载成功的装饰画不绘制
+        if (surface.material != MATERIAL_NONE && materialImages[surface.material].pixels.empty()) {
+            continue;
+        }
+        // 被墙挡住的绘制在提交前剔除
+        if (!surface.occluder && isBoxOccluded(surface.minBounds.x, surface.minBounds.y, surface.minBounds.z,
+                                               surface.maxBounds.x, surface.maxBounds.y, surface.maxBounds.z)) {
+            continue;
+        }
+        RenderQueue::Pass pass = surface.translucent ? RenderQueue::PASS_TRANSLUCENT : RenderQueue::PASS_OPAQUE;
+        RenderProgram program = surface.material != MATERIAL_NONE ? PROGRAM_TEXTURED : PROGRAM_COLORED;
+        renderQueue.Submit(pass, program, surface.material, boxDepth(surface.minBounds, surface.maxBounds), i);
+    }
     
-    // 在右墙上绘制logo，位置在墙的中央
-    float logoSize = 6.0f; // logo的大小
-    float logoX = ROOM_HALF - 0.1f; // 更突出墙面，避免被遮挡
-    float logoY = ROOM_HEIGHT * 0.5f; // 垂直居中
-    float logoZ = 0.0f; // 水平居中
+    // 所有贴花是一次绘制，在不透明表面之后、半透明之前
+    if (decals.GetCount() > 0) {
+        renderQueue.Submit(RenderQueue::PASS_DECAL, PROGRAM_DECAL, MATERIAL_NONE, 0.0f, DRAW_DECALS);
+    }
     
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(logoX, logoY - logoSize/2, logoZ - logoSize/2);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(logoX, logoY - logoSize/2, logoZ + logoSize/2);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(logoX, logoY + logoSize/2, logoZ + logoSize/2);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(logoX, logoY + logoSize/2, logoZ - logoSize/2);
-    glEnd();
+    particleDrawOffsets.clear();
+    queuedParticleCount = 0;
+    uint32_t particleOffset = 0;
+    for (int e = 0; e < particleWorld.GetEmitterCount(); e++) {
+        const ParticleSystem& particles = particleWorld.GetParticles(e);
+        particleDrawOffsets.push_back(static_cast<int>(particleOffset));
+        for (int i = 0; i < particles.GetCount(); i++) {
+            glm::vec3 p = particles.GetPosition(i);
+            float half = particles.GetSize(i) * 0.5f;
+            if (isBoxOccluded(p.x - half, p.y - half, p.z - half, p.x + half, p.y + half, p.z + half)) {
+                continue;
+            }
+            float dx = p.x - camera.x;
+            float dy = p.y - camera.y;
+            float dz = p.z - camera.z;
+            float depth = sqrt(dx * dx + dy * dy + dz * dz) / CAMERA_FAR;
+            renderQueue.Submit(RenderQueue::PASS_TRANSLUCENT, PROGRAM_PARTICLE, MATERIAL_NONE, depth,
+                               DRAW_PARTICLE_BASE + particleOffset + i);
+            queuedParticleCount++;
+        }
+        particleOffset += particles.GetCount();
+    }
     
-    glDisable(GL_TEXTURE_2D);
+    renderQueue.Sort();
 }
 
-// 绘制daqing装饰画
-void drawDaqing() {
-    // 只有在纹理加载成功时才绘制
-    if (daqingTexture == 0) {
-        return;
+// 把粒子payload还原成发射器和发射器内的索引
+const ParticleSystem& findParticle(uint32_t payload, int& index) {
+    int flat = static_cast<int>(payload - DRAW_PARTICLE_BASE);
+    int emitter = static_cast<int>(std::upper_bound(particleDrawOffsets.begin(), particleDrawOffsets.end(), flat) -
+                                   particleDrawOffsets.begin()) - 1;
+    index = flat - particleDrawOffsets[emitter];
+    return particleWorld.GetParticles(emitter);
+}
+
+bool isParticlePayload(uint32_t payload) {
+    return payload >= DRAW_PARTICLE_BASE && payload != DRAW_DECALS;
+}
+
+// 粒子在低分辨率层中绘制，不画在场景上（GPU粒子不经过渲染队列，总是使用层）
+bool particlesInLayer() {
+    return particleResolution > 1 && (queuedParticleCount > 0 || gpuParticles);
+}
+
+void applyRenderPass(RenderQueue::Pass pass) {
+    if (pass == RenderQueue::PASS_OPAQUE) {
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+    } else {
+        // 贴花和半透明都不写深度；半透明已由远到近排序，避免互相遮挡
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+    }
+}
+
+void applyRenderProgram(uint32_t program) {
+    switch (program) {
+        case PROGRAM_TEXTURED:
+            glEnable(GL_TEXTURE_2D);
+            glEnable(GL_LIGHTING);
+            break;
+        case PROGRAM_COLORED:
+            glDisable(GL_TEXTURE_2D);
+            glEnable(GL_LIGHTING);
+            break;
+        case PROGRAM_PARTICLE:
+            glDisable(GL_TEXTURE_2D);
+            glDisable(GL_LIGHTING);
+            break;
+        case PROGRAM_DECAL:
+            // 状态由Renderer::DrawDecals设置
+            break;
+    }
+}
+
+// 按排序后的顺序提交，只在状态变化时切换
+void executeRenderQueue() {
+    uint32_t currentPass = ~0u;
+    uint32_t currentProgram = ~0u;
+    uint32_t currentMaterial = ~0u;
+    
+    for (size_t i = 0; i < renderQueue.GetCount(); i++) {
+        uint64_t key = renderQueue.GetKey(i);
+        
+        RenderQueue::Pass pass = RenderQueue::GetPass(key);
+        if (pass != currentPass) {
+            applyRenderPass(pass);
+            currentPass = pass;
+        }
+        
+        uint32_t program = RenderQueue::GetProgram(key);
+        if (program != currentProgram) {
+            applyRenderProgram(program);
+            currentProgram = program;
+        }
+        
+        uint32_t material = RenderQueue::GetMaterial(key);
+        if (material != currentMaterial) {
+            if (material != MATERIAL_NONE) {
+                glBindTexture(GL_TEXTURE_2D, materialTextures[material]);
+            }
+            currentMaterial = material;
+        }
+        
+        uint32_t payload = renderQueue.GetPayload(i);
+        if (payload == DRAW_DECALS) {
+            renderer.DrawDecals(decals, decalAtlasTexture, LIGHT_COUNT);
+            currentMaterial = ~0u; // 绑定了图集
+        } else if (payload >= DRAW_PARTICLE_BASE) {
+            if (particlesInLayer()) {
+                continue;
+            }
+            int index;
+            const ParticleSystem& particles = findParticle(payload, index);
+            drawParticle(particles, index);
+        } else {
+            drawSurface(payload);
+        }
     }
     
-    // 启用纹理
+    // 恢复默认状态
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glEnable(GL_LIGHTING);
     glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, daqingTexture);
-    
-    // 在前墙上绘制daqing，位置在墙的中央
-    float daqingSize = 6.0f; // daqing的大小
-    float daqingX = 0.0f; // 水平居中
-    float daqingY = ROOM_HEIGHT * 0.5f; // 垂直居中
-    float daqingZ = -ROOM_HALF - 0.1f; // 更突出墙面，避免被遮挡
-    
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(daqingX - daqingSize/2, daqingY - daqingSize/2, daqingZ);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(daqingX + daqingSize/2, daqingY - daqingSize/2, daqingZ);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(daqingX + daqingSize/2, daqingY + daqingSize/2, daqingZ);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(daqingX - daqingSize/2, daqingY + daqingSize/2, daqingZ);
-    glEnd();
+}
+
+// 粒子画到低分辨率层再合成回场景，顺序与队列相同（由远到近）
+// 层在其他半透明表面之后合成，粒子与窗户玻璃之间不再按深度交错
+void executeParticleLayer() {
+    if (!particlesInLayer()) {
+        return;
+    }
     
-    glDisable(GL_TEXTURE_2D);
+    renderer.BeginParticleLayer(particleResolution, projectionMatrix);
+    applyRenderProgram(PROGRAM_PARTICLE);
+    if (gpuParticles) {
+        gpuParticleWorld.Draw();
+    }
+    for (size_t i = 0; i < renderQueue.GetCount(); i++) {
+        uint32_t payload = renderQueue.GetPayload(i);
+        if (isParticlePayload(payload)) {
+            int index;
+            const ParticleSystem& particles = findParticle(payload, index);
+            drawParticle(particles, index);
+        }
+    }
+    renderer.EndParticleLayer();
 }
 
-// 绘制home装饰画
-void drawHome() {
-    // 只有在纹理加载成功时才绘制
-    if (homeTexture == 0) {
+// 不使用粒子层时，GPU粒子在所有半透明表面之后一次画在场景上
+void drawGpuParticles() {
+    if (!gpuParticles || particlesInLayer()) {
         return;
     }
     
-    // 启用纹理
+    applyRenderPass(RenderQueue::PASS_TRANSLUCENT);
+    applyRenderProgram(PROGRAM_PARTICLE);
+    gpuParticleWorld.Draw();
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glEnable(GL_LIGHTING);
     glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, homeTexture);
-    
-    // 在左墙上绘制home，位置在墙的中央，尺寸较小
-    float homeSize = 4.0f; // home的大小（比logo小一些）
-    float homeX = -ROOM_HALF - 0.1f; // 更突出墙面，避免被遮挡
-    float homeY = ROOM_HEIGHT * 0.5f; // 垂直居中
-    float homeZ = 0.0f; // 水平居中
-    
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(homeX, homeY - homeSize/2, homeZ - homeSize/2);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(homeX, homeY - homeSize/2, homeZ + homeSize/2);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(homeX, homeY + homeSize/2, homeZ + homeSize/2);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(homeX, homeY + homeSize/2, homeZ - homeSize/2);
-    glEnd();
-    
-    glDisable(GL_TEXTURE_2D);
 }
 
-// 绘制窗户
-void drawWindow() {
-    // 禁用纹理，使用纯色绘制窗户
-    glDisable(GL_TEXTURE_2D);
-    
-    float innerZ = -ROOM_HALF;
-    float outerZ = -ROOM_HALF - wallThickness;
-    
-    // 绘制窗户框架（深棕色）
-    glColor3f(0.4f, 0.2f, 0.1f);
-    float frameThickness = 0.3f;
-    
-    // 内层窗户框架 - 上边框
-    glBegin(GL_QUADS);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY + windowHeight/2, innerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY + windowHeight/2, innerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY + windowHeight/2 + frameThickness, innerZ);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY + windowHeight/2 + frameThickness, innerZ);
-    glEnd();
-    
-    // 内层窗户框架 - 下边框
-    glBegin(GL_QUADS);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY - windowHeight/2 - frameThickness, innerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY - windowHeight/2 - frameThickness, innerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY - windowHeight/2, innerZ);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY - windowHeight/2, innerZ);
-    glEnd();
-    
-    // 内层窗户框架 - 左边框
-    glBegin(GL_QUADS);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY - windowHeight/2, innerZ);
-    glVertex3f(windowX - windowWidth/2, windowY - windowHeight/2, innerZ);
-    glVertex3f(windowX - windowWidth/2, windowY + windowHeight/2, innerZ);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY + windowHeight/2, innerZ);
-    glEnd();
-    
-    // 内层窗户框架 - 右边框
-    glBegin(GL_QUADS);
-    glVertex3f(windowX + windowWidth/2, windowY - windowHeight/2, innerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY - windowHeight/2, innerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY + windowHeight/2, innerZ);
-    glVertex3f(windowX + windowWidth/2, windowY + windowHeight/2, innerZ);
-    glEnd();
-    
-    // 外层窗户框架 - 上边框
-    glBegin(GL_QUADS);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY + windowHeight/2, outerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY + windowHeight/2, outerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY + windowHeight/2 + frameThickness, outerZ);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY + windowHeight/2 + frameThickness, outerZ);
-    glEnd();
-    
-    // 外层窗户框架 - 下边框
-    glBegin(GL_QUADS);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY - windowHeight/2 - frameThickness, outerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY - windowHeight/2 - frameThickness, outerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY - windowHeight/2, outerZ);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY - windowHeight/2, outerZ);
-    glEnd();
-    
-    // 外层窗户框架 - 左边框
-    glBegin(GL_QUADS);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY - windowHeight/2, outerZ);
-    glVertex3f(windowX - windowWidth/2, windowY - windowHeight/2, outerZ);
-    glVertex3f(windowX - windowWidth/2, windowY + windowHeight/2, outerZ);
-    glVertex3f(windowX - windowWidth/2 - frameThickness, windowY + windowHeight/2, outerZ);
-    glEnd();
-    
-    // 外层窗户框架 - 右边框
-    glBegin(GL_QUADS);
-    glVertex3f(windowX + windowWidth/2, windowY - windowHeight/2, outerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY - windowHeight/2, outerZ);
-    glVertex3f(windowX + windowWidth/2 + frameThickness, windowY + windowHeight/2, outerZ);
-    glVertex3f(windowX + windowWidth/2, windowY + windowHeight/2, outerZ);
-    glEnd();
-    
-    // 绘制窗户玻璃（内层，半透明，带阳光效果）
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glColor4f(1.0f, 0.9f, 0.7f, 0.1f); // 更明亮的阳光色，更透明
-    
-    glBegin(GL_QUADS);
-    glVertex3f(windowX - windowWidth/2, windowY - windowHeight/2, innerZ);
-    glVertex3f(windowX + windowWidth/2, windowY - windowHeight/2, innerZ);
-    glVertex3f(windowX + windowWidth/2, windowY + windowHeight/2, innerZ);
-    glVertex3f(windowX - windowWidth/2, windowY + windowHeight/2, innerZ);
-    glEnd();
-    
-    // 绘制窗户玻璃（外层，稍微偏蓝）
-    glColor4f(0.8f, 0.9f, 1.0f, 0.05f);
+// OpenGL路径：场景渲染到离屏目标，再放大到窗口
+// 分辨率由几帧前的GPU场景时间驱动，计时查询不等待GPU
+void renderSceneGL() {
+    // 窗口变大时重建目标；变小时只使用其中一部分
+    if (framebufferWidth > renderer.GetSceneTargetWidth() || framebufferHeight > renderer.GetSceneTargetHeight()) {
+        renderer.CreateSceneTarget(std::max(framebufferWidth, renderer.GetSceneTargetWidth()),
+                                   std::max(framebufferHeight, renderer.GetSceneTargetHeight()));
+    }
     
-    glBegin(GL_QUADS);
-    glVertex3f(windowX - windowWidth/2, windowY - windowHeight/2, outerZ);
-    glVertex3f(windowX + windowWidth/2, windowY - windowHeight/2, outerZ);
-    glVertex3f(windowX + windowWidth/2, windowY + windowHeight/2, outerZ);
-    glVertex3f(windowX - windowWidth/2, windowY + windowHeight/2, outerZ);
-    glEnd();
+    float gpuMilliseconds = 0.0f;
+    if (renderer.ReadGpuTime(gpuMilliseconds) && dynamicResolutionEnabled) {
+        dynamicResolution.Update(gpuMilliseconds);
+    }
     
-    glDisable(GL_BLEND);
-    glEnable(GL_TEXTURE_2D);
+    int sceneWidth, sceneHeight;
+    dynamicResolution.GetRenderSize(framebufferWidth, framebufferHeight, sceneWidth, sceneHeight);
+    
+    renderer.BeginScene(sceneWidth, sceneHeight);
+    renderer.BeginGpuTimer();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    setupCamera();
+    executeRenderQueue();
+    drawGpuParticles();
+    executeParticleLayer();
+    renderer.EndGpuTimer();
+    renderer.EndScene();
+    
+    // 原始分辨率时不需要锐化
+    bool upscaled = sceneWidth < framebufferWidth || sceneHeight < framebufferHeight;
+    PostProcessSettings postProcess;
+    postProcess.sharpness = upscaled ? upscaleSharpness : 0.0f;
+    postProcess.bloom = bloomEnabled;
+    renderer.EndFrame(framebufferWidth, framebufferHeight, postProcess);
 }
 
-// 初始化粒子系统
-void initParticles() {
-    particleCount = 0;
-    for (int i = 0; i < MAX_PARTICLES; i++) {
-        particles[i].life = 0.0f;
+// 与drawParticle相同：XY平面上以粒子为中心的正方形
+void addSoftwareParticle(SoftwareRasterizer& target, uint32_t payload) {
+    int index;
+    const ParticleSystem& particles = findParticle(payload, index);
+    glm::vec3 p = particles.GetPosition(index);
+    float half = particles.GetSize(index) * 0.5f;
+    const float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+    RasterVertex quad[4];
+    for (int k = 0; k < 4; k++) {
+        quad[k].position = glm::vec3(p.x + corners[k][0] * half, p.y + corners[k][1] * half, p.z);
+        quad[k].normal = glm::vec3(0, 0, 1);
+        quad[k].uv = glm::vec2(0, 0);
     }
+    target.AddQuad(quad, ParticleSystem::UnpackColor(particles.GetColor(index)));
 }
 
-// 创建新粒子
-void createParticle() {
-    if (particleCount >= MAX_PARTICLES) return;
-    
-    Particle& p = particles[particleCount];
-    p.x = fireX + (rand() % 100 - 50) / 1000.0f; // 小范围随机
-    p.y = fireY;
-    p.z = fireZ + (rand() % 100 - 50) / 1000.0f;
-    
-    p.vx = (rand() % 100 - 50) / 1000.0f; // 水平随机速度
-    p.vy = 0.02f + (rand() % 50) / 1000.0f; // 向上速度
-    p.vz = (rand() % 100 - 50) / 1000.0f; // 深度随机速度
+// 用软件光栅化执行同一个排序后的队列，状态与固定管线路径一一对应
+void executeSoftwareRenderQueue() {
+    softwareRasterizer.SetLights(sceneLights, LIGHT_COUNT);
+    softwareRasterizer.SetMatrices(viewMatrix, projectionMatrix);
+    softwareRasterizer.Begin(glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
+    
+    for (size_t i = 0; i < renderQueue.GetCount(); i++) {
+        uint64_t key = renderQueue.GetKey(i);
+        bool blend = RenderQueue::GetPass(key) != RenderQueue::PASS_OPAQUE;
+        uint32_t program = RenderQueue::GetProgram(key);
+        uint32_t material = RenderQueue::GetMaterial(key);
+        const Image* texture = program == PROGRAM_TEXTURED ? &materialImages[material] : nullptr;
+        softwareRasterizer.SetState(texture, program != PROGRAM_PARTICLE, blend);
+        
+        uint32_t payload = renderQueue.GetPayload(i);
+        RasterVertex quad[4];
+        if (payload == DRAW_DECALS) {
+            // 从旧到新，新的贴花画在上面
+            softwareRasterizer.SetState(&decalAtlas.GetImage(), true, true);
+            for (int d = 0; d < decals.GetCount(); d++) {
+                int slot = decals.GetSlot(d);
+                glm::vec3 corners[4];
+                glm::vec2 uvs[4];
+                decals.GetCorners(slot, corners, uvs);
+                glm::vec3 normal = glm::normalize(glm::cross(decals.GetAxesU()[slot], decals.GetAxesV()[slot]));
+                for (int k = 0; k < 4; k++) {
+                    quad[k].position = corners[k];
+                    quad[k].normal = normal;
+                    quad[k].uv = uvs[k];
+                }
+                softwareRasterizer.AddQuad(quad, decals.GetColors()[slot]);
+            }
+            continue;
+        }
+        if (payload >= DRAW_PARTICLE_BASE) {
+            if (!particlesInLayer()) {
+                addSoftwareParticle(softwareRasterizer, payload);
+            }
+            continue;
+        }
+        
+        const LevelSurface& surface = level.GetSurface(payload);
+        for (int q = 0; q < surface.quadCount; q++) {
+            for (int k = 0; k < 4; k++) {
+                const LevelVertex& v = level.GetQuadVertex(surface.firstQuad + q, k);
+                quad[k].position = v.position;
+                quad[k].normal = v.normal;
+                quad[k].uv = v.uv;
+            }
+            softwareRasterizer.AddQuad(quad, surface.color);
+        }
+    }
     
-    p.life = 1.0f;
-    p.size = 0.1f + (rand() % 30) / 100.0f;
+    softwareRasterizer.End();
     
-    // 火焰颜色：从红色到黄色到白色
-    float colorFactor = (rand() % 100) / 100.0f;
-    p.r = 1.0f;
-    p.g = 0.3f + colorFactor * 0.7f;
-    p.b = 0.0f;
-    p.a = 0.8f;
+    // 与executeParticleLayer相同：粒子画到低分辨率层，再按深度放大合成
+    if (particlesInLayer()) {
+        particleLayer.BeginLayer(softwareRasterizer, particleResolution);
+        particleLayer.SetState(nullptr, false, true);
+        for (size_t i = 0; i < renderQueue.GetCount(); i++) {
+            uint32_t payload = renderQueue.GetPayload(i);
+            if (isParticlePayload(payload)) {
+                addSoftwareParticle(particleLayer, payload);
+            }
+        }
+        particleLayer.End();
+        softwareRasterizer.Composite(particleLayer);
+    }
+}
+
+// 把软件光栅化的结果画到窗口
+void presentSoftwareFrame() {
+    static std::vector<uint8_t> pixels;
+    pixels.resize(static_cast<size_t>(SCREEN_WIDTH) * SCREEN_HEIGHT * 4);
+    softwareRasterizer.ReadPixels(pixels.data(), true);
     
-    particleCount++;
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glDisable(GL_DEPTH_TEST);
+    glRasterPos2f(-1.0f, -1.0f);
+    glDrawPixels(SCREEN_WIDTH, SCREEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glEnable(GL_DEPTH_TEST);
 }
 
-// 更新粒子
-void updateParticles(float deltaTime) {
-    // 创建新粒子
-    static float particleTimer = 0.0f;
-    particleTimer += deltaTime;
-    if (particleTimer > 0.01f) { // 每0.01秒创建一个粒子
-        createParticle();
-        particleTimer = 0.0f;
+// 保存最后一帧，并可与参考图像（例如另一个渲染器的输出）比较
+bool saveFrame(const char* path) {
+    Image image;
+    image.width = framebufferWidth;
+    image.height = framebufferHeight;
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height * 4);
+    
+    if (useSoftwareRenderer) {
+        softwareRasterizer.ReadPixels(image.pixels.data(), false);
+    } else {
+        // glReadPixels从下往上，逐行翻转
+        std::vector<uint8_t> rows(image.pixels.size());
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, rows.data());
+        size_t rowBytes = static_cast<size_t>(image.width) * 4;
+        for (int y = 0; y < image.height; y++) {
+            memcpy(&image.pixels[y * rowBytes], &rows[(image.height - 1 - y) * rowBytes], rowBytes);
+        }
     }
     
-    // 更新现有粒子
-    for (int i = 0; i < particleCount; i++) {
-        Particle& p = particles[i];
+    if (!SavePNG(path, image)) {
+        return false;
+    }
+    std::cout << "已保存: " << path << std::endl;
+    
+    if (comparePath) {
+        Image reference;
+        if (LoadPNG(comparePath, reference)) {
+            double psnr = ComputePSNR(image, reference);
+            if (psnr < 0.0) {
+                std::cout << "参考图像尺寸不同: " << comparePath << std::endl;
+            } else {
+                std::cout << "与 " << comparePath << " 的PSNR: " << psnr << " dB" << std::endl;
+            }
+        }
+    }
+    return true;
+}
+
+// 解析命令行，出错返回false
+bool parseArguments(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
         
-        if (p.life > 0.0f) {
-            // 更新位置
-            p.x += p.vx;
-            p.y += p.vy;
-            p.z += p.vz;
-            
-            // 添加重力效果
-            p.vy -= 0.001f * deltaTime;
-            
-            // 添加随机扰动
-            p.vx += (rand() % 100 - 50) / 100000.0f;
-            p.vz += (rand() % 100 - 50) / 100000.0f;
-            
-            // 减少生命值
-            p.life -= 0.5f * deltaTime;
-            
-            // 更新颜色（从红色到黄色到白色）
-            if (p.life > 0.7f) {
-                p.r = 1.0f;
-                p.g = 0.3f + (1.0f - p.life) * 0.7f;
-                p.b = 0.0f;
-            } else if (p.life > 0.3f) {
-                p.r = 1.0f;
-                p.g = 1.0f;
-                p.b = (0.7f - p.life) / 0.4f;
+        if (strcmp(arg, "--renderer") == 0 && value) {
+            if (strcmp(value, "software") == 0) {
+                useSoftwareRenderer = true;
+            } else if (strcmp(value, "gl") == 0) {
+                useSoftwareRenderer = false;
+            } else {
+                std::cerr << "未知的渲染器: " << value << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--frames") == 0 && value) {
+            frameLimit = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--output") == 0 && value) {
+            outputPath = value;
+            i++;
+        } else if (strcmp(arg, "--compare") == 0 && value) {
+            comparePath = value;
+            i++;
+        } else if (strcmp(arg, "--seed") == 0 && value) {
+            srand(static_cast<unsigned int>(strtoul(value, nullptr, 10)));
+            i++;
+        } else if (strcmp(arg, "--bullet-holes") == 0 && value) {
+            initialBulletHoles = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--grenades") == 0 && value) {
+            initialGrenades = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--particle-bench") == 0 && value) {
+            particleBenchCount = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--particle-resolution") == 0 && value) {
+            particleResolution = atoi(value);
+            if (particleResolution != 1 && particleResolution != 2 && particleResolution != 4) {
+                std::cerr << "粒子分辨率只能是1、2或4: " << value << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--particle-backend") == 0 && value) {
+            if (strcmp(value, "gpu") == 0) {
+                gpuParticles = true;
+            } else if (strcmp(value, "cpu") == 0) {
+                gpuParticles = false;
             } else {
-                p.r = 1.0f;
-                p.g = 1.0f;
-                p.b = 1.0f;
+                std::cerr << "未知的粒子后端: " << value << std::endl;
+                return false;
             }
-            
-            // 更新透明度
-            p.a = p.life * 0.8f;
-            
-            // 更新大小
-            p.size += 0.01f * deltaTime;
-        }
-    }
-    
-    // 移除死亡的粒子
-    for (int i = 0; i < particleCount; i++) {
-        if (particles[i].life <= 0.0f) {
-            // 将最后一个粒子移到这里
-            particles[i] = particles[particleCount - 1];
-            particleCount--;
-            i--; // 重新检查这个位置
-        }
-    }
-}
-
-// 绘制粒子
-void drawParticles() {
-    glDisable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_LIGHTING);
-    
-    for (int i = 0; i < particleCount; i++) {
-        Particle& p = particles[i];
-        if (p.life > 0.0f) {
-            glColor4f(p.r, p.g, p.b, p.a);
-            
-            glPushMatrix();
-            glTranslatef(p.x, p.y, p.z);
-            glScalef(p.size, p.size, p.size);
-            
-            // 绘制简单的四边形作为粒子
-            glBegin(GL_QUADS);
-            glVertex3f(-0.5f, -0.5f, 0.0f);
-            glVertex3f(0.5f, -0.5f, 0.0f);
-            glVertex3f(0.5f, 0.5f, 0.0f);
-            glVertex3f(-0.5f, 0.5f, 0.0f);
-            glEnd();
-            
-            glPopMatrix();
+            i++;
+        } else if (strcmp(arg, "--bloom") == 0) {
+            bloomEnabled = true;
+        } else if (strcmp(arg, "--late-latch") == 0) {
+            lateLatchEnabled = true;
+        } else if (strcmp(arg, "--frame-budget") == 0 && value) {
+            DynamicResolutionSettings settings = dynamicResolution.GetSettings();
+            settings.targetMilliseconds = static_cast<float>(atof(value));
+            dynamicResolution.SetSettings(settings);
+            i++;
+        } else if (strcmp(arg, "--resolution-scale") == 0 && value) {
+            fixedResolutionScale = static_cast<float>(atof(value));
+            dynamicResolutionEnabled = false;
+            dynamicResolution.Reset(fixedResolutionScale);
+            i++;
+        } else if (strcmp(arg, "--sharpness") == 0 && value) {
+            upscaleSharpness = std::min(std::max(static_cast<float>(atof(value)), 0.0f), 1.0f);
+            i++;
+        } else {
+            std::cerr << "用法: " << argv[0]
+                      << " [--renderer gl|software] [--frames N] [--output file.png] [--compare ref.png] [--seed N]"
+                      << " [--frame-budget ms] [--resolution-scale S] [--sharpness S] [--bloom] [--late-latch]"
+                      << " [--bullet-holes N] [--grenades N] [--particle-bench N] [--particle-resolution 1|2|4]"
+                      << " [--particle-backend cpu|gpu]" << std::endl;
+            return false;
         }
     }
     
-    glEnable(GL_LIGHTING);
-    glDisable(GL_BLEND);
-    glEnable(GL_TEXTURE_2D);
+    // GPU粒子的状态只在GL缓冲区里，软件光栅化读不到
+    if (gpuParticles && useSoftwareRenderer) {
+        std::cerr << "GPU粒子需要OpenGL渲染器" << std::endl;
+        return false;
+    }
+    
+    // 输出图像时至少渲染一帧
+    if (outputPath && frameLimit <= 0) {
+        frameLimit = 1;
+    }
+    return true;
 }
 
-// 设置光照
-void setupLighting() {
-    // 启用光照
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
-    glEnable(GL_LIGHT1); // 添加第二个光源
-    glEnable(GL_LIGHT2); // 添加第三个光源
-    glEnable(GL_LIGHT3); // 添加太阳光源
-    
-    // 设置主光源位置
-    glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
-    
-    // 设置环境光
-    glLightfv(GL_LIGHT0, GL_AMBIENT, lightAmbient);
-    
-    // 设置漫反射光
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, lightDiffuse);
-    
-    // 设置镜面反射光
-    glLightfv(GL_LIGHT0, GL_SPECULAR, lightSpecular);
-    
-    // 设置光源衰减
-    glLightf(GL_LIGHT0, GL_CONSTANT_ATTENUATION, 1.0f);
-    glLightf(GL_LIGHT0, GL_LINEAR_ATTENUATION, 0.05f);
-    glLightf(GL_LIGHT0, GL_QUADRATIC_ATTENUATION, 0.005f);
-    
-    // 添加第二个光源（补充光源）
-    float light1Position[4] = {0.0f, 8.0f, 0.0f, 1.0f};
-    float light1Ambient[4] = {0.4f, 0.4f, 0.4f, 1.0f};
-    float light1Diffuse[4] = {4.0f, 4.0f, 4.0f, 1.0f};
-    float light1Specular[4] = {4.0f, 4.0f, 4.0f, 1.0f};
-    
-    glLightfv(GL_LIGHT1, GL_POSITION, light1Position);
-    glLightfv(GL_LIGHT1, GL_AMBIENT, light1Ambient);
-    glLightfv(GL_LIGHT1, GL_DIFFUSE, light1Diffuse);
-    glLightfv(GL_LIGHT1, GL_SPECULAR, light1Specular);
-    
-    glLightf(GL_LIGHT1, GL_CONSTANT_ATTENUATION, 1.0f);
-    glLightf(GL_LIGHT1, GL_LINEAR_ATTENUATION, 0.1f);
-    glLightf(GL_LIGHT1, GL_QUADRATIC_ATTENUATION, 0.01f);
-    
-    // 添加第三个光源（角落光源）
-    float light2Position[4] = {15.0f, 10.0f, 15.0f, 1.0f};
-    float light2Ambient[4] = {0.3f, 0.3f, 0.3f, 1.0f};
-    float light2Diffuse[4] = {3.0f, 3.0f, 3.0f, 1.0f};
-    float light2Specular[4] = {3.0f, 3.0f, 3.0f, 1.0f};
-    
-    glLightfv(GL_LIGHT2, GL_POSITION, light2Position);
-    glLightfv(GL_LIGHT2, GL_AMBIENT, light2Ambient);
-    glLightfv(GL_LIGHT2, GL_DIFFUSE, light2Diffuse);
-    glLightfv(GL_LIGHT2, GL_SPECULAR, light2Specular);
-    
-    glLightf(GL_LIGHT2, GL_CONSTANT_ATTENUATION, 1.0f);
-    glLightf(GL_LIGHT2, GL_LINEAR_ATTENUATION, 0.15f);
-    glLightf(GL_LIGHT2, GL_QUADRATIC_ATTENUATION, 0.02f);
-    
-    // 添加太阳光源（从窗户照射进来）
-    float sunPosition[4] = {windowX, windowY, windowZ + 15.0f, 1.0f}; // 在窗户外面15单位处，更近一些
-    float sunAmbient[4] = {0.3f, 0.3f, 0.2f, 1.0f}; // 增强太阳环境光
-    float sunDiffuse[4] = {5.0f, 4.5f, 3.5f, 1.0f}; // 大幅增强阳光强度
-    float sunSpecular[4] = {4.0f, 3.5f, 2.8f, 1.0f}; // 增强阳光镜面反射
-    
-    glLightfv(GL_LIGHT3, GL_POSITION, sunPosition);
-    glLightfv(GL_LIGHT3, GL_AMBIENT, sunAmbient);
-    glLightfv(GL_LIGHT3, GL_DIFFUSE, sunDiffuse);
-    glLightfv(GL_LIGHT3, GL_SPECULAR, sunSpecular);
-    
-    // 太阳光衰减设置（减少衰减，让光源更强）
-    glLightf(GL_LIGHT3, GL_CONSTANT_ATTENUATION, 1.0f);
-    glLightf(GL_LIGHT3, GL_LINEAR_ATTENUATION, 0.01f);
-    glLightf(GL_LIGHT3, GL_QUADRATIC_ATTENUATION, 0.0005f);
+// 加载所有材质图像，logo之前的是必需的
+bool loadMaterials(bool createTextures) {
+    struct MaterialFile {
+        LevelMaterial material;
+        const char* path;
+        bool required;
+    };
+    const MaterialFile files[] = {
+        {MATERIAL_WALL, "res/wall.png", true},
+        {MATERIAL_FLOOR, "res/floor.png", true},
+        {MATERIAL_SKY, "res/sky.png", true},
+        {MATERIAL_LOGO, "res/logo.png", true},
+        {MATERIAL_DAQING, "res/daqing.png", false},
+        {MATERIAL_HOME, "res/home.png", false},
+    };
+    
+    for (const MaterialFile& file : files) {
+        Image& image = materialImages[file.material];
+        if (!LoadPNG(file.path, image)) {
+            image = Image();
+            if (file.required) {
+                std::cerr << "Failed to load texture: " << file.path << std::endl;
+                return false;
+            }
+            std::cerr << "Warning: Failed to load " << file.path << ", continuing without it" << std::endl;
+            continue;
+        }
+        // 贴花图像放进图集，不单独创建纹理
+        if (createTextures && file.material < MATERIAL_FIRST_DECAL) {
+            materialTextures[file.material] = createTexture(image);
+        }
+    }
     
-    // 启用颜色材质
-    glEnable(GL_COLOR_MATERIAL);
-    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+    std::cout << "纹理加载成功！" << std::endl;
+    return true;
 }
 
-// 设置相机
-void setupCamera() {
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(45.0, 1024.0/768.0, 0.1, 100.0);
-    
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+// 把装饰画和弹孔图像打包进图集，放置关卡中的装饰画
+void initDecals(bool createTextures) {
+    int materialRegions[MATERIAL_COUNT];
+    for (int i = 0; i < MATERIAL_COUNT; i++) {
+        materialRegions[i] = -1;
+    }
     
-    float radYaw = camera.yaw * M_PI / 180.0f;
-    float radPitch = camera.pitch * M_PI / 180.0f;
+    decals.Clear();
+    for (const LevelDecal& poster : level.GetDecals()) {
+        // 纹理没有加载成功的装饰画不绘制
+        if (materialImages[poster.material].pixels.empty()) {
+            continue;
+        }
+        if (materialRegions[poster.material] < 0) {
+            materialRegions[poster.material] = decalAtlas.Add(materialImages[poster.material]);
+            if (materialRegions[poster.material] < 0) {
+                std::cerr << "Warning: decal atlas is full" << std::endl;
+                continue;
+            }
+        }
+        decals.Add(poster.position, poster.normal, poster.up, poster.halfWidth, poster.halfHeight,
+                   decalAtlas.GetRegion(materialRegions[poster.material]));
+    }
     
-    float lookX = cos(radPitch) * cos(radYaw);
-    float lookY = sin(radPitch);
-    float lookZ = cos(radPitch) * sin(radYaw);
+    Image bulletHole;
+    GenerateBulletHoleImage(64, 1, bulletHole);
+    bulletHoleRegion = decalAtlas.Add(bulletHole);
     
-    gluLookAt(camera.x, camera.y, camera.z,
-              camera.x + lookX, camera.y + lookY, camera.z + lookZ,
-              0, 1, 0);
+    if (createTextures) {
+        decalAtlasTexture = createTexture(decalAtlas.GetImage());
+    }
 }
 
-int main() {
-    // 初始化GLFW
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
+int main(int argc, char** argv) {
+    srand(time(nullptr)); // 初始化随机数种子（--seed可以覆盖）
+    if (!parseArguments(argc, argv)) {
         return -1;
     }
     
-    // 创建窗口
-    GLFWwindow* window = glfwCreateWindow(1024, 768, "CSGO Demo", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+    if (particleBenchCount > 0 && !gpuParticles) {
+        runParticleBenchmark(particleBenchCount);
+        return 0;
     }
     
-    // 获取主显示器信息并居中显示窗口
-    GLFWmonitor* primary = glfwGetPrimaryMonitor();
-    const GLFWvidmode* mode = glfwGetVideoMode(primary);
+    // 软件渲染输出图像时不需要窗口，可以在没有显示器和显卡的机器上运行
+    bool headless = useSoftwareRenderer && outputPath;
+    GLFWwindow* window = nullptr;
     
-    int windowWidth = 1024;
-    int windowHeight = 768;
-    int xPos = (mode->width - windowWidth) / 2;
-    int yPos = (mode->height - windowHeight) / 2;
-    
-    glfwSetWindowPos(window, xPos, yPos);
-    glfwMakeContextCurrent(window);
-    glfwSetKeyCallback(window, keyCallback);
-    glfwSetCursorPosCallback(window, mouseCallback);
-    glfwSetScrollCallback(window, scrollCallback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    
-    // 设置OpenGL
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_TEXTURE_2D);
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    if (!headless) {
+        // 初始化GLFW
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW" << std::endl;
+            return -1;
+        }
+        
+        // 创建窗口
+        window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "CSGO Demo", nullptr, nullptr);
+        if (!window) {
+            std::cerr << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        
+        // 获取主显示器信息并居中显示窗口
+        GLFWmonitor* primary = glfwGetPrimaryMonitor();
+        const GLFWvidmode* mode = glfwGetVideoMode(primary);
+        
+        int windowWidth = SCREEN_WIDTH;
+        int windowHeight = SCREEN_HEIGHT;
+        int xPos = (mode->width - windowWidth) / 2;
+        int yPos = (mode->height - windowHeight) / 2;
+        
+        glfwSetWindowPos(window, xPos, yPos);
+        glfwMakeContextCurrent(window);
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetCursorPosCallback(window, mouseCallback);
+        glfwSetMouseButtonCallback(window, mouseButtonCallback);
+        glfwSetScrollCallback(window, scrollCallback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        
+        // 帧节奏按显示器刷新率计算，低延迟模式需要垂直同步，普通模式明确关掉（驱动的默认值不一定）
+        framePacer.SetRefreshRate(mode->refreshRate > 0 ? mode->refreshRate : 60.0);
+        glfwSwapInterval(lateLatchEnabled ? 1 : 0);
+        
+        // 设置OpenGL
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_TEXTURE_2D);
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        
+        if (!useSoftwareRenderer) {
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            renderer.Initialize();
+            if (!renderer.CreateSceneTarget(framebufferWidth, framebufferHeight)) {
+                glfwTerminate();
+                return -1;
+            }
+            // GPU粒子的测试需要GL上下文
+            if (particleBenchCount > 0) {
+                runGpuParticleBenchmark(particleBenchCount);
+                renderer.Shutdown();
+                glfwTerminate();
+                return 0;
+            }
+        }
+    }
     
-    // 设置光照
-    setupLighting();
+    // 构建关卡几何和碰撞BVH，设置光照
+    level.Build();
+    collisionWorld.AddLevel(level);
+    collisionWorld.Build();
+    hitscan.SetWorld(&collisionWorld);
+    hitscan.SetLevelResistances(level);
+    playerMovement.SetWorld(&collisionWorld);
+    resetPlayer();
+    initLights();
+    if (!useSoftwareRenderer) {
+        setupLighting();
+    }
     
     // 初始化粒子系统
-    srand(time(nullptr)); // 初始化随机数种子
     initParticles();
     
-    // 加载纹理
-    wallTexture = loadTexture("res/wall.png");
-    if (wallTexture == 0) {
-        std::cerr << "Failed to load wall texture" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    
-    floorTexture = loadTexture("res/floor.png");
-    if (floorTexture == 0) {
-        std::cerr << "Failed to load floor texture" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    
-    skyTexture = loadTexture("res/sky.png");
-    if (skyTexture == 0) {
-        std::cerr << "Failed to load sky texture" << std::endl;
-        glfwTerminate();
+    // 加载纹理（软件渲染只需要CPU端的图像）
+    if (!loadMaterials(!useSoftwareRenderer)) {
+        if (window) {
+            glfwTerminate();
+        }
         return -1;
     }
-    
-    logoTexture = loadTexture("res/logo.png");
-    if (logoTexture == 0) {
-        std::cerr << "Failed to load logo texture" << std::endl;
-        glfwTerminate();
-        return -1;
+    initDecals(!useSoftwareRenderer);
+    for (int i = 0; i < initialBulletHoles; i++) {
+        // 从相机位置向随机方向射击
+        glm::vec3 direction(rand() % 2001 - 1000, rand() % 2001 - 1000, rand() % 2001 - 1000);
+        if (glm::dot(direction, direction) > 0.0f) {
+            LevelHit hit;
+            spawnBulletHole(glm::vec3(camera.x, camera.y, camera.z), glm::normalize(direction), hit);
+        }
     }
-    
-    daqingTexture = loadTexture("res/daqing.png");
-    if (daqingTexture == 0) {
-        std::cerr << "Warning: Failed to load daqing texture, continuing without it" << std::endl;
-    } else {
-        std::cout << "Daqing texture loaded successfully" << std::endl;
+    for (int i = 0; i < initialGrenades; i++) {
+        // 向随机方向扔出，在命中的表面前引爆
+        glm::vec3 direction(rand() % 2001 - 1000, rand() % 2001 - 1000, rand() % 2001 - 1000);
+        LevelHit hit;
+        if (glm::dot(direction, direction) > 0.0f &&
+            collisionWorld.Raycast(glm::vec3(camera.x, camera.y, camera.z), glm::normalize(direction), 1000.0f,
+                                   hit)) {
+            spawnParticleEffect(grenadeEffect, hit.position + hit.normal * 0.3f);
+        }
     }
-    
-    homeTexture = loadTexture("res/home.png");
-    if (homeTexture == 0) {
-        std::cerr << "Warning: Failed to load home texture, continuing without it" << std::endl;
-    } else {
-        std::cout << "Home texture loaded successfully" << std::endl;
+    renderQueue.Reserve(SURFACE_COUNT + 1 + 4096);
+    
+    // 遮挡剔除、软件光栅化和粒子更新在工作线程上执行
+    JobSystem jobSystem;
+    occlusionCuller.SetJobSystem(&jobSystem);
+    softwareRasterizer.SetJobSystem(&jobSystem);
+    particleLayer.SetJobSystem(&jobSystem);
+    particleWorld.SetJobSystem(&jobSystem);
+    initOccluders();
+    
+    std::cout << "渲染器: " << (useSoftwareRenderer ? "软件光栅化" : "OpenGL") << std::endl;
+    if (window) {
+        std::cout << "控制说明：" << std::endl;
+        std::cout << "  WASD - 移动（需要先按ESC捕获鼠标）" << std::endl;
+        std::cout << "  空格 - 跳跃，左Ctrl - 蹲下，左Shift - 静步" << std::endl;
+        std::cout << "  鼠标 - 控制视角（需要先按ESC捕获鼠标）" << std::endl;
+        std::cout << "  鼠标左键 - 射击，在墙上留下弹孔" << std::endl;
+        std::cout << "  G - 在准星指向的位置引爆手雷" << std::endl;
+        std::cout << "  ESC - 切换鼠标捕获状态" << std::endl;
+        std::cout << "  O - 切换遮挡剔除" << std::endl;
+        std::cout << "  R - 切换动态分辨率" << std::endl;
+        std::cout << "  B - 切换泛光" << std::endl;
+        std::cout << "  L - 切换低延迟模式（输出输入延迟统计）" << std::endl;
+        std::cout << "  Q - 退出应用" << std::endl;
     }
     
-    std::cout << "纹理加载成功！" << std::endl;
-    std::cout << "控制说明：" << std::endl;
-    std::cout << "  WASD - 移动（需要先按ESC捕获鼠标）" << std::endl;
-    std::cout << "  鼠标 - 控制视角（需要先按ESC捕获鼠标）" << std::endl;
-    std::cout << "  ESC - 切换鼠标捕获状态" << std::endl;
-    std::cout << "  Q - 退出应用" << std::endl;
-    
     // 主循环
     auto lastTime = std::chrono::high_resolution_clock::now();
-    
-    while (!glfwWindowShouldClose(window)) {
-        // 计算帧时间
+    int frameCount = 0;
+    double renderSeconds = 0.0;
+    double scaleSum = 0.0;
+    
+    while (!window || !glfwWindowShouldClose(window)) {
+        // 低延迟模式：睡到预计能赶上下一次垂直同步的最晚时刻再开始
+        if (window && lateLatchEnabled) {
+            framePacer.WaitForFrameStart(nowSeconds());
+        }
+        
+        // 计算帧时间，限定帧数运行时使用固定步长保证结果可重复
         auto currentTime = std::chrono::high_resolution_clock::now();
         float deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
         lastTime = currentTime;
+        if (frameLimit > 0) {
+            deltaTime = 1.0f / 60.0f;
+        }
         
-        // 处理输入（只有在鼠标被捕获时才允许移动）
-        if (mouseCaptured) {
-            float moveSpeed = 5.0f * deltaTime;
-            float radYaw = camera.yaw * M_PI / 180.0f;
-            
-            if (keys[GLFW_KEY_W]) {
-                camera.move(cos(radYaw) * moveSpeed, 0, sin(radYaw) * moveSpeed);
-            }
-            if (keys[GLFW_KEY_S]) {
-                camera.move(-cos(radYaw) * moveSpeed, 0, -sin(radYaw) * moveSpeed);
-            }
-            if (keys[GLFW_KEY_A]) {
-                camera.move(sin(radYaw) * moveSpeed, 0, -cos(radYaw) * moveSpeed);
-            }
-            if (keys[GLFW_KEY_D]) {
-                camera.move(-sin(radYaw) * moveSpeed, 0, cos(radYaw) * moveSpeed);
-            }
-            if (keys[GLFW_KEY_SPACE]) {
-                camera.move(0, moveSpeed, 0);
-            }
-            if (keys[GLFW_KEY_LEFT_SHIFT]) {
-                camera.move(0, -moveSpeed, 0);
-            }
+        // 处理输入：本地玩家按固定帧率移动
+        if (window) {
+            updatePlayer(deltaTime);
         }
         
+        // 射击在粒子更新之前处理，火花这一帧就出现
+        processShots();
+        
         // 更新粒子系统
         updateParticles(deltaTime);
         
+        // 窗口大小可能变化（最小化时为0）
+        if (window && !useSoftwareRenderer) {
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            framebufferWidth = std::max(framebufferWidth, 1);
+            framebufferHeight = std::max(framebufferHeight, 1);
+        }
+        
         // 渲染
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        auto renderStart = std::chrono::high_resolution_clock::now();
+        updateCameraMatrices();
+        if (!lateLatchEnabled) {
+            latencyTracker.OnLatch();
+        }
+        renderOccluders();
+        buildRenderQueue(); // 收集并排序本帧的绘制（房间、窗户、装饰画、火焰粒子）
         
-        setupCamera();
-        drawRoom();
-        drawWindow(); // 绘制窗户
-        drawLogo(); // 绘制logo装饰画
-        drawDaqing(); // 绘制daqing装饰画
-        drawHome(); // 绘制home装饰画
-        drawParticles(); // 绘制火焰粒子
+        // 低延迟模式：剔除和排序用帧开始时的相机，提交前用最新的鼠标位置重建视图矩阵
+        if (window && lateLatchEnabled) {
+            latchCameraInput(window);
+            updateCameraMatrices();
+            latencyTracker.OnLatch();
+        }
         
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (useSoftwareRenderer) {
+            executeSoftwareRenderQueue();
+            if (window) {
+                presentSoftwareFrame();
+            }
+        } else {
+            renderSceneGL();
+            scaleSum += dynamicResolution.GetScale();
+        }
+        renderSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - renderStart).count();
+        frameCount++;
+        
+        if (frameLimit > 0 && frameCount >= frameLimit) {
+            if (outputPath) {
+                saveFrame(outputPath);
+            }
+            break;
+        }
+        
+        if (window) {
+            // 低延迟模式下等GPU完成，得到准确的渲染耗时和交换时刻
+            if (lateLatchEnabled) {
+                glFinish();
+                framePacer.OnRenderComplete(nowSeconds());
+            }
+            glfwSwapBuffers(window);
+            if (lateLatchEnabled) {
+                glFinish();
+            }
+            double presentTime = nowSeconds();
+            framePacer.OnPresent(presentTime);
+            latencyTracker.OnPresent(presentTime);
+            glfwPollEvents();
+        }
     }
     
-    // 清理纹理
-    if (wallTexture != 0) {
-        glDeleteTextures(1, &wallTexture);
-    }
-    if (floorTexture != 0) {
-        glDeleteTextures(1, &floorTexture);
-    }
-    if (skyTexture != 0) {
-        glDeleteTextures(1, &skyTexture);
+    if (window) {
+        latencyTracker.PrintReport(lateLatchEnabled ? "低延迟模式" : "普通模式");
     }
-    if (logoTexture != 0) {
-        glDeleteTextures(1, &logoTexture);
+    
+    if (frameLimit > 0) {
+        std::cout << frameCount << " 帧，平均渲染时间 " << renderSeconds * 1000.0 / frameCount << " ms（"
+                  << jobSystem.GetThreadCount() << " 个线程）" << std::endl;
+        if (gpuParticles) {
+            const GpuParticleWorldStats& gpuStats = gpuParticleWorld.GetStats();
+            std::cout << "GPU粒子: " << gpuStats.emitters << " 个发射器，" << gpuStats.pools << " 个粒子池共 "
+                      << gpuStats.capacity << " 个槽位；本帧发射 " << gpuStats.spawned << " 个（"
+                      << gpuStats.spawnRequests << " 个请求）" << std::endl;
+        } else {
+            const ParticleWorldStats& particleStats = particleWorld.GetStats();
+            std::cout << "粒子: " << particleStats.emitters << " 个发射器，" << particleStats.particles
+                      << " 个粒子；本帧发射 " << particleStats.spawned << " 个（" << particleStats.spawnBatches
+                      << " 批），更新 " << particleStats.updateChunks << " 块，碰撞 " << particleStats.collisions
+                      << " 次" << std::endl;
+        }
+        if (!useSoftwareRenderer) {
+            std::cout << "平均分辨率缩放 " << scaleSum / frameCount << std::endl;
+            const RenderGraphStats& post = renderer.GetPostProcessStats();
+            std::cout << "后处理: " << post.declaredPasses << " 个pass，剔除 " << post.culledPasses
+                      << "，合并 " << post.fusedPasses << "，执行 " << post.executedPasses << "；临时纹理 "
+                      << post.virtualTextures << " 个，实际分配 " << post.physicalTextures << " 个（"
+                      << post.physicalBytes / 1024 << " KB）" << std::endl;
+        }
     }
-    if (daqingTexture != 0) {
-        glDeleteTextures(1, &daqingTexture);
+    
+    // 清理纹理
+    for (int i = 0; i < MATERIAL_COUNT; i++) {
+        if (materialTextures[i] != 0) {
+            glDeleteTextures(1, &materialTextures[i]);
+        }
     }
-    if (homeTexture != 0) {
-        glDeleteTextures(1, &homeTexture);
+    if (decalAtlasTexture != 0) {
+        glDeleteTextures(1, &decalAtlasTexture);
     }
     
-    glfwTerminate();
+    gpuParticleWorld.Shutdown();
+    renderer.Shutdown();
+    
+    if (window) {
+        glfwTerminate();
+    }
     return 0;
-}
\ No newline at end of file
+}
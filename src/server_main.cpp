@@ -0,0 +1,1601 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include "GameServer.h"
+#include "BotController.h"
+#include "Broadphase.h"
+#include "ClientPrediction.h"
+#include "DemoRecording.h"
+#include "GameClient.h"
+#include "Hitscan.h"
+#include "NavMesh.h"
+#include "SnapshotEncoder.h"
+#include "VisibilitySet.h"
+
+// 专用服务器：不创建窗口，不需要OpenGL，按固定帧率运行游戏模拟，通过UDP与客户端通信
+
+// 命令行选项
+int serverPort = 27015;               // --port N
+int tickRate = 128;                   // --tick N：每秒的帧数（64或128）
+int maxPlayers = 64;                  // --max-players N
+int loopbackClients = 0;              // --clients N：在本进程里开N个客户端通过本机回环连接，测试服务器
+double runSeconds = 0.0;              // --duration S：运行S秒后退出，0为一直运行（有测试客户端时默认10秒）
+double clientLatencyMs = 0.0;         // --latency MS：测试客户端模拟的往返延迟
+double clientJitterMs = 0.0;          // --jitter MS：每个方向在延迟上随机增加0到MS毫秒
+float clientLossPercent = 0.0f;       // --loss P：每个方向的丢包率（百分比）
+int snapshotBenchPlayers = 0;         // --snapshot-bench N：N个玩家的快照编码基准测试，不开端口，测完退出
+std::string pvsPath;                  // --pvs FILE：加载编译好的可见集，没有时启动时编译
+std::string compilePvsPath;           // --compile-pvs FILE：编译关卡的可见集，检查后存到FILE，然后退出
+std::string recordPath;               // --record FILE：把比赛录到FILE
+std::string playPath;                 // --play FILE：不开端口，尽快回放录像并测试跳转，然后退出
+int botCount = 0;                     // --bots N：在服务器进程里加N个机器人，命令直接放进模拟的队列
+int botBenchCount = 0;                // --bot-bench N：N个机器人（不受槽位数限制）的开销基准测试，不开端口，测完退出
+std::string navPath;                  // --nav FILE：加载生成好的导航网格，没有时启动时生成
+std::string compileNavPath;           // --compile-nav FILE：生成关卡的导航网格，测试寻路后存到FILE，然后退出
+int collisionBenchCount = 0;          // --collision-bench N：测试N个移动物体的碰撞查询后退出
+int broadphaseBenchCount = 0;         // --broadphase-bench N：测试N个移动物体的宽相位后退出
+int hitscanBenchCount = 0;            // --hitscan-bench N：测试每帧N发射击的射线查询后退出
+int lagCompensationBenchCount = 0;    // --lagcomp-bench N：测试每帧N发延迟补偿射击后退出
+int movementBenchCount = 0;           // --movement-bench N：测试N个玩家的移动模拟后退出
+
+// 统计：最近一分钟（128Hz）每帧的模拟和收发时间（秒），环形
+const size_t MAX_TICK_SAMPLES = 128 * 60;
+std::vector<double> tickTimes;
+size_t tickSampleCount = 0;
+
+double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 当前线程用掉的CPU时间
+double threadCpuSeconds() {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// 解析命令行参数，失败时输出错误并返回false
+bool parseArguments(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--port") == 0 && value) {
+            serverPort = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--tick") == 0 && value) {
+            tickRate = atoi(value);
+            if (tickRate < 1 || tickRate > 1000) {
+                std::cerr << "帧率必须在1到1000之间: " << value << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--max-players") == 0 && value) {
+            maxPlayers = atoi(value);
+            if (maxPlayers < 1 || maxPlayers > 255) {
+                std::cerr << "玩家数必须在1到255之间: " << value << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--clients") == 0 && value) {
+            loopbackClients = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--duration") == 0 && value) {
+            runSeconds = atof(value);
+            i++;
+        } else if (strcmp(arg, "--latency") == 0 && value) {
+            clientLatencyMs = atof(value);
+            i++;
+        } else if (strcmp(arg, "--jitter") == 0 && value) {
+            clientJitterMs = atof(value);
+            i++;
+        } else if (strcmp(arg, "--loss") == 0 && value) {
+            clientLossPercent = static_cast<float>(atof(value));
+            i++;
+        } else if (strcmp(arg, "--snapshot-bench") == 0 && value) {
+            snapshotBenchPlayers = atoi(value);
+            if (snapshotBenchPlayers < 1 || snapshotBenchPlayers > 255) {
+                std::cerr << "玩家数必须在1到255之间: " << value << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--pvs") == 0 && value) {
+            pvsPath = value;
+            i++;
+        } else if (strcmp(arg, "--compile-pvs") == 0 && value) {
+            compilePvsPath = value;
+            i++;
+        } else if (strcmp(arg, "--record") == 0 && value) {
+            recordPath = value;
+            i++;
+        } else if (strcmp(arg, "--play") == 0 && value) {
+            playPath = value;
+            i++;
+        } else if (strcmp(arg, "--bots") == 0 && value) {
+            botCount = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--bot-bench") == 0 && value) {
+            botBenchCount = atoi(value);
+            if (botBenchCount < 1 || botBenchCount > 65536) {
+                std::cerr << "机器人数必须在1到65536之间: " << value << std::endl;
+                return false;
+            }
+            i++;
+        } else if (strcmp(arg, "--nav") == 0 && value) {
+            navPath = value;
+            i++;
+        } else if (strcmp(arg, "--compile-nav") == 0 && value) {
+            compileNavPath = value;
+            i++;
+        } else if (strcmp(arg, "--collision-bench") == 0 && value) {
+            collisionBenchCount = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--broadphase-bench") == 0 && value) {
+            broadphaseBenchCount = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--hitscan-bench") == 0 && value) {
+            hitscanBenchCount = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--lagcomp-bench") == 0 && value) {
+            lagCompensationBenchCount = atoi(value);
+            i++;
+        } else if (strcmp(arg, "--movement-bench") == 0 && value) {
+            movementBenchCount = atoi(value);
+            i++;
+        } else {
+            std::cerr << "未知参数: " << arg << std::endl;
+            std::cerr << "用法: " << argv[0] << " [--port N] [--tick N] [--max-players N] [--clients N] [--duration S]"
+                      << " [--latency MS] [--jitter MS] [--loss P] [--snapshot-bench N] [--pvs FILE] [--compile-pvs FILE]"
+                      << " [--record FILE] [--play FILE] [--bots N] [--bot-bench N] [--nav FILE] [--compile-nav FILE]"
+                      << " [--collision-bench N] [--broadphase-bench N] [--hitscan-bench N] [--lagcomp-bench N]"
+                      << " [--movement-bench N]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// 随机的命令：一直往前跑，随机转向，偶尔横移、跳跃，三分之一的帧开火
+PlayerCommand randomCommand(uint32_t& state, float& yaw, int tick) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    yaw += static_cast<float>(static_cast<int>(state % 9) - 4);
+    PlayerCommand command = {};
+    command.tick = tick;
+    command.yaw = PlayerMovement::QuantizeYaw(yaw);
+    command.pitch = 0;
+    command.forward = 127;
+    command.side = static_cast<int8_t>(state % 4 == 0 ? (state >> 8) % 255 - 127 : 0);
+    command.buttons = (state % 256 == 0 ? BUTTON_JUMP : 0) | (state % 3 == 0 ? BUTTON_ATTACK : 0);
+    return command;
+}
+
+// 测试客户端的结果
+struct LoopbackResult {
+    ClientStats network;
+    PredictionStats prediction;
+    InterpolationStats interpolation;
+    double delayTicks = 0.0;          // 退出时的插值缓冲延迟
+    long long pendingCommands = 0;    // 每帧没确认的命令数之和
+    long long frames = 0;
+    long long serverTickMicros = 0;   // 收到的快照里服务器每帧用的时间之和
+    int maxServerTickMicros = 0;
+};
+
+// 测试客户端：每个客户端是一个机器人，按服务器的帧率发送BotController生成的命令（走动、瞄准、开火），
+// 直到running变为false。和真正的客户端一样：自己的玩家用客户端预测立即移动，收到快照时和服务器对账；
+// 其他玩家从插值缓冲区取，命令里带的看到的时间就是插值的时间。机器人看到的是自己预测的位置，
+// 打的目标是第一个连上的客户端插值出来的玩家。所有客户端共用一个客户端的碰撞世界，
+// 寻路用服务器的导航网格（只读），这个线程有自己的NavPathfinder。
+void runLoopbackClients(uint16_t port, int count, const NavMesh* navMesh, std::atomic<bool>& running,
+                        std::vector<LoopbackResult>& results) {
+    LevelGeometry level;
+    level.Build();
+    CollisionWorld world;
+    world.AddLevel(level);
+    world.Build();
+    MovementSettings movementSettings;
+    movementSettings.tickRate = tickRate;
+    PlayerMovement movement(movementSettings);
+    movement.SetWorld(&world);
+
+    NetworkConditions conditions;
+    conditions.latencySeconds = clientLatencyMs * 0.5e-3;
+    conditions.jitterSeconds = clientJitterMs * 1e-3;
+    conditions.lossPercent = clientLossPercent;
+
+    std::vector<std::unique_ptr<GameClient>> clients;
+    std::vector<std::unique_ptr<ClientPrediction>> predictions;
+    BotSettings botSettings;
+    botSettings.tickRate = tickRate;
+    BotController bots(level, botSettings);
+    NavPathfinder pathfinder(*navMesh);
+    if (navMesh->IsValid()) {
+        bots.SetNavigation(&pathfinder);
+    }
+    std::vector<int> commandTicks(count, 0);
+    std::vector<int> reconciledTicks(count, -1);
+    std::vector<uint8_t> alive(count, 0);
+    std::vector<float> viewTicks(count, 0.0f);
+    std::vector<NetPlayerState> others;
+    std::vector<BotTarget> targets;
+    std::vector<PlayerCommand> commands;
+    for (int i = 0; i < count; i++) {
+        clients.emplace_back(new GameClient());
+        clients[i]->SetConditions(conditions);
+        clients[i]->Connect(NetAddress::Loopback(port));
+        predictions.emplace_back(new ClientPrediction(movement));
+        bots.AddBot(-1, 0x9E3779B9u * (i + 1));
+    }
+
+    const double period = 1.0 / tickRate;
+    double next = nowSeconds();
+    int frame = 0;
+    while (running) {
+        double now = nowSeconds();
+        targets.clear();
+        for (int i = 0; i < count; i++) {
+            GameClient& client = *clients[i];
+            ClientPrediction& prediction = *predictions[i];
+            client.Update(now);
+            if (!client.IsConnected()) {
+                bots.Observe(i, glm::vec3(0.0f), false);
+                continue;
+            }
+            bots.SetSlot(i, client.GetSlot());
+            const ClientSnapshot& snapshot = client.GetSnapshot();
+            if (snapshot.tick > reconciledTicks[i]) {
+                reconciledTicks[i] = snapshot.tick;
+                alive[i] = 1;
+                for (const NetPlayerState& player : snapshot.players) {
+                    if (player.slot == client.GetSlot()) {
+                        alive[i] = (player.flags & NetPlayerState::FLAG_ALIVE) != 0;
+                    }
+                }
+                prediction.Reconcile(snapshot.ackCommandTick, snapshot.localState, alive[i] != 0);
+                results[i].serverTickMicros += snapshot.serverTickMicros;
+                results[i].maxServerTickMicros = std::max(results[i].maxServerTickMicros, snapshot.serverTickMicros);
+            }
+            bots.Observe(i, prediction.GetState().position, alive[i] != 0);
+            viewTicks[i] = client.GetInterpolator().GetRenderTick(now);
+            if (viewTicks[i] >= 0.0f) {
+                client.GetInterpolator().Sample(viewTicks[i], others);
+                if (targets.empty()) {
+                    for (const NetPlayerState& player : others) {
+                        targets.push_back({player.slot, player.position, (player.flags & NetPlayerState::FLAG_ALIVE) != 0});
+                    }
+                }
+            }
+        }
+        bots.SetTargets(targets);
+        bots.Think(frame++, commands);
+        for (int i = 0; i < count; i++) {
+            GameClient& client = *clients[i];
+            ClientPrediction& prediction = *predictions[i];
+            if (!client.IsConnected()) {
+                continue;
+            }
+            PlayerCommand& command = commands[i];
+            command.tick = commandTicks[i]++;
+            prediction.Predict(command);
+            prediction.UpdateSmoothing(static_cast<float>(period));
+            client.SendCommand(command, std::max(viewTicks[i], 0.0f));
+            results[i].pendingCommands += prediction.GetPendingCount();
+            results[i].frames++;
+        }
+        next += period;
+        double wait = next - nowSeconds();
+        if (wait > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        results[i].network = clients[i]->GetStats();
+        results[i].prediction = predictions[i]->GetStats();
+        results[i].interpolation = clients[i]->GetInterpolator().GetStats();
+        results[i].delayTicks = clients[i]->GetInterpolator().GetDelayTicks();
+        clients[i]->Disconnect();
+    }
+}
+
+// 同一进程里的机器人：看模拟里自己和所有玩家的状态，生成命令直接放进模拟的队列，和收到的命令一样执行。
+// 它们看到的是刚模拟完的那一帧，没有插值延迟
+void thinkBots(GameSimulation& simulation, BotController& bots, std::vector<BotTarget>& targets,
+               std::vector<PlayerCommand>& commands) {
+    targets.clear();
+    for (int slot = 0; slot < simulation.GetMaxPlayers(); slot++) {
+        const SimPlayer& player = simulation.GetPlayer(slot);
+        if (player.active) {
+            targets.push_back({slot, player.state.position, player.health > 0});
+        }
+    }
+    for (int bot = 0; bot < bots.GetCount(); bot++) {
+        const SimPlayer& player = simulation.GetPlayer(bots.GetSlot(bot));
+        bots.Observe(bot, player.state.position, player.health > 0);
+    }
+    bots.SetTargets(targets);
+    int tick = simulation.GetTick();
+    bots.Think(tick, commands);
+    for (int bot = 0; bot < bots.GetCount(); bot++) {
+        simulation.QueueCommand(bots.GetSlot(bot), commands[bot], static_cast<float>(tick - 1));
+    }
+}
+
+// 机器人的开销：count个机器人在一个不限槽位数的模拟里跑10秒（不开端口、不等时间），
+// 分别用SSE2和标量的避让各跑一遍，同样的种子，比较每帧思考的时间，再看模拟每帧的时间
+void runBotBenchmark(int count) {
+    const int ticks = tickRate * 10;
+    GameSettings settings;
+    settings.tickRate = tickRate;
+    settings.maxPlayers = count;
+    std::cout << "机器人基准测试: " << count << " 个机器人，" << tickRate << " Hz，" << ticks << " 帧" << std::endl;
+    double simdSteerMicros = 0.0;
+    for (int pass = 0; pass < 2; pass++) {
+        bool simd = pass == 0;
+        GameSimulation simulation(settings);
+        BotSettings botSettings;
+        botSettings.tickRate = tickRate;
+        botSettings.simd = simd;
+        BotController bots(simulation.GetLevel(), botSettings);
+        for (int i = 0; i < count; i++) {
+            bots.AddBot(simulation.AddPlayer(), 0x9E3779B9u * (i + 1));
+        }
+        std::vector<BotTarget> targets;
+        std::vector<PlayerCommand> commands;
+        double simulateSeconds = 0.0;
+        for (int tick = 0; tick < ticks; tick++) {
+            thinkBots(simulation, bots, targets, commands);
+            double start = nowSeconds();
+            simulation.Tick();
+            simulateSeconds += nowSeconds() - start;
+        }
+        const BotStats& stats = bots.GetStats();
+        double thinkMicros = stats.thinkSeconds * 1e6 / ticks;
+        double steerMicros = stats.steerSeconds * 1e6 / ticks;
+        const GameStats& game = simulation.GetStats();
+        std::cout << "  " << (simd ? "SSE2" : "标量") << ": 思考 " << thinkMicros << " us/帧（每个机器人 "
+                  << thinkMicros * 1000.0 / count << " ns，其中避让 " << steerMicros << " us），开火命令 " << stats.attacks * 100.0 / std::max(1LL, stats.commands) << "%" << std::endl;
+        if (simd) {
+            simdSteerMicros = steerMicros;
+            std::cout << "  思考占一帧（" << 1e6 / tickRate << " us）的 " << thinkMicros * tickRate / 1e4 << "%" << std::endl;
+            std::cout << "  模拟 " << simulateSeconds * 1000.0 / ticks << " ms/帧，射击 " << game.shots << "，命中 "
+                      << game.hits << "，击杀 " << game.kills << std::endl;
+        } else {
+            std::cout << "  避让SSE2比标量快 " << steerMicros / std::max(simdSteerMicros, 1e-9) << " 倍" << std::endl;
+        }
+    }
+}
+
+// 重新模拟的开销：预测64个命令后，每次给一个和预测不同的服务器状态，从第32个命令开始重新模拟之后的32帧
+double measureReplayMicros() {
+    LevelGeometry level;
+    level.Build();
+    CollisionWorld world;
+    world.AddLevel(level);
+    world.Build();
+    MovementSettings movementSettings;
+    movementSettings.tickRate = tickRate;
+    PlayerMovement movement(movementSettings);
+    movement.SetWorld(&world);
+
+    const int REPEATS = 2000;
+    ClientPrediction prediction(movement);
+    PlayerState start = {};
+    start.position = glm::vec3(0.0f, 0.05f, 0.0f);
+    prediction.Reset(start);
+    uint32_t random = 0x2545F491u;
+    float yaw = 0.0f;
+    PlayerState server = start;
+    for (int tick = 0; tick < 64; tick++) {
+        PlayerCommand command = randomCommand(random, yaw, tick);
+        prediction.Predict(command);
+        if (tick <= 31) {
+            movement.Simulate(server, command);
+        }
+    }
+    double begin = nowSeconds();
+    for (int i = 0; i < REPEATS; i++) {
+        PlayerState corrected = server;
+        corrected.position.x += (i % 2 == 0 ? 0.01f : -0.01f);
+        prediction.Reconcile(31, corrected, true);
+    }
+    return (nowSeconds() - begin) * 1e6 / REPEATS;
+}
+
+bool sameNetState(const NetPlayerState& a, const NetPlayerState& b) {
+    return a.slot == b.slot && a.flags == b.flags && a.health == b.health && a.duck == b.duck && a.yaw == b.yaw &&
+           a.pitch == b.pitch && a.position == b.position && a.velocity == b.velocity;
+}
+
+// 快照编码基准测试：先模拟players个玩家跑一段时间，记下每帧所有玩家的状态，再按两种精度给每个玩家的客户端编码快照。
+// 客户端的往返延迟为2 - 17帧、丢包5%，服务器用往返延迟之前客户端确认的帧做基准（和GameServer一样）；
+// 前几个客户端真的解码，和编码器量化后的状态逐个比较。
+void runSnapshotBenchmark(int players) {
+    const int WARMUP_TICKS = 256;
+    const int RECORD_TICKS = 1024;
+    const int SAMPLE_CLIENTS = 16;
+    const uint32_t LOSS_PERCENT = 5;
+    const int HISTORY = SnapshotEncoder::HISTORY;
+
+    GameSettings settings;
+    settings.tickRate = tickRate;
+    settings.maxPlayers = players;
+    GameSimulation simulation(settings);
+    std::vector<uint32_t> random(players);
+    std::vector<float> yaws(players);
+    for (int i = 0; i < players; i++) {
+        simulation.AddPlayer();
+        random[i] = 0x9E3779B9u * (i + 1);
+        yaws[i] = static_cast<float>(i * 37 % 360);
+    }
+    std::vector<NetPlayerState> recorded;
+    recorded.reserve(static_cast<size_t>(RECORD_TICKS) * players);
+    for (int tick = 0; tick < WARMUP_TICKS + RECORD_TICKS; tick++) {
+        for (int i = 0; i < players; i++) {
+            simulation.QueueCommand(i, randomCommand(random[i], yaws[i], tick), tick - 2.0f);
+        }
+        simulation.Tick();
+        if (tick >= WARMUP_TICKS) {
+            for (int i = 0; i < players; i++) {
+                recorded.push_back(GameServer::BuildPlayerState(i, simulation.GetPlayer(i)));
+            }
+        }
+    }
+    std::cout << "快照编码基准测试: " << players << " 个玩家（每个也是一个客户端），" << RECORD_TICKS << " 帧，往返延迟2 - 17帧，丢包"
+              << LOSS_PERCENT << "%；不压缩时每个玩家32字节" << std::endl;
+
+    SnapshotFormat coarse;
+    coarse.positionStep = 1.0f / 16.0f;
+    coarse.velocityStep = 1.0f / 8.0f;
+    coarse.yawBits = 12;
+    coarse.pitchBits = 10;
+    struct {
+        const char* name;
+        SnapshotFormat format;
+    } formats[] = {
+        {"默认精度（位置1/64米，速度1/32米/秒，水平角16位，俯仰角14位）", SnapshotFormat()},
+        {"粗精度（位置1/16米，速度1/8米/秒，水平角12位，俯仰角10位）", coarse},
+    };
+    for (const auto& entry : formats) {
+        SnapshotEncoder encoder(players, entry.format);
+        int samples = std::min(players, SAMPLE_CLIENTS);
+        std::vector<std::unique_ptr<SnapshotDecoder>> decoders;
+        for (int c = 0; c < samples; c++) {
+            decoders.emplace_back(new SnapshotDecoder(players, entry.format));
+        }
+        // 每个客户端在每一帧收到的最新快照（环形），服务器看到的是往返延迟之前的值
+        std::vector<int> received(static_cast<size_t>(players) * HISTORY, -1);
+        std::vector<int> latest(players, -1);
+        std::vector<int> sizes(players);
+        std::vector<uint8_t> packets(static_cast<size_t>(players) * NET_MAX_PACKET);
+        std::vector<int> bases;
+        std::vector<NetPlayerState> expected;
+        std::vector<NetPlayerState> decoded;
+        uint32_t loss = 0x12345678u;
+        long long fullBytes = 0;
+        long long deltaBytes = 0;
+        long long fullSnapshots = 0;
+        long long sharedEncodes = 0;
+        long long decodes = 0;
+        long long decodeFailures = 0;
+        long long mismatches = 0;
+        double encodeSeconds = 0.0;
+        double decodeSeconds = 0.0;
+        float maxPositionError = 0.0f;
+        for (int tick = 0; tick < RECORD_TICKS; tick++) {
+            const NetPlayerState* states = &recorded[static_cast<size_t>(tick) * players];
+            encoder.BeginSnapshot(tick);
+            for (int i = 0; i < players; i++) {
+                encoder.AddPlayer(states[i]);
+            }
+            encoder.GetPlayers(expected);
+            for (int i = 0; i < players; i++) {
+                maxPositionError = std::max(maxPositionError, glm::length(expected[i].position - states[i].position));
+            }
+            fullBytes += encoder.Encode(-1, packets.data(), NET_MAX_PACKET);
+
+            // 每个客户端编码一次（不共用），统计确认帧不同的有几个，即GameServer实际的编码次数
+            bases.clear();
+            double start = nowSeconds();
+            for (int c = 0; c < players; c++) {
+                int rtt = 2 + c * 7 % 16;
+                int ack = tick >= rtt ? received[static_cast<size_t>(c) * HISTORY + (tick - rtt) % HISTORY] : -1;
+                int base = encoder.HasBaseline(ack) ? ack : -1;
+                sizes[c] = encoder.Encode(base, &packets[static_cast<size_t>(c) * NET_MAX_PACKET], NET_MAX_PACKET);
+                fullSnapshots += base < 0 ? 1 : 0;
+                if (std::find(bases.begin(), bases.end(), base) == bases.end()) {
+                    bases.push_back(base);
+                }
+            }
+            encodeSeconds += nowSeconds() - start;
+            sharedEncodes += static_cast<long long>(bases.size());
+
+            for (int c = 0; c < players; c++) {
+                deltaBytes += sizes[c];
+                loss ^= loss << 13;
+                loss ^= loss >> 17;
+                loss ^= loss << 5;
+                if (loss % 100 >= LOSS_PERCENT && sizes[c] > 0) {
+                    if (c < samples) {
+                        double decodeStart = nowSeconds();
+                        bool ok = decoders[c]->Decode(tick, &packets[static_cast<size_t>(c) * NET_MAX_PACKET],
+                                                      sizes[c], decoded);
+                        decodeSeconds += nowSeconds() - decodeStart;
+                        decodes++;
+                        if (!ok) {
+                            decodeFailures++;
+                            continue;
+                        }
+                        bool same = decoded.size() == expected.size();
+                        for (size_t i = 0; same && i < decoded.size(); i++) {
+                            same = sameNetState(decoded[i], expected[i]);
+                        }
+                        mismatches += same ? 0 : 1;
+                    }
+                    latest[c] = tick;
+                }
+                received[static_cast<size_t>(c) * HISTORY + tick % HISTORY] = latest[c];
+            }
+        }
+
+        double snapshots = static_cast<double>(RECORD_TICKS) * players;
+        double bytesPerPlayer = deltaBytes / snapshots / players;
+        double encodeMicros = encodeSeconds * 1e6 / snapshots;
+        double decodeMicros = decodes > 0 ? decodeSeconds * 1e6 / decodes : 0.0;
+        // 每个快照包另有9字节的包头
+        double clientKbps = (deltaBytes / snapshots + 9.0) * 8.0 * tickRate / 1000.0;
+        std::cout << entry.name << std::endl;
+        std::cout << "  完整快照 " << static_cast<double>(fullBytes) / RECORD_TICKS / players << " 字节/玩家，差量 "
+                  << bytesPerPlayer << " 字节/玩家/帧（" << 32.0 / bytesPerPlayer << " 倍压缩），每个客户端 " << clientKbps
+                  << " kbit/s，完整快照占 " << fullSnapshots * 100.0 / snapshots << "%" << std::endl;
+        std::cout << "  量化误差最大 " << maxPositionError * 100.0f << " 厘米" << std::endl;
+        std::cout << "  编码 " << encodeMicros << " us/快照（" << players / encodeMicros << " 百万玩家/秒，"
+                  << deltaBytes / encodeSeconds / 1e6 << " MB/s）；确认帧相同的共用编码后每帧编码 "
+                  << static_cast<double>(sharedEncodes) / RECORD_TICKS << " 次，约 "
+                  << encodeMicros * sharedEncodes / RECORD_TICKS << " us" << std::endl;
+        std::cout << "  解码 " << decodeMicros << " us/快照（" << players / decodeMicros << " 百万玩家/秒），解码 " << decodes
+                  << " 次，失败 " << decodeFailures << "，和服务器不一致 " << mismatches << std::endl;
+    }
+}
+
+// 碰撞查询的速度：count个物体在房间里以128Hz移动，一半是玩家大小的胶囊，一半是100米/秒的小球（投射物），
+// 房间里随机放一些箱子；碰到表面后沿法线反弹。最后检查有没有物体穿出房间
+void runCollisionBenchmark(int count) {
+    LevelGeometry benchLevel;
+    benchLevel.Build();
+    CollisionWorld world;
+    world.AddLevel(benchLevel);
+    const int crates = 64;
+    for (int i = 0; i < crates; i++) {
+        glm::vec3 corner(rand() % 5001 / 100.0f - 25.0f, 0.0f, rand() % 5001 / 100.0f - 25.0f);
+        float size = 0.5f + rand() % 101 / 100.0f;
+        world.AddBox(corner, corner + glm::vec3(size), -1);
+    }
+    world.Build();
+    
+    const int ticks = 256;
+    const float tickSeconds = 1.0f / 128.0f;
+    const glm::vec3 playerAxis(0.0f, 1.2f, 0.0f);
+    std::vector<glm::vec3> positions(count);
+    std::vector<glm::vec3> velocities(count);
+    for (int i = 0; i < count; i++) {
+        bool projectile = i % 2 == 1;
+        positions[i] = glm::vec3(rand() % 5001 / 100.0f - 25.0f, 1.0f + rand() % 2001 / 100.0f,
+                                 rand() % 5001 / 100.0f - 25.0f);
+        glm::vec3 direction(rand() % 2001 - 1000, rand() % 2001 - 1000, rand() % 2001 - 1000);
+        if (glm::dot(direction, direction) == 0.0f) {
+            direction = glm::vec3(1.0f, 0.0f, 0.0f);
+        }
+        velocities[i] = glm::normalize(direction) * (projectile ? 100.0f : 5.0f);
+    }
+    
+    long long contacts = 0;
+    double start = nowSeconds();
+    for (int tick = 0; tick < ticks; tick++) {
+        for (int i = 0; i < count; i++) {
+            bool projectile = i % 2 == 1;
+            CollisionMoveResult result = world.MoveCapsule(positions[i], projectile ? glm::vec3(0.0f) : playerAxis,
+                                                           velocities[i] * tickSeconds, projectile ? 0.05f : 0.4f);
+            positions[i] = result.position;
+            if (result.contactCount > 0) {
+                float into = glm::dot(velocities[i], result.normals[0]);
+                if (into < 0.0f) {
+                    velocities[i] -= result.normals[0] * (2.0f * into);
+                }
+                contacts++;
+            }
+        }
+    }
+    double seconds = nowSeconds() - start;
+    
+    // 穿出房间：在房间外，或在前墙里却不在窗洞内
+    const LevelDesc& desc = benchLevel.GetDesc();
+    const float half = desc.roomSize / 2.0f;
+    int escaped = 0;
+    for (int i = 0; i < count; i++) {
+        const glm::vec3& p = positions[i];
+        bool outside = p.x < -half || p.x > half || p.y < 0.0f || p.y > desc.roomHeight || p.z > half ||
+                       p.z < -half - desc.wallThickness;
+        bool inWall = p.z < -half && (std::fabs(p.x - desc.windowX) > desc.windowWidth / 2.0f ||
+                                      std::fabs(p.y - desc.windowY) > desc.windowHeight / 2.0f);
+        if (outside || inWall) {
+            escaped++;
+        }
+    }
+    
+    double queries = static_cast<double>(count) * ticks;
+    std::cout << "碰撞查询: " << count << " 个物体，" << ticks << " 帧（128 Hz），BVH " << world.GetTriangleCount()
+              << " 个三角形、" << world.GetNodeCount() << " 个节点" << std::endl;
+    std::cout << "  每次 " << seconds * 1e6 / queries << " us，每帧 " << seconds * 1000.0 / ticks
+              << " ms（单线程），接触 " << contacts << " 次，穿出房间 " << escaped << " 个" << std::endl;
+}
+
+// 宽相位的速度：count个物体在房间里以128Hz随机移动，一半是玩家大小的盒子，一半是小的投射物；
+// 每帧更新所有包围盒并求相交的对，再做一些区域查询。最后一帧的结果与逐对测试比较
+void runBroadphaseBenchmark(int count) {
+    const int ticks = 256;
+    const float tickLength = 1.0f / 128.0f;
+    LevelDesc desc;
+    const float half = desc.roomSize / 2.0f;
+    const int queriesPerTick = 64;
+    const glm::vec3 queryExtent(4.0f, 2.0f, 4.0f);
+    
+    Broadphase broadphase;
+    std::vector<glm::vec3> positions(count);
+    std::vector<glm::vec3> velocities(count);
+    std::vector<glm::vec3> extents(count);
+    std::vector<int> handles(count);
+    for (int i = 0; i < count; i++) {
+        bool projectile = i % 2 == 1;
+        extents[i] = projectile ? glm::vec3(0.05f) : glm::vec3(0.4f, 0.9f, 0.4f);
+        positions[i] = glm::vec3(rand() % 5801 / 100.0f - 29.0f, 1.0f + rand() % 2301 / 100.0f,
+                                 rand() % 5801 / 100.0f - 29.0f);
+        glm::vec3 direction(rand() % 2001 - 1000, rand() % 2001 - 1000, rand() % 2001 - 1000);
+        if (glm::dot(direction, direction) == 0.0f) {
+            direction = glm::vec3(1.0f, 0.0f, 0.0f);
+        }
+        velocities[i] = glm::normalize(direction) * (projectile ? 40.0f : 5.0f);
+        handles[i] = broadphase.Add(positions[i] - extents[i], positions[i] + extents[i]);
+    }
+    
+    std::vector<BroadphasePair> pairs;
+    std::vector<int> found;
+    std::vector<double> tickSeconds(ticks);
+    double querySeconds = 0.0;
+    long long pairSum = 0;
+    long long queryHits = 0;
+    long long moved = 0;
+    for (int tick = 0; tick < ticks; tick++) {
+        // 移动（不计时），在房间的边界上反弹
+        for (int i = 0; i < count; i++) {
+            positions[i] += velocities[i] * tickLength;
+            for (int axis = 0; axis < 3; axis++) {
+                float low = axis == 1 ? 0.0f : -half;
+                float high = axis == 1 ? desc.roomHeight : half;
+                if (positions[i][axis] < low || positions[i][axis] > high) {
+                    velocities[i][axis] = -velocities[i][axis];
+                    positions[i][axis] = glm::clamp(positions[i][axis], low, high);
+                }
+            }
+        }
+        
+        double start = nowSeconds();
+        for (int i = 0; i < count; i++) {
+            broadphase.SetBounds(handles[i], positions[i] - extents[i], positions[i] + extents[i]);
+        }
+        broadphase.FindPairs(pairs);
+        tickSeconds[tick] = nowSeconds() - start;
+        pairSum += pairs.size();
+        moved += broadphase.GetStats().moved;
+        
+        start = nowSeconds();
+        for (int q = 0; q < queriesPerTick; q++) {
+            glm::vec3 center = positions[(tick * queriesPerTick + q) % count];
+            broadphase.Query(center - queryExtent, center + queryExtent, found);
+            queryHits += found.size();
+        }
+        querySeconds += nowSeconds() - start;
+    }
+    
+    // 最后一帧逐对测试
+    long long bruteForce = 0;
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+            glm::vec3 distance = glm::abs(positions[i] - positions[j]);
+            glm::vec3 reach = extents[i] + extents[j];
+            if (distance.x <= reach.x && distance.y <= reach.y && distance.z <= reach.z) {
+                bruteForce++;
+            }
+        }
+    }
+    
+    // 第一帧建网格，偶尔被系统打断的帧也不能代表平时，所以同时给出中位数
+    double updateSeconds = 0.0;
+    for (double seconds : tickSeconds) {
+        updateSeconds += seconds;
+    }
+    std::nth_element(tickSeconds.begin(), tickSeconds.begin() + ticks / 2, tickSeconds.end());
+    
+    const BroadphaseStats& stats = broadphase.GetStats();
+    std::cout << "宽相位: " << count << " 个物体，" << ticks << " 帧（128 Hz），" << stats.entries << " 个格子项，"
+              << stats.buckets << " 个桶" << std::endl;
+    std::cout << "  每帧中位数 " << tickSeconds[ticks / 2] * 1000.0 << " ms，平均 " << updateSeconds * 1000.0 / ticks
+              << " ms（更新包围盒 + 求相交的对，单线程），平均 "
+              << pairSum / ticks << " 对，" << moved / ticks << " 个物体换格子，最后一帧测试 " << stats.pairTests
+              << " 次" << std::endl;
+    std::cout << "  区域查询 " << querySeconds * 1e6 / (ticks * queriesPerTick) << " us/次，平均 "
+              << queryHits / (ticks * queriesPerTick) << " 个物体" << std::endl;
+    std::cout << "  最后一帧 " << pairs.size() << " 对，逐对测试 " << bruteForce << " 对" << std::endl;
+}
+
+const float RIFLE_PENETRATION = 2.5f;  // 步枪子弹能穿过2.5米墙
+
+// 射击的速度：10个玩家站在房间里（放了箱子），每帧一共射出shotsPerTick发，每个人的子弹在3度以内散开；
+// 比较打包批处理（含穿透计算）和逐条射线，再用只有关卡的BVH和逐个四边形求最近交点，检查结果是否一致
+void runHitscanBenchmark(int shotsPerTick) {
+    LevelGeometry benchLevel;
+    benchLevel.Build();
+    CollisionWorld world;
+    world.AddLevel(benchLevel);
+    // 箱子是一个单独的表面，木头，厚度取箱子的大小以内，出口是箱子的背面
+    const int crateSurface = SURFACE_COUNT;
+    world.SetSurface(crateSurface, MATERIAL_NONE, 2.0f);
+    const int crates = 64;
+    for (int i = 0; i < crates; i++) {
+        glm::vec3 corner(rand() % 5001 / 100.0f - 25.0f, 0.0f, rand() % 5001 / 100.0f - 25.0f);
+        float size = 0.5f + rand() % 101 / 100.0f;
+        world.AddBox(corner, corner + glm::vec3(size), crateSurface);
+    }
+    world.Build();
+    CollisionWorld levelWorld;
+    levelWorld.AddLevel(benchLevel);
+    levelWorld.Build();
+    
+    Hitscan batch;
+    batch.SetWorld(&world);
+    batch.SetLevelResistances(benchLevel);
+    batch.SetResistance(crateSurface, 0.5f);
+    
+    const int ticks = 256;
+    const int players = 10;
+    const float spread = 3.0f * float(M_PI) / 180.0f;
+    std::vector<HitscanShot> shots(shotsPerTick);
+    long long impacts = 0;
+    long long penetrations = 0;
+    long long singleHits = 0;
+    double batchSeconds = 0.0;
+    double singleSeconds = 0.0;
+    double bvhSeconds = 0.0;
+    double bruteSeconds = 0.0;
+    int mismatches = 0;
+    for (int tick = 0; tick < ticks; tick++) {
+        // 每个玩家一个位置和瞄准方向
+        for (int player = 0; player < players; player++) {
+            glm::vec3 origin(rand() % 5001 / 100.0f - 25.0f, 1.7f, rand() % 5001 / 100.0f - 25.0f);
+            float yaw = rand() % 3600 / 10.0f * float(M_PI) / 180.0f;
+            float pitch = (rand() % 600 / 10.0f - 30.0f) * float(M_PI) / 180.0f;
+            for (int i = player; i < shotsPerTick; i += players) {
+                float jitterYaw = yaw + (rand() % 2001 / 1000.0f - 1.0f) * spread;
+                float jitterPitch = pitch + (rand() % 2001 / 1000.0f - 1.0f) * spread;
+                glm::vec3 direction(std::cos(jitterPitch) * std::cos(jitterYaw), std::sin(jitterPitch),
+                                    std::cos(jitterPitch) * std::sin(jitterYaw));
+                shots[i] = {origin, direction, 1000.0f, RIFLE_PENETRATION};
+            }
+        }
+        
+        double start = nowSeconds();
+        batch.Clear();
+        for (const HitscanShot& shot : shots) {
+            batch.AddShot(shot);
+        }
+        batch.Process();
+        batchSeconds += nowSeconds() - start;
+        impacts += batch.GetStats().impacts;
+        penetrations += batch.GetStats().penetrations;
+        
+        start = nowSeconds();
+        RayHitList list;
+        for (const HitscanShot& shot : shots) {
+            world.RaycastPacket(&shot.origin, &shot.direction, &shot.range, 1, &list);
+            singleHits += list.count;
+        }
+        singleSeconds += nowSeconds() - start;
+        
+        // 最近交点
+        start = nowSeconds();
+        for (const HitscanShot& shot : shots) {
+            LevelHit hit;
+            levelWorld.Raycast(shot.origin, shot.direction, shot.range, hit);
+        }
+        bvhSeconds += nowSeconds() - start;
+        start = nowSeconds();
+        for (const HitscanShot& shot : shots) {
+            LevelHit hit;
+            benchLevel.Raycast(shot.origin, shot.direction, shot.range, hit);
+        }
+        bruteSeconds += nowSeconds() - start;
+        for (const HitscanShot& shot : shots) {
+            LevelHit bvhHit, bruteHit;
+            bool bvhFound = levelWorld.Raycast(shot.origin, shot.direction, shot.range, bvhHit);
+            bool bruteFound = benchLevel.Raycast(shot.origin, shot.direction, shot.range, bruteHit);
+            if (bvhFound != bruteFound || (bvhFound && std::fabs(bvhHit.distance - bruteHit.distance) > 1e-3f)) {
+                mismatches++;
+            }
+        }
+    }
+    
+    double total = static_cast<double>(shotsPerTick) * ticks;
+    const HitscanStats& stats = batch.GetStats();
+    std::cout << "射击: 每帧 " << shotsPerTick << " 发（" << players << " 个玩家），" << ticks << " 帧，BVH "
+              << world.GetTriangleCount() << " 个三角形、" << world.GetNodeCount() << " 个节点" << std::endl;
+    std::cout << "  打包批处理每帧 " << batchSeconds * 1000.0 / ticks << " ms（" << stats.packets
+              << " 个射线包，含穿透计算），每发 " << batchSeconds * 1e6 / total << " us，平均穿过 "
+              << static_cast<double>(impacts) / total << " 个实体，穿透 " << penetrations * 100.0 / total << "%"
+              << std::endl;
+    std::cout << "  逐条射线每帧 " << singleSeconds * 1000.0 / ticks << " ms，每发 " << singleSeconds * 1e6 / total
+              << " us，平均 " << static_cast<double>(singleHits) / total << " 个交点" << std::endl;
+    std::cout << "  最近交点：BVH " << bvhSeconds * 1e6 / total << " us/次，逐个四边形 " << bruteSeconds * 1e6 / total
+              << " us/次，不一致 " << mismatches << " 次" << std::endl;
+}
+
+// 延迟补偿的速度：64个玩家在房间里以128Hz随机走动，每帧记录所有人的命中盒；
+// 每帧shotsPerTick发射击，射击者的延迟在0 - 150ms之间，瞄准另一个玩家在射击者看到的时间的胸口，
+// 倒回到那个时间求命中。与插值所有玩家、测试所有命中盒的结果比较
+void runLagCompensationBenchmark(int shotsPerTick) {
+    const int players = 64;
+    const int tickRate = 128;
+    const int ticks = 512;
+    const float tickSeconds = 1.0f / tickRate;
+    const float interpolationSeconds = 2.0f / tickRate;   // 客户端在两个快照之间插值
+    const float maxLatency = 0.15f;
+    
+    LagCompensation history(players, tickRate);
+    std::vector<glm::vec3> positions(players);
+    std::vector<glm::vec3> velocities(players);
+    std::vector<float> yaws(players);
+    for (int i = 0; i < players; i++) {
+        positions[i] = glm::vec3(rand() % 5001 / 100.0f - 25.0f, 0.0f, rand() % 5001 / 100.0f - 25.0f);
+        yaws[i] = static_cast<float>(rand() % 360);
+    }
+    
+    double recordSeconds = 0.0;
+    double rewindSeconds = 0.0;
+    long long shots = 0;
+    long long hits = 0;
+    long long rewound = 0;
+    int mismatches = 0;
+    for (int tick = 0; tick < ticks; tick++) {
+        // 走动：随机转向，速度约为步行速度
+        for (int i = 0; i < players; i++) {
+            yaws[i] += static_cast<float>(rand() % 21 - 10);
+            float radYaw = yaws[i] * float(M_PI) / 180.0f;
+            velocities[i] = glm::vec3(std::cos(radYaw), 0.0f, std::sin(radYaw)) * 4.0f;
+            positions[i] = glm::clamp(positions[i] + velocities[i] * tickSeconds, glm::vec3(-28.0f, 0.0f, -28.0f),
+                                      glm::vec3(28.0f, 0.0f, 28.0f));
+        }
+        
+        double start = nowSeconds();
+        for (int i = 0; i < players; i++) {
+            EntityPose pose;
+            GameSimulation::BuildHitboxes(positions[i], yaws[i], 0.0f, pose);
+            history.Record(i, tick, pose);
+        }
+        recordSeconds += nowSeconds() - start;
+        if (tick < tickRate) {
+            continue;
+        }
+        
+        for (int shot = 0; shot < shotsPerTick; shot++) {
+            int shooter = rand() % players;
+            int target = (shooter + 1 + rand() % (players - 1)) % players;
+            float latency = rand() % 1001 / 1000.0f * maxLatency;
+            float viewTick = tick - (latency + interpolationSeconds) * tickRate;
+            EntityPose shooterPose, targetPose;
+            history.GetPose(shooter, static_cast<float>(tick), shooterPose);
+            history.GetPose(target, viewTick, targetPose);
+            glm::vec3 origin = shooterPose.position + glm::vec3(0.0f, 1.6f, 0.0f);
+            glm::vec3 aim = (targetPose.hitboxes[1].a + targetPose.hitboxes[1].b) * 0.5f +
+                            glm::vec3(rand() % 41 - 20, rand() % 41 - 20, rand() % 41 - 20) / 100.0f;
+            glm::vec3 direction = glm::normalize(aim - origin);
+            
+            start = nowSeconds();
+            LagRewind rewind(history, viewTick, origin, direction, 100.0f, shooter);
+            LagHit hit;
+            bool found = rewind.Raycast(hit);
+            rewindSeconds += nowSeconds() - start;
+            shots++;
+            rewound += rewind.GetEntityCount();
+            hits += found ? 1 : 0;
+            
+            // 所有玩家都插值出来逐个测试
+            int bruteEntity = -1;
+            float bruteDistance = 100.0f;
+            for (int i = 0; i < players; i++) {
+                EntityPose pose;
+                if (i == shooter || !history.GetPose(i, viewTick, pose)) {
+                    continue;
+                }
+                for (int h = 0; h < pose.hitboxCount; h++) {
+                    float distance;
+                    if (RaycastHitbox(origin, direction, pose.hitboxes[h], distance) && distance < bruteDistance) {
+                        bruteDistance = distance;
+                        bruteEntity = i;
+                    }
+                }
+            }
+            if (bruteEntity != (found ? hit.entity : -1) || (found && std::fabs(bruteDistance - hit.distance) > 1e-4f)) {
+                mismatches++;
+            }
+        }
+    }
+    
+    std::cout << "延迟补偿: " << players << " 个玩家，" << history.GetHistoryTicks() << " 帧历史（" << tickRate
+              << " Hz），" << history.GetMemoryBytes() / 1024 << " KB" << std::endl;
+    std::cout << "  记录每帧 " << recordSeconds * 1e6 / ticks << " us（所有玩家）" << std::endl;
+    std::cout << "  倒回射击 " << rewindSeconds * 1e6 / shots << " us/发，平均插值 "
+              << static_cast<double>(rewound) / shots << " 个玩家，命中 " << hits * 100.0 / shots
+              << "%，与逐个测试不一致 " << mismatches << " 次" << std::endl;
+}
+
+// 两个移动状态逐位相同
+bool samePlayerState(const PlayerState& a, const PlayerState& b) {
+    return memcmp(&a.position, &b.position, sizeof(glm::vec3)) == 0 &&
+           memcmp(&a.velocity, &b.velocity, sizeof(glm::vec3)) == 0 &&
+           memcmp(&a.duckAmount, &b.duckAmount, sizeof(float)) == 0 && a.onGround == b.onGround &&
+           a.previousButtons == b.previousButtons;
+}
+
+// 玩家移动的速度和可重复性：count个玩家在有箱子和矮台阶的房间里按随机命令跑、跳、蹲，模拟1024帧（128Hz），
+// 同样的命令再模拟一遍比较结果是否逐位相同；再从30帧之前的状态重新模拟（客户端预测的情况），与第一次比较
+void runMovementBenchmark(int count) {
+    LevelGeometry benchLevel;
+    benchLevel.Build();
+    CollisionWorld world;
+    world.AddLevel(benchLevel);
+    for (int i = 0; i < 64; i++) {
+        glm::vec3 corner(rand() % 5001 / 100.0f - 25.0f, 0.0f, rand() % 5001 / 100.0f - 25.0f);
+        // 一半是跳不上去的箱子，一半是能走上去的台阶
+        float height = i % 2 == 0 ? 1.0f + rand() % 101 / 100.0f : 0.1f + rand() % 31 / 100.0f;
+        float size = 1.0f + rand() % 201 / 100.0f;
+        world.AddBox(corner, corner + glm::vec3(size, height, size), -1);
+    }
+    world.Build();
+    PlayerMovement movement;
+    movement.SetWorld(&world);
+    
+    const int ticks = 1024;
+    const int replayTicks = 30;
+    std::vector<PlayerState> initial(count);
+    for (int i = 0; i < count; i++) {
+        initial[i] = {};
+        initial[i].position = glm::vec3(rand() % 5001 / 100.0f - 25.0f, 3.0f, rand() % 5001 / 100.0f - 25.0f);
+    }
+    // 命令：视角随机转动，大多数时候向前跑，偶尔跳、蹲、静步、横移
+    std::vector<PlayerCommand> commands(static_cast<size_t>(ticks) * count);
+    for (int i = 0; i < count; i++) {
+        float yaw = static_cast<float>(rand() % 360);
+        for (int tick = 0; tick < ticks; tick++) {
+            yaw += static_cast<float>(rand() % 9 - 4);
+            PlayerCommand& command = commands[static_cast<size_t>(tick) * count + i];
+            command.tick = tick;
+            command.yaw = PlayerMovement::QuantizeYaw(yaw);
+            command.forward = static_cast<int8_t>(rand() % 8 == 0 ? 0 : 127);
+            command.side = static_cast<int8_t>(rand() % 4 == 0 ? rand() % 255 - 127 : 0);
+            command.buttons = (rand() % 256 == 0 ? BUTTON_JUMP : 0) | (tick % 256 < 32 ? BUTTON_DUCK : 0) |
+                              (rand() % 4 == 0 ? BUTTON_WALK : 0);
+        }
+    }
+    
+    // 第一次模拟，保存重新模拟的起点
+    std::vector<PlayerState> states = initial;
+    std::vector<PlayerState> replayStart(count);
+    long long grounded = 0;
+    double start = nowSeconds();
+    for (int tick = 0; tick < ticks; tick++) {
+        if (tick == ticks - replayTicks) {
+            replayStart = states;
+        }
+        const PlayerCommand* tickCommands = &commands[static_cast<size_t>(tick) * count];
+        for (int i = 0; i < count; i++) {
+            movement.Simulate(states[i], tickCommands[i]);
+            grounded += states[i].onGround;
+        }
+    }
+    double simulateSeconds = nowSeconds() - start;
+    
+    // 同样的命令再模拟一遍
+    std::vector<PlayerState> again = initial;
+    for (int tick = 0; tick < ticks; tick++) {
+        const PlayerCommand* tickCommands = &commands[static_cast<size_t>(tick) * count];
+        for (int i = 0; i < count; i++) {
+            movement.Simulate(again[i], tickCommands[i]);
+        }
+    }
+    
+    // 从30帧之前重新模拟
+    start = nowSeconds();
+    for (int tick = ticks - replayTicks; tick < ticks; tick++) {
+        const PlayerCommand* tickCommands = &commands[static_cast<size_t>(tick) * count];
+        for (int i = 0; i < count; i++) {
+            movement.Simulate(replayStart[i], tickCommands[i]);
+        }
+    }
+    double replaySeconds = nowSeconds() - start;
+    
+    int rerunMismatches = 0;
+    int replayMismatches = 0;
+    float minHeight = states.empty() ? 0.0f : states[0].position.y;
+    for (int i = 0; i < count; i++) {
+        rerunMismatches += samePlayerState(states[i], again[i]) ? 0 : 1;
+        replayMismatches += samePlayerState(states[i], replayStart[i]) ? 0 : 1;
+        minHeight = std::min(minHeight, states[i].position.y);
+    }
+    
+    double total = static_cast<double>(ticks) * count;
+    std::cout << "玩家移动: " << count << " 个玩家，" << ticks << " 帧（" << movement.GetSettings().tickRate
+              << " Hz），BVH " << world.GetTriangleCount() << " 个三角形" << std::endl;
+    std::cout << "  每帧 " << simulateSeconds * 1000.0 / ticks << " ms，每个玩家每帧 " << simulateSeconds * 1e6 / total
+              << " us，在地面上 " << grounded * 100.0 / total << "%，最低的脚底 " << minHeight << std::endl;
+    std::cout << "  重新模拟" << replayTicks << "帧：每个玩家 " << replaySeconds * 1e6 / count << " us" << std::endl;
+    std::cout << "  同样的命令再模拟一遍不一致 " << rerunMismatches << " 个，从" << replayTicks << "帧前重新模拟不一致 "
+              << replayMismatches << " 个" << std::endl;
+}
+
+// 两点之间的视线有没有被挡住，玻璃不挡
+bool clearLine(const LevelGeometry& level, const CollisionWorld& world, const glm::vec3& from, const glm::vec3& to) {
+    glm::vec3 direction = to - from;
+    float remaining = glm::length(direction);
+    if (remaining < 1e-4f) {
+        return true;
+    }
+    direction /= remaining;
+    glm::vec3 origin = from;
+    LevelHit hit;
+    while (world.Raycast(origin, direction, remaining, hit)) {
+        if (!level.GetSurface(hit.surface).translucent) {
+            return false;
+        }
+        origin = hit.position + direction * 1e-3f;
+        remaining -= hit.distance + 1e-3f;
+    }
+    return true;
+}
+
+// 编译可见集：输出大小和压缩率；在单元格里随机取点对，视线没被挡住的点对必须可见（检查没有漏算）；
+// 测一次查找（两个位置各找叶子再查一位）的时间，最后存文件
+bool compileVisibility(const std::string& path) {
+    LevelGeometry level;
+    level.Build();
+    CollisionWorld world;
+    world.AddLevel(level);
+    world.Build();
+    VisibilitySet visibility;
+    if (!visibility.Compile(level)) {
+        std::cerr << "可见集编译失败" << std::endl;
+        return false;
+    }
+    const VisibilityStats& stats = visibility.GetStats();
+    std::cout << "可见集: " << stats.cells << " 个单元格，" << stats.leaves << " 个叶子，不同的行 " << stats.uniqueRows
+              << "，" << stats.rawBytes / 1024.0 << " KB 压缩到 " << stats.compressedBytes / 1024.0 << " KB，可见的叶子对 "
+              << stats.visibleFraction * 100.0f << "%，编译 " << stats.compileSeconds * 1000.0 << " ms" << std::endl;
+
+    const int SAMPLES = 200000;
+    const std::vector<LevelCell>& cells = level.GetCells();
+    uint32_t random = 12345;
+    auto randomPoint = [&]() {
+        random = random * 1664525u + 1013904223u;
+        const LevelCell& cell = cells[(random >> 8) % cells.size()];
+        glm::vec3 t;
+        for (int i = 0; i < 3; i++) {
+            random = random * 1664525u + 1013904223u;
+            t[i] = (random >> 8) / 16777216.0f;
+        }
+        return cell.minBounds + (cell.maxBounds - cell.minBounds) * t;
+    };
+    std::vector<glm::vec3> points(SAMPLES * 2);
+    for (glm::vec3& point : points) {
+        point = randomPoint();
+    }
+    int clear = 0;
+    int missed = 0;
+    int culled = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        bool canSee = visibility.CanSee(visibility.FindLeaf(points[i * 2]), visibility.FindLeaf(points[i * 2 + 1]));
+        if (clearLine(level, world, points[i * 2], points[i * 2 + 1])) {
+            clear++;
+            missed += canSee ? 0 : 1;
+        } else {
+            culled += canSee ? 0 : 1;
+        }
+    }
+    int blocked = SAMPLES - clear;
+    std::cout << "  随机点对 " << SAMPLES << "：视线通的 " << clear << "，其中判为不可见 " << missed << "（必须为0）；被挡住的 "
+              << blocked << "，其中剔除掉 " << (blocked > 0 ? culled * 100.0 / blocked : 0.0) << "%" << std::endl;
+
+    double start = nowSeconds();
+    int visible = 0;
+    const int ROUNDS = 20;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < SAMPLES; i++) {
+            visible += visibility.CanSee(visibility.FindLeaf(points[i * 2]), visibility.FindLeaf(points[i * 2 + 1]));
+        }
+    }
+    double lookupNanos = (nowSeconds() - start) * 1e9 / (static_cast<double>(ROUNDS) * SAMPLES);
+    std::cout << "  查找 " << lookupNanos << " ns（两次找叶子和一次查位，可见 " << visible / ROUNDS << "）" << std::endl;
+
+    if (missed > 0 || !visibility.Save(path)) {
+        std::cerr << "无法保存可见集: " << path << std::endl;
+        return false;
+    }
+    std::cout << "  已保存到 " << path << std::endl;
+    return true;
+}
+
+// 生成导航网格：输出每一步的大小和时间；512个机器人从随机的点到随机的点寻路，
+// 拐点之间的视线（膝盖高度）不能被挡住；比较只在多边形上A*和走层次图的时间和路径长度，
+// 再看512个机器人去16个固定地点时路径缓存的效果；最后存文件，读回来检查
+bool compileNavMesh(const std::string& path) {
+    LevelGeometry level;
+    level.Build();
+    CollisionWorld world;
+    world.AddLevel(level);
+    world.Build();
+    NavMesh mesh;
+    if (!mesh.Build(level)) {
+        std::cerr << "导航网格生成失败" << std::endl;
+        return false;
+    }
+    const NavMeshStats& stats = mesh.GetStats();
+    std::cout << "导航网格: " << stats.columns << " 列，" << stats.spans << " 个实心段，能站人的格子 " << stats.walkableCells
+              << "，离墙收缩后 " << stats.cells << "，" << stats.regions << " 个区域，" << stats.polygons << " 个多边形，"
+              << stats.links << " 个连接；生成 " << stats.buildSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "  层次图: " << stats.clusters << " 个簇，" << stats.entrances << " 个入口，" << stats.abstractEdges
+              << " 条边；建图 " << stats.graphSeconds * 1000.0 << " ms" << std::endl;
+
+    const int AGENTS = 512;
+    uint32_t random = 12345;
+    auto randomPoint = [&]() {
+        random = random * 1664525u + 1013904223u;
+        int polygon = static_cast<int>((random >> 8) % mesh.GetPolygonCount());
+        glm::vec3 lo = mesh.GetPolygonMin(polygon);
+        glm::vec3 hi = mesh.GetPolygonMax(polygon);
+        random = random * 1664525u + 1013904223u;
+        float tx = (random >> 8) / 16777216.0f;
+        random = random * 1664525u + 1013904223u;
+        float tz = (random >> 8) / 16777216.0f;
+        return glm::vec3(lo.x + (hi.x - lo.x) * tx, lo.y, lo.z + (hi.z - lo.z) * tz);
+    };
+    std::vector<glm::vec3> starts(AGENTS), goals(AGENTS);
+    for (int i = 0; i < AGENTS; i++) {
+        starts[i] = randomPoint();
+        goals[i] = randomPoint();
+    }
+    auto pathLength = [](const std::vector<glm::vec3>& points) {
+        float length = 0.0f;
+        for (size_t i = 1; i < points.size(); i++) {
+            length += glm::length(points[i] - points[i - 1]);
+        }
+        return length;
+    };
+
+    // 先只在多边形上A*（默认），再总是走层次图（起点和终点不在同一个簇时）
+    const int thresholds[2] = {-1, 0};
+    std::vector<float> flatLengths(AGENTS, 0.0f);
+    std::vector<glm::vec3> points;
+    bool valid = true;
+    for (int pass = 0; pass < 2; pass++) {
+        NavPathfinder pathfinder(mesh);
+        pathfinder.SetCacheEnabled(false);
+        pathfinder.SetHierarchyThreshold(thresholds[pass]);
+        int found = 0;
+        int blocked = 0;
+        double longer = 0.0;
+        for (int i = 0; i < AGENTS; i++) {
+            if (!pathfinder.FindPath(starts[i], goals[i], points)) {
+                continue;
+            }
+            found++;
+            for (size_t k = 1; k < points.size(); k++) {
+                glm::vec3 knee(0.0f, 0.5f, 0.0f);
+                if (!clearLine(level, world, points[k - 1] + knee, points[k] + knee)) {
+                    blocked++;
+                    break;
+                }
+            }
+            if (pass == 0) {
+                flatLengths[i] = pathLength(points);
+            } else {
+                longer += pathLength(points) / std::max(flatLengths[i], 1e-3f);
+            }
+        }
+        const NavPathStats& pathStats = pathfinder.GetStats();
+        std::cout << "  " << (pass == 0 ? "多边形上A*" : "层次图") << ": " << AGENTS << " 次寻路，找到 " << found << "，穿墙 "
+                  << blocked << "（必须为0），每次 " << pathStats.seconds * 1e6 / AGENTS << " us，展开 "
+                  << static_cast<double>(pathStats.expanded) / AGENTS << " 个节点";
+        if (pass == 1) {
+            std::cout << "，走层次图的 " << pathStats.hierarchical << "，路径长度是最短的 " << longer / std::max(found, 1) << " 倍";
+        }
+        std::cout << std::endl;
+        valid = valid && blocked == 0 && found > 0;
+    }
+
+    // 路径缓存：机器人在随机的点上，去16个地点中的一个，每轮所有机器人都重新寻路
+    NavPathfinder pathfinder(mesh);
+    std::vector<glm::vec3> hotspots(16);
+    for (glm::vec3& hotspot : hotspots) {
+        hotspot = randomPoint();
+    }
+    const int ROUNDS = 8;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < AGENTS; i++) {
+            pathfinder.FindPath(starts[(i + round * 7) % AGENTS], hotspots[(i + round) % hotspots.size()], points);
+        }
+    }
+    const NavPathStats& cached = pathfinder.GetStats();
+    std::cout << "  路径缓存: " << cached.queries << " 次寻路，命中 " << cached.cacheHits * 100.0 / std::max(1LL, cached.queries)
+              << "%，每次 " << cached.seconds * 1e6 / std::max(1LL, cached.queries) << " us（" << AGENTS
+              << " 个机器人每帧都寻路时 " << cached.seconds * 1e3 / ROUNDS << " ms/帧）" << std::endl;
+
+    NavMesh loaded;
+    if (!valid || !mesh.Save(path) || !loaded.Load(path) || loaded.GetPolygonCount() != mesh.GetPolygonCount() ||
+        loaded.GetStats().links != stats.links) {
+        std::cerr << "无法保存导航网格: " << path << std::endl;
+        return false;
+    }
+    std::cout << "  已保存到 " << path << std::endl;
+    return true;
+}
+
+// 一帧所有玩家的校验和，检查跳转后解出来的和顺序回放的一样
+uint32_t frameChecksum(const DemoFrame& frame) {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    };
+    for (const NetPlayerState& player : frame.players) {
+        mix(&player.slot, 4);
+        mix(&player.yaw, 4);
+        mix(&player.position, sizeof(player.position));
+        mix(&player.velocity, sizeof(player.velocity));
+    }
+    for (const ExecutedCommand& command : frame.commands) {
+        mix(&command.slot, sizeof(command.slot));
+        mix(&command.command.tick, sizeof(command.command.tick));
+        mix(&command.command.buttons, sizeof(command.command.buttons));
+    }
+    return hash;
+}
+
+// 无界面回放：顺序解码整个录像（数命令、开火和死亡），算出比实时快多少倍；
+// 再随机跳转到一些帧，和顺序回放时的校验和比较，统计每次跳转的时间
+bool playDemo(const std::string& path) {
+    DemoPlayer player;
+    double openStart = nowSeconds();
+    if (!player.Open(path)) {
+        std::cerr << "无法打开录像: " << path << std::endl;
+        return false;
+    }
+    double openMillis = (nowSeconds() - openStart) * 1000.0;
+    int firstTick = player.GetFirstTick();
+    int lastTick = player.GetLastTick();
+    double seconds = static_cast<double>(lastTick - firstTick + 1) / player.GetTickRate();
+    std::cout << "录像: " << path << "，" << player.GetFileSize() / 1024.0 / 1024.0 << " MB，帧 " << firstTick << " - "
+              << lastTick << "（" << seconds << " 秒），" << player.GetChunkCount() << " 块，"
+              << (player.HasIndex() ? "读取索引" : "没有索引，扫描块头") << " " << openMillis << " ms" << std::endl;
+
+    std::vector<uint32_t> checksums(lastTick - firstTick + 1, 0);
+    std::vector<uint8_t> seen(checksums.size(), 0);
+    std::vector<uint8_t> alive(player.GetMaxPlayers(), 0);
+    DemoFrame frame;
+    long long frames = 0;
+    long long commands = 0;
+    long long shots = 0;
+    long long deaths = 0;
+    double start = nowSeconds();
+    while (player.ReadTick(frame)) {
+        frames++;
+        commands += frame.commands.size();
+        for (const ExecutedCommand& command : frame.commands) {
+            shots += (command.command.buttons & BUTTON_ATTACK) ? 1 : 0;
+        }
+        for (const NetPlayerState& state : frame.players) {
+            bool isAlive = (state.flags & NetPlayerState::FLAG_ALIVE) != 0;
+            deaths += alive[state.slot] && !isAlive ? 1 : 0;
+            alive[state.slot] = isAlive;
+        }
+        checksums[frame.tick - firstTick] = frameChecksum(frame);
+        seen[frame.tick - firstTick] = 1;
+    }
+    double playSeconds = nowSeconds() - start;
+    std::cout << "  顺序回放 " << frames << " 帧，" << playSeconds * 1000.0 << " ms，" << frames / playSeconds
+              << " 帧/秒（" << seconds / playSeconds << " 倍实时）；命令 " << commands << "，按住开火 " << shots
+              << "，死亡 " << deaths << std::endl;
+
+    const int SEEKS = 1000;
+    uint32_t random = 2463534242u;
+    int mismatches = 0;
+    int failures = 0;
+    start = nowSeconds();
+    for (int i = 0; i < SEEKS; i++) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        int tick = firstTick + static_cast<int>(random % checksums.size());
+        if (!player.Seek(tick) || !player.ReadTick(frame) || frame.tick != tick) {
+            failures += seen[tick - firstTick] ? 1 : 0;
+            continue;
+        }
+        mismatches += frameChecksum(frame) != checksums[tick - firstTick] ? 1 : 0;
+    }
+    double seekMicros = (nowSeconds() - start) * 1e6 / SEEKS;
+    std::cout << "  随机跳转 " << SEEKS << " 次，平均 " << seekMicros << " us（从关键帧最多解码 "
+              << DemoRecorder::KEYFRAME_INTERVAL << " 帧），失败 " << failures << "，和顺序回放不一致 " << mismatches
+              << std::endl;
+    return failures == 0 && mismatches == 0;
+}
+
+int main(int argc, char** argv) {
+    if (!parseArguments(argc, argv)) {
+        return -1;
+    }
+    if (snapshotBenchPlayers > 0) {
+        runSnapshotBenchmark(snapshotBenchPlayers);
+        return 0;
+    }
+    if (!compilePvsPath.empty()) {
+        return compileVisibility(compilePvsPath) ? 0 : -1;
+    }
+    if (!compileNavPath.empty()) {
+        return compileNavMesh(compileNavPath) ? 0 : -1;
+    }
+    if (!playPath.empty()) {
+        return playDemo(playPath) ? 0 : -1;
+    }
+    if (botBenchCount > 0) {
+        runBotBenchmark(botBenchCount);
+        return 0;
+    }
+    if (collisionBenchCount > 0) {
+        runCollisionBenchmark(collisionBenchCount);
+        return 0;
+    }
+    if (broadphaseBenchCount > 0) {
+        runBroadphaseBenchmark(broadphaseBenchCount);
+        return 0;
+    }
+    if (hitscanBenchCount > 0) {
+        runHitscanBenchmark(hitscanBenchCount);
+        return 0;
+    }
+    if (lagCompensationBenchCount > 0) {
+        runLagCompensationBenchmark(lagCompensationBenchCount);
+        return 0;
+    }
+    if (movementBenchCount > 0) {
+        runMovementBenchmark(movementBenchCount);
+        return 0;
+    }
+    if (botCount < 0 || botCount > maxPlayers) {
+        std::cerr << "机器人数必须在0到槽位数之间: " << botCount << std::endl;
+        return -1;
+    }
+    if ((loopbackClients > 0 || botCount > 0) && runSeconds <= 0.0) {
+        runSeconds = 10.0;
+    }
+
+    GameSettings settings;
+    settings.tickRate = tickRate;
+    settings.maxPlayers = maxPlayers;
+    GameServer server(settings);
+    VisibilitySet visibility;
+    if (!pvsPath.empty()) {
+        if (!visibility.Load(pvsPath)) {
+            std::cerr << "无法加载可见集: " << pvsPath << std::endl;
+            return -1;
+        }
+    } else {
+        visibility.Compile(server.GetSimulation().GetLevel());
+    }
+    server.SetVisibility(&visibility);
+    NavMesh navMesh;
+    if (!navPath.empty()) {
+        if (!navMesh.Load(navPath)) {
+            std::cerr << "无法加载导航网格: " << navPath << std::endl;
+            return -1;
+        }
+    } else {
+        navMesh.Build(server.GetSimulation().GetLevel());
+    }
+    NavPathfinder pathfinder(navMesh);
+    BotSettings botSettings;
+    botSettings.tickRate = tickRate;
+    BotController bots(server.GetSimulation().GetLevel(), botSettings);
+    if (navMesh.IsValid()) {
+        bots.SetNavigation(&pathfinder);
+    }
+    for (int i = 0; i < botCount; i++) {
+        bots.AddBot(server.GetSimulation().AddPlayer(), 0x7F4A7C15u * (i + 1));
+    }
+    std::vector<BotTarget> botTargets;
+    std::vector<PlayerCommand> botCommands;
+    DemoRecorder recorder;
+    if (!recordPath.empty()) {
+        if (!recorder.Open(recordPath, tickRate, maxPlayers)) {
+            std::cerr << "无法创建录像: " << recordPath << std::endl;
+            return -1;
+        }
+        server.SetRecorder(&recorder);
+    }
+    if (!server.Start(static_cast<uint16_t>(serverPort), loopbackClients > 0)) {
+        std::cerr << "无法绑定UDP端口 " << serverPort << std::endl;
+        return -1;
+    }
+    std::cout << "服务器: 端口 " << server.GetPort() << "，" << tickRate << " Hz，" << maxPlayers << " 个槽位，可见集 "
+              << visibility.GetLeafCount() << " 个叶子（" << (pvsPath.empty() ? "启动时编译" : pvsPath) << "），导航网格 "
+              << navMesh.GetPolygonCount() << " 个多边形（" << (navPath.empty() ? "启动时生成" : navPath) << "）"
+              << std::endl;
+    if (botCount > 0) {
+        std::cout << "机器人: " << botCount << " 个，在服务器进程里" << std::endl;
+    }
+
+    std::atomic<bool> clientsRunning(true);
+    std::vector<LoopbackResult> clientResults(loopbackClients);
+    std::thread clientThread;
+    if (loopbackClients > 0) {
+        std::cout << "测试客户端: " << loopbackClients << " 个，本机回环，往返延迟 " << clientLatencyMs << " ms，抖动 "
+                  << clientJitterMs << " ms，丢包 " << clientLossPercent << "%" << std::endl;
+        clientThread = std::thread(runLoopbackClients, server.GetPort(), loopbackClients, &navMesh,
+                                   std::ref(clientsRunning), std::ref(clientResults));
+    }
+
+    // 固定帧率：按开始时间排好每一帧，睡到下一帧的时刻；落后超过1秒时不再追赶
+    const double period = 1.0 / tickRate;
+    double start = nowSeconds();
+    double cpuStart = threadCpuSeconds();
+    double next = start;
+    int lateTicks = 0;
+    while (runSeconds <= 0.0 || nowSeconds() - start < runSeconds) {
+        if (botCount > 0) {
+            thinkBots(server.GetSimulation(), bots, botTargets, botCommands);
+        }
+        double tickStart = nowSeconds();
+        server.RunTick();
+        double tickEnd = nowSeconds();
+        if (tickTimes.size() < MAX_TICK_SAMPLES) {
+            tickTimes.push_back(tickEnd - tickStart);
+        } else {
+            tickTimes[tickSampleCount % MAX_TICK_SAMPLES] = tickEnd - tickStart;
+        }
+        tickSampleCount++;
+
+        next += period;
+        if (tickEnd > next) {
+            lateTicks++;
+            if (tickEnd - next > 1.0) {
+                next = tickEnd;
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::duration<double>(next - tickEnd));
+        }
+    }
+    double wallSeconds = nowSeconds() - start;
+    double cpuSeconds = threadCpuSeconds() - cpuStart;
+    clientsRunning = false;
+    if (clientThread.joinable()) {
+        clientThread.join();
+    }
+    server.Stop();
+    bool recorded = recorder.IsOpen() && recorder.Close();
+
+    // 结果
+    const ServerStats& stats = server.GetStats();
+    const GameStats& game = server.GetSimulation().GetStats();
+    std::vector<double> sorted = tickTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (double time : tickTimes) {
+        total += time;
+    }
+    double ticks = std::max<double>(1.0, static_cast<double>(stats.ticks));
+    std::cout << "运行 " << wallSeconds << " 秒，" << stats.ticks << " 帧（" << stats.ticks / wallSeconds
+              << " Hz），迟到 " << lateTicks << " 帧，连接 " << stats.connects << " 次，超时 " << stats.timeouts << " 次"
+              << std::endl;
+    if (!sorted.empty()) {
+        std::cout << "  最近 " << sorted.size() << " 帧 平均 " << total * 1000.0 / sorted.size() << " ms，中位数 "
+                  << sorted[sorted.size() / 2] * 1000.0 << " ms，99% " << sorted[sorted.size() * 99 / 100] * 1000.0
+                  << " ms，最长 " << sorted.back() * 1000.0 << " ms" << std::endl;
+    }
+    std::cout << "  服务器线程CPU " << cpuSeconds / wallSeconds * 100.0 << "% 个核心" << std::endl;
+    std::cout << "  收 " << stats.packetsIn / ticks << " 包/帧，发 " << stats.packetsOut / ticks << " 包/帧，"
+              << stats.bytesOut / ticks / 1024.0 << " KB/帧（" << stats.bytesOut / wallSeconds / 1e6 << " MB/s）"
+              << std::endl;
+    // 模拟线程每帧最多一次write唤醒I/O线程，I/O线程的系统调用和客户端数基本无关
+    const NetIoStats& io = server.GetIoStats();
+    std::cout << "  I/O线程 每帧 poll " << io.wakeups / ticks << " 次，recvmmsg " << io.receiveCalls / ticks << " 次，sendmmsg "
+              << io.sendCalls / ticks << " 次，唤醒 " << io.flushes / ticks << " 次（逐包收发时约 "
+              << (stats.packetsIn + stats.packetsOut) / ticks << " 次）；发包池满丢掉 " << stats.sendDrops << "，发送失败 "
+              << io.sendFailures << std::endl;
+    std::cout << "  命令 " << game.commands << "，重复或过时 " << game.droppedCommands << "，射击 " << game.shots << "，命中 "
+              << game.hits << "，击杀 " << game.kills << std::endl;
+    if (recorded) {
+        const DemoStats& demo = recorder.GetStats();
+        std::cout << "  录像 " << recordPath << "：" << demo.ticks << " 帧，" << demo.chunks << " 块，"
+                  << demo.fileBytes / 1024.0 / 1024.0 << " MB（每帧命令 "
+                  << static_cast<double>(demo.commandBytes) / std::max(1LL, demo.ticks) << " 字节，快照 "
+                  << static_cast<double>(demo.snapshotBytes) / std::max(1LL, demo.ticks) << " 字节）" << std::endl;
+    }
+    if (botCount > 0) {
+        const BotStats& botStats = bots.GetStats();
+        std::cout << "  机器人思考 " << botStats.thinkSeconds * 1e6 / std::max(1LL, botStats.thinks) << " us/帧（其中避让 "
+                  << botStats.steerSeconds * 1e6 / std::max(1LL, botStats.thinks) << " us），开火命令 "
+                  << botStats.attacks * 100.0 / std::max(1LL, botStats.commands) << "%" << std::endl;
+        const NavPathStats& pathStats = pathfinder.GetStats();
+        std::cout << "  机器人寻路 " << pathStats.queries << " 次，缓存命中 "
+                  << pathStats.cacheHits * 100.0 / std::max(1LL, pathStats.queries) << "%，失败 " << pathStats.failures
+                  << "，每次 " << pathStats.seconds * 1e6 / std::max(1LL, pathStats.queries) << " us" << std::endl;
+    }
+    std::cout << "  不在可见集里没有发的玩家平均每个快照 "
+              << (stats.snapshots > 0 ? static_cast<double>(stats.culledPlayers) / stats.snapshots : 0.0) << " 个"
+              << std::endl;
+    if (loopbackClients > 0) {
+        long long snapshots = 0;
+        long long bytesIn = 0;
+        PredictionStats prediction;
+        InterpolationStats interpolation;
+        long long pending = 0;
+        long long frames = 0;
+        double delay = 0.0;
+        long long bytesOut = 0;
+        long long serverTickMicros = 0;
+        int maxServerTickMicros = 0;
+        for (const LoopbackResult& client : clientResults) {
+            snapshots += client.network.snapshots;
+            bytesIn += client.network.bytesIn;
+            prediction.commands += client.prediction.commands;
+            prediction.corrections += client.prediction.corrections;
+            prediction.replayedTicks += client.prediction.replayedTicks;
+            prediction.snaps += client.prediction.snaps;
+            prediction.maxReplayTicks = std::max(prediction.maxReplayTicks, client.prediction.maxReplayTicks);
+            prediction.replaySeconds += client.prediction.replaySeconds;
+            interpolation.samples += client.interpolation.samples;
+            interpolation.underruns += client.interpolation.underruns;
+            interpolation.late += client.interpolation.late;
+            pending += client.pendingCommands;
+            frames += client.frames;
+            delay += client.delayTicks;
+            bytesOut += client.network.bytesOut;
+            serverTickMicros += client.serverTickMicros;
+            maxServerTickMicros = std::max(maxServerTickMicros, client.maxServerTickMicros);
+        }
+        std::cout << "  客户端平均每秒收到 " << snapshots / wallSeconds / loopbackClients << " 个快照，每个快照 "
+                  << (snapshots > 0 ? static_cast<double>(bytesIn) / snapshots : 0.0) << " 字节" << std::endl;
+        std::cout << "  机器人看到的: 服务器每帧平均 "
+                  << (snapshots > 0 ? static_cast<double>(serverTickMicros) / snapshots : 0.0) << " us，最长 "
+                  << maxServerTickMicros << " us；每个机器人收 " << bytesIn / wallSeconds / loopbackClients / 1024.0
+                  << " KB/s，发 " << bytesOut / wallSeconds / loopbackClients / 1024.0 << " KB/s" << std::endl;
+        std::cout << "  预测: 命令 " << prediction.commands << "，平均未确认 "
+                  << (frames > 0 ? static_cast<double>(pending) / frames : 0.0) << " 个，重新模拟 "
+                  << prediction.corrections << " 次（平均 "
+                  << (prediction.corrections > 0 ? static_cast<double>(prediction.replayedTicks) / prediction.corrections
+                                                 : 0.0)
+                  << " 帧，最多 " << prediction.maxReplayTicks << " 帧，每帧 "
+                  << (prediction.replayedTicks > 0 ? prediction.replaySeconds * 1e6 / prediction.replayedTicks : 0.0)
+                  << " us），误差太大直接跳过 " << prediction.snaps << " 次" << std::endl;
+        std::cout << "  插值: 缓冲延迟平均 " << delay / loopbackClients << " 帧，取样 " << interpolation.samples
+                  << " 次，超过最新快照 " << interpolation.underruns << " 次，迟到的快照 " << interpolation.late << std::endl;
+        std::cout << "  重新模拟32帧 " << measureReplayMicros() << " us" << std::endl;
+    }
+    return 0;
+}